@@ -314,10 +314,10 @@ uint64_t BlockchainDB::add_block( const std::pair<block, blobdata>& blck
 
     // count the current block's rct outs by asset type
     for (auto& vout: blk.miner_tx.vout) {
-      std::string asset_type;
-      if (!get_output_asset_type(vout, asset_type))
+      offshore::asset_id_t asset_id;
+      if (!get_output_asset_id(vout, asset_id))
         throw std::runtime_error("Failed to get output asset type");
-      num_rct_outs_by_asset_type.add(asset_type, 1);
+      num_rct_outs_by_asset_type.add(asset_id, 1);
     }
   }
   int tx_i = 0;
@@ -330,10 +330,10 @@ uint64_t BlockchainDB::add_block( const std::pair<block, blobdata>& blck
     {
       if (vout.amount == 0) {
         ++num_rct_outs;
-      std::string asset_type;
-      if (!get_output_asset_type(vout, asset_type))
+      offshore::asset_id_t asset_id;
+      if (!get_output_asset_id(vout, asset_id))
         throw std::runtime_error("Failed to get output asset type");
-      num_rct_outs_by_asset_type.add(asset_type, 1);
+      num_rct_outs_by_asset_type.add(asset_id, 1);
       }
     }
     ++tx_i;
@@ -455,6 +455,15 @@ transaction BlockchainDB::get_pruned_tx(const crypto::hash& h) const
   return tx;
 }
 
+std::shared_ptr<const offshore::supply_snapshot> BlockchainDB::get_supply_snapshot() const
+{
+  std::shared_ptr<offshore::supply_snapshot> snapshot = std::make_shared<offshore::supply_snapshot>();
+  if (!snapshot->from_amounts(get_circulating_supply()))
+    throw DB_ERROR("Failed to parse circulating supply retrieved from the db");
+  snapshot->height = height();
+  return snapshot;
+}
+
 void BlockchainDB::reset_stats()
 {
   num_calls = 0;
@@ -30,6 +30,7 @@
 
 #pragma once
 
+#include <memory>
 #include <string>
 #include <exception>
 #include <boost/program_options.hpp>
@@ -41,6 +42,7 @@
 #include "cryptonote_basic/hardfork.h"
 #include "cryptonote_protocol/enums.h"
 #include "offshore/asset_types.h"
+#include "offshore/supply_snapshot.h"
 
 /** \file
  * Cryptonote Blockchain Database Interface
@@ -1071,6 +1073,38 @@ public:
    */
   virtual uint64_t get_block_already_generated_coins(const uint64_t& height) const = 0;
 
+  /**
+   * @brief fetch a block's pricing record
+   *
+   * The subclass should return the pricing record stored alongside the
+   * block's metadata, without parsing the block itself.
+   *
+   * Databases migrated from versions which did not keep the pricing record
+   * have an empty record for the blocks they held at the time, the subclass
+   * should fall back to the block header for those.
+   *
+   * If the block does not exist, the subclass should throw BLOCK_DNE
+   *
+   * @param height the height requested
+   *
+   * @return the pricing record
+   */
+  virtual offshore::pricing_record get_block_pricing_record(const uint64_t& height) const = 0;
+
+  /**
+   * @brief fetch the pricing records of a range of blocks
+   *
+   * As get_block_pricing_record, for count blocks from start_height.
+   *
+   * If there are fewer blocks, the returned array will be smaller than count
+   *
+   * @param start_height the height of the first block
+   * @param count the number of blocks requested
+   *
+   * @return the pricing records
+   */
+  virtual std::vector<offshore::pricing_record> get_block_pricing_records(uint64_t start_height, size_t count) const = 0;
+
   /**
    * @brief fetch a block's long term weight
    *
@@ -1176,10 +1210,25 @@ public:
    * @return the current circulating supply tally values
    */
   virtual std::vector<std::pair<std::string, std::string>> get_circulating_supply() const = 0;
+
+  /**
+   * @brief fetch a typed snapshot of the circulating supply at the top of the blockchain
+   *
+   * The default implementation converts the result of get_circulating_supply().
+   * Subclasses should keep the snapshot in memory and update it as blocks
+   * are added and removed, so that callers need neither a read txn nor any
+   * string parsing.
+   *
+   * @return the current circulating supply snapshot
+   */
+  virtual std::shared_ptr<const offshore::supply_snapshot> get_supply_snapshot() const;
   
   /**
    * @brief Recalculate supply after the audit
    *
+   * Progress is committed in checkpoints, so an interrupted recalculation
+   * resumes where it stopped when called again with the same key.
+   *
    * @param decryption_secretkey Decryption key for amount_encrypted
    */
   virtual void recalculate_supply_after_audit(const rct::key & decryption_secretkey) = 0;
@@ -1618,6 +1667,22 @@ public:
    */
   virtual cryptonote::blobdata get_txpool_tx_blob(const crypto::hash& txid, relay_category tx_category) const = 0;
 
+  /**
+   * @brief get a txpool transaction's metadata and blob without copying them
+   *
+   * The returned pointer and blob point into the database, so this may only
+   * be called with a db txn already open (a batch, or a read txn from
+   * block_rtxn_start), and they are only valid until that txn ends or
+   * writes to the txpool.
+   *
+   * @param txid the transaction id of the transation to lookup
+   * @param meta return-by-reference the metadata
+   * @param blob return-by-reference the blob
+   *
+   * @return true if the tx was found, false otherwise
+   */
+  virtual bool get_txpool_tx_view(const crypto::hash& txid, const txpool_tx_meta_t *&meta, cryptonote::blobdata_ref &blob) const = 0;
+
   /**
    * @brief Check if `tx_hash` relay status is in `category`.
    *
@@ -0,0 +1,97 @@
+// Copyright (c) 2023, Haven Protocol
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+namespace cryptonote
+{
+
+  // In-memory copy of the per-height hard fork versions. Versions only change at a
+  // handful of heights, so the table stores the height at which each run of equal
+  // versions starts and answers lookups with a binary search. It mirrors the heights
+  // [0, height()) of the DB table; anything above is left to the DB.
+  class hard_fork_table
+  {
+  public:
+    hard_fork_table(): m_height(0) {}
+
+    uint64_t height() const { return m_height; }
+    size_t runs() const { return m_starts.size(); }
+
+    void clear()
+    {
+      m_starts.clear();
+      m_versions.clear();
+      m_height = 0;
+    }
+
+    //! version of a height below height(), false if the table does not cover it
+    bool get(uint64_t height, uint8_t &version) const
+    {
+      if (height >= m_height)
+        return false;
+      const auto it = std::upper_bound(m_starts.begin(), m_starts.end(), height);
+      version = m_versions[it - m_starts.begin() - 1];
+      return true;
+    }
+
+    //! records the version of a height, heights above it are forgotten
+    //! returns false, leaving the table as it was, if height would leave a gap
+    bool set(uint64_t height, uint8_t version)
+    {
+      if (height > m_height)
+        return false;
+      truncate(height);
+      if (m_starts.empty() || m_versions.back() != version)
+      {
+        m_starts.push_back(height);
+        m_versions.push_back(version);
+      }
+      m_height = height + 1;
+      return true;
+    }
+
+    //! forgets the versions of heights from height on
+    void truncate(uint64_t height)
+    {
+      if (height >= m_height)
+        return;
+      const size_t keep = std::lower_bound(m_starts.begin(), m_starts.end(), height) - m_starts.begin();
+      m_starts.resize(keep);
+      m_versions.resize(keep);
+      m_height = height;
+    }
+
+  private:
+    std::vector<uint64_t> m_starts;
+    std::vector<uint8_t> m_versions;
+    uint64_t m_height;
+  };
+
+} // cryptonote
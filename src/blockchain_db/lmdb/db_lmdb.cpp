@@ -39,6 +39,7 @@
 #include "file_io_utils.h"
 #include "common/util.h"
 #include "common/pruning.h"
+#include "common/threadpool.h"
 #include "cryptonote_basic/cryptonote_format_utils.h"
 #include "crypto/crypto.h"
 #include "profile_tools.h"
@@ -58,7 +59,7 @@ using epee::string_tools::pod_to_hex;
 using namespace crypto;
 
 // Increase when the DB structure changes
-#define VERSION 8
+#define VERSION 9
 
 namespace
 {
@@ -210,6 +211,8 @@ namespace
  *
  * alt_blocks       block hash   {block data, block blob}
  *
+ * rct_asset_counts asset ID     [{block ID, cumulative rct outputs}...]
+ *
  * Note: where the data items are of uniform size, DUPFIXED tables have
  * been used to save space. In most of these cases, a dummy "zerokval"
  * key is used when accessing the table; the Key listed above will be
@@ -217,6 +220,8 @@ namespace
  * (DUPFIXED saves 8 bytes per record.)
  *
  * The output_amounts table doesn't use a dummy key, but uses DUPSORT.
+ * Neither does rct_asset_counts, whose records for an asset start at the
+ * first block with an output of that asset and continue up to the top block.
  */
 const char* const LMDB_BLOCKS = "blocks";
 const char* const LMDB_BLOCK_HEIGHTS = "block_heights";
@@ -248,6 +253,8 @@ const char* const LMDB_PROPERTIES = "properties";
 const char* const LMDB_CIRC_SUPPLY = "circ_supply";
 const char* const LMDB_CIRC_SUPPLY_TALLY = "circ_supply_tally";
 
+const char* const LMDB_RCT_ASSET_COUNTS = "rct_asset_counts";
+
 const char zerokey[8] = {0};
 const MDB_val zerokval = { sizeof(zerokey), (void *)zerokey };
 
@@ -366,7 +373,27 @@ typedef struct mdb_block_info_6
   offshore::asset_type_counts bi_cum_rct_by_asset_type;
 } mdb_block_info_6;
 
-typedef mdb_block_info_6 mdb_block_info;
+typedef struct mdb_block_info_7
+{
+  uint64_t bi_height;
+  uint64_t bi_timestamp;
+  uint64_t bi_coins;
+  uint64_t bi_weight; // a size_t really but we need 32-bit compat
+  uint64_t bi_diff_lo;
+  uint64_t bi_diff_hi;
+  crypto::hash bi_hash;
+  uint64_t bi_cum_rct;
+  uint64_t bi_long_term_block_weight;
+  offshore::pricing_record bi_pricing_record;
+} mdb_block_info_7;
+
+typedef mdb_block_info_7 mdb_block_info;
+
+typedef struct mdb_rct_asset_count
+{
+  uint64_t rc_height;
+  uint64_t rc_cum_rct;
+} mdb_rct_asset_count;
 
 typedef struct blk_height {
     crypto::hash bh_hash;
@@ -411,6 +438,21 @@ typedef struct circ_supply_tally {
   uint64_t amount_lo;
 } circ_supply_tally;
 
+// Progress of an interrupted supply audit recalculation, kept in the properties
+// table and followed by num_tallies supply_audit_tally records
+typedef struct supply_audit_progress {
+  uint64_t next_height;
+  crypto::hash prev_id; // id of the block at next_height - 1, a reorg invalidates the checkpoint
+  crypto::hash key_id; // hash of the decryption public key the tallies were made with
+  uint64_t coinbase_at_start_of_audit;
+  uint64_t num_tallies;
+} supply_audit_progress;
+
+typedef struct supply_audit_tally {
+  uint64_t asset_id;
+  circ_supply_tally tally;
+} supply_audit_tally;
+
 std::atomic<uint64_t> mdb_txn_safe::num_active_txns{0};
 std::atomic_flag mdb_txn_safe::creation_gate = ATOMIC_FLAG_INIT;
 
@@ -889,21 +931,51 @@ void BlockchainLMDB::add_block(const block& blk, size_t block_weight, uint64_t l
         throw1(BLOCK_DNE(lmdb_error("Failed to get block info: ", result).c_str()));
     const mdb_block_info *bi_prev = (const mdb_block_info*)h.mv_data;
     bi.bi_cum_rct += bi_prev->bi_cum_rct;
-    for (auto const& asset_type : offshore::ASSET_TYPES)
-      cum_rct_by_asset_type.add(asset_type, bi_prev->bi_cum_rct_by_asset_type[asset_type]);
   }
   bi.bi_long_term_block_weight = long_term_block_weight;
-  bi.bi_cum_rct_by_asset_type = cum_rct_by_asset_type;
 
   MDB_val_set(val, bi);
   result = mdb_cursor_put(m_cur_block_info, (MDB_val *)&zerokval, &val, MDB_APPENDDUP);
   if (result)
     throw0(DB_ERROR(lmdb_error("Failed to add block info to db transaction: ", result).c_str()));
 
+  CURSOR(rct_asset_counts)
+  for (uint8_t asset_id = 0; asset_id < offshore::ASSET_COUNT; ++asset_id)
+  {
+    MDB_val_copy<uint64_t> asset_key(asset_id);
+    MDB_val v;
+    result = mdb_cursor_get(m_cur_rct_asset_counts, &asset_key, &v, MDB_SET);
+    if (result == 0)
+      result = mdb_cursor_get(m_cur_rct_asset_counts, &asset_key, &v, MDB_LAST_DUP);
+    if (result == 0)
+    {
+      const mdb_rct_asset_count *rc_prev = (const mdb_rct_asset_count*)v.mv_data;
+      if (rc_prev->rc_height + 1 != m_height)
+        throw0(DB_ERROR(("Top rct output count for asset " + std::to_string(asset_id) + " is not at the top block").c_str()));
+      cum_rct_by_asset_type.add(offshore::asset_id_t(asset_id), rc_prev->rc_cum_rct);
+    }
+    else if (result != MDB_NOTFOUND)
+      throw0(DB_ERROR(lmdb_error("Failed to get rct output count: ", result).c_str()));
+
+    // no record until the asset's first output
+    const mdb_rct_asset_count rc = {m_height, cum_rct_by_asset_type[offshore::asset_id_t(asset_id)]};
+    if (rc.rc_cum_rct == 0)
+      continue;
+    MDB_val_set(rc_val, rc);
+    result = mdb_cursor_put(m_cur_rct_asset_counts, &asset_key, &rc_val, MDB_APPENDDUP);
+    if (result)
+      throw0(DB_ERROR(lmdb_error("Failed to add rct output count to db transaction: ", result).c_str()));
+  }
+
   result = mdb_cursor_put(m_cur_block_heights, (MDB_val *)&zerokval, &val_h, 0);
   if (result)
     throw0(DB_ERROR(lmdb_error("Failed to add block height by hash to db transaction: ", result).c_str()));
 
+  stage_supply_snapshot([&](offshore::supply_snapshot &snapshot) {
+    snapshot.height = m_height + 1;
+    snapshot.mined_xhv = coins_generated;
+  });
+
   // we use weight as a proxy for size, since we don't have size but weight is >= size
   // and often actually equal
   m_cum_size += block_weight;
@@ -945,6 +1017,31 @@ void BlockchainLMDB::remove_block()
 
   if ((result = mdb_cursor_del(m_cur_block_info, 0)))
       throw1(DB_ERROR(lmdb_error("Failed to add removal of block info to db transaction: ", result).c_str()));
+
+  CURSOR(rct_asset_counts)
+  for (uint8_t asset_id = 0; asset_id < offshore::ASSET_COUNT; ++asset_id)
+  {
+    MDB_val_copy<uint64_t> asset_key(asset_id);
+    MDB_val v;
+    result = mdb_cursor_get(m_cur_rct_asset_counts, &asset_key, &v, MDB_SET);
+    if (result == MDB_NOTFOUND)
+      continue;
+    if (!result)
+      result = mdb_cursor_get(m_cur_rct_asset_counts, &asset_key, &v, MDB_LAST_DUP);
+    if (result)
+      throw1(DB_ERROR(lmdb_error("Failed to get rct output count: ", result).c_str()));
+    const uint64_t top_height = ((const mdb_rct_asset_count*)v.mv_data)->rc_height;
+    if (top_height > m_height - 1)
+      throw1(DB_ERROR(("Top rct output count for asset " + std::to_string(asset_id) + " is above the top block").c_str()));
+    if (top_height == m_height - 1 && (result = mdb_cursor_del(m_cur_rct_asset_counts, 0)))
+      throw1(DB_ERROR(lmdb_error("Failed to add removal of rct output count to db transaction: ", result).c_str()));
+  }
+
+  const uint64_t mined_xhv = m_height > 1 ? get_block_already_generated_coins(m_height - 2) : 0;
+  stage_supply_snapshot([&](offshore::supply_snapshot &snapshot) {
+    snapshot.height = m_height - 1;
+    snapshot.mined_xhv = mined_xhv;
+  });
 }
 
 boost::multiprecision::int128_t
@@ -987,11 +1084,10 @@ read_circulating_supply_data(MDB_cursor *cur_circ_supply_tally, MDB_val idx)
   return import_tally_from_cst(&cst);
 }
 
-void write_circulating_supply_data(MDB_cursor *cur_circ_supply_tally, MDB_val idx, boost::multiprecision::int128_t tally)
+void export_tally_to_cst(boost::multiprecision::int128_t tally, circ_supply_tally *cst)
 {
   // packing the Boost 128-bit signed integer into 2 uint64's + a sign bit
-  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
-  circ_supply_tally cst;
+  memset(cst, 0, sizeof(*cst));
 
   // From the Boost docs, bitwise operations on negative values "Yields the value, but not the bit pattern, that would result from
   // performing the operation on a 2's complement integer type." This means in order to keep bit patterns consistent during bitwise ops,
@@ -1001,14 +1097,21 @@ void write_circulating_supply_data(MDB_cursor *cur_circ_supply_tally, MDB_val id
   if (tally < 0)
   {
     tally = -tally;
-    cst.is_negative = true;
+    cst->is_negative = true;
   }
   else
-    cst.is_negative = false;
+    cst->is_negative = false;
 
   // export into two uint64_t integers to store in LMDB as familiar native types
-  cst.amount_hi = ((tally >> 64) & 0xffffffffffffffff).convert_to<uint64_t>();
-  cst.amount_lo = (tally & 0xffffffffffffffff).convert_to<uint64_t>();
+  cst->amount_hi = ((tally >> 64) & 0xffffffffffffffff).convert_to<uint64_t>();
+  cst->amount_lo = (tally & 0xffffffffffffffff).convert_to<uint64_t>();
+}
+
+void write_circulating_supply_data(MDB_cursor *cur_circ_supply_tally, MDB_val idx, boost::multiprecision::int128_t tally)
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  circ_supply_tally cst;
+  export_tally_to_cst(tally, &cst);
 
   MDB_val_set(nvs, cst);
   int result = mdb_cursor_put(cur_circ_supply_tally, &idx, &nvs, 0);
@@ -1119,16 +1222,15 @@ uint64_t BlockchainLMDB::add_transaction_data(const crypto::hash& blk_hash, cons
     circ_supply cs;
     cs.tx_hash = tx_hash;
     cs.pricing_record_height = tx.pricing_record_height;
-    cs.source_currency_type = std::find(offshore::ASSET_TYPES.begin(), offshore::ASSET_TYPES.end(), strSource) - offshore::ASSET_TYPES.begin();
-    cs.dest_currency_type = std::find(offshore::ASSET_TYPES.begin(), offshore::ASSET_TYPES.end(), strDest) - offshore::ASSET_TYPES.begin();
+    cs.source_currency_type = offshore::get_asset_id(strSource);
+    cs.dest_currency_type = offshore::get_asset_id(strDest);
     cs.amount_burnt = tx.amount_burnt;
     if(m_height>=SUPPLY_AUDIT_BLOCK_HEIGHT && is_mint_and_burn_tx){ //Fees are in XHV, so have to be removed from the supply. This is actually a bug from earlier, but only discovered during the supply audit.
       fee_in_XHV=tx.rct_signatures.txnFee + tx.rct_signatures.txnOffshoreFee;
-      crypto::hash pricing_block_hash=get_block_hash_from_height(tx.pricing_record_height);
-      block_header pricing_block=get_block_header(pricing_block_hash);
+      const offshore::pricing_record pr = get_block_pricing_record(tx.pricing_record_height);
       uint8_t hf_version = get_hard_fork_version(tx.pricing_record_height);
       uint64_t conversion_rate = 0;
-      if (!cryptonote::get_conversion_rate(pricing_block.pricing_record, "XHV", strSource, conversion_rate, hf_version)){
+      if (!cryptonote::get_conversion_rate(pr, "XHV", strSource, conversion_rate, hf_version)){
         LOG_PRINT_L2("Failed to get conversition rate for transaction " << tx.hash << " total supply will not account properly for fees in XHV");
       } else {
         if (strSource=="XHV")
@@ -1171,12 +1273,20 @@ uint64_t BlockchainLMDB::add_transaction_data(const crypto::hash& blk_hash, cons
     boost::multiprecision::int128_t final_dest_tally = dest_tally + cs.amount_minted;
     write_circulating_supply_data(m_cur_circ_supply_tally, dest_idx, final_dest_tally);
 
+    stage_supply_snapshot([&](offshore::supply_snapshot &snapshot) {
+      snapshot.set_tally(offshore::asset_id_t(cs.source_currency_type), final_source_tally);
+      snapshot.set_tally(offshore::asset_id_t(cs.dest_currency_type), final_dest_tally);
+    });
+
     if(fee_in_XHV>0){
-      uint64_t source_idx_XHV = std::find(offshore::ASSET_TYPES.begin(), offshore::ASSET_TYPES.end(), "XHV") - offshore::ASSET_TYPES.begin();
+      uint64_t source_idx_XHV = offshore::ASSET_XHV;
       MDB_val_copy<uint64_t> dest_idx(source_idx_XHV);
       boost::multiprecision::int128_t dest_tally_XHV = read_circulating_supply_data(m_cur_circ_supply_tally, dest_idx);
       boost::multiprecision::int128_t final_dest_tally_XHV = dest_tally_XHV + fee_in_XHV;
       write_circulating_supply_data(m_cur_circ_supply_tally, dest_idx, final_dest_tally_XHV);
+      stage_supply_snapshot([&](offshore::supply_snapshot &snapshot) {
+        snapshot.set_tally(offshore::ASSET_XHV, final_dest_tally_XHV);
+      });
     }
 
     LOG_PRINT_L2("tx ID " << tx_id << "\nSource tally before burn =" << source_tally.str() << "\nSource tally after burn =" << final_source_tally.str() <<
@@ -1271,11 +1381,10 @@ void BlockchainLMDB::remove_transaction_data(const crypto::hash& tx_hash, const
   
     if(m_height>=SUPPLY_AUDIT_BLOCK_HEIGHT && is_mint_and_burn_tx){ //Fees are in XHV, so have to be removed from the supply. This is actually a bug from earlier, but only discovered during the supply audit.
       fee_in_XHV=tx.rct_signatures.txnFee + tx.rct_signatures.txnOffshoreFee;
-      crypto::hash pricing_block_hash=get_block_hash_from_height(tx.pricing_record_height);
-      block_header pricing_block=get_block_header(pricing_block_hash);
+      const offshore::pricing_record pr = get_block_pricing_record(tx.pricing_record_height);
       uint8_t hf_version = get_hard_fork_version(tx.pricing_record_height);
       uint64_t conversion_rate = 0;
-      if (!cryptonote::get_conversion_rate(pricing_block.pricing_record, "XHV", strSource, conversion_rate, hf_version)){
+      if (!cryptonote::get_conversion_rate(pr, "XHV", strSource, conversion_rate, hf_version)){
         LOG_PRINT_L2("Failed to get conversition rate for transaction " << tx.hash << " total supply will not account properly for fees in XHV");
       } else {
           if (strSource=="XHV")
@@ -1292,8 +1401,8 @@ void BlockchainLMDB::remove_transaction_data(const crypto::hash& tx_hash, const
       }
     }
     cs.amount_minted = tx.amount_minted;
-    cs.source_currency_type = std::find(offshore::ASSET_TYPES.begin(), offshore::ASSET_TYPES.end(), strSource) - offshore::ASSET_TYPES.begin();
-    cs.dest_currency_type = std::find(offshore::ASSET_TYPES.begin(), offshore::ASSET_TYPES.end(), strDest) - offshore::ASSET_TYPES.begin();
+    cs.source_currency_type = offshore::get_asset_id(strSource);
+    cs.dest_currency_type = offshore::get_asset_id(strDest);
 
     // Update the tally by increasing the amount by how much we've burnt
     MDB_val_copy<uint64_t> source_idx(cs.source_currency_type);
@@ -1313,8 +1422,13 @@ void BlockchainLMDB::remove_transaction_data(const crypto::hash& tx_hash, const
     }
     write_circulating_supply_data(m_cur_circ_supply_tally, dest_idx, final_dest_tally);
 
+    stage_supply_snapshot([&](offshore::supply_snapshot &snapshot) {
+      snapshot.set_tally(offshore::asset_id_t(cs.source_currency_type), final_source_tally);
+      snapshot.set_tally(offshore::asset_id_t(cs.dest_currency_type), final_dest_tally);
+    });
+
     if(fee_in_XHV>0){
-      uint64_t source_idx_XHV = std::find(offshore::ASSET_TYPES.begin(), offshore::ASSET_TYPES.end(), "XHV") - offshore::ASSET_TYPES.begin();
+      uint64_t source_idx_XHV = offshore::ASSET_XHV;
       MDB_val_copy<uint64_t> dest_idx(source_idx_XHV);
       boost::multiprecision::int128_t dest_tally_XHV = read_circulating_supply_data(m_cur_circ_supply_tally, dest_idx);
       boost::multiprecision::int128_t final_dest_tally_XHV = dest_tally_XHV - fee_in_XHV;
@@ -1323,6 +1437,9 @@ void BlockchainLMDB::remove_transaction_data(const crypto::hash& tx_hash, const
         final_dest_tally_XHV = 0;
       }
       write_circulating_supply_data(m_cur_circ_supply_tally, dest_idx, final_dest_tally_XHV);
+      stage_supply_snapshot([&](offshore::supply_snapshot &snapshot) {
+        snapshot.set_tally(offshore::ASSET_XHV, final_dest_tally_XHV);
+      });
     }
 
 
@@ -1688,6 +1805,8 @@ BlockchainLMDB::BlockchainLMDB(bool batch_transactions): BlockchainDB()
   m_batch_active = false;
   m_cum_size = 0;
   m_cum_count = 0;
+  m_supply_snapshot_version = 1; // 0 is left for snapshots not kept by the db, such as BlockchainDB::get_supply_snapshot()'s
+  m_pricing_record_fallback_height = 0;
 
   // reset may also need changing when initialize things here
 
@@ -1704,6 +1823,11 @@ void BlockchainLMDB::open(const std::string& filename, const int db_flags)
   if (m_open)
     throw0(DB_OPEN_FAILURE("Attempted to open db, but it's already open"));
 
+  m_supply_snapshot.reset();
+  m_staged_supply_snapshot.reset();
+  m_hf_table.clear();
+  m_staged_hf_table.reset();
+
   boost::filesystem::path direc(filename);
   if (!boost::filesystem::exists(direc) &&
       !boost::filesystem::create_directories(direc)) {
@@ -1829,6 +1953,8 @@ void BlockchainLMDB::open(const std::string& filename, const int db_flags)
   lmdb_db_open(txn, LMDB_CIRC_SUPPLY, MDB_INTEGERKEY | MDB_CREATE, m_circ_supply, "Failed to open db handle for m_circ_supply");
   lmdb_db_open(txn, LMDB_CIRC_SUPPLY_TALLY, MDB_CREATE, m_circ_supply_tally, "Failed to open db handle for m_circ_supply_tally");
 
+  lmdb_db_open(txn, LMDB_RCT_ASSET_COUNTS, MDB_INTEGERKEY | MDB_DUPSORT | MDB_DUPFIXED | MDB_CREATE, m_rct_asset_counts, "Failed to open db handle for m_rct_asset_counts");
+
   mdb_set_dupsort(txn, m_spent_keys, compare_hash32);
   mdb_set_dupsort(txn, m_block_heights, compare_hash32);
   mdb_set_dupsort(txn, m_tx_indices, compare_hash32);
@@ -1850,6 +1976,8 @@ void BlockchainLMDB::open(const std::string& filename, const int db_flags)
   mdb_set_compare(txn, m_circ_supply, compare_uint64);
   mdb_set_compare(txn, m_circ_supply_tally, compare_uint64);
 
+  mdb_set_dupsort(txn, m_rct_asset_counts, compare_uint64);
+
   if (!(mdb_flags & MDB_RDONLY))
   {
     result = mdb_drop(txn, m_hf_starting_heights, 1);
@@ -1894,7 +2022,9 @@ void BlockchainLMDB::open(const std::string& filename, const int db_flags)
       // We don't handle the old format previous to that commit.
       txn.commit();
       m_open = true;
+      load_pricing_record_fallback_height(false);
       migrate(db_version);
+      load_hard_fork_table();
       return;
     }
 #endif
@@ -1941,6 +2071,8 @@ void BlockchainLMDB::open(const std::string& filename, const int db_flags)
   txn.commit();
 
   m_open = true;
+  load_hard_fork_table();
+  load_pricing_record_fallback_height(mdb_flags & MDB_RDONLY);
   // from here, init should be finished
 }
 
@@ -1954,6 +2086,10 @@ void BlockchainLMDB::close()
   }
   BlockchainLMDB::sync();
   m_tinfo.reset();
+  m_supply_snapshot.reset();
+  m_staged_supply_snapshot.reset();
+  m_hf_table.clear();
+  m_staged_hf_table.reset();
 
   // FIXME: not yet thread safe!!!  Use with care.
   mdb_env_close(m_env);
@@ -2013,6 +2149,8 @@ void BlockchainLMDB::reset()
     throw0(DB_ERROR(lmdb_error("Failed to drop m_circ_supply: ", result).c_str()));
   if (auto result = mdb_drop(txn, m_circ_supply_tally, 0))
     throw0(DB_ERROR(lmdb_error("Failed to drop m_circ_supply_tally: ", result).c_str()));
+  if (auto result = mdb_drop(txn, m_rct_asset_counts, 0))
+    throw0(DB_ERROR(lmdb_error("Failed to drop m_rct_asset_counts: ", result).c_str()));
   if (auto result = mdb_drop(txn, m_output_txs, 0))
     throw0(DB_ERROR(lmdb_error("Failed to drop m_output_txs: ", result).c_str()));
   if (auto result = mdb_drop(txn, m_output_amounts, 0))
@@ -2024,6 +2162,11 @@ void BlockchainLMDB::reset()
   (void)mdb_drop(txn, m_hf_starting_heights, 0); // this one is dropped in new code
   if (auto result = mdb_drop(txn, m_hf_versions, 0))
     throw0(DB_ERROR(lmdb_error("Failed to drop m_hf_versions: ", result).c_str()));
+  {
+    CRITICAL_REGION_LOCAL(m_hf_table_lock);
+    m_hf_table.clear();
+  }
+  m_staged_hf_table.reset();
   if (auto result = mdb_drop(txn, m_properties, 0))
     throw0(DB_ERROR(lmdb_error("Failed to drop m_properties: ", result).c_str()));
 
@@ -2032,10 +2175,17 @@ void BlockchainLMDB::reset()
   MDB_val_copy<uint32_t> v(VERSION);
   if (auto result = mdb_put(txn, m_properties, &k, &v, 0))
     throw0(DB_ERROR(lmdb_error("Failed to write version to database: ", result).c_str()));
+  MDB_val_str(fk, "pricing_record_fallback_height");
+  MDB_val_copy<uint64_t> fv(0);
+  if (auto result = mdb_put(txn, m_properties, &fk, &fv, 0))
+    throw0(DB_ERROR(lmdb_error("Failed to write the pricing record fallback height to database: ", result).c_str()));
 
   txn.commit();
+  m_pricing_record_fallback_height = 0;
   m_cum_size = 0;
   m_cum_count = 0;
+  CRITICAL_REGION_LOCAL(m_supply_snapshot_lock);
+  m_supply_snapshot.reset();
 }
 
 std::vector<std::string> BlockchainLMDB::get_filenames() const
@@ -2336,6 +2486,37 @@ cryptonote::blobdata BlockchainLMDB::get_txpool_tx_blob(const crypto::hash& txid
   return bd;
 }
 
+bool BlockchainLMDB::get_txpool_tx_view(const crypto::hash& txid, const txpool_tx_meta_t *&meta, cryptonote::blobdata_ref &blob) const
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  check_open();
+
+  TXN_PREFIX_RDONLY();
+  // the data would not outlive a txn started here
+  if (my_rtxn)
+    throw0(DB_ERROR("get_txpool_tx_view called without an open db txn"));
+  RCURSOR(txpool_meta)
+  RCURSOR(txpool_blob)
+
+  MDB_val k = {sizeof(txid), (void *)&txid};
+  MDB_val v;
+  auto result = mdb_cursor_get(m_cur_txpool_meta, &k, &v, MDB_SET);
+  if (result == MDB_NOTFOUND)
+    return false;
+  if (result != 0)
+    throw1(DB_ERROR(lmdb_error("Error finding txpool tx meta: ", result).c_str()));
+  meta = (const txpool_tx_meta_t*)v.mv_data;
+
+  result = mdb_cursor_get(m_cur_txpool_blob, &k, &v, MDB_SET);
+  if (result == MDB_NOTFOUND)
+    return false;
+  if (result != 0)
+    throw1(DB_ERROR(lmdb_error("Error finding txpool tx blob: ", result).c_str()));
+  blob = cryptonote::blobdata_ref{reinterpret_cast<const char*>(v.mv_data), v.mv_size};
+  TXN_POSTFIX_RDONLY();
+  return true;
+}
+
 uint32_t BlockchainLMDB::get_blockchain_pruning_seed() const
 {
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
@@ -2892,6 +3073,7 @@ std::pair<std::vector<uint64_t>, uint64_t> BlockchainLMDB::get_block_cumulative_
 
   TXN_PREFIX_RDONLY();
   RCURSOR(block_info);
+  RCURSOR(rct_asset_counts);
 
   MDB_stat db_stats;
   if ((result = mdb_stat(m_txn, m_blocks, &db_stats)))
@@ -2902,22 +3084,43 @@ std::pair<std::vector<uint64_t>, uint64_t> BlockchainLMDB::get_block_cumulative_
 
   MDB_val v;
 
+  // if no asset type is provided in the request, an old client is requesting the cumulative outputs,
+  // and is expecting the global output distribution that isn't bucketed by asset type in response
+  MDB_cursor *cur = asset_type.empty() ? m_cur_block_info : m_cur_rct_asset_counts;
+  const size_t record_size = asset_type.empty() ? sizeof(mdb_block_info) : sizeof(mdb_rct_asset_count);
+  const offshore::asset_id_t asset_id = offshore::get_asset_id(asset_type);
+  MDB_val_copy<uint64_t> asset_key(static_cast<uint8_t>(asset_id));
+  MDB_val *key = asset_type.empty() ? (MDB_val *)&zerokval : &asset_key;
+
+  // heights below the asset's first record have no outputs of it
+  uint64_t first_record_height = 0;
+  if (!asset_type.empty() && !offshore::is_valid_asset_id(asset_id))
+    first_record_height = std::numeric_limits<uint64_t>::max();
+
   uint64_t prev_height = heights[0];
   uint64_t range_begin = 0, range_end = 0;
   for (uint64_t height: heights)
   {
+    if (height < first_record_height)
+    {
+      res.push_back(0);
+      prev_height = height;
+      continue;
+    }
     if (height >= range_begin && height < range_end)
     {
       // nohting to do
     }
     else
     {
-      if (height == prev_height + 1)
+      if (height == prev_height + 1 && height == range_end)
       {
         MDB_val k2;
-        result = mdb_cursor_get(m_cur_block_info, &k2, &v, MDB_NEXT_MULTIPLE);
-        range_begin = ((const mdb_block_info*)v.mv_data)->bi_height;
-        range_end = range_begin + v.mv_size / sizeof(mdb_block_info); // whole records please
+        result = mdb_cursor_get(cur, &k2, &v, MDB_NEXT_MULTIPLE);
+        if (result)
+          throw0(DB_ERROR(lmdb_error("Error attempting to retrieve rct distribution from the db: ", result).c_str()));
+        range_begin = *(const uint64_t*)v.mv_data;
+        range_end = range_begin + v.mv_size / record_size; // whole records please
         if (height < range_begin || height >= range_end)
           throw0(DB_ERROR(("Height " + std::to_string(height) + " not included in multuple record range: " + std::to_string(range_begin) + "-" + std::to_string(range_end)).c_str()));
       }
@@ -2925,25 +3128,47 @@ std::pair<std::vector<uint64_t>, uint64_t> BlockchainLMDB::get_block_cumulative_
       {
         v.mv_size = sizeof(uint64_t);
         v.mv_data = (void*)&height;
-        result = mdb_cursor_get(m_cur_block_info, (MDB_val *)&zerokval, &v, MDB_GET_BOTH);
-        range_begin = height;
+        result = mdb_cursor_get(cur, key, &v, asset_type.empty() ? MDB_GET_BOTH : MDB_GET_BOTH_RANGE);
+        if (result == MDB_NOTFOUND && !asset_type.empty())
+        {
+          // no record at or above this height, so none of the asset's outputs are in the chain yet
+          first_record_height = std::numeric_limits<uint64_t>::max();
+          res.push_back(0);
+          prev_height = height;
+          continue;
+        }
+        if (result)
+          throw0(DB_ERROR(lmdb_error("Error attempting to retrieve rct distribution from the db: ", result).c_str()));
+        range_begin = *(const uint64_t*)v.mv_data;
         range_end = range_begin + 1;
+        if (range_begin > height)
+        {
+          first_record_height = range_begin;
+          res.push_back(0);
+          prev_height = height;
+          continue;
+        }
       }
-      if (result)
-        throw0(DB_ERROR(lmdb_error("Error attempting to retrieve rct distribution from the db: ", result).c_str()));
     }
-    const mdb_block_info *bi = ((const mdb_block_info *)v.mv_data) + (height - range_begin);
-
-    // if no asset type is provided in the request, an old client is requesting the cumulative outputs,
-    // and is expecting the global output distribution that isn't bucketed by asset type in response
-    res.push_back(asset_type.empty() ? bi->bi_cum_rct : bi->bi_cum_rct_by_asset_type[asset_type]);
-
-    if (height == heights[heights.size() - default_tx_spendable_age])
-      num_spendable_global_outs = bi->bi_cum_rct;
+    if (asset_type.empty())
+      res.push_back(((const mdb_block_info *)v.mv_data)[height - range_begin].bi_cum_rct);
+    else
+      res.push_back(((const mdb_rct_asset_count *)v.mv_data)[height - range_begin].rc_cum_rct);
 
     prev_height = height;
   }
 
+  if (default_tx_spendable_age > 0 && default_tx_spendable_age <= heights.size())
+  {
+    uint64_t spendable_height = heights[heights.size() - default_tx_spendable_age];
+    v.mv_size = sizeof(uint64_t);
+    v.mv_data = (void*)&spendable_height;
+    result = mdb_cursor_get(m_cur_block_info, (MDB_val *)&zerokval, &v, MDB_GET_BOTH);
+    if (result)
+      throw0(DB_ERROR(lmdb_error("Error attempting to retrieve rct distribution from the db: ", result).c_str()));
+    num_spendable_global_outs = ((const mdb_block_info *)v.mv_data)->bi_cum_rct;
+  }
+
   TXN_POSTFIX_RDONLY();
   return std::make_pair(res, num_spendable_global_outs);
 }
@@ -3205,6 +3430,132 @@ uint64_t BlockchainLMDB::get_block_already_generated_coins(const uint64_t& heigh
   return ret;
 }
 
+offshore::pricing_record BlockchainLMDB::get_block_pricing_record(const uint64_t& height) const
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  check_open();
+
+  TXN_PREFIX_RDONLY();
+  RCURSOR(block_info);
+
+  MDB_val_set(result, height);
+  auto get_result = mdb_cursor_get(m_cur_block_info, (MDB_val *)&zerokval, &result, MDB_GET_BOTH);
+  if (get_result == MDB_NOTFOUND)
+  {
+    throw0(BLOCK_DNE(std::string("Attempt to get pricing record from height ").append(boost::lexical_cast<std::string>(height)).append(" failed -- block info not in db").c_str()));
+  }
+  else if (get_result)
+    throw0(DB_ERROR("Error attempting to retrieve a pricing record from the db"));
+
+  mdb_block_info *bi = (mdb_block_info *)result.mv_data;
+  offshore::pricing_record ret = bi->bi_pricing_record;
+  if (ret.empty() && needs_pricing_record_fallback(height))
+    ret = get_block_from_height(height).pricing_record;
+  TXN_POSTFIX_RDONLY();
+  return ret;
+}
+
+std::vector<offshore::pricing_record> BlockchainLMDB::get_block_pricing_records(uint64_t start_height, size_t count) const
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  check_open();
+
+  TXN_PREFIX_RDONLY();
+  RCURSOR(block_info);
+
+  const uint64_t h = height();
+  if (start_height >= h)
+    throw0(BLOCK_DNE(("Attempt to get pricing records from height " + std::to_string(start_height) + " failed -- block info not in db").c_str()));
+
+  std::vector<offshore::pricing_record> ret;
+  ret.reserve(std::min<uint64_t>(count, h - start_height));
+
+  MDB_val v;
+  uint64_t range_begin = 0, range_end = 0;
+  for (uint64_t height = start_height; height < h && count--; ++height)
+  {
+    if (height >= range_begin && height < range_end)
+    {
+      // nothing to do
+    }
+    else
+    {
+      int result = 0;
+      if (range_end > 0)
+      {
+        MDB_val k2;
+        result = mdb_cursor_get(m_cur_block_info, &k2, &v, MDB_NEXT_MULTIPLE);
+        range_begin = ((const mdb_block_info*)v.mv_data)->bi_height;
+        range_end = range_begin + v.mv_size / sizeof(mdb_block_info); // whole records please
+        if (height < range_begin || height >= range_end)
+          throw0(DB_ERROR(("Height " + std::to_string(height) + " not included in multiple record range: " + std::to_string(range_begin) + "-" + std::to_string(range_end)).c_str()));
+      }
+      else
+      {
+        v.mv_size = sizeof(uint64_t);
+        v.mv_data = (void*)&height;
+        result = mdb_cursor_get(m_cur_block_info, (MDB_val *)&zerokval, &v, MDB_GET_BOTH);
+        range_begin = height;
+        range_end = range_begin + 1;
+      }
+      if (result)
+        throw0(DB_ERROR(lmdb_error("Error attempting to retrieve pricing records from the db: ", result).c_str()));
+    }
+    ret.push_back(((const mdb_block_info *)v.mv_data)[height - range_begin].bi_pricing_record);
+    if (ret.back().empty() && needs_pricing_record_fallback(height))
+      ret.back() = get_block_from_height(height).pricing_record;
+  }
+
+  TXN_POSTFIX_RDONLY();
+  return ret;
+}
+
+bool BlockchainLMDB::needs_pricing_record_fallback(uint64_t height) const
+{
+  // databases migrated from before the record was kept in the block info have
+  // empty ones for the blocks they held, and blocks before the oracle have none
+  return height < m_pricing_record_fallback_height && get_hard_fork_version(height) >= HF_VERSION_OFFSHORE_PRICING;
+}
+
+void BlockchainLMDB::load_pricing_record_fallback_height(bool read_only)
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+
+  mdb_txn_safe txn;
+  int result = mdb_txn_begin(m_env, NULL, read_only ? MDB_RDONLY : 0, txn);
+  if (result)
+    throw0(DB_ERROR(lmdb_error("Failed to create a transaction for the db: ", result).c_str()));
+
+  MDB_val_str(k, "pricing_record_fallback_height");
+  MDB_val v;
+  result = mdb_get(txn, m_properties, &k, &v);
+  if (result == MDB_SUCCESS)
+  {
+    if (v.mv_size != sizeof(uint64_t))
+      throw0(DB_ERROR("Failed to retrieve the pricing record fallback height: unexpected value size"));
+    m_pricing_record_fallback_height = *(const uint64_t*)v.mv_data;
+    txn.abort();
+    return;
+  }
+  if (result != MDB_NOTFOUND)
+    throw0(DB_ERROR(lmdb_error("Failed to retrieve the pricing record fallback height: ", result).c_str()));
+
+  // not recorded by the migration, so any block already there may have been migrated
+  MDB_stat db_stats;
+  if ((result = mdb_stat(txn, m_blocks, &db_stats)))
+    throw0(DB_ERROR(lmdb_error("Failed to query m_blocks: ", result).c_str()));
+  m_pricing_record_fallback_height = db_stats.ms_entries;
+  if (read_only)
+  {
+    txn.abort();
+    return;
+  }
+  MDB_val_copy<uint64_t> vh(m_pricing_record_fallback_height);
+  if ((result = mdb_put(txn, m_properties, &k, &vh, 0)))
+    throw0(DB_ERROR(lmdb_error("Failed to save the pricing record fallback height: ", result).c_str()));
+  txn.commit();
+}
+
 uint64_t BlockchainLMDB::get_block_long_term_weight(const uint64_t& height) const
 {
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
@@ -3326,19 +3677,39 @@ uint64_t BlockchainLMDB::height() const
 std::vector<std::pair<std::string, std::string>> BlockchainLMDB::get_circulating_supply() const
 {
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
-  uint64_t m_height = height();
-  uint64_t m_coinbase = get_block_already_generated_coins(m_height-1);
-  LOG_PRINT_L3("BlockchainLMDB::" << __func__ << " - mined supply for XHV = " << m_coinbase);
+  return get_supply_snapshot()->to_amounts();
+}
+
+std::shared_ptr<const offshore::supply_snapshot> BlockchainLMDB::get_supply_snapshot() const
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
   check_open();
-  
+
+  // the writer sees its own uncommitted changes, like it does for every other read
+  if (m_write_txn && m_writer == boost::this_thread::get_id() && m_staged_supply_snapshot)
+    return m_staged_supply_snapshot;
+
+  CRITICAL_REGION_LOCAL(m_supply_snapshot_lock);
+  if (!m_supply_snapshot)
+    m_supply_snapshot = load_supply_snapshot();
+  return m_supply_snapshot;
+}
+
+std::shared_ptr<offshore::supply_snapshot> BlockchainLMDB::load_supply_snapshot() const
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  check_open();
+
   TXN_PREFIX_RDONLY();
   RCURSOR(circ_supply_tally);
 
+  std::shared_ptr<offshore::supply_snapshot> snapshot = std::make_shared<offshore::supply_snapshot>();
+  snapshot->version = m_supply_snapshot_version;
+  snapshot->height = height();
+  snapshot->mined_xhv = snapshot->height ? get_block_already_generated_coins(snapshot->height - 1) : 0;
+
   MDB_val k;
   MDB_val v;
-  std::vector<std::pair<std::string, std::string>> circulating_supply;
-  int result = 0;
-
   MDB_cursor_op op = MDB_FIRST;
   while (1)
   {
@@ -3349,52 +3720,76 @@ std::vector<std::pair<std::string, std::string>> BlockchainLMDB::get_circulating
     if (result)
       throw0(DB_ERROR(lmdb_error("Failed to get circulating supply: ", result).c_str()));
 
-    // Push the data into the circulating supply return struct
     const uint64_t currency_type = *(const uint64_t*)k.mv_data;
-    circ_supply_tally *cst = (circ_supply_tally*)v.mv_data;
-    const std::string currency_label = offshore::ASSET_TYPES.at(currency_type);
-    boost::multiprecision::int128_t amount = import_tally_from_cst(cst);
-
-    // Check for XHV - we need to adjust the total for them
-    if (currency_type == 0) {
-      // Get the current circulating supply for XHV
-      amount += m_coinbase;
-    }
-
-    circulating_supply.emplace_back(std::pair<std::string, std::string>{currency_label, amount.str()});
+    if (currency_type >= offshore::ASSET_COUNT)
+      throw0(DB_ERROR("Unknown currency type in circulating supply tally"));
+    snapshot->set_tally(offshore::asset_id_t(currency_type), import_tally_from_cst((circ_supply_tally*)v.mv_data));
   }
 
   TXN_POSTFIX_RDONLY();
 
-  // NEAC: check for empty supply tally - only happens prior to first conversion on chain
-  if (circulating_supply.empty()) {
-    circulating_supply.emplace_back(std::pair<std::string, std::string>{"XHV", std::to_string(m_coinbase)});
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__ << " - mined supply for XHV = " << snapshot->mined_xhv);
+  return snapshot;
+}
+
+void BlockchainLMDB::stage_supply_snapshot(const std::function<void(offshore::supply_snapshot&)>& update)
+{
+  std::shared_ptr<const offshore::supply_snapshot> base = m_staged_supply_snapshot;
+  if (!base)
+  {
+    CRITICAL_REGION_LOCAL(m_supply_snapshot_lock);
+    base = m_supply_snapshot;
   }
-  return circulating_supply;
+  if (!base)
+    base = load_supply_snapshot();
+
+  // published snapshots may still be in use by readers, so never modify one in place
+  std::shared_ptr<offshore::supply_snapshot> staged = std::make_shared<offshore::supply_snapshot>(*base);
+  staged->version = ++m_supply_snapshot_version;
+  update(*staged);
+  m_staged_supply_snapshot = staged;
+}
+
+void BlockchainLMDB::stage_supply_snapshot_reload()
+{
+  std::shared_ptr<offshore::supply_snapshot> staged = load_supply_snapshot();
+  staged->version = ++m_supply_snapshot_version;
+  m_staged_supply_snapshot = staged;
+}
+
+void BlockchainLMDB::publish_supply_snapshot()
+{
+  if (!m_staged_supply_snapshot)
+    return;
+  CRITICAL_REGION_LOCAL(m_supply_snapshot_lock);
+  m_supply_snapshot = std::move(m_staged_supply_snapshot);
+  m_staged_supply_snapshot.reset();
+}
+
+void BlockchainLMDB::discard_supply_snapshot()
+{
+  m_staged_supply_snapshot.reset();
 }
 
 //! This function updates the circulating total supply, but it does not update the individual transaction supply. 
 //! It is meant as a temporary measure, due to the limitation of not being able to publish the private decryption key.
 //! It will be redesigned in the next Haven release
+//!
+//! The audited range is tallied in parallel from read txns, and progress is checkpointed
+//! in the properties table after every round so an interrupted run resumes where it stopped.
+//! Only the checkpoints and the final tallies are written, each in a short write txn.
 void BlockchainLMDB::recalculate_supply_after_audit(const rct::key & decryption_secretkey)
 {
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
-
-
   check_open();
-  mdb_txn_cursors *m_cursors = &m_wcursors;
-
-  block_wtxn_start();
-  int result = 0;
-
-  CURSOR(block_info)
-  CURSOR(blocks)
-  CURSOR(circ_supply)
-  CURSOR(circ_supply_tally)
 
   const uint64_t bc_height = height();
   const uint64_t start_height=1700000;
-  uint64_t height = start_height;
+  static const uint64_t blocks_per_range = 1000;
+
+  //write supply back to the DB only if the current height is above the start of the audit
+  if (bc_height == 0 || get_hard_fork_version(bc_height - 1) < HF_VERSION_SUPPLY_AUDIT)
+    return;
 
   //Initialize new total supply at 0
   std::map<uint64_t, boost::multiprecision::int128_t> total_new_supply;
@@ -3405,37 +3800,78 @@ void BlockchainLMDB::recalculate_supply_after_audit(const rct::key & decryption_
     asset_id++;
   }
 
-  uint64_t coinbase_at_start_of_audit = 0;
-  const bool after_audit_start = get_hard_fork_version(bc_height - 1) >= HF_VERSION_SUPPLY_AUDIT;
-  bool audit_blocked_reached = false;
-  
-  std::vector<std::pair<std::pair<cryptonote::blobdata, crypto::hash>, std::vector<std::pair<crypto::hash, cryptonote::blobdata> > > > blocks;
-
-  while(height < bc_height && after_audit_start) {
-    block b = get_block_from_height(height);
-    if (!audit_blocked_reached)
-      audit_blocked_reached=(get_hard_fork_version(height) == HF_VERSION_SUPPLY_AUDIT);
-    if(audit_blocked_reached){
-      if (coinbase_at_start_of_audit == 0)  //All coins minted by mining prior to the audit will have to undergo audit, so have to be removed from the coinbase supply
-        coinbase_at_start_of_audit=get_block_already_generated_coins(height-1);
-        
+  // hard fork versions only ever increase, so the first audit block can be found by bisection
+  uint64_t audit_height = std::max(start_height, bc_height);
+  {
+    uint64_t lo = start_height, hi = bc_height;
+    while (lo < hi)
+    {
+      const uint64_t mid = lo + (hi - lo) / 2;
+      if (get_hard_fork_version(mid) >= HF_VERSION_SUPPLY_AUDIT)
+        hi = mid;
+      else
+        lo = mid + 1;
+    }
+    if (lo < bc_height && get_hard_fork_version(lo) == HF_VERSION_SUPPLY_AUDIT)
+      audit_height = lo;
+  }
+
+  //All coins minted by mining prior to the audit will have to undergo audit, so have to be removed from the coinbase supply
+  const uint64_t coinbase_at_start_of_audit = audit_height < bc_height ? get_block_already_generated_coins(audit_height - 1) : 0;
+
+  const rct::key decryption_pubkey = rct::scalarmultBase(decryption_secretkey);
+  const crypto::hash key_id = crypto::cn_fast_hash(decryption_pubkey.bytes, sizeof(decryption_pubkey.bytes));
+  MDB_val_str(k_progress, "supply_audit_progress");
+
+  // resume from a previous run if it used the same key and the chain it covered is still there
+  uint64_t next_height = audit_height;
+  {
+    TXN_PREFIX_RDONLY();
+    MDB_val v;
+    int result = mdb_get(m_txn, m_properties, &k_progress, &v);
+    if (result && result != MDB_NOTFOUND)
+      throw0(DB_ERROR(lmdb_error("Failed to retrieve supply audit progress: ", result).c_str()));
+    if (result == 0 && v.mv_size >= sizeof(supply_audit_progress))
+    {
+      supply_audit_progress progress;
+      memcpy(&progress, v.mv_data, sizeof(progress));
+      if (v.mv_size == sizeof(progress) + progress.num_tallies * sizeof(supply_audit_tally) &&
+          progress.key_id == key_id && progress.coinbase_at_start_of_audit == coinbase_at_start_of_audit &&
+          progress.next_height > audit_height && progress.next_height <= bc_height &&
+          get_block_hash_from_height(progress.next_height - 1) == progress.prev_id)
+      {
+        const char *ptr = (const char*)v.mv_data + sizeof(progress);
+        for (uint64_t i = 0; i < progress.num_tallies; ++i, ptr += sizeof(supply_audit_tally))
+        {
+          supply_audit_tally sat;
+          memcpy(&sat, ptr, sizeof(sat));
+          total_new_supply[sat.asset_id] = import_tally_from_cst(&sat.tally);
+        }
+        next_height = progress.next_height;
+        MINFO("Resuming supply audit recalculation at height " << next_height);
+      }
+    }
+    TXN_POSTFIX_RDONLY();
+  }
+
+  auto tally_range = [&](uint64_t begin, uint64_t end, std::map<uint64_t, boost::multiprecision::int128_t> &tally, uint64_t &num_txes)
+  {
+    // conversions use a pricing record from the last few blocks, read the range's ones in one go
+    const uint64_t pr_begin = begin > PRICING_RECORD_VALID_BLOCKS ? begin - PRICING_RECORD_VALID_BLOCKS : 0;
+    const std::vector<offshore::pricing_record> range_prs = get_block_pricing_records(pr_begin, end - pr_begin);
+    for (uint64_t height = begin; height < end; ++height)
+    {
+      const block b = get_block_from_height(height);
       for (auto &tx_hash: b.tx_hashes){
         cryptonote::blobdata tx_blob;
         if(!get_pruned_tx_blob(tx_hash, tx_blob))
           throw1(TX_DNE("Cant get transaction from DB"));
-       
 
-        circ_supply cs;
         transaction tx;
-        MDB_val_set(val_h, tx_hash);
         if (!parse_and_validate_tx_base_from_blob(tx_blob, tx))
           throw0(DB_ERROR("Failed to parse tx from blob retrieved from the db"));
-        
+        ++num_txes;
 
-        if (mdb_cursor_get(m_cur_tx_indices, (MDB_val *)&zerokval, &val_h, MDB_GET_BOTH))
-          throw1(TX_DNE("Attempting to remove transaction that isn't in the db"));
-        txindex *tip = (txindex *)val_h.mv_data;
-        MDB_val_set(val_tx_id, tip->data.tx_id);
         bool is_miner_tx = (tx.vin[0].type() == typeid(cryptonote::txin_gen));
         // get tx assets
         std::string strSource;
@@ -3447,10 +3883,8 @@ void BlockchainLMDB::recalculate_supply_after_audit(const rct::key & decryption_
         if(tx.rct_signatures.type==rct::RCTTypeSupplyAudit){
           rct::xmr_amount amount_decrypted=tx.rct_signatures.amount_encrypted;
           rct::xmr_amount encryption_key=0;
-            
-          rct::key decryption_pubkey=tx.rct_signatures.decryption_pubkey;
-            
-          const rct::key rS = scalarmultKey(decryption_pubkey,decryption_secretkey);
+
+          const rct::key rS = scalarmultKey(tx.rct_signatures.decryption_pubkey,decryption_secretkey);
           for (int i = 8; i < 16; i++){ //Use bytes 8 to 16 for the encryption
             encryption_key*=256; //Shift 1 bytes
             encryption_key+=rS.bytes[i];  //Add current byte
@@ -3458,70 +3892,166 @@ void BlockchainLMDB::recalculate_supply_after_audit(const rct::key & decryption_
           amount_decrypted ^= encryption_key; //XOR using the encryption key
 
           MDEBUG("height: "<< height <<"audit of " << print_money(amount_decrypted) << strDest);
-          uint64_t dest_currency_type = std::find(offshore::ASSET_TYPES.begin(), offshore::ASSET_TYPES.end(), strDest) - offshore::ASSET_TYPES.begin();
-          total_new_supply[dest_currency_type] += amount_decrypted; //Sum of outgoing amounts
+          uint64_t dest_currency_type = offshore::get_asset_id(strDest);
+          tally[dest_currency_type] += amount_decrypted; //Sum of outgoing amounts
         } else { 
-            bool is_mint_and_burn_tx = (strSource != strDest);
-            bool is_burn_tx = (strSource == strDest) && tx.amount_burnt > 0;
-            uint64_t fee_in_XHV=0;
-            uint64_t fee_in_strSource=0;
-            
-            if ((tx.version >= OFFSHORE_TRANSACTION_VERSION) && (is_mint_and_burn_tx || is_burn_tx)) {
-              // Offshore TX - update our records
-              circ_supply cs;
-              cs.tx_hash = tx_hash;
-              cs.pricing_record_height = tx.pricing_record_height;
-              cs.source_currency_type = std::find(offshore::ASSET_TYPES.begin(), offshore::ASSET_TYPES.end(), strSource) - offshore::ASSET_TYPES.begin();
-              cs.dest_currency_type = std::find(offshore::ASSET_TYPES.begin(), offshore::ASSET_TYPES.end(), strDest) - offshore::ASSET_TYPES.begin();
-              uint64_t XHV_currency_type_id = std::find(offshore::ASSET_TYPES.begin(), offshore::ASSET_TYPES.end(), "XHV") - offshore::ASSET_TYPES.begin();
-              
-              cs.amount_burnt = tx.amount_burnt;
-              if(height>=SUPPLY_AUDIT_BLOCK_HEIGHT && is_mint_and_burn_tx){ //Fees are in XHV, so have to be removed from the supply. This is actually a bug from earlier, but only discovered during the supply audit.
-                fee_in_XHV=tx.rct_signatures.txnFee + tx.rct_signatures.txnOffshoreFee;
-                crypto::hash pricing_block_hash=get_block_hash_from_height(tx.pricing_record_height);
-                block_header pricing_block=get_block_header(pricing_block_hash);
-                uint8_t hf_version = get_hard_fork_version(tx.pricing_record_height);
-                uint64_t conversion_rate = 0;
-                if (!cryptonote::get_conversion_rate(pricing_block.pricing_record, "XHV", strSource , conversion_rate, hf_version)){
-                  LOG_PRINT_L2("Failed to get conversition rate for transaction " << tx.hash << " total supply will not account properly for fees in XHV");
-                } else {
-                  if (strSource=="XHV")
-                    conversion_rate = COIN;
-                  boost::multiprecision::uint128_t tx_fee_128 = tx.rct_signatures.txnFee; // Fee stored in XHV
-                  tx_fee_128 *= conversion_rate;
-                  tx_fee_128 /= COIN;
-                  boost::multiprecision::uint128_t conversion_fee_128 = tx.amount_burnt; // Fee stored in XHV
-                  conversion_fee_128 *= 3;
-                  conversion_fee_128 /= 200;
-                  fee_in_strSource += tx_fee_128.convert_to<uint64_t>();
-                  fee_in_strSource += conversion_fee_128.convert_to<uint64_t>();
-                  cs.amount_burnt+=fee_in_strSource;
-                  MDEBUG(print_money(tx.amount_burnt) << " " << print_money(tx_fee_128.convert_to<uint64_t>()) << " " <<  print_money(conversion_fee_128.convert_to<uint64_t>()));
-                }
+          bool is_mint_and_burn_tx = (strSource != strDest);
+          bool is_burn_tx = (strSource == strDest) && tx.amount_burnt > 0;
+          uint64_t fee_in_XHV=0;
+          uint64_t fee_in_strSource=0;
+
+          if ((tx.version >= OFFSHORE_TRANSACTION_VERSION) && (is_mint_and_burn_tx || is_burn_tx)) {
+            // Offshore TX - update our records
+            circ_supply cs;
+            cs.tx_hash = tx_hash;
+            cs.pricing_record_height = tx.pricing_record_height;
+            cs.source_currency_type = offshore::get_asset_id(strSource);
+            cs.dest_currency_type = offshore::get_asset_id(strDest);
+            uint64_t XHV_currency_type_id = offshore::ASSET_XHV;
+
+            cs.amount_burnt = tx.amount_burnt;
+            if(height>=SUPPLY_AUDIT_BLOCK_HEIGHT && is_mint_and_burn_tx){ //Fees are in XHV, so have to be removed from the supply. This is actually a bug from earlier, but only discovered during the supply audit.
+              fee_in_XHV=tx.rct_signatures.txnFee + tx.rct_signatures.txnOffshoreFee;
+              const uint64_t pr_height = tx.pricing_record_height;
+              const offshore::pricing_record pr = pr_height >= pr_begin && pr_height - pr_begin < range_prs.size() ? range_prs[pr_height - pr_begin] : get_block_pricing_record(pr_height);
+              uint8_t hf_version = get_hard_fork_version(tx.pricing_record_height);
+              uint64_t conversion_rate = 0;
+              if (!cryptonote::get_conversion_rate(pr, "XHV", strSource , conversion_rate, hf_version)){
+                LOG_PRINT_L2("Failed to get conversition rate for transaction " << tx_hash << " total supply will not account properly for fees in XHV");
+              } else {
+                if (strSource=="XHV")
+                  conversion_rate = COIN;
+                boost::multiprecision::uint128_t tx_fee_128 = tx.rct_signatures.txnFee; // Fee stored in XHV
+                tx_fee_128 *= conversion_rate;
+                tx_fee_128 /= COIN;
+                boost::multiprecision::uint128_t conversion_fee_128 = tx.amount_burnt; // Fee stored in XHV
+                conversion_fee_128 *= 3;
+                conversion_fee_128 /= 200;
+                fee_in_strSource += tx_fee_128.convert_to<uint64_t>();
+                fee_in_strSource += conversion_fee_128.convert_to<uint64_t>();
+                cs.amount_burnt+=fee_in_strSource;
+                MDEBUG(print_money(tx.amount_burnt) << " " << print_money(tx_fee_128.convert_to<uint64_t>()) << " " <<  print_money(conversion_fee_128.convert_to<uint64_t>()));
               }
-              
-              cs.amount_minted = tx.amount_minted;
-              MDEBUG("height: "<< height <<" Burnt: << " << print_money(cs.amount_burnt) << strSource << " minted " << print_money(cs.amount_minted) << strDest << " and " << print_money(fee_in_XHV) << "XHV");
-              total_new_supply[cs.source_currency_type] -= cs.amount_burnt;
-              total_new_supply[cs.dest_currency_type] += cs.amount_minted;
-              total_new_supply[XHV_currency_type_id] += fee_in_XHV;
             }
+
+            cs.amount_minted = tx.amount_minted;
+            MDEBUG("height: "<< height <<" Burnt: << " << print_money(cs.amount_burnt) << strSource << " minted " << print_money(cs.amount_minted) << strDest << " and " << print_money(fee_in_XHV) << "XHV");
+            tally[cs.source_currency_type] -= cs.amount_burnt;
+            tally[cs.dest_currency_type] += cs.amount_minted;
+            tally[XHV_currency_type_id] += fee_in_XHV;
           }
-        
+        }
       }
     }
-    height++;
+  };
+
+  auto save_progress = [&](uint64_t height)
+  {
+    supply_audit_progress progress;
+    memset(&progress, 0, sizeof(progress));
+    progress.next_height = height;
+    progress.prev_id = get_block_hash_from_height(height - 1);
+    progress.key_id = key_id;
+    progress.coinbase_at_start_of_audit = coinbase_at_start_of_audit;
+    progress.num_tallies = total_new_supply.size();
+
+    std::string data(sizeof(progress) + total_new_supply.size() * sizeof(supply_audit_tally), '\0');
+    memcpy(&data[0], &progress, sizeof(progress));
+    char *ptr = &data[sizeof(progress)];
+    for (const auto &tally: total_new_supply)
+    {
+      supply_audit_tally sat;
+      sat.asset_id = tally.first;
+      export_tally_to_cst(tally.second, &sat.tally);
+      memcpy(ptr, &sat, sizeof(sat));
+      ptr += sizeof(sat);
+    }
+
+    block_wtxn_start();
+    try
+    {
+      MDB_val v = {data.size(), (void*)data.data()};
+      if (int result = mdb_put(*m_write_txn, m_properties, &k_progress, &v, 0))
+        throw0(DB_ERROR(lmdb_error("Failed to save supply audit progress: ", result).c_str()));
+      block_wtxn_stop();
+    }
+    catch (...)
+    {
+      block_wtxn_abort();
+      throw;
+    }
+  };
+
+  tools::threadpool& tpool = tools::threadpool::getInstanceForCompute();
+  const uint64_t ranges_per_round = std::max<uint64_t>(tpool.get_max_concurrency(), 1);
+  const uint64_t total_blocks = bc_height - std::min(audit_height, bc_height);
+  const uint64_t first_height = next_height;
+  uint64_t total_txes = 0;
+  const uint64_t t0 = epee::misc_utils::get_tick_count();
+
+  while (next_height < bc_height)
+  {
+    const uint64_t round_end = std::min(bc_height, next_height + ranges_per_round * blocks_per_range);
+    const size_t num_ranges = (round_end - next_height + blocks_per_range - 1) / blocks_per_range;
+    std::vector<std::map<uint64_t, boost::multiprecision::int128_t>> partial(num_ranges);
+    std::vector<uint64_t> num_txes(num_ranges, 0);
+    std::vector<std::string> errors(num_ranges);
+
+    tools::threadpool::waiter waiter(tpool);
+    for (size_t i = 0; i < num_ranges; ++i)
+    {
+      const uint64_t begin = next_height + i * blocks_per_range;
+      const uint64_t end = std::min(round_end, begin + blocks_per_range);
+      tpool.submit(&waiter, [&, i, begin, end]() {
+        try { tally_range(begin, end, partial[i], num_txes[i]); }
+        catch (const std::exception &e) { errors[i] = e.what(); }
+      }, true);
+    }
+    if (!waiter.wait())
+      throw0(DB_ERROR("Failed to recalculate the supply: a worker thread failed"));
+
+    // ranges are reduced in height order so the result does not depend on scheduling
+    for (size_t i = 0; i < num_ranges; ++i)
+    {
+      if (!errors[i].empty())
+        throw0(DB_ERROR(("Failed to recalculate the supply: " + errors[i]).c_str()));
+      for (const auto &tally: partial[i])
+        total_new_supply[tally.first] += tally.second;
+      total_txes += num_txes[i];
+    }
+
+    next_height = round_end;
+    save_progress(next_height);
+
+    const uint64_t elapsed = std::max<uint64_t>(epee::misc_utils::get_tick_count() - t0, 1);
+    MINFO("Supply audit recalculation: " << (next_height - audit_height) << "/" << total_blocks << " blocks, "
+        << (next_height - first_height) * 1000 / elapsed << " blocks/s, " << total_txes * 1000 / elapsed << " txs/s");
   }
+
   //remove old coinbase amount
-  uint64_t dest_currency_type = std::find(offshore::ASSET_TYPES.begin(), offshore::ASSET_TYPES.end(), "XHV") - offshore::ASSET_TYPES.begin();
+  uint64_t dest_currency_type = offshore::ASSET_XHV;
   total_new_supply[dest_currency_type]-=coinbase_at_start_of_audit;
 
-  if (after_audit_start) //write supply back to the DB only if the current height is above the start of the audit
+  block_wtxn_start();
+  try
+  {
+    mdb_txn_cursors *m_cursors = &m_wcursors;
+    CURSOR(circ_supply_tally)
     for (auto &tally: total_new_supply) {
       MDB_val_copy<uint64_t> currency_type(tally.first);
       write_circulating_supply_data(m_cur_circ_supply_tally, currency_type, tally.second);
     }
-  block_wtxn_stop();
+    int result = mdb_del(*m_write_txn, m_properties, &k_progress, NULL);
+    if (result && result != MDB_NOTFOUND)
+      throw0(DB_ERROR(lmdb_error("Failed to remove supply audit progress: ", result).c_str()));
+    stage_supply_snapshot_reload();
+    block_wtxn_stop();
+  }
+  catch (...)
+  {
+    block_wtxn_abort();
+    throw;
+  }
 }
 
 uint64_t BlockchainLMDB::num_outputs() const
@@ -4444,6 +4974,10 @@ void BlockchainLMDB::batch_commit()
   time_commit1 += time1;
   LOG_PRINT_L3("batch transaction: committed");
 
+  publish_supply_snapshot();
+
+  publish_hard_fork_table();
+
   m_write_txn = nullptr;
   delete m_write_batch_txn;
   m_write_batch_txn = nullptr;
@@ -4479,10 +5013,14 @@ void BlockchainLMDB::batch_stop()
     m_write_txn->commit();
     TIME_MEASURE_FINISH(time1);
     time_commit1 += time1;
+    publish_supply_snapshot();
+    publish_hard_fork_table();
     cleanup_batch();
   }
   catch (const std::exception &e)
   {
+    discard_supply_snapshot();
+    discard_hard_fork_table();
     cleanup_batch();
     throw;
   }
@@ -4508,6 +5046,8 @@ void BlockchainLMDB::batch_abort()
   delete m_write_batch_txn;
   m_write_batch_txn = nullptr;
   m_batch_active = false;
+  discard_supply_snapshot();
+  discard_hard_fork_table();
   memset(&m_wcursors, 0, sizeof(m_wcursors));
   LOG_PRINT_L3("batch transaction: aborted");
 }
@@ -4629,6 +5169,8 @@ void BlockchainLMDB::block_wtxn_stop()
       m_write_txn->commit();
       TIME_MEASURE_FINISH(time1);
       time_commit1 += time1;
+      publish_supply_snapshot();
+      publish_hard_fork_table();
 
       delete m_write_txn;
       m_write_txn = nullptr;
@@ -4650,6 +5192,8 @@ void BlockchainLMDB::block_wtxn_abort()
     delete m_write_txn;
     m_write_txn = nullptr;
     memset(&m_wcursors, 0, sizeof(m_wcursors));
+    discard_supply_snapshot();
+    discard_hard_fork_table();
   }
 }
 
@@ -5024,6 +5568,10 @@ void BlockchainLMDB::drop_hard_fork_info()
     throw1(DB_ERROR(lmdb_error("Error dropping hard fork versions db: ", result).c_str()));
 
   TXN_POSTFIX_SUCCESS();
+
+  CRITICAL_REGION_LOCAL(m_hf_table_lock);
+  m_hf_table.clear();
+  m_staged_hf_table.reset();
 }
 
 void BlockchainLMDB::set_hard_fork_version(uint64_t height, uint8_t version)
@@ -5042,7 +5590,67 @@ void BlockchainLMDB::set_hard_fork_version(uint64_t height, uint8_t version)
   if (result)
     throw1(DB_ERROR(lmdb_error("Error adding hard fork version to db transaction: ", result).c_str()));
 
-  TXN_BLOCK_POSTFIX_SUCCESS();
+  if (txn_ptr == &auto_txn)
+  {
+    TXN_BLOCK_POSTFIX_SUCCESS();
+    CRITICAL_REGION_LOCAL(m_hf_table_lock);
+    if (!m_hf_table.set(height, version))
+      m_hf_table.truncate(height);
+    return;
+  }
+
+  if (!m_staged_hf_table)
+  {
+    CRITICAL_REGION_LOCAL(m_hf_table_lock);
+    m_staged_hf_table.reset(new hard_fork_table(m_hf_table));
+  }
+  if (!m_staged_hf_table->set(height, version))
+    m_staged_hf_table->truncate(height);
+}
+
+void BlockchainLMDB::load_hard_fork_table()
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+
+  hard_fork_table table;
+  {
+    TXN_PREFIX_RDONLY();
+    RCURSOR(hf_versions);
+
+    MDB_val k, v;
+    MDB_cursor_op op = MDB_FIRST;
+    while (1)
+    {
+      int result = mdb_cursor_get(m_cur_hf_versions, &k, &v, op);
+      op = MDB_NEXT;
+      if (result == MDB_NOTFOUND)
+        break;
+      if (result)
+        throw0(DB_ERROR(lmdb_error("Failed to enumerate hard fork versions: ", result).c_str()));
+      const uint64_t height = *(const uint64_t*)k.mv_data;
+      if (!table.set(height, *(const uint8_t*)v.mv_data))
+        break;
+    }
+    TXN_POSTFIX_RDONLY();
+  }
+  MDEBUG("Loaded " << table.height() << " hard fork versions in " << table.runs() << " runs");
+
+  CRITICAL_REGION_LOCAL(m_hf_table_lock);
+  m_hf_table = std::move(table);
+}
+
+void BlockchainLMDB::publish_hard_fork_table()
+{
+  if (!m_staged_hf_table)
+    return;
+  CRITICAL_REGION_LOCAL(m_hf_table_lock);
+  m_hf_table = std::move(*m_staged_hf_table);
+  m_staged_hf_table.reset();
+}
+
+void BlockchainLMDB::discard_hard_fork_table()
+{
+  m_staged_hf_table.reset();
 }
 
 uint8_t BlockchainLMDB::get_hard_fork_version(uint64_t height) const
@@ -5050,6 +5658,19 @@ uint8_t BlockchainLMDB::get_hard_fork_version(uint64_t height) const
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
   check_open();
 
+  uint8_t version;
+  if (m_write_txn && m_writer == boost::this_thread::get_id() && m_staged_hf_table)
+  {
+    if (m_staged_hf_table->get(height, version))
+      return version;
+  }
+  else
+  {
+    CRITICAL_REGION_LOCAL(m_hf_table_lock);
+    if (m_hf_table.get(height, version))
+      return version;
+  }
+
   TXN_PREFIX_RDONLY();
   RCURSOR(hf_versions);
 
@@ -6450,7 +7071,18 @@ void BlockchainLMDB::migrate_5_6()
   result = mdb_put(txn, m_properties, &vk, &v, 0);
   if (result)
     throw0(DB_ERROR(lmdb_error("Failed to update version for the db: ", result).c_str()));
+
+  // the migrated block info records have empty pricing records, which have to be read from the blocks
+  MDB_stat db_stats;
+  if ((result = mdb_stat(txn, m_blocks, &db_stats)))
+    throw0(DB_ERROR(lmdb_error("Failed to query m_blocks: ", result).c_str()));
+  MDB_val_str(fk, "pricing_record_fallback_height");
+  MDB_val_copy<uint64_t> fv(db_stats.ms_entries);
+  result = mdb_put(txn, m_properties, &fk, &fv, 0);
+  if (result)
+    throw0(DB_ERROR(lmdb_error("Failed to save the pricing record fallback height: ", result).c_str()));
   txn.commit();
+  m_pricing_record_fallback_height = db_stats.ms_entries;
 }
 
 void BlockchainLMDB::migrate_6_7()
@@ -6791,7 +7423,7 @@ void BlockchainLMDB::migrate_6_7()
     txn.commit();
   } while(0);
 
-  uint32_t version = VERSION;
+  uint32_t version = 8;
   v.mv_data = (void *)&version;
   v.mv_size = sizeof(version);
   MDB_val_str(vk, "version");
@@ -6930,7 +7562,146 @@ void BlockchainLMDB::migrate_7_8()
     }
   } while(0);
 
-  uint32_t version = VERSION;
+  uint32_t version = 8;
+  v.mv_data = (void *)&version;
+  v.mv_size = sizeof(version);
+  MDB_val_str(vk, "version");
+  result = mdb_txn_begin(m_env, NULL, 0, txn);
+  if (result)
+    throw0(DB_ERROR(lmdb_error("Failed to create a transaction for the db: ", result).c_str()));
+  result = mdb_put(txn, m_properties, &vk, &v, 0);
+  if (result)
+    throw0(DB_ERROR(lmdb_error("Failed to update version for the db: ", result).c_str()));
+  txn.commit();
+}
+
+void BlockchainLMDB::migrate_8_9()
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  uint64_t i;
+  int result;
+  mdb_txn_safe txn(false);
+  MDB_val k, v;
+  char *ptr;
+
+  MGINFO_YELLOW("Migrating blockchain from DB version 8 to 9 - this may take a while:");
+
+  do {
+    LOG_PRINT_L1("moving per asset rct output counts out of block info:");
+
+    result = mdb_txn_begin(m_env, NULL, 0, txn);
+    if (result)
+      throw0(DB_ERROR(lmdb_error("Failed to create a transaction for the db: ", result).c_str()));
+
+    MDB_stat db_stats;
+    if ((result = mdb_stat(txn, m_blocks, &db_stats)))
+      throw0(DB_ERROR(lmdb_error("Failed to query m_blocks: ", result).c_str()));
+    const uint64_t blockchain_height = db_stats.ms_entries;
+
+    /* same approach as migrate_5_6: rewrite block_info into block_infn, which
+     * then replaces it, and drop anything a previous interrupted run left behind
+     */
+    MDB_dbi o_block_info = m_block_info;
+    lmdb_db_open(txn, "block_infn", MDB_INTEGERKEY | MDB_CREATE | MDB_DUPSORT | MDB_DUPFIXED, m_block_info, "Failed to open db handle for block_infn");
+    mdb_set_dupsort(txn, m_block_info, compare_uint64);
+    if ((result = mdb_drop(txn, m_block_info, 0)))
+      throw0(DB_ERROR(lmdb_error("Failed to drop block_infn: ", result).c_str()));
+    if ((result = mdb_drop(txn, m_rct_asset_counts, 0)))
+      throw0(DB_ERROR(lmdb_error("Failed to drop m_rct_asset_counts: ", result).c_str()));
+    txn.commit();
+
+    MDB_cursor *c_old, *c_cur, *c_counts;
+    MDB_cursor_op op = MDB_NEXT;
+    i = 0;
+    while(1) {
+      if (!(i % 1000)) {
+        if (i) {
+          LOGIF(el::Level::Info) {
+            std::cout << i << " / " << blockchain_height << "  \r" << std::flush;
+          }
+          txn.commit();
+        }
+        result = mdb_txn_begin(m_env, NULL, 0, txn);
+        if (result)
+          throw0(DB_ERROR(lmdb_error("Failed to create a transaction for the db: ", result).c_str()));
+        result = mdb_cursor_open(txn, m_block_info, &c_cur);
+        if (result)
+          throw0(DB_ERROR(lmdb_error("Failed to open a cursor for block_infn: ", result).c_str()));
+        result = mdb_cursor_open(txn, o_block_info, &c_old);
+        if (result)
+          throw0(DB_ERROR(lmdb_error("Failed to open a cursor for block_info: ", result).c_str()));
+        result = mdb_cursor_open(txn, m_rct_asset_counts, &c_counts);
+        if (result)
+          throw0(DB_ERROR(lmdb_error("Failed to open a cursor for rct_asset_counts: ", result).c_str()));
+        /* the old records are kept until the table is dropped, so a new cursor has to
+         * be moved to the first record not migrated yet
+         */
+        if (i) {
+          MDB_val_set(kh, i);
+          result = mdb_cursor_get(c_old, (MDB_val *)&zerokval, &kh, MDB_GET_BOTH);
+          if (result)
+            throw0(DB_ERROR(lmdb_error("Failed to find a record in block_info: ", result).c_str()));
+          op = MDB_GET_CURRENT;
+        }
+      }
+      result = mdb_cursor_get(c_old, &k, &v, op);
+      op = MDB_NEXT;
+      if (result == MDB_NOTFOUND) {
+        txn.commit();
+        break;
+      }
+      else if (result)
+        throw0(DB_ERROR(lmdb_error("Failed to get a record from block_info: ", result).c_str()));
+      const mdb_block_info_6 *bi_old = (const mdb_block_info_6*)v.mv_data;
+      mdb_block_info_7 bi;
+      bi.bi_height = bi_old->bi_height;
+      bi.bi_timestamp = bi_old->bi_timestamp;
+      bi.bi_coins = bi_old->bi_coins;
+      bi.bi_weight = bi_old->bi_weight;
+      bi.bi_diff_lo = bi_old->bi_diff_lo;
+      bi.bi_diff_hi = bi_old->bi_diff_hi;
+      bi.bi_hash = bi_old->bi_hash;
+      bi.bi_cum_rct = bi_old->bi_cum_rct;
+      bi.bi_long_term_block_weight = bi_old->bi_long_term_block_weight;
+      bi.bi_pricing_record = bi_old->bi_pricing_record;
+
+      for (uint8_t asset_id = 0; asset_id < offshore::ASSET_COUNT; ++asset_id)
+      {
+        const mdb_rct_asset_count rc = {bi_old->bi_height, bi_old->bi_cum_rct_by_asset_type[offshore::asset_id_t(asset_id)]};
+        if (rc.rc_cum_rct == 0)
+          continue;
+        MDB_val_copy<uint64_t> asset_key(asset_id);
+        MDB_val_set(rc_val, rc);
+        result = mdb_cursor_put(c_counts, &asset_key, &rc_val, MDB_APPENDDUP);
+        if (result)
+          throw0(DB_ERROR(lmdb_error("Failed to put a record into rct_asset_counts: ", result).c_str()));
+      }
+
+      MDB_val_set(nv, bi);
+      result = mdb_cursor_put(c_cur, (MDB_val *)&zerokval, &nv, MDB_APPENDDUP);
+      if (result)
+        throw0(DB_ERROR(lmdb_error("Failed to put a record into block_infn: ", result).c_str()));
+      i++;
+    }
+
+    result = mdb_txn_begin(m_env, NULL, 0, txn);
+    if (result)
+      throw0(DB_ERROR(lmdb_error("Failed to create a transaction for the db: ", result).c_str()));
+    /* Delete the old table */
+    result = mdb_drop(txn, o_block_info, 1);
+    if (result)
+      throw0(DB_ERROR(lmdb_error("Failed to delete old block_info table: ", result).c_str()));
+
+    RENAME_DB("block_infn");
+    mdb_dbi_close(m_env, m_block_info);
+
+    lmdb_db_open(txn, "block_info", MDB_INTEGERKEY | MDB_CREATE | MDB_DUPSORT | MDB_DUPFIXED, m_block_info, "Failed to open db handle for block_infn");
+    mdb_set_dupsort(txn, m_block_info, compare_uint64);
+
+    txn.commit();
+  } while(0);
+
+  uint32_t version = 9;
   v.mv_data = (void *)&version;
   v.mv_size = sizeof(version);
   MDB_val_str(vk, "version");
@@ -6970,6 +7741,8 @@ void BlockchainLMDB::migrate(const uint32_t oldversion)
     // this will set the db version 8.
     migrate_7_8();
   }
+  if (oldversion < 9)
+    migrate_8_9();
   // at the end data format and the db version will be the same.
 }
 
@@ -30,6 +30,7 @@
 #include <atomic>
 
 #include "blockchain_db/blockchain_db.h"
+#include "blockchain_db/hard_fork_table.h"
 #include "cryptonote_basic/blobdatatype.h" // for type blobdata
 #include "ringct/rctTypes.h"
 #include <boost/thread/tss.hpp>
@@ -79,6 +80,8 @@ typedef struct mdb_txn_cursors
   MDB_cursor *m_txc_circ_supply;
   MDB_cursor *m_txc_circ_supply_tally;
 
+  MDB_cursor *m_txc_rct_asset_counts;
+
 } mdb_txn_cursors;
 
 #define m_cur_blocks	m_cursors->m_txc_blocks
@@ -102,6 +105,7 @@ typedef struct mdb_txn_cursors
 #define m_cur_properties	m_cursors->m_txc_properties
 #define m_cur_circ_supply       m_cursors->m_txc_circ_supply
 #define m_cur_circ_supply_tally m_cursors->m_txc_circ_supply_tally
+#define m_cur_rct_asset_counts	m_cursors->m_txc_rct_asset_counts
 
 typedef struct mdb_rflags
 {
@@ -127,6 +131,7 @@ typedef struct mdb_rflags
   bool m_rf_properties;
   bool m_rf_circ_supply;
   bool m_rf_circ_supply_tally;
+  bool m_rf_rct_asset_counts;
 } mdb_rflags;
 
 typedef struct mdb_threadinfo
@@ -247,6 +252,10 @@ public:
 
   virtual uint64_t get_block_already_generated_coins(const uint64_t& height) const;
 
+  virtual offshore::pricing_record get_block_pricing_record(const uint64_t& height) const;
+
+  virtual std::vector<offshore::pricing_record> get_block_pricing_records(uint64_t start_height, size_t count) const;
+
   virtual uint64_t get_block_long_term_weight(const uint64_t& height) const;
 
   virtual std::vector<uint64_t> get_long_term_block_weights(uint64_t start_height, size_t count) const;
@@ -263,6 +272,8 @@ public:
 
   virtual std::vector<std::pair<std::string, std::string>> get_circulating_supply() const;
 
+  virtual std::shared_ptr<const offshore::supply_snapshot> get_supply_snapshot() const;
+
   virtual void recalculate_supply_after_audit(const rct::key & decryption_secretkey);
   
   virtual uint64_t height() const;
@@ -311,6 +322,7 @@ public:
   virtual bool get_txpool_tx_meta(const crypto::hash& txid, txpool_tx_meta_t &meta) const;
   virtual bool get_txpool_tx_blob(const crypto::hash& txid, cryptonote::blobdata& bd, relay_category tx_category) const;
   virtual cryptonote::blobdata get_txpool_tx_blob(const crypto::hash& txid, relay_category tx_category) const;
+  virtual bool get_txpool_tx_view(const crypto::hash& txid, const txpool_tx_meta_t *&meta, cryptonote::blobdata_ref &blob) const;
   virtual uint32_t get_blockchain_pruning_seed() const;
   virtual bool prune_blockchain(uint32_t pruning_seed = 0);
   virtual bool update_pruning();
@@ -472,8 +484,27 @@ private:
   // migrate from DB version 7 to 8
   void migrate_7_8();
 
+  // migrate from DB version 8 to 9
+  void migrate_8_9();
+
   void cleanup_batch();
 
+  // circulating supply snapshot, staged by the writer and published when its txn commits
+  std::shared_ptr<offshore::supply_snapshot> load_supply_snapshot() const;
+  void stage_supply_snapshot(const std::function<void(offshore::supply_snapshot&)>& update);
+  void stage_supply_snapshot_reload();
+  void publish_supply_snapshot();
+  void discard_supply_snapshot();
+
+  // hard fork versions, staged by the writer and published when its txn commits
+  void load_hard_fork_table();
+  void publish_hard_fork_table();
+  void discard_hard_fork_table();
+
+  // whether the pricing record of the block at height may only be in the block itself
+  bool needs_pricing_record_fallback(uint64_t height) const;
+  void load_pricing_record_fallback_height(bool read_only);
+
 private:
   MDB_env* m_env;
 
@@ -507,6 +538,8 @@ private:
 
   MDB_dbi m_circ_supply;
   MDB_dbi m_circ_supply_tally;
+
+  MDB_dbi m_rct_asset_counts;
   
   mutable uint64_t m_cum_size;	// used in batch size estimation
   mutable unsigned int m_cum_count;
@@ -521,6 +554,17 @@ private:
   mdb_txn_cursors m_wcursors;
   mutable boost::thread_specific_ptr<mdb_threadinfo> m_tinfo;
 
+  mutable epee::critical_section m_supply_snapshot_lock;
+  mutable std::shared_ptr<const offshore::supply_snapshot> m_supply_snapshot; // matches the last committed txn
+  std::shared_ptr<const offshore::supply_snapshot> m_staged_supply_snapshot; // writer only, matches m_write_txn
+  std::atomic<uint64_t> m_supply_snapshot_version;
+
+  uint64_t m_pricing_record_fallback_height; // blocks below it may have an empty pricing record in their block info
+
+  mutable epee::critical_section m_hf_table_lock;
+  hard_fork_table m_hf_table; // matches the last committed txn
+  std::unique_ptr<hard_fork_table> m_staged_hf_table; // writer only, matches m_write_txn
+
 #if defined(__arm__)
   // force a value so it can compile with 32-bit ARM
   constexpr static uint64_t DEFAULT_MAPSIZE = 1LL << 31;
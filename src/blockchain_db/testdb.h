@@ -84,6 +84,8 @@ public:
   virtual cryptonote::difficulty_type get_block_difficulty(const uint64_t& height) const override { return 0; }
   virtual void correct_block_cumulative_difficulties(const uint64_t& start_height, const std::vector<difficulty_type>& new_cumulative_difficulties) override {}
   virtual uint64_t get_block_already_generated_coins(const uint64_t& height) const override { return 10000000000; }
+  virtual offshore::pricing_record get_block_pricing_record(const uint64_t& height) const override { return offshore::pricing_record(); }
+  virtual std::vector<offshore::pricing_record> get_block_pricing_records(uint64_t start_height, size_t count) const override { return {}; }
   virtual uint64_t get_block_long_term_weight(const uint64_t& height) const override { return 128; }
   virtual std::vector<uint64_t> get_long_term_block_weights(uint64_t start_height, size_t count) const override { return {}; }
   virtual crypto::hash get_block_hash_from_height(const uint64_t& height) const override { return crypto::hash(); }
@@ -136,6 +138,7 @@ public:
   virtual bool get_txpool_tx_blob(const crypto::hash& txid, cryptonote::blobdata &bd, relay_category tx_category) const override { return false; }
   virtual uint64_t get_database_size() const override { return 0; }
   virtual cryptonote::blobdata get_txpool_tx_blob(const crypto::hash& txid, relay_category tx_category) const override { return ""; }
+  virtual bool get_txpool_tx_view(const crypto::hash& txid, const cryptonote::txpool_tx_meta_t *&meta, cryptonote::blobdata_ref &blob) const override { return false; }
   virtual bool for_all_txpool_txes(std::function<bool(const crypto::hash&, const cryptonote::txpool_tx_meta_t&, const cryptonote::blobdata_ref*)>, bool include_blob = false, relay_category category = relay_category::broadcasted) const override { return false; }
 
   virtual void add_block( const cryptonote::block& blk
@@ -1108,11 +1108,11 @@ namespace cryptonote
     }
     
     // check both strSource and strDest are supported.
-    if (std::find(offshore::ASSET_TYPES.begin(), offshore::ASSET_TYPES.end(), source) == offshore::ASSET_TYPES.end()) {
+    if (!offshore::is_valid_asset_type(source)) {
       LOG_ERROR("Source Asset type " << source << " is not supported! Rejecting..");
       return false;
     }
-    if (std::find(offshore::ASSET_TYPES.begin(), offshore::ASSET_TYPES.end(), destination) == offshore::ASSET_TYPES.end()) {
+    if (!offshore::is_valid_asset_type(destination)) {
       LOG_ERROR("Destination Asset type " << destination << " is not supported! Rejecting..");
       return false;
     }
@@ -1146,6 +1146,22 @@ namespace cryptonote
     return true;
   }
   //---------------------------------------------------------------
+  bool get_output_asset_id(const cryptonote::tx_out& out, offshore::asset_id_t& output_asset_id)
+  {
+    // same as get_output_asset_type(), but avoids copying the asset type string out of the output
+    if (out.target.type() == typeid(txout_haven_key))
+      output_asset_id = offshore::get_asset_id(boost::get< txout_haven_key >(out.target).asset_type);
+    else if (out.target.type() == typeid(txout_haven_tagged_key))
+      output_asset_id = offshore::get_asset_id(boost::get< txout_haven_tagged_key >(out.target).asset_type);
+    else
+    {
+      LOG_ERROR("Unexpected output target type found: " << out.target.type().name());
+      return false;
+    }
+
+    return true;
+  }
+  //---------------------------------------------------------------
   bool get_output_unlock_time(const cryptonote::tx_out& out, uint64_t& output_unlock_time)
   {
     // before HF_VERSION_VIEW_TAGS, outputs with public keys are of type txout_haven_key
@@ -136,6 +136,7 @@ namespace cryptonote
   uint64_t get_outs_money_amount(const transaction& tx, const std::string& output_asset_type="XHV");
   bool get_tx_asset_types(const transaction& tx, const crypto::hash &txid, std::string& source, std::string& destination, const bool is_miner_tx);
   bool get_output_asset_type(const cryptonote::tx_out& out, std::string& output_asset_type);
+  bool get_output_asset_id(const cryptonote::tx_out& out, offshore::asset_id_t& output_asset_id);
   bool get_output_unlock_time(const cryptonote::tx_out& out, uint64_t& output_unlock_time);
   bool get_output_rct_mask(const rct::rctSigBase& rct, const cryptonote::tx_out& out, const uint64_t& idx, rct::key& mask);
   bool get_output_public_key(const cryptonote::tx_out& out, crypto::public_key& output_public_key);
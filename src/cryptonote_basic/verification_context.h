@@ -30,6 +30,7 @@
 
 #pragma once
 
+#include "crypto/hash.h"
 #include "cryptonote_protocol/enums.h"
 #include "offshore/pricing_record.h"
 
@@ -66,6 +67,7 @@ namespace cryptonote
     offshore::pricing_record pr;
     uint64_t m_collateral;
     uint64_t m_slippage;
+    uint64_t m_economics_supply_version = 0; // version of the supply snapshot m_slippage and m_collateral were computed against, 0 if they were not
     bool tx_pr_height_verified = false;
     anonymity_pool m_tx_anon_pool = anonymity_pool::UNSET;
   };
@@ -30,6 +30,7 @@
 // Parts of this file are originally copyright (c) 2012-2013 The Cryptonote developers
 
 #include <algorithm>
+#include <array>
 #include <cstdio>
 #include <boost/filesystem.hpp>
 #include <boost/range/adaptor/reversed.hpp>
@@ -67,8 +68,6 @@
 #undef MONERO_DEFAULT_LOG_CATEGORY
 #define MONERO_DEFAULT_LOG_CATEGORY "blockchain"
 
-#define FIND_BLOCKCHAIN_SUPPLEMENT_MAX_SIZE (100*1024*1024) // 100 MB
-
 using namespace crypto;
 
 //#include "serialization/json_archive.h"
@@ -91,6 +90,9 @@ DISABLE_VS_WARNINGS(4267)
 // used to overestimate the block reward when estimating a per kB to use
 #define BLOCK_REWARD_OVERESTIMATE (10 * 1000000000000)
 
+// only RCT signatures of this type go through the RCT verification cache
+static constexpr const std::uint8_t RCT_CACHE_TYPE = rct::RCTTypeBulletproofPlus;
+
 //------------------------------------------------------------------
 Blockchain::Blockchain(tx_memory_pool& tx_pool) :
   m_db(), m_tx_pool(tx_pool), m_hardfork(NULL), m_timestamps_and_difficulties_height(0), m_reset_timestamps_and_difficulties_height(true), m_current_block_cumul_weight_limit(0), m_current_block_cumul_weight_median(0),
@@ -104,6 +106,8 @@ Blockchain::Blockchain(tx_memory_pool& tx_pool) :
   m_btc_valid(false),
   m_batch_success(true),
   m_prepare_height(0),
+  m_recent_pricing_records_start(0),
+  m_recent_pricing_records_end(0),
   m_rct_ver_cache()
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
@@ -215,22 +219,27 @@ bool Blockchain::scan_outputkeys_for_indexes(const uint8_t hf_version, size_t tx
     }
   }
 
+  // resolve the input asset type once, rather than handing the string to the visitor for every ring member
+  const offshore::asset_id_t input_asset_id = offshore::get_asset_id(tx_in_to_key.asset_type);
+
+  // known invalid output IDs, sorted
+  static const uint64_t invalid_output_ids[] = {
+    // KuCoin outputs
+    6832483, 6832485, 6834093, 6834095, 6870373, 6870374, 6870840, 6870841, 6872325,
+    6872326, 6872554, 6872555, 6872556, 6872557, 6872558, 6872559, 6872560, 6872561,
+    6872562, 6872563, 6872564, 6872565, 6872566, 6872567, 6872568, 6872569, 6872656,
+    6872657, 6872660, 6872661, 6872742, 6872743,
+    // 3.2.1 collateral exploit outputs
+    9613698, 9613699, 9613700, 9613701, 9613702, 9613703, 9613704, 9613705, 9613706,
+    9613707, 9613708, 9613709
+  };
+
   size_t count = 0;
   for (const uint64_t& i : absolute_offsets)
   {
     // Check for known invalid output IDs
     if (hf_version >= HF_VERSION_XASSET_FEES_V2) {
-      std::vector<uint64_t> invalid_output_ids = {
-        // KuCoin outputs
-        6872743, 6872555, 6872560, 6872563, 6872565, 
-        6832483, 6832485, 6834093, 6834095, 6870840, 6870841, 6872742, 6872660, 6872661,
-        6872554, 6872556, 6872557, 6872558, 6872559, 6872561, 6872562, 6872564, 6872566, 
-        6872567, 6872568, 6872569, 6870373, 6870374, 6872656, 6872657, 6872325, 6872326,
-        // 3.2.1 collateral exploit outputs
-        9613698, 9613699, 9613700, 9613701, 9613702, 9613703, 9613704, 9613705, 9613706,
-        9613707, 9613708, 9613709
-      };
-      if (std::find(invalid_output_ids.begin(), invalid_output_ids.end(), i) != invalid_output_ids.end()) {
+      if (std::binary_search(std::begin(invalid_output_ids), std::end(invalid_output_ids), i)) {
         MERROR_VER("Known invalid output id " << i << " detected - rejecting");
         return false;
       }
@@ -247,7 +256,7 @@ bool Blockchain::scan_outputkeys_for_indexes(const uint8_t hf_version, size_t tx
           output_index = m_db->get_output_key(tx_in_to_key.amount, i);
 
         // call to the passed boost visitor to grab the public key for the output
-        if (!vis.handle_output(output_index.unlock_time, tx_in_to_key.asset_type, output_index.pubkey, output_index.commitment, output_index.height))
+        if (!vis.handle_output(output_index.unlock_time, input_asset_id, output_index.pubkey, output_index.commitment, output_index.height))
         {
           MERROR_VER("Failed to handle_output for output no = " << count << ", with absolute offset " << i);
           return false;
@@ -290,25 +299,92 @@ bool Blockchain::scan_outputkeys_for_indexes(const uint8_t hf_version, size_t tx
 bool Blockchain::get_latest_acceptable_pr(offshore::pricing_record& pr) const
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
-  uint64_t current_height = get_current_blockchain_height();
-  block latest_bl;
-  for (size_t i = 1; i <= 10; i++) {
-    if (!get_block_by_hash(get_block_id_by_height(current_height - i), latest_bl)) {
-      continue;
-    }
+  CRITICAL_REGION_LOCAL(m_recent_pricing_records_lock);
+  const uint64_t current_height = get_current_blockchain_height();
+  const uint64_t window_start = current_height > PRICING_RECORD_VALID_BLOCKS ? current_height - PRICING_RECORD_VALID_BLOCKS : 0;
 
-    if (!latest_bl.pricing_record.empty()) {
-      break;
+  // the add/pop hooks keep the records in step with the chain, reload them if they fell out of step
+  if (m_recent_pricing_records_end != current_height || m_recent_pricing_records_start > window_start)
+  {
+    m_recent_pricing_records.clear();
+    std::vector<offshore::pricing_record> prs;
+    try
+    {
+      if (window_start < current_height)
+        prs = m_db->get_block_pricing_records(window_start, current_height - window_start);
     }
+    catch (const BLOCK_DNE&) {}
+    for (size_t i = 0; i < prs.size(); ++i)
+      if (!prs[i].empty())
+        m_recent_pricing_records.emplace_back(window_start + i, prs[i]);
+    m_recent_pricing_records_start = window_start;
+    m_recent_pricing_records_end = current_height;
   }
-  pr = latest_bl.pricing_record;
 
+  if (m_recent_pricing_records.empty() || m_recent_pricing_records.back().first < window_start)
+    return false;
 
-  if (!pr.empty()) {
-    return true;
+  pr = m_recent_pricing_records.back().second;
+  return true;
+}
+//------------------------------------------------------------------
+bool Blockchain::get_pricing_record_at_height(uint64_t height, offshore::pricing_record& pr) const
+{
+  LOG_PRINT_L3("Blockchain::" << __func__);
+  // does not take m_blockchain_lock, get_latest_acceptable_pr calls this with
+  // m_recent_pricing_records_lock held and the add/pop hooks take them the other way round
+  try
+  {
+    pr = m_db->get_block_pricing_record(height);
+  }
+  catch (const BLOCK_DNE&)
+  {
+    return false;
+  }
+  return true;
+}
+//------------------------------------------------------------------
+void Blockchain::on_pricing_record_added(uint64_t height, const offshore::pricing_record& pr)
+{
+  CRITICAL_REGION_LOCAL(m_recent_pricing_records_lock);
+  if (m_recent_pricing_records_end != height)
+  {
+    invalidate_recent_pricing_records();
+    return;
   }
 
-  return false;
+  if (!pr.empty())
+    m_recent_pricing_records.emplace_back(height, pr);
+  m_recent_pricing_records_end = height + 1;
+
+  // keep twice the window so that popping a few blocks does not need a reload
+  if (m_recent_pricing_records_end - m_recent_pricing_records_start > 2 * PRICING_RECORD_VALID_BLOCKS)
+    m_recent_pricing_records_start = m_recent_pricing_records_end - 2 * PRICING_RECORD_VALID_BLOCKS;
+  while (!m_recent_pricing_records.empty() && m_recent_pricing_records.front().first < m_recent_pricing_records_start)
+    m_recent_pricing_records.pop_front();
+}
+//------------------------------------------------------------------
+void Blockchain::on_pricing_record_popped(uint64_t height)
+{
+  CRITICAL_REGION_LOCAL(m_recent_pricing_records_lock);
+  if (m_recent_pricing_records_end != height + 1)
+  {
+    invalidate_recent_pricing_records();
+    return;
+  }
+
+  while (!m_recent_pricing_records.empty() && m_recent_pricing_records.back().first >= height)
+    m_recent_pricing_records.pop_back();
+  m_recent_pricing_records_end = height;
+  m_recent_pricing_records_start = std::min(m_recent_pricing_records_start, height);
+}
+//------------------------------------------------------------------
+void Blockchain::invalidate_recent_pricing_records()
+{
+  CRITICAL_REGION_LOCAL(m_recent_pricing_records_lock);
+  m_recent_pricing_records.clear();
+  m_recent_pricing_records_start = 0;
+  m_recent_pricing_records_end = 0;
 }
 //------------------------------------------------------------------
 uint64_t Blockchain::get_current_blockchain_height() const
@@ -348,6 +424,8 @@ bool Blockchain::init(BlockchainDB* db, const network_type nettype, bool offline
 
   m_nettype = test_options != NULL ? FAKECHAIN : nettype;
   m_offline = offline;
+  const auto &oracle_urls = get_config(m_nettype).ORACLE_URLS;
+  m_pricing_record_service.reset(new pricing_record_service({oracle_urls.begin(), oracle_urls.end()}, get_config(m_nettype).ORACLE_PUBLIC_KEY));
   m_fixed_difficulty = fixed_difficulty;
   if (m_hardfork == nullptr)
   {
@@ -477,6 +555,7 @@ bool Blockchain::init(BlockchainDB* db, const network_type nettype, bool offline
   {
     m_timestamps_and_difficulties_height = 0;
     m_reset_timestamps_and_difficulties_height = true;
+    invalidate_recent_pricing_records();
     m_hardfork->reorganize_from_chain_height(get_current_blockchain_height());
     uint64_t top_block_height;
     crypto::hash top_block_hash = get_tail_id(top_block_height);
@@ -566,6 +645,9 @@ bool Blockchain::deinit()
   m_async_pool.join_all();
   m_async_service.stop();
 
+  if (m_pricing_record_service)
+    m_pricing_record_service->stop();
+
   // as this should be called if handling a SIGSEGV, need to check
   // if m_db is a NULL pointer (and thus may have caused the illegal
   // memory operation), otherwise we may cause a loop.
@@ -641,8 +723,7 @@ void Blockchain::recalculate_supply_after_audit(rct::key decrypt_secretkey)
   CRITICAL_REGION_LOCAL(m_tx_pool);
   CRITICAL_REGION_LOCAL1(m_blockchain_lock);
 
-  bool stop_batch = m_db->batch_start();
-
+  // the db commits its own progress checkpoints, so this must not run inside a batch
   try
   {
     m_db->recalculate_supply_after_audit(decrypt_secretkey);
@@ -650,14 +731,8 @@ void Blockchain::recalculate_supply_after_audit(rct::key decrypt_secretkey)
   catch (const std::exception& e)
   {
     LOG_ERROR("Error when when recalculating the supply" << e.what());
-    if (stop_batch)
-      m_db->batch_abort();
     return;
   }
-
-
-  if (stop_batch)
-    m_db->batch_stop();
 }
 //------------------------------------------------------------------
 // This function tells BlockchainDB to remove the top block from the
@@ -696,6 +771,7 @@ block Blockchain::pop_block_from_blockchain()
 
   // make sure the hard fork object updates its current version
   m_hardfork->on_block_popped(1);
+  on_pricing_record_popped(m_db->height());
 
   // return transactions from popped block to the tx_pool
   size_t pruned = 0;
@@ -731,6 +807,7 @@ block Blockchain::pop_block_from_blockchain()
     MWARNING(pruned << " pruned txes could not be added back to the txpool");
 
   m_blocks_longhash_table.clear();
+  m_verified_pricing_records.clear();
   m_scan_table.clear();
   m_blocks_txs_check.clear();
 
@@ -756,6 +833,7 @@ bool Blockchain::reset_and_set_genesis_block(const block& b)
   m_timestamps_and_difficulties_height = 0;
   m_reset_timestamps_and_difficulties_height = true;
   invalidate_block_template_cache();
+  invalidate_recent_pricing_records();
   m_db->reset();
   m_db->drop_alt_blocks();
   m_hardfork->init();
@@ -1925,6 +2003,7 @@ bool Blockchain::create_block_template(block& b, const crypto::hash *from_block,
   size_t median_weight;
   uint64_t already_generated_coins;
   uint64_t pool_cookie;
+  uint64_t prev_timestamp;
 
   seed_hash = crypto::null_hash;
 
@@ -1937,7 +2016,8 @@ bool Blockchain::create_block_template(block& b, const crypto::hash *from_block,
     // this would be the case anyway if we'd lock, and the change happened
     // just after the block template was created
     if (!memcmp(&miner_address, &m_btc_address, sizeof(cryptonote::account_public_address)) && m_btc_nonce == ex_nonce
-      && m_btc_pool_cookie == m_tx_pool.cookie() && m_btc.prev_id == get_tail_id()) {
+      && m_btc_pool_cookie == m_tx_pool.cookie() && m_btc.prev_id == get_tail_id()
+      && (m_btc.major_version < HF_VERSION_OFFSHORE_PRICING || !m_btc.pricing_record.empty())) {
       MDEBUG("Using cached template");
       const uint64_t now = time(NULL);
       if (m_btc.timestamp < now) // ensures it can't get below the median of the last few blocks
@@ -1981,6 +2061,7 @@ bool Blockchain::create_block_template(block& b, const crypto::hash *from_block,
       CHECK_AND_ASSERT_MES(get_block_by_hash(*from_block, prev_block), false, "From block not found"); // TODO
       uint64_t from_block_height = cryptonote::get_block_height(prev_block);
       height = from_block_height + 1;
+      prev_timestamp = prev_block.timestamp;
       if (m_hardfork->get_current_version() >= RX_BLOCK_VERSION)
       {
         uint64_t next_height;
@@ -1991,6 +2072,7 @@ bool Blockchain::create_block_template(block& b, const crypto::hash *from_block,
     else
     {
       height = alt_chain.back().height + 1;
+      prev_timestamp = alt_chain.back().bl.timestamp;
       uint64_t next_height;
       crypto::rx_seedheights(height, &seed_height, &next_height);
 
@@ -2043,6 +2125,7 @@ bool Blockchain::create_block_template(block& b, const crypto::hash *from_block,
     median_weight = m_current_block_cumul_weight_limit / 2;
     diffic = get_difficulty_for_next_block();
     already_generated_coins = m_db->get_block_already_generated_coins(height - 1);
+    prev_timestamp = m_db->get_top_block_timestamp();
     if (m_hardfork->get_current_version() >= RX_BLOCK_VERSION)
     {
       uint64_t next_height;
@@ -2060,7 +2143,7 @@ bool Blockchain::create_block_template(block& b, const crypto::hash *from_block,
   if (b.major_version >= HF_VERSION_OFFSHORE_PRICING) {
     // NEAC - populate the pricing record here
     offshore::pricing_record pr;
-    if (!get_pricing_record(pr, b.timestamp)) {
+    if (!get_pricing_record(pr, b.major_version, b.timestamp, prev_timestamp)) {
       LOG_ERROR("Creating block template: error: failed to get pricing record");
       return false;
     }
@@ -2696,6 +2779,60 @@ void Blockchain::get_output_key(const epee::span<const uint64_t> &amounts, const
 {
   m_db->get_output_key(amounts, offsets, outputs, allow_partial);
 }
+//------------------------------------------------------------------
+bool Blockchain::get_tx_ring_members(const transaction &tx, tx_ring_members &ring_members) const
+{
+  LOG_PRINT_L3("Blockchain::" << __func__);
+  ring_members = tx_ring_members();
+
+  // the ring members of all inputs are read in one go
+  std::vector<uint64_t> amounts, offsets;
+  std::vector<size_t> ring_sizes;
+  ring_sizes.reserve(tx.vin.size());
+  for (const txin_v& txin: tx.vin)
+  {
+    if (txin.type() == typeid(txin_haven_key))
+    {
+      const txin_haven_key &tx_input = boost::get<txin_haven_key>(txin);
+      const std::vector<uint64_t> absolute_offsets = relative_output_offsets_to_absolute(tx_input.key_offsets);
+      amounts.insert(amounts.end(), absolute_offsets.size(), tx_input.amount);
+      offsets.insert(offsets.end(), absolute_offsets.begin(), absolute_offsets.end());
+      ring_sizes.push_back(absolute_offsets.size());
+    }
+    else if (txin.type() == typeid(txin_gen))
+      ring_sizes.push_back(0);
+    else
+    {
+      MERROR_VER("Unexpected input type for transaction " << get_transaction_hash(tx));
+      return false;
+    }
+  }
+
+  std::vector<output_data_t> outputs;
+  try
+  {
+    if (!offsets.empty())
+      m_db->get_output_key(epee::span<const uint64_t>(amounts.data(), amounts.size()), offsets, outputs, true);
+  }
+  catch (...)
+  {
+    outputs.clear();
+  }
+  if (outputs.size() != offsets.size())
+  {
+    MERROR_VER("Ring member " << outputs.size() << " of transaction " << get_transaction_hash(tx) << " does not exist");
+    return false;
+  }
+
+  ring_members.reserve(ring_sizes.size(), outputs.size());
+  const output_data_t *ring = outputs.data();
+  for (const size_t ring_size: ring_sizes)
+  {
+    ring_members.add_input(ring, ring_size);
+    ring += ring_size;
+  }
+  return true;
+}
 
 
 //------------------------------------------------------------------
@@ -2905,75 +3042,36 @@ bool Blockchain::find_blockchain_supplement(const std::list<crypto::hash>& qbloc
   return true;
 }
 //------------------------------------------------------------------
-bool Blockchain::get_pricing_record(offshore::pricing_record& pr, uint64_t timestamp)
+bool Blockchain::get_pricing_record(offshore::pricing_record& pr, uint8_t hf_version, uint64_t timestamp, uint64_t prev_timestamp)
 {
-  LOG_PRINT_L1("Requesting pricing record from Oracle - time : " << timestamp);
+  pr = offshore::pricing_record();
 
-  bool r = false;
+  // Pricing records can go in at any time - we just mustn't create txs that use them before the HF!!!
+  // Before that, the record is empty and will only be allowed to be mined until HF_VERSION_OFFSHORE_FULL is reached
+  if (hf_version < HF_VERSION_OFFSHORE_PRICING || !m_pricing_record_service)
+    return true;
 
-  const uint8_t hf_version = m_hardfork->get_current_version();
+  // The oracle is polled in the background, the first template after startup
+  // (or a fork) goes out with an empty record as it would if the oracle was down
+  m_pricing_record_service->set_hf_version(hf_version);
+  if (!m_pricing_record_service->is_running())
+    m_pricing_record_service->start();
 
-  // Get the old-style PR
-  epee::net_utils::http::http_simple_client http_client;
-  COMMAND_RPC_GET_PRICING_RECORD::request req = AUTO_VAL_INIT(req);
-  COMMAND_RPC_GET_PRICING_RECORD::response res = AUTO_VAL_INIT(res);
-
-  // HERE BE DRAGONS!!!
-  // NEAC: Initialise the pricing record to be the correct format
-  if (hf_version >= HF_VERSION_SLIPPAGE) {
-    res.pr.set_version(3);
-  } else if (hf_version >= HF_VERSION_OFFSHORE_FULL) {
-    res.pr.set_version(2);
-  } else {
-    res.pr.set_version(1);
-  }
-  // LAND AHOY!!!
-  
-  std::array<std::string, 3> oracle_urls = get_config(m_nettype).ORACLE_URLS;
-  std::shuffle(oracle_urls.begin(), oracle_urls.end(), std::default_random_engine(crypto::rand<unsigned>()));
-  for (size_t n = 0; n < oracle_urls.size(); n++) {
-    http_client.set_server(oracle_urls[n], boost::none, epee::net_utils::ssl_support_t::e_ssl_support_autodetect);
-    if (hf_version >= HF_VERSION_SLIPPAGE) {
-      std::string url = "/price2/?timestamp=" + boost::lexical_cast<std::string>(timestamp) + "&version=" + std::to_string(m_hardfork->get_current_version());
-      r = epee::net_utils::invoke_http_json(url, req, res, http_client, std::chrono::seconds(10), "GET");
-    } else {
-      std::string url = "/price/?timestamp=" + boost::lexical_cast<std::string>(timestamp) + "&version=" + std::to_string(m_hardfork->get_current_version());
-      r = epee::net_utils::invoke_http_json(url, req, res, http_client, std::chrono::seconds(10), "GET");
-    }
-    if (r) {
-      LOG_PRINT_L1("Obtained pricing record from Oracle : " << oracle_urls[n]);
-      break;
-    }
-    LOG_PRINT_L1("Failed to obtain pricing record from Oracle : " << oracle_urls[n]);
-  }
-  
-  if (!r) {
-    LOG_PRINT_L0("Failed to get pricing record from Oracle - returning empty PR");
-    res.pr = offshore::pricing_record();
+  offshore::pricing_record cached;
+  if (!m_pricing_record_service->get(cached)) {
+    LOG_PRINT_L0("No pricing record from Oracle available yet - returning empty PR");
+    return true;
   }
-  
-  if (hf_version < HF_VERSION_XASSET_FEES_V2)
-    res.pr.timestamp = 0;
 
-  // Pricing records can go in at any time - we just mustn't create txs that use them before the HF!!!
-  if (hf_version >= HF_VERSION_OFFSHORE_PRICING) {
-    // Only VERIFY if full mode has been enabled
-    if (hf_version >= HF_VERSION_OFFSHORE_FULL) {
-      // Verify the signature
-      if (res.pr.verifySignature(get_config(m_nettype).ORACLE_PUBLIC_KEY)) {
-        pr = res.pr;
-      } else {
-        LOG_PRINT_L0("Failed to verify signature of pricing record from Oracle - returning empty PR");
-        pr = offshore::pricing_record();
-      }
-    } else {
-      // Do not attempt to verify this pricing record
-      pr = res.pr;
+  // Same timestamp window as pricing_record::valid(), the signature was checked on fetch
+  if (hf_version >= HF_VERSION_XASSET_FEES_V2 && !cached.empty()) {
+    if (cached.timestamp <= prev_timestamp || cached.timestamp > timestamp + PRICING_RECORD_VALID_TIME_DIFF_FROM_BLOCK) {
+      LOG_PRINT_L1("Cached pricing record is stale (PR = " << cached.timestamp << ", block timestamp = " << timestamp << ", timestamp of last block = " << prev_timestamp << ") - returning empty PR");
+      m_pricing_record_service->refresh();
+      return true;
     }
-  } else {
-    // Empty record - will only be allowed to be mined until HF_VERSION_OFFSHORE_FULL is reached
-    pr = offshore::pricing_record();
   }
+  pr = cached;
 
   std::string sig_hex;
   for (size_t i = 0; i < 64; i++) {
@@ -2981,11 +3079,18 @@ bool Blockchain::get_pricing_record(offshore::pricing_record& pr, uint64_t times
     ss << std::hex << std::setw(2) << std::setfill('0') << (0xff & pr.signature[i]);
     sig_hex += ss.str();
   }
-  LOG_PRINT_L1("Received pricing record - signature = " << sig_hex);
+  LOG_PRINT_L1("Using pricing record - signature = " << sig_hex);
 
   return true;
 }
 //------------------------------------------------------------------
+pricing_record_service::stats Blockchain::get_pricing_record_stats() const
+{
+  if (!m_pricing_record_service)
+    return pricing_record_service::stats();
+  return m_pricing_record_service->get_stats();
+}
+//------------------------------------------------------------------
 difficulty_type Blockchain::block_difficulty(uint64_t i) const
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
@@ -4001,23 +4106,30 @@ bool Blockchain::check_tx_outputs(const transaction& tx, tx_verification_context
   if (hf_version >= HF_VERSION_HAVEN2) {
     if (tvc.m_source_asset != tvc.m_dest_asset) {
       if (tx.vout.size() >= 4) {
-        std::map<std::string, uint32_t> asset_counter;
-        std::string asset;
+        // count by asset id; unknown asset types are counted in their own bucket so that they
+        // still count as a distinct asset type, as they did when this was keyed by string
+        std::array<uint32_t, offshore::ASSET_COUNT + 1> asset_counter{};
+        size_t distinct_assets = 0;
+        offshore::asset_id_t asset;
         for (const auto &o: tx.vout) {
-          if (!cryptonote::get_output_asset_type(o, asset)) {
+          if (!cryptonote::get_output_asset_id(o, asset)) {
             MERROR_VER("Invalid output type detected in conversion TX.");
             tvc.m_invalid_output = true;
             return false;
           }
-          asset_counter[asset]++;
+          if (asset_counter[offshore::is_valid_asset_id(asset) ? asset : offshore::ASSET_COUNT]++ == 0)
+            ++distinct_assets;
         }
 
-        if (asset_counter.size() != 2) {
+        const offshore::asset_id_t source_id = offshore::get_asset_id(tvc.m_source_asset);
+        const offshore::asset_id_t dest_id = offshore::get_asset_id(tvc.m_dest_asset);
+        if (distinct_assets != 2) {
           MERROR_VER("Conversion tx has more or less than 2 different asset types in the outputs.");
           tvc.m_invalid_output = true;
           return false;
         }
-        if (asset_counter[tvc.m_source_asset] < 2 || asset_counter[tvc.m_dest_asset] < 2) {
+        if (!offshore::is_valid_asset_id(source_id) || !offshore::is_valid_asset_id(dest_id) ||
+            asset_counter[source_id] < 2 || asset_counter[dest_id] < 2) {
           MERROR_VER("Conversion Txs should have at least 2 output that is same asset type as source asset and  2 output that is same asset type as dest asset after Haven2 fork.");
           tvc.m_invalid_output = true;
           return false;
@@ -4213,7 +4325,7 @@ bool Blockchain::expand_transaction_2(transaction &tx, const uint8_t hf_version,
 //        check_tx_input() rather than here, and use this function simply
 //        to iterate the inputs as necessary (splitting the task
 //        using threads, etc.)
-bool Blockchain::check_tx_inputs(transaction& tx, tx_verification_context &tvc, uint64_t* pmax_used_block_height) const
+bool Blockchain::check_tx_inputs(transaction& tx, tx_verification_context &tvc, uint64_t* pmax_used_block_height, rct::ctkeyM* deferred_mix_ring) const
 {
   PERF_TIMER(check_tx_inputs);
   LOG_PRINT_L3("Blockchain::" << __func__);
@@ -4472,7 +4584,6 @@ bool Blockchain::check_tx_inputs(transaction& tx, tx_verification_context &tvc,
         false, "Transaction spends at least one output which is too young");
   }
   // Warn that new RCT types are present, and thus the cache is not being used effectively
-  static constexpr const std::uint8_t RCT_CACHE_TYPE = rct::RCTTypeBulletproofPlus;
   if (tx.rct_signatures.type > RCT_CACHE_TYPE)
   {
     MWARNING("RCT cache is not caching new verification results. Please update RCT_CACHE_TYPE!");
@@ -4519,6 +4630,11 @@ bool Blockchain::check_tx_inputs(transaction& tx, tx_verification_context &tvc,
     case rct::RCTTypeBulletproofPlus:
     case rct::RCTTypeSupplyAudit:
     {
+      if (deferred_mix_ring && !pubkeys.empty())
+      {
+        *deferred_mix_ring = std::move(pubkeys);
+        break;
+      }
       if (!ver_rct_non_semantics_simple_cached(tx, hf_version, pubkeys, m_rct_ver_cache, RCT_CACHE_TYPE))
       {
         MERROR_VER("Failed to check ringct signatures!");
@@ -4922,13 +5038,13 @@ bool Blockchain::check_tx_input(size_t tx_version, const txin_haven_key& txin, c
   {
     std::vector<rct::ctkey >& m_output_keys;
     const Blockchain& m_bch;
-    const std::string& m_asset_type; // just to get the access to txin_xasset.asset_type
+    const offshore::asset_id_t m_asset_id; // just to get the access to txin_xasset.asset_type
     const uint8_t hf_version;
-    outputs_visitor(std::vector<rct::ctkey>& output_keys, const Blockchain& bch, const std::string& asset_type, uint8_t hf_version) :
-      m_output_keys(output_keys), m_bch(bch), m_asset_type(asset_type), hf_version(hf_version)
+    outputs_visitor(std::vector<rct::ctkey>& output_keys, const Blockchain& bch, const offshore::asset_id_t asset_id, uint8_t hf_version) :
+      m_output_keys(output_keys), m_bch(bch), m_asset_id(asset_id), hf_version(hf_version)
     {
     }
-    bool handle_output(uint64_t unlock_time, const std::string& asset_type, const crypto::public_key &pubkey, const rct::key &commitment, const uint64_t height)
+    bool handle_output(uint64_t unlock_time, const offshore::asset_id_t asset_id, const crypto::public_key &pubkey, const rct::key &commitment, const uint64_t height)
     {
       //check tx unlock time
       if (!m_bch.is_tx_spendtime_unlocked(unlock_time, hf_version))
@@ -4939,8 +5055,8 @@ bool Blockchain::check_tx_input(size_t tx_version, const txin_haven_key& txin, c
 
       // check whether output asset types matches
       if (hf_version >= HF_VERSION_XASSET_FEES_V2) {
-        if (asset_type != m_asset_type) {
-          MERROR_VER("One of outputs for one of inputs has wrong asset type. Expected = " << asset_type << " Got = " << m_asset_type);
+        if (asset_id != m_asset_id) {
+          MERROR_VER("One of outputs for one of inputs has wrong asset type. Expected = " << (unsigned)asset_id << " Got = " << (unsigned)m_asset_id);
           return false;
         }
       }
@@ -4967,7 +5083,7 @@ bool Blockchain::check_tx_input(size_t tx_version, const txin_haven_key& txin, c
   output_keys.clear();
 
   // collect output keys
-  outputs_visitor vi(output_keys, *this, txin.asset_type, hf_version);
+  outputs_visitor vi(output_keys, *this, offshore::get_asset_id(txin.asset_type), hf_version);
   if (!scan_outputkeys_for_indexes(hf_version, tx_version, txin, vi, tx_prefix_hash, pmax_related_block_height))
   {
     MERROR_VER("Failed to get output keys for tx with amount = " << print_money(txin.amount) << " and count indexes " << txin.key_offsets.size());
@@ -5186,7 +5302,8 @@ leave:
   // validate the pricing record
   if (hf_version >= HF_VERSION_OFFSHORE_PRICING) {
     TIME_MEASURE_START(pricing_record);
-    if (!bl.pricing_record.valid(m_nettype, hf_version, bl.timestamp, m_db->get_top_block_timestamp())) {
+    const bool pr_signature_verified = m_verified_pricing_records.find(id) != m_verified_pricing_records.end();
+    if (!bl.pricing_record.valid(m_nettype, hf_version, bl.timestamp, m_db->get_top_block_timestamp(), pr_signature_verified)) {
       MERROR_VER("Block with id: " << id << std::endl << "has invalid pricing record!");
       bvc.m_verifivation_failed = true;
       goto leave;
@@ -5315,7 +5432,7 @@ leave:
   offshore::pricing_record latest_pr;
   uint64_t total_conversion_xhv = 0; // only offshore/onshore
   uint64_t block_cap_xhv = 0;
-  std::vector<std::pair<std::string, std::string>> supply_amounts;
+  std::shared_ptr<const offshore::supply_snapshot> supply = std::make_shared<const offshore::supply_snapshot>();
   if (hf_version >= HF_VERSION_OFFSHORE_FULL) {
     if (!get_latest_acceptable_pr(latest_pr)) {
       if (hf_version >= HF_VERSION_USE_COLLATERAL) {
@@ -5326,14 +5443,19 @@ leave:
     }
 
     // get the block cap
-    supply_amounts = get_db().get_circulating_supply();
-    block_cap_xhv = get_block_cap(supply_amounts, latest_pr, hf_version);
+    supply = get_db().get_supply_snapshot();
+    block_cap_xhv = get_block_cap(*supply, latest_pr, hf_version);
   }
 
   size_t tx_index = 0;
+  // mix rings of the txes whose RCT signatures still need verifying, by index in txs
+  std::vector<rct::ctkeyM> rct_mix_rings(bl.tx_hashes.size());
+  // range proofs of the txes, verified in one batch after the loop, by index in txs
+  std::vector<rct::range_proof_batch> rct_range_proofs(bl.tx_hashes.size());
   // Iterate over the block's transaction hashes, grabbing each
   // from the tx_pool and validating them.  Each is then added
   // to txs.  Keys spent in each are added to <keys> by the double spend check.
+  // txs must not reallocate, the verification below keeps references to its txes.
   txs.reserve(bl.tx_hashes.size());
   for (const crypto::hash& tx_id : bl.tx_hashes)
   {
@@ -5402,8 +5524,9 @@ leave:
 #endif
     {
       // validate that transaction inputs and the keys spending them are correct.
+      // The RCT signatures are left for after the loop, where they are verified in parallel
       tx_verification_context tvc;
-      if(!check_tx_inputs(tx, tvc))
+      if(!check_tx_inputs(tx, tvc, NULL, &rct_mix_rings[txs.size() - 1]))
       {
         MERROR_VER("Block with id: " << id  << " has at least one transaction (id: " << tx_id << ") with wrong inputs.");
 
@@ -5461,51 +5584,14 @@ leave:
     // Get the TX anonymity pool
     anonymity_pool tx_anon_pool=anonymity_pool::UNSET;
     if (hf_version>=HF_VERSION_BURN && blockchain_height >= SUPPLY_AUDIT_ANON_POOL_CHECK_HEIGHT) {
-      std::vector<std::vector<output_data_t>> tx_ring_outputs;
-      tx_ring_outputs.reserve(tx.vin.size());
-      for (const txin_v& txin: tx.vin){
-        std::vector<output_data_t> ring_outputs;
-        if (txin.type() == typeid(txin_haven_key)){
-          txin_haven_key tx_input=boost::get<txin_haven_key>(txin);
-          std::vector<uint64_t> absolute_offsets = relative_output_offsets_to_absolute(tx_input.key_offsets);
-
-          if (absolute_offsets.size()!=tx_input.key_offsets.size()){
-            MERROR_VER("Failed to obtain absolute ring offsets! amount = " << tx_input.amount);
-            bvc.m_verifivation_failed = true;
-            goto leave;
-          }
-          
-          try{
-            get_output_key(epee::span<const uint64_t>(&tx_input.amount, 1), absolute_offsets, ring_outputs, true);
-            if (absolute_offsets.size() != ring_outputs.size()){
-              MERROR_VER("Output does not exist! amount = " << tx_input.amount);
-              bvc.m_verifivation_failed = true;
-              goto leave;
-            }
-          }
-          catch (...){
-            MERROR_VER("Output does not exist! amount = " << tx_input.amount);
-            bvc.m_verifivation_failed = true;
-            goto leave;
-          }
-          
-          tx_ring_outputs.push_back(ring_outputs);
-        } else if (txin.type() == typeid(txin_gen)){
-          tx_ring_outputs.push_back(ring_outputs);
-        } else {
-          MERROR_VER("Unexpected input type for transaction" << tx_id);
-          bvc.m_verifivation_failed = true;
-          goto leave;
-        }
-      }
-
-      if (tx_ring_outputs.size()!=tx.vin.size()){
-        MERROR_VER("Transaction has more inputs than number of ring member groups: " << tx_id);
+      tx_ring_members ring_members;
+      if (!get_tx_ring_members(tx, ring_members)){
+        MERROR_VER("Failed to get the ring members of transaction " << tx_id);
         bvc.m_verifivation_failed = true;
         goto leave;
       }
 
-      if(!get_anonymity_pool(tx, tx_ring_outputs, tx_anon_pool, m_nettype)){
+      if(!get_anonymity_pool(tx, ring_members, tx_anon_pool, m_nettype)){
         MERROR("Failed to get the anonymity pool for transaction " << tx_id);
         bvc.m_verifivation_failed = true;
         goto leave;
@@ -5563,8 +5649,8 @@ leave:
       if (hf_version >= HF_VERSION_HAVEN2) {
 
         // get tx type and pricing record
-        block pr_bl;
-        if (!get_block_by_hash(get_block_id_by_height(tx.pricing_record_height), pr_bl)) {
+        offshore::pricing_record tx_pr;
+        if (!get_pricing_record_at_height(tx.pricing_record_height, tx_pr)) {
           LOG_PRINT_L2("error: failed to get block containing pricing record");
           bvc.m_verifivation_failed = true;
           goto leave;
@@ -5573,7 +5659,7 @@ leave:
         // Get the slippage
         uint64_t slippage = 0;
         if (hf_version >= HF_VERSION_SLIPPAGE && source != dest) {
-          if (!get_slippage(tx_type, source, dest, tx.amount_burnt, slippage, pr_bl.pricing_record, supply_amounts, hf_version)) {
+          if (!get_slippage(tx_type, source, dest, tx.amount_burnt, slippage, tx_pr, *supply, hf_version)) {
             LOG_PRINT_L2("Failed to obtain slippage requirements for tx " << tx.hash);
             bvc.m_verifivation_failed = true;
             goto leave;
@@ -5583,7 +5669,7 @@ leave:
         // Get the collateral requirements
         uint64_t collateral = 0;
         if (hf_version >= HF_VERSION_USE_COLLATERAL && (tx_type == tt::OFFSHORE || tx_type == tt::ONSHORE)) {
-          bool r = get_collateral_requirements(tx_type, tx.amount_burnt, collateral, pr_bl.pricing_record, supply_amounts, hf_version);
+          bool r = get_collateral_requirements(tx_type, tx.amount_burnt, collateral, tx_pr, *supply, hf_version);
           if (!r) {
             LOG_PRINT_L2("Failed to obtain collateral requirements for tx " << tx.hash);
             bvc.m_verifivation_failed = true;
@@ -5593,7 +5679,7 @@ leave:
 
         // NEAC: Get conversion rate so we can avoid doing an invert() on a number with excessive precision
         uint64_t conversion_rate = COIN;
-        if (!cryptonote::get_conversion_rate(pr_bl.pricing_record, source, dest, conversion_rate, hf_version)) {
+        if (!cryptonote::get_conversion_rate(tx_pr, source, dest, conversion_rate, hf_version)) {
           LOG_PRINT_L2("Failed to get conversion rate of tx " << tx.hash);
           bvc.m_verifivation_failed = true;
           goto leave;
@@ -5601,7 +5687,7 @@ leave:
 
         // Get the fee conversion rate used
         uint64_t fee_conversion_rate = COIN;
-        if (!cryptonote::get_conversion_rate(pr_bl.pricing_record, source, "XHV", fee_conversion_rate, hf_version)) {
+        if (!cryptonote::get_conversion_rate(tx_pr, source, "XHV", fee_conversion_rate, hf_version)) {
           LOG_PRINT_L2("error: unable to obtain fee conversion rate.");
           bvc.m_verifivation_failed = true;
           goto leave;
@@ -5609,20 +5695,23 @@ leave:
           
         // Get the TX fee conversion rate used
         uint64_t tx_fee_conversion_rate = COIN;
-        if (!cryptonote::get_conversion_rate(pr_bl.pricing_record, "XHV", source, tx_fee_conversion_rate, hf_version)) {
+        if (!cryptonote::get_conversion_rate(tx_pr, "XHV", source, tx_fee_conversion_rate, hf_version)) {
           LOG_PRINT_L2("error: unable to obtain fee conversion rate.");
           bvc.m_verifivation_failed = true;
           goto leave;
         }
           
-        // make sure proof-of-value still holds
-        if (!rct::verRctSemanticsSimple2(tx.rct_signatures, pr_bl.pricing_record, conversion_rate, fee_conversion_rate, tx_fee_conversion_rate, tx_type, source, dest, tx.amount_burnt, tx.amount_minted, tx.vout, tx.vin, hf_version, collateral, slippage, tx_anon_pool))
+        // 2 tx that used reorged pricing record for collateral calculation.
+        const bool pov_exempt = epee::string_tools::pod_to_hex(tx_id) == "e9c0753df108cb9de343d78c3bbdec0cebd56ee5c26c09ecf46dbf8af7838956"
+          || epee::string_tools::pod_to_hex(tx_id) == "55de061be8f769d6ab5ba7938c10e2f2fb635e5da82d2615ed7a8b06d9f9025b"
+          || epee::string_tools::pod_to_hex(tx_id) == "10e47b28af3dd84326f651ad064ffce7533bef41753c1affa64f0f6cf47d869d"
+          || epee::string_tools::pod_to_hex(tx_id) == "736c9a002f8d402536b00bf01fd048d3bd7d868cfbf25edf47ded05ab42421be";
+
+        // make sure proof-of-value still holds. The range proofs of exempt txes are
+        // checked right here, as a failure there has to be ignored too
+        if (!rct::verRctSemanticsSimple2(tx.rct_signatures, tx_pr, conversion_rate, fee_conversion_rate, tx_fee_conversion_rate, tx_type, source, dest, tx.amount_burnt, tx.amount_minted, tx.vout, tx.vin, hf_version, collateral, slippage, tx_anon_pool, pov_exempt ? NULL : &rct_range_proofs[txs.size() - 1]))
         {
-          // 2 tx that used reorged pricing record for collateral calculation.
-          if (epee::string_tools::pod_to_hex(tx_id) != "e9c0753df108cb9de343d78c3bbdec0cebd56ee5c26c09ecf46dbf8af7838956"
-          && epee::string_tools::pod_to_hex(tx_id) != "55de061be8f769d6ab5ba7938c10e2f2fb635e5da82d2615ed7a8b06d9f9025b"
-          && epee::string_tools::pod_to_hex(tx_id) != "10e47b28af3dd84326f651ad064ffce7533bef41753c1affa64f0f6cf47d869d"
-          && epee::string_tools::pod_to_hex(tx_id) != "736c9a002f8d402536b00bf01fd048d3bd7d868cfbf25edf47ded05ab42421be") {
+          if (!pov_exempt) {
             LOG_PRINT_L2(" transaction proof-of-value is now invalid for tx " << tx.hash);
             bvc.m_verifivation_failed = true;
             goto leave;
@@ -5654,7 +5743,7 @@ leave:
       uint64_t slippage = 0;
       offshore::pricing_record pr_empty;
       if (hf_version >= HF_VERSION_HAVEN2) {
-        if (!rct::verRctSemanticsSimple2(tx.rct_signatures, pr_empty, conversion_rate, fee_conversion_rate, tx_fee_conversion_rate, tx_type, source, dest, tx.amount_burnt, tx.amount_minted, tx.vout, tx.vin, hf_version, collateral, slippage, tx_anon_pool))
+        if (!rct::verRctSemanticsSimple2(tx.rct_signatures, pr_empty, conversion_rate, fee_conversion_rate, tx_fee_conversion_rate, tx_type, source, dest, tx.amount_burnt, tx.amount_minted, tx.vout, tx.vin, hf_version, collateral, slippage, tx_anon_pool, &rct_range_proofs[txs.size() - 1]))
           {
             LOG_PRINT_L2(" transaction proof-of-value is now invalid for tx " << tx.hash);
             bvc.m_verifivation_failed = true;
@@ -5677,7 +5766,79 @@ leave:
     }
     cumulative_block_weight += tx_weight;
   }
-  
+
+  // The RCT signatures and range proofs are the bulk of the work of verifying
+  // a tx, and do not depend on the other txes in the block. The signatures are
+  // verified on the compute threadpool, while this thread verifies the range
+  // proofs of the whole block in one batch. Failures are reported for the first
+  // failing tx, as they would have been when checked in the loop above.
+  {
+    TIME_MEASURE_START(rct);
+    std::vector<uint8_t> rct_results(txs.size(), 1);
+    tools::threadpool& tpool = tools::threadpool::getInstanceForCompute();
+    tools::threadpool::waiter waiter(tpool);
+    for (size_t i = 0; i < txs.size(); ++i)
+    {
+      if (rct_mix_rings[i].empty())
+        continue;
+      tpool.submit(&waiter, [this, i, hf_version, &txs, &rct_mix_rings, &rct_results]() {
+        rct_results[i] = ver_rct_non_semantics_simple_cached(txs[i].first, hf_version, rct_mix_rings[i], m_rct_ver_cache, RCT_CACHE_TYPE);
+      }, false); // not a leaf, verRctNonSemanticsSimple uses the threadpool too
+    }
+
+    rct::range_proof_batch block_range_proofs;
+    for (const rct::range_proof_batch &tx_range_proofs: rct_range_proofs)
+    {
+      block_range_proofs.bulletproofs.insert(block_range_proofs.bulletproofs.end(), tx_range_proofs.bulletproofs.begin(), tx_range_proofs.bulletproofs.end());
+      block_range_proofs.bulletproofs_plus.insert(block_range_proofs.bulletproofs_plus.end(), tx_range_proofs.bulletproofs_plus.begin(), tx_range_proofs.bulletproofs_plus.end());
+    }
+    size_t range_proof_failure = txs.size();
+    if (!rct::verRangeProofBatch(block_range_proofs))
+    {
+      // find the culprit
+      for (size_t i = 0; i < txs.size(); ++i)
+      {
+        if (!rct::verRangeProofBatch(rct_range_proofs[i]))
+        {
+          range_proof_failure = i;
+          break;
+        }
+      }
+    }
+
+    if (!waiter.wait())
+    {
+      // a job threw, so not every result can be trusted
+      for (size_t i = 0; i < txs.size(); ++i)
+        if (!rct_mix_rings[i].empty())
+          rct_results[i] = 0;
+    }
+    TIME_MEASURE_FINISH(rct);
+    t_checktx += rct;
+
+    for (size_t i = 0; i < txs.size(); ++i)
+    {
+      if (i == range_proof_failure && rct_results[i])
+      {
+        LOG_PRINT_L1("Aggregate range proof verified failed");
+        LOG_PRINT_L2(" transaction proof-of-value is now invalid for tx " << bl.tx_hashes[i]);
+        bvc.m_verifivation_failed = true;
+        goto leave;
+      }
+      if (rct_results[i])
+        continue;
+      MERROR_VER("Failed to check ringct signatures!");
+      MERROR_VER("Block with id: " << id  << " has at least one transaction (id: " << bl.tx_hashes[i] << ") with wrong inputs.");
+
+      //TODO: why is this done?  make sure that keeping invalid blocks makes sense.
+      add_block_as_invalid(bl, id);
+      MERROR_VER("Block with id " << id << " added as invalid because of wrong inputs in transactions");
+      bvc.m_verifivation_failed = true;
+      return_tx_to_pool(txs);
+      goto leave;
+    }
+  }
+
   // if we were syncing pruned blocks
   if (n_pruned > 0)
   {
@@ -5731,7 +5892,9 @@ leave:
     {
       uint64_t long_term_block_weight = get_next_long_term_block_weight(block_weight);
       cryptonote::blobdata bd = cryptonote::block_to_blob(bl);
+      const offshore::pricing_record block_pr = bl.pricing_record;
       new_height = m_db->add_block(std::make_pair(std::move(bl), std::move(bd)), block_weight, long_term_block_weight, cumulative_difficulty, already_generated_coins, txs);
+      on_pricing_record_added(new_height - 1, block_pr);
     }
     catch (const KEY_IMAGE_EXISTS& e)
     {
@@ -6159,6 +6322,7 @@ bool Blockchain::cleanup_handle_incoming_blocks(bool force_sync)
 
   TIME_MEASURE_FINISH(t1);
   m_blocks_longhash_table.clear();
+  m_verified_pricing_records.clear();
   m_scan_table.clear();
   m_blocks_txs_check.clear();
 
@@ -6476,6 +6640,25 @@ bool Blockchain::prepare_handle_incoming_blocks(const std::vector<block_complete
       {
         m_blocks_longhash_table.insert(map.begin(), map.end());
       }
+
+      // check the oracle signatures of the whole span in one go, handle_block_to_main_chain
+      // then only has the cheap checks of pricing_record::valid left to do
+      m_verified_pricing_records.clear();
+      std::vector<const offshore::pricing_record*> pricing_records;
+      std::vector<crypto::hash> pricing_record_blocks;
+      for (const block &b : blocks)
+      {
+        if (b.major_version >= HF_VERSION_OFFSHORE_FULL && !b.pricing_record.empty())
+        {
+          pricing_records.push_back(&b.pricing_record);
+          pricing_record_blocks.push_back(get_block_hash(b));
+        }
+      }
+      std::vector<uint8_t> pricing_record_results;
+      offshore::verify_signatures(pricing_records, get_config(m_nettype).ORACLE_PUBLIC_KEY, pricing_record_results);
+      for (size_t i = 0; i < pricing_record_results.size(); ++i)
+        if (pricing_record_results[i])
+          m_verified_pricing_records.insert(pricing_record_blocks[i]);
     }
   }
 
@@ -6717,6 +6900,11 @@ cryptonote::blobdata Blockchain::get_txpool_tx_blob(const crypto::hash& txid, re
   return m_db->get_txpool_tx_blob(txid, tx_category);
 }
 
+bool Blockchain::get_txpool_tx_view(const crypto::hash& txid, const txpool_tx_meta_t *&meta, cryptonote::blobdata_ref &blob) const
+{
+  return m_db->get_txpool_tx_view(txid, meta, blob);
+}
+
 bool Blockchain::for_all_txpool_txes(std::function<bool(const crypto::hash&, const txpool_tx_meta_t&, const cryptonote::blobdata_ref*)> f, bool include_blob, relay_category tx_category) const
 {
   return m_db->for_all_txpool_txes(f, include_blob, tx_category);
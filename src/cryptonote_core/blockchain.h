@@ -43,7 +43,9 @@
 #include <boost/multi_index/hashed_index.hpp>
 #include <boost/multi_index/member.hpp>
 #include <atomic>
+#include <deque>
 #include <functional>
+#include <memory>
 #include <unordered_map>
 #include <unordered_set>
 
@@ -64,6 +66,7 @@
 #include "checkpoints/checkpoints.h"
 #include "cryptonote_basic/hardfork.h"
 #include "blockchain_db/blockchain_db.h"
+#include "pricing_record_service.h"
 
 namespace tools { class Notify; }
 
@@ -547,6 +550,16 @@ namespace cryptonote
      + @param allow_partial tbd
     */
     void get_output_key(const epee::span<const uint64_t> &amounts, const std::vector<uint64_t> &offsets, std::vector<output_data_t> &outputs, bool allow_partial=false) const;
+
+    /**
+     * @brief gets the ring members of a transaction's inputs for the anonymity pool checks
+     *
+     * @param tx the transaction
+     * @param ring_members return-by-reference the heights and asset ids of the ring members
+     *
+     * @return false if an input is of an unexpected type or a ring member does not exist, otherwise true
+     */
+    bool get_tx_ring_members(const transaction &tx, tx_ring_members &ring_members) const;
     
     /**
      * @brief gets specific outputs to mix with
@@ -758,11 +771,27 @@ namespace cryptonote
     uint64_t get_current_cumulative_block_weight_median() const;
 
     /**
-     * @brief gets the pricing record for the specified timestamp
+     * @brief gets the pricing record to put in a new block template
+     *
+     * The record comes from the pricing record service cache, so this never
+     * waits on the oracle. If the cached record would not be valid for the
+     * block, an empty record is returned and a refresh is requested.
+     *
+     * @param pr return-by-reference the pricing record
+     * @param hf_version the version of the block being created
+     * @param timestamp the timestamp of the block being created
+     * @param prev_timestamp the timestamp of the block's parent
+     *
+     * @return true, the returned record may be empty
+     */
+    bool get_pricing_record(offshore::pricing_record& pr, uint8_t hf_version, uint64_t timestamp, uint64_t prev_timestamp);
+
+    /**
+     * @brief gets the oracle fetch statistics of the pricing record service
      *
-     * @return false if method failed to obtain pricing record from oracle, otherwise true
+     * @return the statistics, all zero if the service has not been created
      */
-    bool get_pricing_record(offshore::pricing_record& pr, uint64_t timestamp);
+    pricing_record_service::stats get_pricing_record_stats() const;
 
     /**
      * @brief gets the latest pricing record that was in the last 10 block.
@@ -772,6 +801,19 @@ namespace cryptonote
      */
     bool get_latest_acceptable_pr(offshore::pricing_record& pr) const;
 
+    /**
+     * @brief gets the pricing record of the block with a given height
+     *
+     * Reads the record kept with the block's metadata rather than parsing
+     * the block, falling back to the block for databases which predate it.
+     *
+     * @param height the height
+     * @param pr return-by-reference the block's pricing record
+     *
+     * @return false if there is no block at that height, otherwise true
+     */
+    bool get_pricing_record_at_height(uint64_t height, offshore::pricing_record& pr) const;
+
     /**
      * @brief gets the difficulty of the block with a given height
      *
@@ -1103,6 +1145,7 @@ namespace cryptonote
     bool get_txpool_tx_meta(const crypto::hash& txid, txpool_tx_meta_t &meta) const;
     bool get_txpool_tx_blob(const crypto::hash& txid, cryptonote::blobdata &bd, relay_category tx_category) const;
     cryptonote::blobdata get_txpool_tx_blob(const crypto::hash& txid, relay_category tx_category) const;
+    bool get_txpool_tx_view(const crypto::hash& txid, const txpool_tx_meta_t *&meta, cryptonote::blobdata_ref &blob) const;
     bool for_all_txpool_txes(std::function<bool(const crypto::hash&, const txpool_tx_meta_t&, const cryptonote::blobdata_ref*)>, bool include_blob = false, relay_category tx_category = relay_category::broadcasted) const;
     bool txpool_tx_matches_category(const crypto::hash& tx_hash, relay_category category);
 
@@ -1204,6 +1247,7 @@ namespace cryptonote
     // metadata containers
     std::unordered_map<crypto::hash, std::unordered_map<crypto::key_image, std::vector<output_data_t>>> m_scan_table;
     std::unordered_map<crypto::hash, crypto::hash> m_blocks_longhash_table;
+    std::unordered_set<crypto::hash> m_verified_pricing_records;
 
     // Keccak hashes for each block and for fast pow checking
     std::vector<std::pair<crypto::hash, crypto::hash>> m_blocks_hash_of_hashes;
@@ -1230,6 +1274,12 @@ namespace cryptonote
     mutable crypto::hash m_long_term_block_weights_cache_tip_hash;
     mutable epee::misc_utils::rolling_median_t<uint64_t> m_long_term_block_weights_cache_rolling_median;
 
+    // non-empty pricing records of the recent blocks in [m_recent_pricing_records_start, m_recent_pricing_records_end)
+    mutable epee::critical_section m_recent_pricing_records_lock;
+    mutable std::deque<std::pair<uint64_t, offshore::pricing_record>> m_recent_pricing_records;
+    mutable uint64_t m_recent_pricing_records_start;
+    mutable uint64_t m_recent_pricing_records_end;
+
     epee::critical_section m_difficulty_lock;
     crypto::hash m_difficulty_for_next_block_top_hash;
     difficulty_type m_difficulty_for_next_block;
@@ -1249,6 +1299,8 @@ namespace cryptonote
 
     network_type m_nettype;
     bool m_offline;
+
+    std::unique_ptr<pricing_record_service> m_pricing_record_service;
     difficulty_type m_fixed_difficulty;
 
     std::atomic<bool> m_cancel;
@@ -1343,13 +1395,19 @@ namespace cryptonote
      * Currently this function calls ring signature validation for each
      * transaction.
      *
+     * If deferred_mix_ring is not NULL, the RCT signatures of simple RCT
+     * transactions are not verified here; the mix ring is moved into it
+     * instead, and the caller is left to call ver_rct_non_semantics_simple_cached
+     * with it. It is left empty when nothing was deferred.
+     *
      * @param tx the transaction to validate
      * @param tvc returned information about tx verification
      * @param pmax_related_block_height return-by-pointer the height of the most recent block in the input set
+     * @param deferred_mix_ring return-by-pointer the mix ring of a tx whose RCT signatures still need verifying
      *
      * @return false if any validation step fails, otherwise true
      */
-    bool check_tx_inputs(transaction& tx, tx_verification_context &tvc, uint64_t* pmax_used_block_height = NULL) const;
+    bool check_tx_inputs(transaction& tx, tx_verification_context &tvc, uint64_t* pmax_used_block_height = NULL, rct::ctkeyM* deferred_mix_ring = NULL) const;
 
     /**
      * @brief performs a blockchain reorganization according to the longest chain rule
@@ -1644,6 +1702,26 @@ namespace cryptonote
      */
     void invalidate_block_template_cache();
 
+    /**
+     * @brief keeps the recent pricing records in step with a block added at the top of the chain
+     *
+     * @param height the height of the new block
+     * @param pr the new block's pricing record
+     */
+    void on_pricing_record_added(uint64_t height, const offshore::pricing_record& pr);
+
+    /**
+     * @brief keeps the recent pricing records in step with the top block being popped
+     *
+     * @param height the height of the popped block
+     */
+    void on_pricing_record_popped(uint64_t height);
+
+    /**
+     * @brief drops the recent pricing records, they are reloaded on the next lookup
+     */
+    void invalidate_recent_pricing_records();
+
     /**
      * @brief stores a new cached block template
      *
@@ -913,6 +913,11 @@ namespace cryptonote
     const uint8_t hf_version = m_blockchain_storage.get_current_hard_fork_version();
     using tt = cryptonote::transaction_type;
     std::vector<const rct::rctSig*> rvv;
+
+    // The conversion economics of the whole batch are checked against this one
+    // supply snapshot, and tagged with its version so the pool only redoes those
+    // checks if the supply changed by the time the tx is added
+    const std::shared_ptr<const offshore::supply_snapshot> supply = m_blockchain_storage.get_db().get_supply_snapshot();
     for (size_t n = 0; n < tx_info.size(); ++n)
     {
       // Get the TX asset types
@@ -951,59 +956,16 @@ namespace cryptonote
       const uint64_t current_height = m_blockchain_storage.get_current_blockchain_height();
       anonymity_pool tx_anon_pool=anonymity_pool::UNSET;
       if (hf_version >= HF_VERSION_BURN && current_height >= SUPPLY_AUDIT_ANON_POOL_CHECK_HEIGHT) {
-        std::vector<std::vector<output_data_t>> tx_ring_outputs;
-        tx_ring_outputs.reserve(tx_info[n].tx->vin.size());
-        for (const txin_v& txin: tx_info[n].tx->vin){
-          std::vector<output_data_t> ring_outputs;
-          if (txin.type() == typeid(txin_haven_key)){
-            txin_haven_key tx_input=boost::get<txin_haven_key>(txin);
-            std::vector<uint64_t> absolute_offsets = relative_output_offsets_to_absolute(tx_input.key_offsets);
-
-            if (absolute_offsets.size()!=tx_input.key_offsets.size()){
-                MERROR_VER("Failed to obtain absolute ring offsets! amount = " << tx_input.amount);
-                set_semantics_failed(tx_info[n].tx_hash);
-                tx_info[n].tvc.m_verifivation_failed = true;
-                tx_info[n].result = false;
-                continue;  
-            }
-            try{
-              m_blockchain_storage.get_output_key(epee::span<const uint64_t>(&tx_input.amount, 1), absolute_offsets, ring_outputs, true);
-              if (absolute_offsets.size() != ring_outputs.size()){
-                MERROR_VER("Output does not exist! amount = " << tx_input.amount);
-                set_semantics_failed(tx_info[n].tx_hash);
-                tx_info[n].tvc.m_verifivation_failed = true;
-                tx_info[n].result = false;
-                continue;
-              }
-            }
-            catch (...){
-              MERROR_VER("Output does not exist! amount = " << tx_input.amount);
-              set_semantics_failed(tx_info[n].tx_hash);
-              tx_info[n].tvc.m_verifivation_failed = true;
-              tx_info[n].result = false;
-              continue;
-            }
-            tx_ring_outputs.push_back(ring_outputs);
-          } else if (txin.type() == typeid(txin_gen)){
-            tx_ring_outputs.push_back(ring_outputs);
-          } else {
-            MERROR_VER("Unexpected input type for transaction" << tx_info[n].tx_hash);
-            set_semantics_failed(tx_info[n].tx_hash);
-            tx_info[n].tvc.m_verifivation_failed = true;
-            tx_info[n].result = false;
-            continue;  
-          }
-        }
-
-        if (tx_ring_outputs.size()!=tx_info[n].tx->vin.size()){
-          MERROR_VER("Transaction has more inputs than number of ring member groups: " << tx_info[n].tx_hash);
+        tx_ring_members ring_members;
+        if (!m_blockchain_storage.get_tx_ring_members(*tx_info[n].tx, ring_members)){
+          MERROR_VER("Failed to get the ring members of transaction " << tx_info[n].tx_hash);
           set_semantics_failed(tx_info[n].tx_hash);
           tx_info[n].tvc.m_verifivation_failed = true;
           tx_info[n].result = false;
-          continue;    
+          continue;
         }
 
-        if(!get_anonymity_pool(*tx_info[n].tx, tx_ring_outputs, tx_anon_pool, m_blockchain_storage.get_nettype())){
+        if(!get_anonymity_pool(*tx_info[n].tx, ring_members, tx_anon_pool, m_blockchain_storage.get_nettype())){
           MERROR("Failed to get the anonymity pool for transaction " << tx_info[n].tx_hash);
           set_semantics_failed(tx_info[n].tx_hash);
           tx_info[n].tvc.m_verifivation_failed = true;
@@ -1050,58 +1012,15 @@ namespace cryptonote
           tx_info[n].tvc.pr.set_for_height_821428();
         } else {
           // Get the correct pricing record here, given the height
-          std::vector<std::pair<cryptonote::blobdata,block>> blocks_pr;
-          bool b = m_blockchain_storage.get_blocks(pr_height, 1, blocks_pr);
-          if (!b) {
+          if (!m_blockchain_storage.get_pricing_record_at_height(pr_height, tx_info[n].tvc.pr)) {
             MERROR_VER("Failed to obtain pricing record for block: " << pr_height);
             set_semantics_failed(tx_info[n].tx_hash);
             tx_info[n].tvc.m_verifivation_failed = true;
             tx_info[n].result = false;
             continue;
           }
-          tx_info[n].tvc.pr = blocks_pr[0].second.pricing_record;
         }
 
-        const std::vector<std::pair<std::string, std::string>>& supply_amounts = m_blockchain_storage.get_db().get_circulating_supply();
-
-        // Get the slippage
-        if (hf_version >= HF_VERSION_SLIPPAGE && tx_info[n].tvc.m_source_asset != tx_info[n].tvc.m_dest_asset) {
-          bool r = get_slippage(tx_info[n].tvc.m_type,
-                                tx_info[n].tvc.m_source_asset,
-                                tx_info[n].tvc.m_dest_asset,
-                                tx_info[n].tx->amount_burnt,
-                                tx_info[n].tvc.m_slippage,
-                                tx_info[n].tvc.pr,
-                                supply_amounts,
-                                hf_version
-                                );
-          if (!r) {
-            MERROR_VER("Failed to obtain slippage");
-            set_semantics_failed(tx_info[n].tx_hash);
-            tx_info[n].tvc.m_verifivation_failed = true;
-            tx_info[n].result = false;
-            continue;
-          }
-        }
-        
-        // Get the collateral requirements
-        if (hf_version >= HF_VERSION_USE_COLLATERAL && (tx_info[n].tvc.m_type == tt::OFFSHORE || tx_info[n].tvc.m_type == tt::ONSHORE)) {
-          bool r = get_collateral_requirements(
-            tx_info[n].tvc.m_type, 
-            tx_info[n].tx->amount_burnt,
-            tx_info[n].tvc.m_collateral,
-            tx_info[n].tvc.pr,
-            supply_amounts,
-            hf_version
-          );
-          if (!r) {
-            MERROR_VER("Failed to obtain collateral requirements");
-            set_semantics_failed(tx_info[n].tx_hash);
-            tx_info[n].tvc.m_verifivation_failed = true;
-            tx_info[n].result = false;
-            continue;
-          }
-        }
       }
 
       if (!check_tx_semantic(*tx_info[n].tx, keeped_by_block))
@@ -1191,8 +1110,12 @@ namespace cryptonote
     }
     if (!rvv.empty())
     {
-      LOG_PRINT_L1("Verifying one transaction at a time");
+      // Each tx's slippage, collateral and semantics only depend on the tx, its
+      // pricing record and the supply snapshot, so they are checked in parallel
+      LOG_PRINT_L1("Verifying " << tx_info.size() << " transactions in parallel");
       ret = false;
+      tools::threadpool& tpool = tools::threadpool::getInstanceForCompute();
+      tools::threadpool::waiter waiter(tpool);
       for (size_t n = 0; n < tx_info.size(); ++n)
       {
         if (!tx_info[n].result)
@@ -1207,62 +1130,109 @@ namespace cryptonote
             tx_info[n].tx->rct_signatures.type != rct::RCTTypeSupplyAudit)
           continue;
 
-        if (tx_info[n].tx->rct_signatures.type == rct::RCTTypeHaven2 || tx_info[n].tx->rct_signatures.type == rct::RCTTypeHaven3 || tx_info[n].tx->rct_signatures.type == rct::RCTTypeBulletproofPlus || tx_info[n].tx->rct_signatures.type == rct::RCTTypeSupplyAudit) {
-
-          // NEAC: Get conversion rates for TX and for fees
-          uint64_t conversion_rate = COIN;
-          uint64_t fee_conversion_rate = COIN;
-          uint64_t tx_fee_conversion_rate = COIN;
-          if (tx_info[n].tvc.m_source_asset != tx_info[n].tvc.m_dest_asset) {
-
-            if (!cryptonote::get_conversion_rate(tx_info[n].tvc.pr, tx_info[n].tvc.m_source_asset, tx_info[n].tvc.m_dest_asset, conversion_rate, hf_version)) {
-              MERROR_VER("Failed to get conversion rate - aborting");
-              set_semantics_failed(tx_info[n].tx_hash);
-              tx_info[n].tvc.m_verifivation_failed = true;
-              tx_info[n].result = false;
-              continue;
-            }
-
-            if (!cryptonote::get_conversion_rate(tx_info[n].tvc.pr, tx_info[n].tvc.m_source_asset, "XHV", fee_conversion_rate, hf_version)) {
-              MERROR_VER("Failed to get fee conversion rate - aborting");
-              set_semantics_failed(tx_info[n].tx_hash);
-              tx_info[n].tvc.m_verifivation_failed = true;
-              tx_info[n].result = false;
-              continue;
+        tpool.submit(&waiter, [this, n, hf_version, &tx_info, &supply] {
+          if (tx_info[n].tvc.m_source_asset != tx_info[n].tvc.m_dest_asset)
+          {
+            // Get the slippage
+            if (hf_version >= HF_VERSION_SLIPPAGE) {
+              bool r = get_slippage(tx_info[n].tvc.m_type,
+                                    tx_info[n].tvc.m_source_asset,
+                                    tx_info[n].tvc.m_dest_asset,
+                                    tx_info[n].tx->amount_burnt,
+                                    tx_info[n].tvc.m_slippage,
+                                    tx_info[n].tvc.pr,
+                                    *supply,
+                                    hf_version
+                                    );
+              if (!r) {
+                MERROR_VER("Failed to obtain slippage");
+                set_semantics_failed(tx_info[n].tx_hash);
+                tx_info[n].tvc.m_verifivation_failed = true;
+                tx_info[n].result = false;
+                return;
+              }
             }
 
-            if (!cryptonote::get_conversion_rate(tx_info[n].tvc.pr, "XHV", tx_info[n].tvc.m_source_asset, tx_fee_conversion_rate, hf_version)) {
-              MERROR_VER("Failed to get TX fee conversion rate - aborting");
-              set_semantics_failed(tx_info[n].tx_hash);
-              tx_info[n].tvc.m_verifivation_failed = true;
-              tx_info[n].result = false;
-              continue;
+            // Get the collateral requirements
+            if (hf_version >= HF_VERSION_USE_COLLATERAL && (tx_info[n].tvc.m_type == tt::OFFSHORE || tx_info[n].tvc.m_type == tt::ONSHORE)) {
+              bool r = get_collateral_requirements(
+                tx_info[n].tvc.m_type,
+                tx_info[n].tx->amount_burnt,
+                tx_info[n].tvc.m_collateral,
+                tx_info[n].tvc.pr,
+                *supply,
+                hf_version
+              );
+              if (!r) {
+                MERROR_VER("Failed to obtain collateral requirements");
+                set_semantics_failed(tx_info[n].tx_hash);
+                tx_info[n].tvc.m_verifivation_failed = true;
+                tx_info[n].result = false;
+                return;
+              }
             }
+            tx_info[n].tvc.m_economics_supply_version = supply->version;
           }
-          
-          if (!rct::verRctSemanticsSimple2(tx_info[n].tx->rct_signatures, tx_info[n].tvc.pr, conversion_rate, fee_conversion_rate, tx_fee_conversion_rate, tx_info[n].tvc.m_type, tx_info[n].tvc.m_source_asset, tx_info[n].tvc.m_dest_asset, tx_info[n].tx->amount_burnt, tx_info[n].tx->amount_minted, tx_info[n].tx->vout, tx_info[n].tx->vin, hf_version, tx_info[n].tvc.m_collateral, tx_info[n].tvc.m_slippage, tx_info[n].tvc.m_tx_anon_pool))
-            {
-              // 2 tx that used reorged pricing reocord for callateral calculation.
-              if (epee::string_tools::pod_to_hex(tx_info[n].tx_hash) != "e9c0753df108cb9de343d78c3bbdec0cebd56ee5c26c09ecf46dbf8af7838956"
-              && epee::string_tools::pod_to_hex(tx_info[n].tx_hash) != "55de061be8f769d6ab5ba7938c10e2f2fb635e5da82d2615ed7a8b06d9f9025b"
-              && epee::string_tools::pod_to_hex(tx_info[n].tx_hash) != "10e47b28af3dd84326f651ad064ffce7533bef41753c1affa64f0f6cf47d869d"
-              && epee::string_tools::pod_to_hex(tx_info[n].tx_hash) != "736c9a002f8d402536b00bf01fd048d3bd7d868cfbf25edf47ded05ab42421be") {
+
+          if (tx_info[n].tx->rct_signatures.type == rct::RCTTypeHaven2 || tx_info[n].tx->rct_signatures.type == rct::RCTTypeHaven3 || tx_info[n].tx->rct_signatures.type == rct::RCTTypeBulletproofPlus || tx_info[n].tx->rct_signatures.type == rct::RCTTypeSupplyAudit) {
+
+            // NEAC: Get conversion rates for TX and for fees
+            uint64_t conversion_rate = COIN;
+            uint64_t fee_conversion_rate = COIN;
+            uint64_t tx_fee_conversion_rate = COIN;
+            if (tx_info[n].tvc.m_source_asset != tx_info[n].tvc.m_dest_asset) {
+
+              if (!cryptonote::get_conversion_rate(tx_info[n].tvc.pr, tx_info[n].tvc.m_source_asset, tx_info[n].tvc.m_dest_asset, conversion_rate, hf_version)) {
+                MERROR_VER("Failed to get conversion rate - aborting");
+                set_semantics_failed(tx_info[n].tx_hash);
+                tx_info[n].tvc.m_verifivation_failed = true;
+                tx_info[n].result = false;
+                return;
+              }
+
+              if (!cryptonote::get_conversion_rate(tx_info[n].tvc.pr, tx_info[n].tvc.m_source_asset, "XHV", fee_conversion_rate, hf_version)) {
+                MERROR_VER("Failed to get fee conversion rate - aborting");
                 set_semantics_failed(tx_info[n].tx_hash);
                 tx_info[n].tvc.m_verifivation_failed = true;
                 tx_info[n].result = false;
-              } else {
-                LOG_PRINT_L2("NOTICE: allowing PR fix for TX " << epee::string_tools::pod_to_hex(tx_info[n].tx_hash));
+                return;
+              }
+
+              if (!cryptonote::get_conversion_rate(tx_info[n].tvc.pr, "XHV", tx_info[n].tvc.m_source_asset, tx_fee_conversion_rate, hf_version)) {
+                MERROR_VER("Failed to get TX fee conversion rate - aborting");
+                set_semantics_failed(tx_info[n].tx_hash);
+                tx_info[n].tvc.m_verifivation_failed = true;
+                tx_info[n].result = false;
+                return;
               }
             }
-        } else {
-          if (!rct::verRctSemanticsSimple(tx_info[n].tx->rct_signatures, tx_info[n].tvc.pr, tx_info[n].tvc.m_type, tx_info[n].tvc.m_source_asset, tx_info[n].tvc.m_dest_asset))
-          {
-            set_semantics_failed(tx_info[n].tx_hash);
-            tx_info[n].tvc.m_verifivation_failed = true;
-            tx_info[n].result = false;
+          
+            if (!rct::verRctSemanticsSimple2(tx_info[n].tx->rct_signatures, tx_info[n].tvc.pr, conversion_rate, fee_conversion_rate, tx_fee_conversion_rate, tx_info[n].tvc.m_type, tx_info[n].tvc.m_source_asset, tx_info[n].tvc.m_dest_asset, tx_info[n].tx->amount_burnt, tx_info[n].tx->amount_minted, tx_info[n].tx->vout, tx_info[n].tx->vin, hf_version, tx_info[n].tvc.m_collateral, tx_info[n].tvc.m_slippage, tx_info[n].tvc.m_tx_anon_pool))
+              {
+                // 2 tx that used reorged pricing reocord for callateral calculation.
+                if (epee::string_tools::pod_to_hex(tx_info[n].tx_hash) != "e9c0753df108cb9de343d78c3bbdec0cebd56ee5c26c09ecf46dbf8af7838956"
+                && epee::string_tools::pod_to_hex(tx_info[n].tx_hash) != "55de061be8f769d6ab5ba7938c10e2f2fb635e5da82d2615ed7a8b06d9f9025b"
+                && epee::string_tools::pod_to_hex(tx_info[n].tx_hash) != "10e47b28af3dd84326f651ad064ffce7533bef41753c1affa64f0f6cf47d869d"
+                && epee::string_tools::pod_to_hex(tx_info[n].tx_hash) != "736c9a002f8d402536b00bf01fd048d3bd7d868cfbf25edf47ded05ab42421be") {
+                  set_semantics_failed(tx_info[n].tx_hash);
+                  tx_info[n].tvc.m_verifivation_failed = true;
+                  tx_info[n].result = false;
+                } else {
+                  LOG_PRINT_L2("NOTICE: allowing PR fix for TX " << epee::string_tools::pod_to_hex(tx_info[n].tx_hash));
+                }
+              }
+          } else {
+            if (!rct::verRctSemanticsSimple(tx_info[n].tx->rct_signatures, tx_info[n].tvc.pr, tx_info[n].tvc.m_type, tx_info[n].tvc.m_source_asset, tx_info[n].tvc.m_dest_asset))
+            {
+              set_semantics_failed(tx_info[n].tx_hash);
+              tx_info[n].tvc.m_verifivation_failed = true;
+              tx_info[n].result = false;
+            }
           }
-        }
+        });
       }
+      if (!waiter.wait())
+        return false;
     }
     return ret;
   }
@@ -29,6 +29,8 @@
 // 
 // Parts of this file are originally copyright (c) 2012-2013 The Cryptonote developers
 
+#include <cmath>
+#include <sstream>
 #include <unordered_set>
 #include <random>
 #include "include_base_utils.h"
@@ -46,6 +48,7 @@ using namespace epee;
 #include "ringct/rctSigs.h"
 #include "multisig/multisig.h"
 #include "offshore/asset_types.h"
+#include "slippage_utils.h"
 
 #include <boost/multiprecision/cpp_bin_float.hpp>
 
@@ -668,11 +671,11 @@ namespace cryptonote
   bool get_tx_type(const std::string& source, const std::string& destination, transaction_type& type) {
 
     // check both source and destination are supported.
-    if (std::find(offshore::ASSET_TYPES.begin(), offshore::ASSET_TYPES.end(), source) == offshore::ASSET_TYPES.end()) {
+    if (!offshore::is_valid_asset_type(source)) {
       LOG_ERROR("Source Asset type " << source << " is not supported! Rejecting..");
       return false;
     }
-    if (std::find(offshore::ASSET_TYPES.begin(), offshore::ASSET_TYPES.end(), destination) == offshore::ASSET_TYPES.end()) {
+    if (!offshore::is_valid_asset_type(destination)) {
       LOG_ERROR("Destination Asset type " << destination << " is not supported! Rejecting..");
       return false;
     }
@@ -707,99 +710,65 @@ namespace cryptonote
   //---------------------------------------------------------------
   bool get_slippage(const transaction_type &tx_type, const std::string &source_asset, const std::string &dest_asset, const uint64_t amount, uint64_t &slippage, const offshore::pricing_record &pr, const std::vector<std::pair<std::string, std::string>> &amounts, const uint8_t hf_version)
   {
-    using namespace boost::multiprecision;
-    using tt = cryptonote::transaction_type;
-
-    LOG_PRINT_L2("cryptonote_tx_utils::" << __func__);
-
-    // Fail dismally if we have been called too early
-    if (hf_version < HF_VERSION_SLIPPAGE) {
-      LOG_ERROR("get_slippage() called from a pre-slippage client - aborting");
+    offshore::supply_snapshot supply;
+    if (!supply.from_amounts(amounts)) {
+      LOG_ERROR("Invalid circulating supply data passed to get_slippage() - aborting");
       return false;
     }
-    
-    // Do the right thing based upon TX type
-    if (tx_type == tt::TRANSFER || tx_type == tt::OFFSHORE_TRANSFER || tx_type == tt::XASSET_TRANSFER) {
-      slippage = 0;
-      return true;
-    }
-
-    // Process the circulating supply data
-    std::map<std::string, uint128_t> map_amounts;
-    uint128_t mcap_xassets = 0;
-    for (const auto &i: amounts)
-    {
-      // Copy into the map for expediency
-      map_amounts[i.first] = uint128_t(i.second.c_str());
-
-      // Exclude XHV from the xAssets MCAP
-      if (i.first == "XHV") continue;
-
-      // Get the pricing data for the xAsset
-      uint128_t price_xasset = pr.spot(i.first);
-      
-      // Multiply by the amount of coin in circulation
-      uint128_t amount_xasset(i.second.c_str());
-
-      // Skip scaling of xUSD, because price uses notional peg rather than actual value
-      if (i.first != "XUSD") {
-        amount_xasset *= COIN;
-        amount_xasset /= price_xasset;
-      }
-
-      // Sum into our total for all xAssets
-      mcap_xassets += amount_xasset;
-    }
+    return get_slippage(tx_type, source_asset, dest_asset, amount, slippage, pr, supply, hf_version);
+  }
+  //---------------------------------------------------------------
+  namespace
+  {
+    inline double to_double(double x) { return x; }
+    inline double to_double(const boost::multiprecision::cpp_bin_float_quad &x) { return x.convert_to<double>(); }
+  }
+  //---------------------------------------------------------------
+  template<typename F>
+  bool get_total_slippage(F &total_slippage, const slippage_inputs &in, const offshore::pricing_record &pr, const offshore::supply_snapshot &supply, const uint8_t hf_version)
+  {
+    using namespace boost::multiprecision;
+    using tt = cryptonote::transaction_type;
+    using std::pow;
+    using std::sqrt;
 
-    // Check for seeding of pools
-    if (!map_amounts.count(dest_asset) || map_amounts[dest_asset] == 0) {
-      slippage = 0;
-      return true;
-    }
+    const transaction_type tx_type = in.tx_type;
+    const uint128_t &convert_amount = in.convert_amount;
+    const uint128_t &supply_xhv = in.supply_xhv;
+    const uint128_t &supply_xusd = in.supply_xusd;
 
-    // Calculate the XHV market cap for spot + MA
-    uint128_t mcap_xhv_spot = map_amounts["XHV"];
-    mcap_xhv_spot *= pr.spot("XHV");
-    mcap_xhv_spot /= COIN;
-    uint128_t mcap_xhv_ma = map_amounts["XHV"];
-    mcap_xhv_ma *= pr.ma("XHV");
-    mcap_xhv_ma /= COIN;
-
-    // Take a copy of the amount to convert
-    uint128_t convert_amount = amount;
-    
     // Calculate the source pool %
-    cpp_bin_float_quad src_pool_ratio = convert_amount.convert_to<cpp_bin_float_quad>() / map_amounts[source_asset].convert_to<cpp_bin_float_quad>();
+    F src_pool_ratio = convert_amount.convert_to<F>() / supply.circulating(in.source_id).convert_to<F>();
 
     // Calculate the source pool multiplier
-    cpp_bin_float_quad src_pool_multiplier = pow((sqrt(pow((src_pool_ratio * 7.0), 0.5)) + 1.0), 5.0);
+    F src_pool_multiplier = pow((sqrt(pow((src_pool_ratio * 7.0), 0.5)) + 1.0), 5.0);
 
     // Calculate the source pool slippage
-    cpp_bin_float_quad src_pool_slippage = src_pool_ratio * src_pool_multiplier;
+    F src_pool_slippage = src_pool_ratio * src_pool_multiplier;
 
     // Calculate the dest pool ratio and multiplier 
-    cpp_bin_float_quad dest_pool_ratio = 0.0;
-    cpp_bin_float_quad dest_pool_multiplier = 5.0;
+    F dest_pool_ratio = 0.0;
+    F dest_pool_multiplier = 5.0;
     if (tx_type == tt::ONSHORE) {
       uint128_t dpr_numerator = convert_amount * COIN;
-      uint128_t dpr_denominator = map_amounts["XHV"] * std::min(pr.spot("XHV"), pr.ma("XHV"));
-      dest_pool_ratio = dpr_numerator.convert_to<cpp_bin_float_quad>() / dpr_denominator.convert_to<cpp_bin_float_quad>();
+      uint128_t dpr_denominator = supply_xhv * std::min(pr.spot(offshore::ASSET_XHV), pr.ma(offshore::ASSET_XHV));
+      dest_pool_ratio = dpr_numerator.convert_to<F>() / dpr_denominator.convert_to<F>();
       dest_pool_multiplier = pow((sqrt(pow(dest_pool_ratio, 0.4)) + 1.0), 15.0);
     } else if (tx_type == tt::OFFSHORE) {
       //dest_pool_ratio = (convert_amount * std::max(pr.spot("XHV"), pr.ma("XHV")) / (map_amounts["xUSD"] * std::min(pr.spot("xUSD"), pr.ma("xUSD"))));
-      uint128_t dpr_numerator = convert_amount * pr.max("XHV");
-      uint128_t dpr_denominator = map_amounts["XUSD"] * pr.min("XUSD");
-      dest_pool_ratio = dpr_numerator.convert_to<cpp_bin_float_quad>() / dpr_denominator.convert_to<cpp_bin_float_quad>();
+      uint128_t dpr_numerator = convert_amount * pr.max(offshore::ASSET_XHV);
+      uint128_t dpr_denominator = supply_xusd * pr.min(offshore::ASSET_XUSD);
+      dest_pool_ratio = dpr_numerator.convert_to<F>() / dpr_denominator.convert_to<F>();
     } else if (tx_type == tt::XASSET_TO_XUSD) {
       //dest_pool_ratio = (convert_amount * COIN) / (map_amounts[dest_asset] * pr.min("xUSD"));
-      uint128_t dpr_numerator = (convert_amount * COIN) / pr.spot(source_asset);
-      uint128_t dpr_denominator = (map_amounts["XUSD"] * pr.min("XUSD")) / COIN;
-      dest_pool_ratio = dpr_numerator.convert_to<cpp_bin_float_quad>() / dpr_denominator.convert_to<cpp_bin_float_quad>();
+      uint128_t dpr_numerator = (convert_amount * COIN) / pr.spot(in.source_id);
+      uint128_t dpr_denominator = (supply_xusd * pr.min(offshore::ASSET_XUSD)) / COIN;
+      dest_pool_ratio = dpr_numerator.convert_to<F>() / dpr_denominator.convert_to<F>();
     } else if (tx_type == tt::XUSD_TO_XASSET) {
       //dest_pool_ratio = (convert_amount * pr.spot(source_asset)) / (map_amounts[dest_asset] * pr.spot(dest_asset));
       uint128_t dpr_numerator = convert_amount;
-      uint128_t dpr_denominator = (map_amounts[dest_asset] * COIN) / pr.spot(dest_asset);
-      dest_pool_ratio = dpr_numerator.convert_to<cpp_bin_float_quad>() / dpr_denominator.convert_to<cpp_bin_float_quad>();
+      uint128_t dpr_denominator = (supply.circulating(in.dest_id) * COIN) / pr.spot(in.dest_id);
+      dest_pool_ratio = dpr_numerator.convert_to<F>() / dpr_denominator.convert_to<F>();
     } else {
       // Not a valid transaction type for slippage
       LOG_ERROR("Invalid transaction type specified for get_slippage() - aborting");
@@ -807,50 +776,50 @@ namespace cryptonote
     }
 
     // Calculate the dest pool slippage
-    cpp_bin_float_quad dest_pool_slippage = dest_pool_ratio * dest_pool_multiplier;
+    F dest_pool_slippage = dest_pool_ratio * dest_pool_multiplier;
 
     // Calculate basic_slippage
-    cpp_bin_float_quad basic_slippage = src_pool_slippage + dest_pool_slippage;
-    LOG_PRINT_L2("*** basic_slippage = " << basic_slippage.convert_to<double>());
+    F basic_slippage = src_pool_slippage + dest_pool_slippage;
+    LOG_PRINT_L2("*** basic_slippage = " << to_double(basic_slippage));
     
     // Calculate Mcap ratio slippage
-    cpp_bin_float_quad mcap_ratio_slippage = 0.0;
-    cpp_bin_float_quad mcap_ratio_onshore_addon_slippage = 0.0;
+    F mcap_ratio_slippage = 0.0;
+    F mcap_ratio_onshore_addon_slippage = 0.0;
     if (tx_type == tt::ONSHORE || tx_type == tt::OFFSHORE) {
     
       // Calculate Mcap Ratio for XHV spot
-      cpp_bin_float_quad mcr_sp = mcap_xassets.convert_to<cpp_bin_float_quad>() / mcap_xhv_spot.convert_to<cpp_bin_float_quad>();
+      F mcr_sp = in.mcap_xassets.convert_to<F>() / in.mcap_xhv_spot.convert_to<F>();
 
       // Calculate Mcap Ratio for XHV MA
-      cpp_bin_float_quad mcr_ma = mcap_xassets.convert_to<cpp_bin_float_quad>() / mcap_xhv_ma.convert_to<cpp_bin_float_quad>();
+      F mcr_ma = in.mcap_xassets.convert_to<F>() / in.mcap_xhv_ma.convert_to<F>();
 
       // Get the largest of these in a more usable format
-      cpp_bin_float_quad mcr_max = (mcr_sp > mcr_ma) ? mcr_sp : mcr_ma;
+      F mcr_max = (mcr_sp > mcr_ma) ? mcr_sp : mcr_ma;
       
       // Calculate the Mcap ratio slippage
-      mcap_ratio_slippage = (hf_version < HF_VERSION_SLIPPAGE_V2) ? std::sqrt(std::pow(mcr_max.convert_to<double>(), 1.2)) / 6.0 : std::sqrt(std::pow(mcr_max.convert_to<double>(), 1.7)) / 3.0;
+      mcap_ratio_slippage = (hf_version < HF_VERSION_SLIPPAGE_V2) ? std::sqrt(std::pow(to_double(mcr_max), 1.2)) / 6.0 : std::sqrt(std::pow(to_double(mcr_max), 1.7)) / 3.0;
       //add-on for onshores, based on XHV price
       if ((hf_version >= HF_VERSION_SLIPPAGE_V2) && (tx_type == tt::ONSHORE)) {
 
-        uint128_t mraon_numerator = map_amounts["XHV"];
-        uint128_t mraon_denominator = ((map_amounts["XUSD"] * pr.min("XHV"))/COIN)*100;
+        uint128_t mraon_numerator = supply_xhv;
+        uint128_t mraon_denominator = ((supply_xusd * pr.min(offshore::ASSET_XHV))/COIN)*100;
         if ( mraon_denominator == 0 ){
-          LOG_ERROR("Invalid denominator (0) in calculation of mcap ratio onshore addon - aborting, XHV price is " << pr.min("XHV") << " XUSD supply is " << map_amounts["XUSD"] );
+          LOG_ERROR("Invalid denominator (0) in calculation of mcap ratio onshore addon - aborting, XHV price is " << pr.min(offshore::ASSET_XHV) << " XUSD supply is " << supply_xusd );
           return false;  
         }
-        mcap_ratio_onshore_addon_slippage = mraon_numerator.convert_to<cpp_bin_float_quad>() / mraon_denominator.convert_to<cpp_bin_float_quad>();
+        mcap_ratio_onshore_addon_slippage = mraon_numerator.convert_to<F>() / mraon_denominator.convert_to<F>();
       }
       
-      LOG_PRINT_L2("*** original mcap_ratio_slippage = " << mcap_ratio_slippage.convert_to<double>());
-      LOG_PRINT_L2("*** mcap_ratio_onshore_addon_slippage = " << mcap_ratio_onshore_addon_slippage.convert_to<double>());
+      LOG_PRINT_L2("*** original mcap_ratio_slippage = " << to_double(mcap_ratio_slippage));
+      LOG_PRINT_L2("*** mcap_ratio_onshore_addon_slippage = " << to_double(mcap_ratio_onshore_addon_slippage));
       mcap_ratio_slippage+=mcap_ratio_onshore_addon_slippage;
-      LOG_PRINT_L2("*** final mcap_ratio_slippage (sum of original mcap_ratio_slippage and mcap_ratio_onshore_addon_slippage) = " << mcap_ratio_slippage.convert_to<double>());
+      LOG_PRINT_L2("*** final mcap_ratio_slippage (sum of original mcap_ratio_slippage and mcap_ratio_onshore_addon_slippage) = " << to_double(mcap_ratio_slippage));
       
     }
 
     // Calculate xUSD Peg Slippage
-    cpp_bin_float_quad xusd_peg_slippage = 0;
-    double xusd_peg_ratio = pr.min("XUSD");
+    F xusd_peg_slippage = 0;
+    double xusd_peg_ratio = pr.min(offshore::ASSET_XUSD);
     xusd_peg_ratio /= COIN;
     
     if (xusd_peg_ratio < 1.0) {
@@ -859,45 +828,193 @@ namespace cryptonote
     }
 
     // Calculate the xBTC Mcap Ratio Slippage
-    cpp_bin_float_quad xbtc_mcap_ratio_slippage = 0.0;
+    F xbtc_mcap_ratio_slippage = 0.0;
     if (tx_type == tt::XUSD_TO_XASSET || tx_type == tt::XASSET_TO_XUSD) {
 
       // Calculate the xBTC Mcap
-      cpp_bin_float_quad mcap_xbtc = map_amounts["XBTC"].convert_to<cpp_bin_float_quad>();
+      F mcap_xbtc = supply.circulating(offshore::ASSET_XBTC).convert_to<F>();
       mcap_xbtc *= COIN;
-      mcap_xbtc /= pr.spot("XBTC");
+      mcap_xbtc /= pr.spot(offshore::ASSET_XBTC);
       
       // Calculate the xUSD Mcap
-      cpp_bin_float_quad mcap_xusd = map_amounts["XUSD"].convert_to<cpp_bin_float_quad>();
-      mcap_xusd *= pr.min("XUSD");
+      F mcap_xusd = supply_xusd.convert_to<F>();
+      mcap_xusd *= pr.min(offshore::ASSET_XUSD);
       mcap_xusd /= COIN;
 
       // Update the xBTC Mcap Ratio Slippage
-      xbtc_mcap_ratio_slippage = std::sqrt(std::pow((mcap_xbtc / mcap_xusd).convert_to<double>(), 1.4)) / 10.0;
-      LOG_PRINT_L2("*** xbtc_mcap_ratio_slippage = " << xbtc_mcap_ratio_slippage.convert_to<double>());
+      xbtc_mcap_ratio_slippage = std::sqrt(std::pow(to_double(mcap_xbtc / mcap_xusd), 1.4)) / 10.0;
+      LOG_PRINT_L2("*** xbtc_mcap_ratio_slippage = " << to_double(xbtc_mcap_ratio_slippage));
     }
     
     // Calculate the total slippage
-    cpp_bin_float_quad total_slippage =
+    total_slippage =
       (tx_type == tt::ONSHORE || tx_type == tt::OFFSHORE) ? basic_slippage + std::max(mcap_ratio_slippage, xusd_peg_slippage) :
-      (tx_type == tt::XUSD_TO_XASSET && dest_asset == "XBTC") ? basic_slippage + std::max(xbtc_mcap_ratio_slippage, xusd_peg_slippage) :
+      (tx_type == tt::XUSD_TO_XASSET && in.dest_id == offshore::ASSET_XBTC) ? basic_slippage + std::max(xbtc_mcap_ratio_slippage, xusd_peg_slippage) :
       basic_slippage + xusd_peg_slippage;
-    LOG_PRINT_L1("total_slippage (before rounding) = " << total_slippage.convert_to<double>());
-    
+    LOG_PRINT_L1("total_slippage (before rounding) = " << to_double(total_slippage));
+    return true;
+  }
+  template bool get_total_slippage<double>(double &total_slippage, const slippage_inputs &in, const offshore::pricing_record &pr, const offshore::supply_snapshot &supply, const uint8_t hf_version);
+  template bool get_total_slippage<boost::multiprecision::cpp_bin_float_quad>(boost::multiprecision::cpp_bin_float_quad &total_slippage, const slippage_inputs &in, const offshore::pricing_record &pr, const offshore::supply_snapshot &supply, const uint8_t hf_version);
+  //---------------------------------------------------------------
+  bool round_slippage_v1(double total_slippage, uint64_t amount, uint64_t &slippage)
+  {
+    if (!std::isfinite(total_slippage) || total_slippage < 0.0)
+      return false;
+    const double error = total_slippage * SLIPPAGE_DOUBLE_TOLERANCE;
+    if (total_slippage + error >= 0.99)
+      return false;
+    const double units = total_slippage * amount / 100000000.0;
+    const double units_error = 2.0 * units * SLIPPAGE_DOUBLE_TOLERANCE;
+    const double whole = std::floor(units);
+    if (units - whole <= units_error || whole + 1.0 - units <= units_error)
+      return false;
+    slippage = static_cast<uint64_t>(whole) * 100000000;
+    return true;
+  }
+  //---------------------------------------------------------------
+  uint64_t round_slippage_v1(boost::multiprecision::cpp_bin_float_quad total_slippage, const boost::multiprecision::uint128_t &amount)
+  {
     // Limit total_slippage to 99% so that the code doesn't break
+    if (total_slippage > 0.99) total_slippage = 0.99;
+    LOG_PRINT_L1("total_slippage (after rounding) = " << total_slippage.convert_to<double>());
+    total_slippage *= amount.convert_to<boost::multiprecision::cpp_bin_float_quad>();
+    uint64_t slippage = total_slippage.convert_to<uint64_t>();
+    slippage -= (slippage % 100000000);
+    return slippage;
+  }
+  //---------------------------------------------------------------
+  bool round_slippage_percent(double total_slippage, boost::multiprecision::uint128_t &percent)
+  {
+    if (!std::isfinite(total_slippage) || total_slippage < 0.0)
+      return false;
+    const double error = total_slippage * SLIPPAGE_DOUBLE_TOLERANCE;
+    if (total_slippage - error > 1.0)
+    {
+      percent = 100;
+      return true;
+    }
+    if (total_slippage + error >= 1.0)
+      return false;
+    const double percents = total_slippage * 100.0;
+    const double percents_error = 2.0 * percents * SLIPPAGE_DOUBLE_TOLERANCE;
+    const double whole = std::floor(percents);
+    if (percents - whole <= percents_error || whole + 1.0 - percents <= percents_error)
+      return false;
+    percent = static_cast<uint64_t>(whole);
+    return true;
+  }
+  //---------------------------------------------------------------
+  boost::multiprecision::uint128_t round_slippage_percent(boost::multiprecision::cpp_bin_float_quad total_slippage)
+  {
+    if (total_slippage > 1) total_slippage = 1.00;
+    total_slippage=total_slippage*100.0;
+    return total_slippage.convert_to<boost::multiprecision::uint128_t>();
+  }
+  //---------------------------------------------------------------
+  void get_slippage_inputs(slippage_inputs &in, const transaction_type tx_type, const offshore::asset_id_t source_id, const offshore::asset_id_t dest_id, const uint64_t amount, const offshore::pricing_record &pr, const offshore::supply_snapshot &supply)
+  {
+    using namespace boost::multiprecision;
+
+    // Process the circulating supply data
+    const uint128_t supply_xhv = supply.circulating(offshore::ASSET_XHV);
+    const uint128_t supply_xusd = supply.circulating(offshore::ASSET_XUSD);
+    uint128_t mcap_xassets = 0;
+    for (uint8_t id = offshore::ASSET_XHV + 1; id < offshore::ASSET_COUNT; ++id)
+    {
+      const offshore::asset_id_t asset_id = static_cast<offshore::asset_id_t>(id);
+      if (!supply.has(asset_id)) continue;
+
+      // Get the pricing data for the xAsset
+      uint128_t price_xasset = pr.spot(asset_id);
+      
+      // Multiply by the amount of coin in circulation
+      uint128_t amount_xasset = supply.circulating(asset_id);
+
+      // Skip scaling of xUSD, because price uses notional peg rather than actual value
+      if (asset_id != offshore::ASSET_XUSD) {
+        amount_xasset *= COIN;
+        amount_xasset /= price_xasset;
+      }
+
+      // Sum into our total for all xAssets
+      mcap_xassets += amount_xasset;
+    }
+
+    // Calculate the XHV market cap for spot + MA
+    uint128_t mcap_xhv_spot = supply_xhv;
+    mcap_xhv_spot *= pr.spot(offshore::ASSET_XHV);
+    mcap_xhv_spot /= COIN;
+    uint128_t mcap_xhv_ma = supply_xhv;
+    mcap_xhv_ma *= pr.ma(offshore::ASSET_XHV);
+    mcap_xhv_ma /= COIN;
+
+    // Take a copy of the amount to convert
+    in = {tx_type, source_id, dest_id, amount, supply_xhv, supply_xusd, mcap_xassets, mcap_xhv_spot, mcap_xhv_ma};
+  }
+  //---------------------------------------------------------------
+  bool get_slippage(const transaction_type &tx_type, const std::string &source_asset, const std::string &dest_asset, const uint64_t amount, uint64_t &slippage, const offshore::pricing_record &pr, const offshore::supply_snapshot &supply, const uint8_t hf_version)
+  {
+    using namespace boost::multiprecision;
+    using tt = cryptonote::transaction_type;
+
+    LOG_PRINT_L2("cryptonote_tx_utils::" << __func__);
+
+    // Fail dismally if we have been called too early
+    if (hf_version < HF_VERSION_SLIPPAGE) {
+      LOG_ERROR("get_slippage() called from a pre-slippage client - aborting");
+      return false;
+    }
+    
+    // Do the right thing based upon TX type
+    if (tx_type == tt::TRANSFER || tx_type == tt::OFFSHORE_TRANSFER || tx_type == tt::XASSET_TRANSFER) {
+      slippage = 0;
+      return true;
+    }
+
+    const offshore::asset_id_t source_id = offshore::get_asset_id(source_asset);
+    const offshore::asset_id_t dest_id = offshore::get_asset_id(dest_asset);
+    if (!offshore::is_valid_asset_id(source_id) || !offshore::is_valid_asset_id(dest_id)) {
+      LOG_ERROR("Invalid asset type specified for get_slippage() - aborting");
+      return false;
+    }
+
+    slippage_inputs in;
+    get_slippage_inputs(in, tx_type, source_id, dest_id, amount, pr, supply);
+
+    // Check for seeding of pools
+    if (!supply.has(dest_id) || supply.circulating(dest_id) == 0) {
+      slippage = 0;
+      return true;
+    }
+
+    const uint128_t &convert_amount = in.convert_amount;
+
+    // The slippage fraction is rounded to whole percents (whole 0.0001 units of the
+    // amount before SLIPPAGE_V2), so unless it is too close to a rounding boundary,
+    // computing it in doubles rounds to the same slippage as the quad computation,
+    // which is much slower and only runs for those close calls
+    double total_slippage_double = 0.0;
+    if (!get_total_slippage(total_slippage_double, in, pr, supply, hf_version))
+      return false;
 
     if (hf_version < HF_VERSION_SLIPPAGE_V2) {
-      if (total_slippage > 0.99) total_slippage = 0.99;
-      LOG_PRINT_L1("total_slippage (after rounding) = " << total_slippage.convert_to<double>());
-      total_slippage *= convert_amount.convert_to<cpp_bin_float_quad>();
-      slippage = total_slippage.convert_to<uint64_t>();
-      slippage -= (slippage % 100000000);
+      if (!round_slippage_v1(total_slippage_double, amount, slippage)) {
+        cpp_bin_float_quad total_slippage;
+        if (!get_total_slippage(total_slippage, in, pr, supply, hf_version))
+          return false;
+        slippage = round_slippage_v1(total_slippage, convert_amount);
+      }
     } 
     else {
-      if (total_slippage > 1) total_slippage = 1.00;
-      total_slippage=total_slippage*100.0;
       //Make slippage a number in an discrete set of values - integers between 0 and 100
-      uint128_t slippage_rounded_numerator=total_slippage.convert_to<uint128_t>();
+      uint128_t slippage_rounded_numerator;
+      if (!round_slippage_percent(total_slippage_double, slippage_rounded_numerator)) {
+        cpp_bin_float_quad total_slippage;
+        if (!get_total_slippage(total_slippage, in, pr, supply, hf_version))
+          return false;
+        slippage_rounded_numerator = round_slippage_percent(total_slippage);
+      }
       //Make slippage a number in an discrete set of values - integers multiples of 10 between 0 and 1000
       slippage_rounded_numerator *= 10;
       if (slippage_rounded_numerator == 0)
@@ -941,28 +1058,44 @@ namespace cryptonote
     return true;
   }
   //---------------------------------------------------------------
+  bool get_slippage_reusing(const uint64_t computed_supply_version, const uint64_t computed_slippage, const transaction_type &tx_type, const std::string &source_asset, const std::string &dest_asset, const uint64_t amount, uint64_t &slippage, const offshore::pricing_record &pr, const offshore::supply_snapshot &supply, const uint8_t hf_version)
+  {
+    // snapshot versions only ever go up, so the same version is the same supply
+    if (computed_supply_version != 0 && computed_supply_version == supply.version) {
+      slippage = computed_slippage;
+      return true;
+    }
+    return get_slippage(tx_type, source_asset, dest_asset, amount, slippage, pr, supply, hf_version);
+  }
+  //---------------------------------------------------------------
   bool get_collateral_requirements(const transaction_type &tx_type, const uint64_t amount, uint64_t &collateral, const offshore::pricing_record &pr, const std::vector<std::pair<std::string, std::string>> &amounts, const uint8_t hf_version)
+  {
+    offshore::supply_snapshot supply;
+    if (!supply.from_amounts(amounts)) {
+      LOG_ERROR("Invalid circulating supply data passed to get_collateral_requirements() - aborting");
+      return false;
+    }
+    return get_collateral_requirements(tx_type, amount, collateral, pr, supply, hf_version);
+  }
+  //---------------------------------------------------------------
+  bool get_collateral_requirements(const transaction_type &tx_type, const uint64_t amount, uint64_t &collateral, const offshore::pricing_record &pr, const offshore::supply_snapshot &supply, const uint8_t hf_version)
   {
     using namespace boost::multiprecision;
     using tt = transaction_type;
 
     LOG_PRINT_L2("cryptonote_tx_utils::" << __func__);
     // Process the circulating supply data
-    std::map<std::string, uint128_t> map_amounts;
     uint128_t mcap_xassets = 0;
-    for (const auto &i: amounts)
+    for (uint8_t id = offshore::ASSET_XHV + 1; id < offshore::ASSET_COUNT; ++id)
     {
-      // Copy into the map for expediency
-      map_amounts[i.first] = uint128_t(i.second.c_str());
-      
-      // Skip XHV
-      if (i.first == "XHV") continue;
+      const offshore::asset_id_t asset_id = static_cast<offshore::asset_id_t>(id);
+      if (!supply.has(asset_id)) continue;
 
       // Get the pricing data for the xAsset
-      uint128_t price_xasset = (hf_version >= HF_VERSION_SLIPPAGE) ? pr.spot(i.first) : pr[i.first];
+      uint128_t price_xasset = (hf_version >= HF_VERSION_SLIPPAGE) ? pr.spot(asset_id) : pr[asset_id];
       
       // Multiply by the amount of coin in circulation
-      uint128_t amount_xasset(i.second.c_str());
+      uint128_t amount_xasset = supply.circulating(asset_id);
       amount_xasset *= COIN;
       amount_xasset /= price_xasset;
       
@@ -978,16 +1111,13 @@ namespace cryptonote
       0;
     */
     boost::multiprecision::uint128_t price_xhv =
-      (tx_type == tt::OFFSHORE) ? pr.min("XHV") :
-      (tx_type == tt::ONSHORE)  ? pr.max("XHV") :
+      (tx_type == tt::OFFSHORE) ? pr.min(offshore::ASSET_XHV) :
+      (tx_type == tt::ONSHORE)  ? pr.max(offshore::ASSET_XHV) :
       0;
-    uint128_t mcap_xhv = map_amounts["XHV"];
+    uint128_t mcap_xhv = supply.circulating(offshore::ASSET_XHV);
     mcap_xhv *= price_xhv;
     mcap_xhv /= COIN;
 
-    // Calculate the market cap ratio
-    cpp_bin_float_quad ratio_mcap_128 = mcap_xassets.convert_to<cpp_bin_float_quad>() / mcap_xhv.convert_to<cpp_bin_float_quad>();
-    double ratio_mcap = ratio_mcap_128.convert_to<double>();
     if (hf_version >= HF_VERSION_VBS_DISABLING) {
       // No collateral needed
       collateral = 0;
@@ -1020,7 +1150,12 @@ namespace cryptonote
       // Done - return to caller
       return true;
       
-    } else if (hf_version >= HF_VERSION_USE_COLLATERAL_V2) {
+    }
+
+    // Calculate the market cap ratio, which the VBS was based on before slippage
+    cpp_bin_float_quad ratio_mcap_128 = mcap_xassets.convert_to<cpp_bin_float_quad>() / mcap_xhv.convert_to<cpp_bin_float_quad>();
+    double ratio_mcap = ratio_mcap_128.convert_to<double>();
+    if (hf_version >= HF_VERSION_USE_COLLATERAL_V2) {
 
       if (tx_type == tt::TRANSFER || tx_type == tt::OFFSHORE_TRANSFER || tx_type == tt::XASSET_TRANSFER || tx_type == tt::XUSD_TO_XASSET || tx_type == tt::XASSET_TO_XUSD) {
         collateral = 0;
@@ -1154,13 +1289,25 @@ namespace cryptonote
       }
     }
 
+    offshore::supply_snapshot supply;
+    supply.set_tally(offshore::ASSET_XHV, boost::multiprecision::int128_t(str_xhv_supply));
+    return get_block_cap(supply, pr, hf_version);
+  }
+  //---------------------------------------------------------------
+  uint64_t get_block_cap(const offshore::supply_snapshot& supply, const offshore::pricing_record& pr, const uint8_t hf_version)
+  {
+    // From the introduction of slippage, the block cap was effectively superfluous. This was achieved by using the max TX value as the block cap
+    if (hf_version >= HF_VERSION_SLIPPAGE) {
+      return HAVEN_MAX_TX_VALUE;
+    }
+
     // get supply
-    boost::multiprecision::uint128_t xhv_supply_128(str_xhv_supply);
+    boost::multiprecision::uint128_t xhv_supply_128 = supply.circulating(offshore::ASSET_XHV);
     xhv_supply_128 /= COIN;
     uint64_t xhv_supply = xhv_supply_128.convert_to<uint64_t>();
 
     // get price
-    double price = (double)(pr.min("XHV"));//std::min(pr.unused1, pr.xUSD)); // smaller of the ma vs spot
+    double price = (double)(pr.min(offshore::ASSET_XHV));//std::min(pr.unused1, pr.xUSD)); // smaller of the ma vs spot
     price /= COIN;
 
     // market cap
@@ -2126,12 +2273,28 @@ namespace cryptonote
     return p;
   }
 
+  //---------------------------------------------------------------
+  void tx_ring_members::add_input(const output_data_t *outputs, size_t count)
+  {
+    // anything after the terminating NUL is not part of the asset type string
+    static_assert(sizeof(outputs->asset_type) == sizeof(uint64_t), "unexpected asset type field size");
+    for (size_t i = 0; i < count; ++i)
+    {
+      char padded[sizeof(uint64_t)] = {0};
+      memcpy(padded, outputs[i].asset_type, strnlen(outputs[i].asset_type, sizeof(padded)));
+      uint64_t asset_type;
+      memcpy(&asset_type, padded, sizeof(asset_type));
+      heights.push_back(outputs[i].height);
+      asset_types.push_back(asset_type);
+    }
+    input_begin.push_back(heights.size());
+  }
   //---------------------------------------------------------------
   //! This function tries to obtain the anonymity pool of a transaction.
   //! For each input, we check the ring members and determine if from which pool they are.
   //! If there are inputs with different pools, then the whole transaction has a mixed pool.
   //! If errors are encountered, then the function returns false and assigns UNSET to the anon_pool.
-  bool get_anonymity_pool(const transaction& tx, const std::vector<std::vector<output_data_t>>& tx_ring_outputs, anonymity_pool& tx_anon_pool, const network_type nettype)
+  bool get_anonymity_pool(const transaction& tx, const tx_ring_members& ring_members, anonymity_pool& tx_anon_pool, const network_type nettype)
   {
 
     const uint64_t supply_audit_height = (nettype != TESTNET && nettype != STAGENET) ? SUPPLY_AUDIT_BLOCK_HEIGHT :  SUPPLY_AUDIT_BLOCK_HEIGHT_TESTNET;
@@ -2139,8 +2302,8 @@ namespace cryptonote
     tx_anon_pool=anonymity_pool::UNSET;
     size_t assignments=0; //additional check to ensure we update anon_pool without missing inputs
 
-    //For each input of the transaction, we should have a vector with outputs which form its ring members
-    if (tx.vin.size()!=tx_ring_outputs.size()){
+    //For each input of the transaction, we should have a group of outputs which form its ring members
+    if (tx.vin.size()!=ring_members.num_inputs()){
       tx_anon_pool=anonymity_pool::UNSET;
       LOG_ERROR("The number of inputs differs from the number of groups of ring members! Rejecting..");
       return false;
@@ -2155,7 +2318,8 @@ namespace cryptonote
 
     for (size_t i = 0; i < tx.vin.size(); i++) {
       anonymity_pool pool_current_input=anonymity_pool::UNSET;
-      if(!get_input_anonymity_pool(tx.vin[i], tx_ring_outputs[i], pool_current_input, supply_audit_height)){
+      const size_t begin = ring_members.input_begin[i];
+      if(!get_input_anonymity_pool(tx.vin[i], ring_members.heights.data() + begin, ring_members.asset_types.data() + begin, ring_members.input_size(i), pool_current_input, supply_audit_height)){
         tx_anon_pool=anonymity_pool::UNSET;
         LOG_ERROR("Failed to get the anonymity pool of input " << i << " ! Rejecting..");
         return false;
@@ -2202,90 +2366,78 @@ namespace cryptonote
     return false;
   }
   //---------------------------------------------------------------
-  //! This function tries to obtain the anonymity pool of a transaction.
-  //! For each input, we check the ring members and determine from which pool they are.
-  //! If there are inputs with different pools, then the whole transaction has a mixed pool, which should lead to transaction rejection as part of the tx validation.
+  //! This function tries to obtain the anonymity pool of an input, from the heights and asset types of its ring members.
+  //! Ring members from before the supply audit cut-off are in Pool 1, the later ones in Pool 2.
+  //! If ring members are in both pools, then the input has a mixed pool, which should lead to transaction rejection as part of the tx validation.
   //! If errors are encountered, then the function returns false and assigns UNSET to the anon_pool.
-  bool get_input_anonymity_pool(const txin_v& txin, const std::vector<output_data_t>& ring_outputs, anonymity_pool& anon_pool, const uint64_t supply_audit_height)
+  bool get_input_anonymity_pool(const txin_v& txin, const uint64_t *heights, const uint64_t *asset_types, size_t count, anonymity_pool& anon_pool, const uint64_t supply_audit_height)
   {
     anon_pool=anonymity_pool::UNSET;
-    size_t assignments=0; //additional check to ensure we update anon_pool without missing inputs
 
     if (txin.type() == typeid(txin_gen)){
-      if (ring_outputs.size()==0){
+      if (count==0){
         anon_pool=anonymity_pool::NONE;
         return true;
       } else {
         LOG_ERROR("Coinbase input with ring members found! Rejecting..");
-        anon_pool=anonymity_pool::UNSET;
         return false;
       }
     }
 
     if (txin.type() == typeid(txin_haven_key)){
-      if (ring_outputs.size()==0){
+      if (count==0){
         anon_pool=anonymity_pool::UNSET;
         LOG_ERROR("Non-coinbase input without ring members found! Rejecting..");
         return false;
       }
 
-      std::string source_asset_type = boost::get<txin_haven_key>(txin).asset_type;
+      const std::string &source_asset_type = boost::get<txin_haven_key>(txin).asset_type;
       if (source_asset_type.size()==0){
         anon_pool=anonymity_pool::UNSET;
         LOG_ERROR("Failed to find input asset type! Rejecting..");
-        return false;  
+        return false;
       }
 
-      for (const auto &out: ring_outputs) {
-        anonymity_pool pool_current_ring_member=anonymity_pool::UNSET;
-
+      // a ring member's asset type is a NUL terminated string of at most 8 chars, so a longer
+      // source asset type, or one with a NUL in it, is matched by none of them
+      uint64_t source_word = 0;
+      const bool source_fits = source_asset_type.size() < sizeof(source_word) && source_asset_type.find('\0') == std::string::npos;
+      if (source_fits)
+        memcpy(&source_word, source_asset_type.data(), source_asset_type.size());
+
+      // one branch free pass over the ring, which the compiler can vectorize
+      size_t same_asset = 0, pool_1 = 0, pool_2 = 0;
+      for (size_t i = 0; i < count; ++i){
+        const size_t matches = source_fits & (asset_types[i] == source_word);
+        same_asset += matches;
         //Rules for Pool 1
         //Any output before the supply audit cut-off is considered a member of Pool 1
-        if (out.height < supply_audit_height && out.asset_type==source_asset_type){
-          pool_current_ring_member=anonymity_pool::POOL_1;
-        }
+        pool_1 += matches & (heights[i] < supply_audit_height);
         //Rules for Pool 2
-        if (out.height >= supply_audit_height && out.asset_type==source_asset_type){
-          pool_current_ring_member=anonymity_pool::POOL_2;
-        }
-        
-
-        // Please add any future logic for new anonymity pools above this point in the code
-        // Beyond it, the anonymity pool of the current ring member must be set
-        if (pool_current_ring_member==anonymity_pool::UNSET){
-          anon_pool=anonymity_pool::UNSET;
-          LOG_ERROR("Failed to assign a ring member to anonymity pool! Rejecting..");
-          return false;
-        }
-
-        //Only Pool 1 and Pool 2 are valid values for a ring member
-        if (pool_current_ring_member!=anonymity_pool::POOL_1 && pool_current_ring_member!=anonymity_pool::POOL_2){
-          anon_pool=anonymity_pool::UNSET;
-          LOG_ERROR("Failed to assign a ring member to either Pool 1 or Pool 2! Rejecting..");
-          return false;
-        }
+        pool_2 += matches & (heights[i] >= supply_audit_height);
+      }
 
-        if (anon_pool==anonymity_pool::UNSET){
-          anon_pool=pool_current_ring_member;
-          assignments+=1;
-        } else if (anon_pool!=pool_current_ring_member){
-          anon_pool=anonymity_pool::MIXED;
-          assignments+=1;
-        } else if (anon_pool==pool_current_ring_member){
-          assignments+=1;
-        }
+      // Please add any future logic for new anonymity pools to the pass above
+      // Beyond it, the anonymity pool of every ring member must be set
+      if (same_asset!=count){
+        anon_pool=anonymity_pool::UNSET;
+        LOG_ERROR("Failed to assign a ring member to anonymity pool! Rejecting..");
+        return false;
       }
 
-      if (assignments!=ring_outputs.size()){
+      // every ring member must have been assigned to exactly one pool
+      if (pool_1+pool_2!=count){
         LOG_ERROR("Not all ring members were considered when assigning a pool! Rejecting..");
         anon_pool=anonymity_pool::UNSET;
         return false;
       }
 
+      anon_pool = pool_2 == 0 ? anonymity_pool::POOL_1 : pool_1 == 0 ? anonymity_pool::POOL_2 : anonymity_pool::MIXED;
+
       if (anon_pool==anonymity_pool::MIXED){
         LOG_PRINT_L2("Mixed anonymity pool found, this should not happen. Transaction will rejected as part of transaction validation");  
       } else {
-        LOG_PRINT_L2("Anonymity pool of the input is " << (anon_pool==anonymity_pool::POOL_1 ? "Pool 1" : (anon_pool==anonymity_pool::POOL_2 ? "Pool 2" : "Unknown")));
+        LOG_PRINT_L2("Anonymity pool of the input is " << (anon_pool==anonymity_pool::POOL_1 ? "Pool 1" : "Pool 2"));
       }
       return true;
     }
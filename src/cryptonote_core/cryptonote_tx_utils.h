@@ -245,6 +245,12 @@ namespace cryptonote
   bool get_slippage(const transaction_type &tx_type, const std::string &source_asset, const std::string &dest_asset, const uint64_t amount, uint64_t &slippage, const offshore::pricing_record &pr, const std::vector<std::pair<std::string, std::string>> &amounts, const uint8_t hf_version);
   bool get_collateral_requirements(const transaction_type &tx_type, const uint64_t amount, uint64_t &collateral, const offshore::pricing_record &pr, const std::vector<std::pair<std::string, std::string>> &amounts, const uint8_t hf_version);
   uint64_t get_block_cap(const std::vector<std::pair<std::string, std::string>>& supply_amounts, const offshore::pricing_record& pr, const uint8_t hf_version);
+  // same as above, using the typed supply snapshot kept by the blockchain DB rather than decimal strings
+  bool get_slippage(const transaction_type &tx_type, const std::string &source_asset, const std::string &dest_asset, const uint64_t amount, uint64_t &slippage, const offshore::pricing_record &pr, const offshore::supply_snapshot &supply, const uint8_t hf_version);
+  bool get_collateral_requirements(const transaction_type &tx_type, const uint64_t amount, uint64_t &collateral, const offshore::pricing_record &pr, const offshore::supply_snapshot &supply, const uint8_t hf_version);
+  uint64_t get_block_cap(const offshore::supply_snapshot& supply, const offshore::pricing_record& pr, const uint8_t hf_version);
+  // same as get_slippage, but takes computed_slippage when it was computed against this very snapshot (computed_supply_version 0 means it never was)
+  bool get_slippage_reusing(const uint64_t computed_supply_version, const uint64_t computed_slippage, const transaction_type &tx_type, const std::string &source_asset, const std::string &dest_asset, const uint64_t amount, uint64_t &slippage, const offshore::pricing_record &pr, const offshore::supply_snapshot &supply, const uint8_t hf_version);
   bool tx_pr_height_valid(const uint64_t current_height, const uint64_t pr_height, const crypto::hash& tx_hash);
   // Get conversion rate for any conversion TX
   bool get_conversion_rate(const offshore::pricing_record& pr, const std::string& from_asset, const std::string& to_asset, uint64_t& rate, const uint8_t hf_version);
@@ -256,8 +262,22 @@ namespace cryptonote
   uint64_t get_xusd_amount(const uint64_t amount, const std::string& amount_asset_type, const offshore::pricing_record& pr, const transaction_type tx_type, uint8_t hf_version);
   // Get onshore amount in XHV, not XUSD
   uint64_t get_xhv_amount(const uint64_t xusd_amount, const offshore::pricing_record& pr, const transaction_type tx_type, uint8_t hf_version);
-  bool get_anonymity_pool(const transaction& tx, const std::vector<std::vector<output_data_t>>& tx_ring_outputs, anonymity_pool& tx_anon_pool, const network_type nettype );
-  bool get_input_anonymity_pool(const txin_v& txin, const std::vector<output_data_t>& ring_outputs, anonymity_pool& anon_pool, const uint64_t supply_audit_height);
+  // The ring members of a tx's inputs, with just what the anonymity pool checks need, in flat
+  // arrays: the members of input i are at [input_begin[i], input_begin[i + 1]). Asset types are
+  // kept as their NUL padded 8 bytes, so comparing them is comparing the asset type strings
+  struct tx_ring_members
+  {
+    std::vector<size_t> input_begin = {0};
+    std::vector<uint64_t> heights;
+    std::vector<uint64_t> asset_types;
+
+    size_t num_inputs() const { return input_begin.size() - 1; }
+    size_t input_size(size_t i) const { return input_begin[i + 1] - input_begin[i]; }
+    void reserve(size_t inputs, size_t members) { input_begin.reserve(inputs + 1); heights.reserve(members); asset_types.reserve(members); }
+    void add_input(const output_data_t *outputs, size_t count);
+  };
+  bool get_anonymity_pool(const transaction& tx, const tx_ring_members& ring_members, anonymity_pool& tx_anon_pool, const network_type nettype);
+  bool get_input_anonymity_pool(const txin_v& txin, const uint64_t *heights, const uint64_t *asset_types, size_t count, anonymity_pool& anon_pool, const uint64_t supply_audit_height);
 }
 
 BOOST_CLASS_VERSION(cryptonote::tx_source_entry, 5)
@@ -0,0 +1,237 @@
+// Copyright (c) 2023, Haven Protocol
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <algorithm>
+#include <chrono>
+#include <limits>
+#include <random>
+#include <boost/bind/bind.hpp>
+#include <boost/lexical_cast.hpp>
+
+#include "pricing_record_service.h"
+#include "cryptonote_config.h"
+#include "crypto/crypto.h"
+#include "net/http_client.h"
+#include "storages/http_abstract_invoke.h"
+#include "rpc/core_rpc_server_commands_defs.h"
+
+#undef MONERO_DEFAULT_LOG_CATEGORY
+#define MONERO_DEFAULT_LOG_CATEGORY "blockchain.oracle"
+
+namespace cryptonote
+{
+  constexpr uint64_t pricing_record_service::PRICING_RECORD_POLL_INTERVAL;
+  constexpr uint64_t pricing_record_service::ORACLE_TIMEOUT;
+  //---------------------------------------------------------------------------
+  pricing_record_service::pricing_record_service(std::vector<std::string> oracle_urls, std::string public_key, epee::net_utils::ssl_support_t ssl_support):
+    m_oracle_urls(std::move(oracle_urls)),
+    m_public_key(std::move(public_key)),
+    m_ssl_support(ssl_support),
+    m_hf_version(0),
+    m_running(false),
+    m_stop(false),
+    m_poll_interval(PRICING_RECORD_POLL_INTERVAL),
+    m_refresh_requested(false),
+    m_have_record(false),
+    m_record_hf_version(0),
+    m_stats()
+  {
+  }
+  //---------------------------------------------------------------------------
+  pricing_record_service::~pricing_record_service()
+  {
+    try { stop(); }
+    catch (...) { /* ignore */ }
+  }
+  //---------------------------------------------------------------------------
+  bool pricing_record_service::start(uint64_t poll_interval_seconds)
+  {
+    boost::unique_lock<boost::mutex> lock(m_lock);
+    if (m_running)
+      return false;
+    m_poll_interval = std::max<uint64_t>(poll_interval_seconds, 1);
+    m_stop = false;
+    m_refresh_requested = false;
+    boost::thread::attributes attrs;
+    attrs.set_stack_size(THREAD_STACK_SIZE);
+    m_thread = boost::thread(attrs, boost::bind(&pricing_record_service::run, this));
+    m_running = true;
+    MINFO("Pricing record service started, polling every " << m_poll_interval << " seconds");
+    return true;
+  }
+  //---------------------------------------------------------------------------
+  void pricing_record_service::stop()
+  {
+    {
+      boost::unique_lock<boost::mutex> lock(m_lock);
+      if (!m_running)
+        return;
+      m_stop = true;
+      m_wakeup.notify_all();
+    }
+    if (m_thread.joinable())
+      m_thread.join();
+    m_running = false;
+    MINFO("Pricing record service stopped");
+  }
+  //---------------------------------------------------------------------------
+  void pricing_record_service::set_hf_version(uint8_t hf_version)
+  {
+    if (m_hf_version.exchange(hf_version) != hf_version)
+      refresh();
+  }
+  //---------------------------------------------------------------------------
+  void pricing_record_service::refresh()
+  {
+    boost::unique_lock<boost::mutex> lock(m_lock);
+    m_refresh_requested = true;
+    m_wakeup.notify_all();
+  }
+  //---------------------------------------------------------------------------
+  void pricing_record_service::run()
+  {
+    while (!m_stop)
+    {
+      try
+      {
+        fetch();
+      }
+      catch (const std::exception &e)
+      {
+        MERROR("Exception while fetching pricing record: " << e.what());
+      }
+
+      boost::unique_lock<boost::mutex> lock(m_lock);
+      if (!m_refresh_requested && !m_stop)
+        m_wakeup.wait_for(lock, boost::chrono::seconds(m_poll_interval));
+      m_refresh_requested = false;
+    }
+  }
+  //---------------------------------------------------------------------------
+  bool pricing_record_service::fetch()
+  {
+    const uint8_t hf_version = m_hf_version;
+    if (hf_version == 0)
+      return false;
+
+    const uint64_t timestamp = time(NULL);
+    LOG_PRINT_L1("Requesting pricing record from Oracle - time : " << timestamp);
+    const auto start = std::chrono::steady_clock::now();
+
+    epee::net_utils::http::http_simple_client http_client;
+    COMMAND_RPC_GET_PRICING_RECORD::request req = AUTO_VAL_INIT(req);
+    COMMAND_RPC_GET_PRICING_RECORD::response res = AUTO_VAL_INIT(res);
+
+    // HERE BE DRAGONS!!!
+    // NEAC: Initialise the pricing record to be the correct format
+    if (hf_version >= HF_VERSION_SLIPPAGE) {
+      res.pr.set_version(3);
+    } else if (hf_version >= HF_VERSION_OFFSHORE_FULL) {
+      res.pr.set_version(2);
+    } else {
+      res.pr.set_version(1);
+    }
+    // LAND AHOY!!!
+
+    const std::string path = hf_version >= HF_VERSION_SLIPPAGE ? "/price2/" : "/price/";
+    const std::string url = path + "?timestamp=" + boost::lexical_cast<std::string>(timestamp) + "&version=" + std::to_string(hf_version);
+
+    std::vector<std::string> oracle_urls = m_oracle_urls;
+    std::shuffle(oracle_urls.begin(), oracle_urls.end(), std::default_random_engine(crypto::rand<unsigned>()));
+    bool r = false;
+    for (size_t n = 0; n < oracle_urls.size() && !m_stop; n++) {
+      http_client.set_server(oracle_urls[n], boost::none, m_ssl_support);
+      r = epee::net_utils::invoke_http_json(url, req, res, http_client, std::chrono::seconds(ORACLE_TIMEOUT), "GET");
+      if (r) {
+        LOG_PRINT_L1("Obtained pricing record from Oracle : " << oracle_urls[n]);
+        break;
+      }
+      LOG_PRINT_L1("Failed to obtain pricing record from Oracle : " << oracle_urls[n]);
+    }
+
+    if (r) {
+      if (hf_version < HF_VERSION_XASSET_FEES_V2)
+        res.pr.timestamp = 0;
+
+      // Only VERIFY if full mode has been enabled
+      if (hf_version >= HF_VERSION_OFFSHORE_FULL) {
+        try {
+          r = res.pr.verifySignature(m_public_key);
+        } catch (const std::exception &e) {
+          MERROR("Exception while verifying pricing record: " << e.what());
+          r = false;
+        }
+        if (!r)
+          LOG_PRINT_L0("Failed to verify signature of pricing record from Oracle - discarding it");
+      }
+    } else {
+      LOG_PRINT_L0("Failed to get pricing record from Oracle");
+    }
+
+    const uint64_t latency = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+
+    boost::unique_lock<boost::mutex> lock(m_lock);
+    ++m_stats.fetches;
+    m_stats.last_latency_ms = latency;
+    m_stats.max_latency_ms = std::max(m_stats.max_latency_ms, latency);
+    if (!r) {
+      ++m_stats.failures;
+      return false;
+    }
+
+    m_record = res.pr;
+    m_record_hf_version = hf_version;
+    m_have_record = true;
+    m_stats.last_success_time = time(NULL);
+    m_stats.record_timestamp = m_record.timestamp;
+    LOG_PRINT_L1("Cached pricing record - timestamp = " << m_record.timestamp << ", latency = " << latency << " ms");
+    return true;
+  }
+  //---------------------------------------------------------------------------
+  bool pricing_record_service::get(offshore::pricing_record& pr) const
+  {
+    boost::unique_lock<boost::mutex> lock(m_lock);
+    if (!m_have_record || m_record_hf_version != m_hf_version)
+      return false;
+    pr = m_record;
+    return true;
+  }
+  //---------------------------------------------------------------------------
+  pricing_record_service::stats pricing_record_service::get_stats() const
+  {
+    boost::unique_lock<boost::mutex> lock(m_lock);
+    stats s = m_stats;
+    if (s.last_success_time == 0)
+      s.staleness = std::numeric_limits<uint64_t>::max();
+    else
+    {
+      const uint64_t now = time(NULL);
+      s.staleness = now > s.last_success_time ? now - s.last_success_time : 0;
+    }
+    return s;
+  }
+}
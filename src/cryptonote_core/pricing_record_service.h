@@ -0,0 +1,111 @@
+// Copyright (c) 2023, Haven Protocol
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <atomic>
+#include <string>
+#include <vector>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+
+#include "net/net_ssl.h"
+#include "offshore/pricing_record.h"
+
+namespace cryptonote
+{
+  /**
+   * @brief polls the oracle for pricing records on a background thread
+   *
+   * Fetching a pricing record may take up to a timeout per oracle, so the
+   * block template code reads the last verified record from this cache
+   * rather than talking to the oracle while holding the blockchain lock.
+   */
+  class pricing_record_service
+  {
+  public:
+    struct stats
+    {
+      uint64_t fetches;            // total fetch attempts
+      uint64_t failures;           // attempts that produced no usable record
+      uint64_t last_latency_ms;    // duration of the last attempt
+      uint64_t max_latency_ms;     // longest attempt so far
+      uint64_t last_success_time;  // wall clock time of the last usable record, 0 if none
+      uint64_t staleness;          // seconds since last_success_time, uint64_t max if none
+      uint64_t record_timestamp;   // timestamp of the cached record
+    };
+
+    pricing_record_service(std::vector<std::string> oracle_urls, std::string public_key,
+      epee::net_utils::ssl_support_t ssl_support = epee::net_utils::ssl_support_t::e_ssl_support_autodetect);
+    ~pricing_record_service();
+
+    //! starts the background thread, returns false if it is already running
+    bool start(uint64_t poll_interval_seconds = PRICING_RECORD_POLL_INTERVAL);
+    void stop();
+    bool is_running() const { return m_running; }
+
+    //! the hard fork version decides the request format and whether records are verified
+    void set_hf_version(uint8_t hf_version);
+
+    //! wakes the background thread up to fetch a new record now
+    void refresh();
+
+    //! does one synchronous fetch, returns true if a new record was cached
+    bool fetch();
+
+    //! returns the cached record if there is one for the current hard fork version
+    bool get(offshore::pricing_record& pr) const;
+
+    stats get_stats() const;
+
+    static constexpr uint64_t PRICING_RECORD_POLL_INTERVAL = 10;
+    static constexpr uint64_t ORACLE_TIMEOUT = 10;
+
+  private:
+    void run();
+
+    const std::vector<std::string> m_oracle_urls;
+    const std::string m_public_key;
+    const epee::net_utils::ssl_support_t m_ssl_support;
+
+    std::atomic<uint8_t> m_hf_version;
+    std::atomic<bool> m_running;
+    std::atomic<bool> m_stop;
+    uint64_t m_poll_interval;
+
+    mutable boost::mutex m_lock;
+    boost::condition_variable m_wakeup;
+    bool m_refresh_requested;
+    bool m_have_record;
+    uint8_t m_record_hf_version;
+    offshore::pricing_record m_record;
+    stats m_stats;
+
+    boost::thread m_thread;
+  };
+}
@@ -0,0 +1,92 @@
+// Copyright (c) 2023, Haven Protocol
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <boost/multiprecision/cpp_int.hpp>
+#include <boost/multiprecision/cpp_bin_float.hpp>
+#include "cryptonote_protocol/enums.h"
+#include "offshore/asset_types.h"
+#include "offshore/pricing_record.h"
+#include "offshore/supply_snapshot.h"
+
+// The steps get_slippage is made of. The slippage fraction is evaluated in doubles,
+// and only re-evaluated in quads when the double is too close to a rounding boundary
+// for the rounding to be trusted.
+namespace cryptonote
+{
+  // The slippage fraction computed in doubles is taken to be within this relative
+  // distance of the one computed in quads. With u = 2^-53 the relative rounding error
+  // of one double operation, and to first order:
+  // - every integer input is exact as a uint128 and gets u converting it to double, so
+  //   each pool ratio (two conversions and a division) is within 3u;
+  // - pow(x, e) turns a relative error d of x into |e|.d, plus its own rounding (taken
+  //   as u, glibc's pow is within 1 ulp), sqrt halves d and adds u, and adding 1.0 to
+  //   a positive value adds u without growing d;
+  // - so src_pool_multiplier is within 5 x 3.5u + u = 18.5u and the onshore
+  //   dest_pool_multiplier, the worst case, within 15 x 3.1u + u = 47.5u, which gives
+  //   dest_pool_slippage within 3u + 47.5u + u = 51.5u;
+  // - all the terms summed are non-negative, so no cancellation can grow their
+  //   relative error, and the mcap, peg and xBTC terms are computed in doubles on both
+  //   paths from inputs within 4u, staying within 8u;
+  // - the total is thus within 54u, and scaling it by the amount or by 100 for the
+  //   rounding adds at most 3u more, 57u ~ 6.4e-15.
+  // The quad evaluation is within a few quad ulps (2^-113) of the exact value, which
+  // is negligible here. 1e-9 leaves a factor of 1.5e5 over the bound, so that even a
+  // libm whose pow is off by thousands of ulps cannot round differently from the quads.
+  const double SLIPPAGE_DOUBLE_TOLERANCE = 1e-9;
+
+  // the integer quantities the slippage of a conversion is computed from
+  struct slippage_inputs
+  {
+    transaction_type tx_type;
+    offshore::asset_id_t source_id;
+    offshore::asset_id_t dest_id;
+    boost::multiprecision::uint128_t convert_amount;
+    boost::multiprecision::uint128_t supply_xhv;
+    boost::multiprecision::uint128_t supply_xusd;
+    boost::multiprecision::uint128_t mcap_xassets;
+    boost::multiprecision::uint128_t mcap_xhv_spot;
+    boost::multiprecision::uint128_t mcap_xhv_ma;
+  };
+
+  void get_slippage_inputs(slippage_inputs &in, const transaction_type tx_type, const offshore::asset_id_t source_id, const offshore::asset_id_t dest_id, const uint64_t amount, const offshore::pricing_record &pr, const offshore::supply_snapshot &supply);
+
+  //! the slippage fraction, before capping and rounding, for F double or cpp_bin_float_quad
+  template<typename F>
+  bool get_total_slippage(F &total_slippage, const slippage_inputs &in, const offshore::pricing_record &pr, const offshore::supply_snapshot &supply, const uint8_t hf_version);
+
+  //! whole 0.0001 units of the amount taken by a fraction below the 99% cap (before SLIPPAGE_V2), false if too close to a rounding boundary
+  bool round_slippage_v1(double total_slippage, uint64_t amount, uint64_t &slippage);
+  //! the same, from the fraction in quads, which always rounds
+  uint64_t round_slippage_v1(boost::multiprecision::cpp_bin_float_quad total_slippage, const boost::multiprecision::uint128_t &amount);
+
+  //! whole percents of a fraction capped at 100% (from SLIPPAGE_V2), false if too close to a rounding boundary
+  bool round_slippage_percent(double total_slippage, boost::multiprecision::uint128_t &percent);
+  //! the same, from the fraction in quads, which always rounds
+  boost::multiprecision::uint128_t round_slippage_percent(boost::multiprecision::cpp_bin_float_quad total_slippage);
+}
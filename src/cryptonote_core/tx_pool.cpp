@@ -92,6 +92,7 @@ namespace cryptonote
     time_t const MIN_RELAY_TIME = (60 * 5); // only start re-relaying transactions after that many seconds
     time_t const MAX_RELAY_TIME = (60 * 60 * 4); // at most that many seconds between resends
     float const ACCEPT_THRESHOLD = 1.0f;
+    size_t const PARSED_TX_CACHE_MAX_SIZE = 10000; // parsed pool txes kept until they leave the pool
 
     //! Max DB check interval for relayable txes
     constexpr const std::chrono::minutes max_relayable_check{2};
@@ -281,14 +282,11 @@ namespace cryptonote
       }
       if(tvc.pr.empty()) {
         // Get the pricing record that was used for conversion
-        block bl;
-        bool r = m_blockchain.get_block_by_hash(m_blockchain.get_block_id_by_height(tx.pricing_record_height), bl);
-        if (!r) {
+        if (!m_blockchain.get_pricing_record_at_height(tx.pricing_record_height, tvc.pr)) {
           LOG_ERROR("error: failed to get block containing pricing record");
           tvc.m_verifivation_failed = true;
           return false;
         }
-        tvc.pr = bl.pricing_record;
       }
 
       // check whether we have a valid exchange rate (some values in the pr might be 0)
@@ -331,13 +329,13 @@ namespace cryptonote
         return false;
       }
       
-      // Get the circulating supply amounts
-      const std::vector<std::pair<std::string, std::string>>& supply_amounts = m_blockchain.get_db().get_circulating_supply();
-
-      // Get the slippage
+      // Get the slippage. The incoming tx checks already computed it, in parallel
+      // and outside the pool lock; it only needs doing again if the supply changed
       uint64_t slippage = 0;
       if (hf_version >= HF_VERSION_SLIPPAGE && source != dest) {
-        if (!get_slippage(tx_type, source, dest, tx.amount_burnt, slippage, tvc.pr, supply_amounts, hf_version)) {
+        // Get the circulating supply amounts
+        const std::shared_ptr<const offshore::supply_snapshot> supply = m_blockchain.get_db().get_supply_snapshot();
+        if (!get_slippage_reusing(tvc.m_economics_supply_version, tvc.m_slippage, tx_type, source, dest, tx.amount_burnt, slippage, tvc.pr, *supply, hf_version)) {
           LOG_ERROR("error: Invalid Tx found. 0 burnt/minted for a conversion tx.");
           tvc.m_verifivation_failed = true;
           return false;
@@ -632,8 +630,6 @@ namespace cryptonote
         memset(meta.padding, 0, sizeof(meta.padding));
         try
         {
-          if (kept_by_block)
-            m_parsed_tx_cache.insert(std::make_pair(id, tx));
           CRITICAL_REGION_LOCAL1(m_blockchain);
           LockedTXN lock(m_blockchain.get_db());
           if (!insert_key_images(tx, id, tx_relay))
@@ -670,8 +666,6 @@ namespace cryptonote
 
       try
       {
-        if (kept_by_block)
-          m_parsed_tx_cache.insert(std::make_pair(id, tx));
         CRITICAL_REGION_LOCAL1(m_blockchain);
         LockedTXN lock(m_blockchain.get_db());
 
@@ -740,6 +734,10 @@ namespace cryptonote
       }
     }
 
+    // txes from blocks are parsed already, keep them until they leave the pool
+    if (kept_by_block)
+      m_parsed_tx_cache.insert(std::make_pair(id, tx));
+
     tvc.m_verifivation_failed = false;
     m_txpool_weight += tx_weight;
 
@@ -818,12 +816,12 @@ namespace cryptonote
           std::string source = offshore_data.data.substr(0,pos);
           std::string dest = offshore_data.data.substr(pos+1);
           // check both strSource and strDest are supported.
-          if (std::find(offshore::ASSET_TYPES.begin(), offshore::ASSET_TYPES.end(), source) == offshore::ASSET_TYPES.end()) {
+          if (!offshore::is_valid_asset_type(source)) {
             tvc.m_verifivation_failed = true;
             LOG_PRINT_L1("Source Asset type " << source << " is not supported! Rejecting..");
             return false;
           }
-          if (std::find(offshore::ASSET_TYPES.begin(), offshore::ASSET_TYPES.end(), dest) == offshore::ASSET_TYPES.end()) {
+          if (!offshore::is_valid_asset_type(dest)) {
             tvc.m_verifivation_failed = true;
             LOG_PRINT_L1("Destination Asset type " << dest << " is not supported! Rejecting..");
             return false;
@@ -941,14 +939,11 @@ namespace cryptonote
             tvc.pr.set_for_height_821428();
           } else {
             // Get the pricing record that was used for conversion
-            block bl;
-            bool r = m_blockchain.get_block_by_hash(m_blockchain.get_block_id_by_height(tx.pricing_record_height), bl);
-            if (!r) {
+            if (!m_blockchain.get_pricing_record_at_height(tx.pricing_record_height, tvc.pr)) {
               LOG_ERROR("error: failed to get block containing pricing record");
               tvc.m_verifivation_failed = true;
               return false;
             }
-            tvc.pr = bl.pricing_record;
           }
         }
 
@@ -1151,8 +1146,6 @@ namespace cryptonote
         memset(meta.padding, 0, sizeof(meta.padding));
         try
         {
-          if (kept_by_block)
-            m_parsed_tx_cache.insert(std::make_pair(id, tx));
           CRITICAL_REGION_LOCAL1(m_blockchain);
           LockedTXN lock(m_blockchain.get_db());
           if (!insert_key_images(tx, id, tx_relay))
@@ -1180,8 +1173,6 @@ namespace cryptonote
     {
       try
       {
-        if (kept_by_block)
-          m_parsed_tx_cache.insert(std::make_pair(id, tx));
         CRITICAL_REGION_LOCAL1(m_blockchain);
         LockedTXN lock(m_blockchain.get_db());
 
@@ -1248,6 +1239,10 @@ namespace cryptonote
       }
     }
 
+    // txes from blocks are parsed already, keep them until they leave the pool
+    if (kept_by_block)
+      m_parsed_tx_cache.insert(std::make_pair(id, tx));
+
     tvc.m_verifivation_failed = false;
     m_txpool_weight += tx_weight;
 
@@ -1348,6 +1343,8 @@ namespace cryptonote
         reduce_txpool_weight(meta.weight);
         remove_transaction_keyimages(tx, txid);
         MINFO("Pruned tx " << txid << " from txpool: weight: " << meta.weight << ", fee/byte: " << it->first.first);
+        m_template_builder.remove(txid);
+        m_parsed_tx_cache.erase(txid);
         m_txs_by_fee_and_receive_time.erase(it--);
         changed = true;
       }
@@ -1366,6 +1363,7 @@ namespace cryptonote
   //---------------------------------------------------------------------------------
   bool tx_memory_pool::insert_key_images(const transaction_prefix &tx, const crypto::hash &id, relay_method tx_relay)
   {
+    boost::unique_lock<boost::shared_mutex> key_images_lock(m_spent_key_images_lock);
     for(const auto& in: tx.vin)
     {
       CHECKED_GET_SPECIFIC_VARIANT(in, const txin_haven_key, txin, false);
@@ -1399,6 +1397,7 @@ namespace cryptonote
   {
     CRITICAL_REGION_LOCAL(m_transactions_lock);
     CRITICAL_REGION_LOCAL1(m_blockchain);
+    boost::unique_lock<boost::shared_mutex> key_images_lock(m_spent_key_images_lock);
     // ND: Speedup
     for(const txin_v& vi: tx.vin)
     {
@@ -1479,6 +1478,8 @@ namespace cryptonote
 
     if (sorted_it != m_txs_by_fee_and_receive_time.end())
       m_txs_by_fee_and_receive_time.erase(sorted_it);
+    m_template_builder.remove(id);
+    m_parsed_tx_cache.erase(id);
     ++m_cookie;
     return true;
   }
@@ -1538,8 +1539,7 @@ namespace cryptonote
   //---------------------------------------------------------------------------------
   bool tx_memory_pool::get_complement(const std::vector<crypto::hash> &hashes, std::vector<cryptonote::blobdata> &txes) const
   {
-    CRITICAL_REGION_LOCAL(m_transactions_lock);
-    CRITICAL_REGION_LOCAL1(m_blockchain);
+    db_rtxn_guard rtxn_guard(&m_blockchain.get_db());
 
     m_blockchain.for_all_txpool_txes([this, &hashes, &txes](const crypto::hash &txid, const txpool_tx_meta_t &meta, const cryptonote::blobdata_ref*) {
       const auto tx_relay_method = meta.get_relay_method();
@@ -1576,11 +1576,11 @@ namespace cryptonote
   //---------------------------------------------------------------------------------
   sorted_tx_container::iterator tx_memory_pool::find_tx_in_sorted_container(const crypto::hash& id) const
   {
-    return std::find_if( m_txs_by_fee_and_receive_time.begin(), m_txs_by_fee_and_receive_time.end()
-                       , [&](const sorted_tx_container::value_type& a){
-                         return a.second == id;
-                       }
-    );
+    const auto &by_id = m_txs_by_fee_and_receive_time.get<by_txid>();
+    const auto it = by_id.find(id);
+    if (it == by_id.end())
+      return m_txs_by_fee_and_receive_time.end();
+    return m_txs_by_fee_and_receive_time.project<by_fee_and_receive_time>(it);
   }
   //---------------------------------------------------------------------------------
   //TODO: investigate whether boolean return is appropriate
@@ -1607,6 +1607,8 @@ namespace cryptonote
         {
           m_txs_by_fee_and_receive_time.erase(sorted_it);
         }
+        m_template_builder.remove(txid);
+        m_parsed_tx_cache.erase(txid);
         m_timed_out_transactions.insert(txid);
         remove.push_back(std::make_pair(txid, meta.weight));
       }
@@ -1778,15 +1780,13 @@ namespace cryptonote
   //---------------------------------------------------------------------------------
   size_t tx_memory_pool::get_transactions_count(bool include_sensitive) const
   {
-    CRITICAL_REGION_LOCAL(m_transactions_lock);
-    CRITICAL_REGION_LOCAL1(m_blockchain);
+    db_rtxn_guard rtxn_guard(&m_blockchain.get_db());
     return m_blockchain.get_txpool_tx_count(include_sensitive);
   }
   //---------------------------------------------------------------------------------
   void tx_memory_pool::get_transactions(std::vector<transaction>& txs, bool include_sensitive) const
   {
-    CRITICAL_REGION_LOCAL(m_transactions_lock);
-    CRITICAL_REGION_LOCAL1(m_blockchain);
+    db_rtxn_guard rtxn_guard(&m_blockchain.get_db());
     const relay_category category = include_sensitive ? relay_category::all : relay_category::broadcasted;
     txs.reserve(m_blockchain.get_txpool_tx_count(include_sensitive));
     m_blockchain.for_all_txpool_txes([&txs](const crypto::hash &txid, const txpool_tx_meta_t &meta, const cryptonote::blobdata_ref *bd){
@@ -1805,8 +1805,7 @@ namespace cryptonote
   //------------------------------------------------------------------
   void tx_memory_pool::get_transaction_hashes(std::vector<crypto::hash>& txs, bool include_sensitive) const
   {
-    CRITICAL_REGION_LOCAL(m_transactions_lock);
-    CRITICAL_REGION_LOCAL1(m_blockchain);
+    db_rtxn_guard rtxn_guard(&m_blockchain.get_db());
     const relay_category category = include_sensitive ? relay_category::all : relay_category::broadcasted;
     txs.reserve(m_blockchain.get_txpool_tx_count(include_sensitive));
     m_blockchain.for_all_txpool_txes([&txs](const crypto::hash &txid, const txpool_tx_meta_t &meta, const cryptonote::blobdata_ref *bd){
@@ -1817,8 +1816,7 @@ namespace cryptonote
   //------------------------------------------------------------------
   void tx_memory_pool::get_transaction_backlog(std::vector<tx_backlog_entry>& backlog, bool include_sensitive) const
   {
-    CRITICAL_REGION_LOCAL(m_transactions_lock);
-    CRITICAL_REGION_LOCAL1(m_blockchain);
+    db_rtxn_guard rtxn_guard(&m_blockchain.get_db());
     const uint64_t now = time(NULL);
     const relay_category category = include_sensitive ? relay_category::all : relay_category::broadcasted;
     backlog.reserve(m_blockchain.get_txpool_tx_count(include_sensitive));
@@ -1891,8 +1889,7 @@ namespace cryptonote
   //------------------------------------------------------------------
   void tx_memory_pool::get_transaction_stats(struct txpool_stats& stats, bool include_sensitive) const
   {
-    CRITICAL_REGION_LOCAL(m_transactions_lock);
-    CRITICAL_REGION_LOCAL1(m_blockchain);
+    db_rtxn_guard rtxn_guard(&m_blockchain.get_db());
     const uint64_t now = time(NULL);
     const relay_category category = include_sensitive ? relay_category::all : relay_category::broadcasted;
     std::map<uint64_t, txpool_histo> agebytes;
@@ -1978,8 +1975,8 @@ namespace cryptonote
   //TODO: investigate whether boolean return is appropriate
   bool tx_memory_pool::get_transactions_and_spent_keys_info(std::vector<tx_info>& tx_infos, std::vector<spent_key_image_info>& key_image_infos, bool include_sensitive_data) const
   {
-    CRITICAL_REGION_LOCAL(m_transactions_lock);
-    CRITICAL_REGION_LOCAL1(m_blockchain);
+    db_rtxn_guard rtxn_guard(&m_blockchain.get_db());
+    boost::shared_lock<boost::shared_mutex> key_images_lock(m_spent_key_images_lock);
     const relay_category category = include_sensitive_data ? relay_category::all : relay_category::broadcasted;
     const size_t count = m_blockchain.get_txpool_tx_count(include_sensitive_data);
     tx_infos.reserve(count);
@@ -2036,8 +2033,8 @@ namespace cryptonote
   //---------------------------------------------------------------------------------
   bool tx_memory_pool::get_pool_for_rpc(std::vector<cryptonote::rpc::tx_in_pool>& tx_infos, cryptonote::rpc::key_images_with_tx_hashes& key_image_infos) const
   {
-    CRITICAL_REGION_LOCAL(m_transactions_lock);
-    CRITICAL_REGION_LOCAL1(m_blockchain);
+    db_rtxn_guard rtxn_guard(&m_blockchain.get_db());
+    boost::shared_lock<boost::shared_mutex> key_images_lock(m_spent_key_images_lock);
     tx_infos.reserve(m_blockchain.get_txpool_tx_count());
     key_image_infos.reserve(m_blockchain.get_txpool_tx_count());
     m_blockchain.for_all_txpool_txes([&tx_infos, key_image_infos](const crypto::hash &txid, const txpool_tx_meta_t &meta, const cryptonote::blobdata_ref *bd){
@@ -2084,8 +2081,8 @@ namespace cryptonote
   //---------------------------------------------------------------------------------
   bool tx_memory_pool::check_for_key_images(const std::vector<crypto::key_image>& key_images, std::vector<bool>& spent) const
   {
-    CRITICAL_REGION_LOCAL(m_transactions_lock);
-    CRITICAL_REGION_LOCAL1(m_blockchain);
+    db_rtxn_guard rtxn_guard(&m_blockchain.get_db());
+    boost::shared_lock<boost::shared_mutex> key_images_lock(m_spent_key_images_lock);
 
     spent.clear();
 
@@ -2106,8 +2103,7 @@ namespace cryptonote
   //---------------------------------------------------------------------------------
   bool tx_memory_pool::get_transaction(const crypto::hash& id, cryptonote::blobdata& txblob, relay_category tx_category) const
   {
-    CRITICAL_REGION_LOCAL(m_transactions_lock);
-    CRITICAL_REGION_LOCAL1(m_blockchain);
+    db_rtxn_guard rtxn_guard(&m_blockchain.get_db());
     try
     {
       return m_blockchain.get_txpool_tx_blob(id, txblob, tx_category);
@@ -2122,7 +2118,7 @@ namespace cryptonote
   {
     CRITICAL_REGION_LOCAL(m_transactions_lock);
     m_input_cache.clear();
-    m_parsed_tx_cache.clear();
+    m_template_builder.clear();
     return true;
   }
   //---------------------------------------------------------------------------------
@@ -2130,14 +2126,13 @@ namespace cryptonote
   {
     CRITICAL_REGION_LOCAL(m_transactions_lock);
     m_input_cache.clear();
-    m_parsed_tx_cache.clear();
+    m_template_builder.clear();
     return true;
   }
   //---------------------------------------------------------------------------------
   bool tx_memory_pool::have_tx(const crypto::hash &id, relay_category tx_category) const
   {
-    CRITICAL_REGION_LOCAL(m_transactions_lock);
-    CRITICAL_REGION_LOCAL1(m_blockchain);
+    db_rtxn_guard rtxn_guard(&m_blockchain.get_db());
     return m_blockchain.get_db().txpool_has_tx(id, tx_category);
   }
   //---------------------------------------------------------------------------------
@@ -2201,44 +2196,13 @@ namespace cryptonote
     anonymity_pool tx_anon_pool=anonymity_pool::UNSET;
 
     if (hf_version>=HF_VERSION_BURN && current_height >= SUPPLY_AUDIT_ANON_POOL_CHECK_HEIGHT) {
-      std::vector<std::vector<output_data_t>> tx_ring_outputs;
-      tx_ring_outputs.reserve(tx.vin.size());
-      
-      for (const txin_v& txin: tx.vin){
-        std::vector<output_data_t> ring_outputs;
-        if (txin.type() == typeid(txin_haven_key)){
-          txin_haven_key tx_input=boost::get<txin_haven_key>(txin);
-          std::vector<uint64_t> absolute_offsets = relative_output_offsets_to_absolute(tx_input.key_offsets);
-          if (absolute_offsets.size()!=tx_input.key_offsets.size()){
-            LOG_ERROR("Failed to obtain absolute ring offsets! amount = " << tx_input.amount);
-            ret = false;
-          }
-          try{
-            m_blockchain.get_output_key(epee::span<const uint64_t>(&tx_input.amount, 1), absolute_offsets, ring_outputs, true);
-            if (absolute_offsets.size() != ring_outputs.size()){
-              LOG_ERROR("Output does not exist! amount = " << tx_input.amount);
-              ret = false;
-            }
-          }
-          catch (...){
-            LOG_ERROR("Output does not exist! amount = " << tx_input.amount);
-            ret = false;
-          }
-          tx_ring_outputs.push_back(ring_outputs);
-        } else if (txin.type() == typeid(txin_gen)){
-          tx_ring_outputs.push_back(ring_outputs);
-        } else {
-          LOG_ERROR("Unexpected input type for transaction" << txid);
-          ret=false;
-        }
-      }
-
-      if (tx_ring_outputs.size()!=tx.vin.size()){
-        LOG_ERROR("Transaction has more inputs than number of ring member groups: " << txid);
-        ret=false;   
+      tx_ring_members ring_members;
+      if (!m_blockchain.get_tx_ring_members(tx, ring_members)){
+        LOG_ERROR("Failed to get the ring members of transaction " << txid);
+        ret=false;
       }
 
-      if(!get_anonymity_pool(tx, tx_ring_outputs, tx_anon_pool, m_blockchain.get_nettype())){
+      if(!get_anonymity_pool(tx, ring_members, tx_anon_pool, m_blockchain.get_nettype())){
         LOG_ERROR("Failed to get the anonymity pool for transaction " << txid);
         ret=false;   
       }
@@ -2261,11 +2225,11 @@ namespace cryptonote
     return ret;
   }
   //---------------------------------------------------------------------------------
-  bool tx_memory_pool::is_transaction_ready_to_go(txpool_tx_meta_t& txd, const crypto::hash &txid, const cryptonote::blobdata_ref& txblob, transaction &tx) const
+  bool tx_memory_pool::is_transaction_ready_to_go(txpool_tx_meta_t& txd, const crypto::hash &txid, const cryptonote::blobdata_ref& txblob, transaction &tx, bool tx_parsed) const
   {
     struct transaction_parser
     {
-      transaction_parser(const cryptonote::blobdata_ref &txblob, const crypto::hash &txid, transaction &tx): txblob(txblob), txid(txid), tx(tx), parsed(false) {}
+      transaction_parser(const cryptonote::blobdata_ref &txblob, const crypto::hash &txid, transaction &tx, bool parsed): txblob(txblob), txid(txid), tx(tx), parsed(parsed) {}
       cryptonote::transaction &operator()()
       {
         if (!parsed)
@@ -2281,7 +2245,7 @@ namespace cryptonote
       const crypto::hash &txid;
       transaction &tx;
       bool parsed;
-    } lazy_tx(txblob, txid, tx);
+    } lazy_tx(txblob, txid, tx, tx_parsed);
 
     //not the best implementation at this time, sorry :(
     //check is ring_signature already checked ?
@@ -2431,93 +2395,96 @@ namespace cryptonote
     return ss.str();
   }
   //---------------------------------------------------------------------------------
-  //TODO: investigate whether boolean return is appropriate
-  bool tx_memory_pool::fill_block_template(
+  block_template_builder::block_template_builder():
+    m_top_id(crypto::null_hash),
+    m_hf_version(0)
+  {
+  }
+  //---------------------------------------------------------------------------------
+  bool block_template_builder::set_tip(const crypto::hash &top_id, uint8_t hf_version)
+  {
+    if (top_id == m_top_id && hf_version == m_hf_version)
+      return false;
+    m_candidates.clear();
+    m_top_id = top_id;
+    m_hf_version = hf_version;
+    return true;
+  }
+  //---------------------------------------------------------------------------------
+  void block_template_builder::clear()
+  {
+    m_candidates.clear();
+    m_top_id = crypto::null_hash;
+    m_hf_version = 0;
+  }
+  //---------------------------------------------------------------------------------
+  bool block_template_builder::fill(
+    const sorted_tx_container &txs,
+    const limits &lim,
+    const loader_t &load_meta,
+    const loader_t &check,
     block &bl,
-    size_t median_weight,
-    uint64_t already_generated_coins,
     size_t &total_weight,
     std::map<std::string, uint64_t> &fee_map,
     std::map<std::string, uint64_t> &offshore_fee_map,
     std::map<std::string, uint64_t> &xasset_fee_map,
-    uint64_t &expected_reward,
-    uint8_t hf_version
+    uint64_t &expected_reward
   ){
-
-    CRITICAL_REGION_LOCAL(m_transactions_lock);
-    CRITICAL_REGION_LOCAL1(m_blockchain);
-    using tt = cryptonote::transaction_type;
-
+    const uint8_t hf_version = lim.hf_version;
     uint64_t best_coinbase = 0, coinbase = 0;
     total_weight = 0;
-    
+
     // this holds the total fee amount in XHV for calculation of block reward. 
     // All fees collected in other assets(both regular & conversion fees)
     // is converted and added this.
     uint64_t total_fee_xhv = 0;
-    
+
     //baseline empty block
-    if (!get_block_reward(median_weight, total_weight, already_generated_coins, best_coinbase, hf_version))
+    if (!get_block_reward(lim.median_weight, total_weight, lim.already_generated_coins, best_coinbase, hf_version))
     {
       MERROR("Failed to get block reward for empty block");
       return false;
     }
 
-    size_t max_total_weight_pre_v5 = (130 * median_weight) / 100 - CRYPTONOTE_COINBASE_BLOB_RESERVED_SIZE;
-    size_t max_total_weight_v5 = 2 * median_weight - CRYPTONOTE_COINBASE_BLOB_RESERVED_SIZE;
+    size_t max_total_weight_pre_v5 = (130 * lim.median_weight) / 100 - CRYPTONOTE_COINBASE_BLOB_RESERVED_SIZE;
+    size_t max_total_weight_v5 = 2 * lim.median_weight - CRYPTONOTE_COINBASE_BLOB_RESERVED_SIZE;
     size_t max_total_weight = hf_version >= 5 ? max_total_weight_v5 : max_total_weight_pre_v5;
     std::unordered_set<crypto::key_image> k_images;
+    uint64_t total_conversion_xhv = 0; // only offshore/onshroe
 
-    LOG_PRINT_L2("Filling block template, median weight " << median_weight << ", " << m_txs_by_fee_and_receive_time.size() << " txes in the pool");
-
-    LockedTXN lock(m_blockchain.get_db());
+    // most of a large pool is skipped, so only pay for the per-tx logs when they are enabled
+    const bool log_txes = ELPP->vRegistry()->allowed(el::Level::Debug, MONERO_DEFAULT_LOG_CATEGORY);
 
-    // grap the latest pricing record for conversion of fee values and block cap calculation.
-    // ignore the fee converison and block conversions if we fail.
-    bool have_valid_pr = true;
-    offshore::pricing_record latest_pr;
-    if (!m_blockchain.get_latest_acceptable_pr(latest_pr)) {
-      if (hf_version >= HF_VERSION_USE_COLLATERAL) {
-        MWARNING("Failed to find a pricing record in last 10 block.");
-        MWARNING("Tx/conversion fees wont be converted. Cant calculuate block cap. Conversion txs wont be included in the block.");
-      }
-      have_valid_pr = false;
-    }
+    LOG_PRINT_L2("Filling block template, median weight " << lim.median_weight << ", " << txs.size() << " txes in the pool, " << m_candidates.size() << " already known");
 
-    // set the block cap
-    const std::vector<std::pair<std::string, std::string>>& supply_amounts = m_blockchain.get_db().get_circulating_supply();
-    uint64_t block_cap_xhv = get_block_cap(supply_amounts, latest_pr, hf_version);
-    uint64_t total_conversion_xhv = 0; // only offshore/onshroe
-    MINFO("Block cap limit for offshore/onshore " << block_cap_xhv << " XHV");
-
-    auto sorted_it = m_txs_by_fee_and_receive_time.begin();
-    for (; sorted_it != m_txs_by_fee_and_receive_time.end(); ++sorted_it)
+    for (auto sorted_it = txs.begin(); sorted_it != txs.end(); ++sorted_it)
     {
-      txpool_tx_meta_t meta;
-      if (!m_blockchain.get_txpool_tx_meta(sorted_it->second, meta))
+      auto ci = m_candidates.find(sorted_it->second);
+      if (ci == m_candidates.end())
       {
-        MERROR("  failed to find tx meta");
-        continue;
+        block_template_candidate candidate;
+        if (!load_meta(sorted_it->second, candidate))
+        {
+          MERROR("  failed to find tx meta");
+          continue;
+        }
+        ci = m_candidates.emplace(sorted_it->second, std::move(candidate)).first;
       }
-      LOG_PRINT_L2("Considering " << sorted_it->second << ", weight " << meta.weight << ", current block weight " << total_weight << "/" << max_total_weight << ", current coinbase " << print_money(best_coinbase) << ", relay method " << (unsigned)meta.get_relay_method());
+      block_template_candidate &candidate = ci->second;
+      if (log_txes)
+        LOG_PRINT_L2("Considering " << sorted_it->second << ", weight " << candidate.weight << ", current block weight " << total_weight << "/" << max_total_weight << ", current coinbase " << print_money(best_coinbase));
 
-      if (!meta.matches(relay_category::legacy) && !(m_mine_stem_txes && meta.get_relay_method() == relay_method::stem))
-      {
-        LOG_PRINT_L2("  tx relay method is " << (unsigned)meta.get_relay_method());
-        // HERE BE DRAGONS!!!
-        //continue;
-        // LAND AHOY!!!
-      }
-      if (meta.pruned)
+      if (candidate.pruned)
       {
         LOG_PRINT_L2("  tx is pruned");
         continue;
       }
 
       // Can not exceed maximum block weight
-      if (max_total_weight < total_weight + meta.weight)
+      if (max_total_weight < total_weight + candidate.weight)
       {
-        LOG_PRINT_L2("  would exceed maximum block weight");
+        if (log_txes)
+          LOG_PRINT_L2("  would exceed maximum block weight");
         continue;
       }
 
@@ -2528,7 +2495,7 @@ namespace cryptonote
         // If we're getting lower coinbase tx,
         // stop including more tx
         uint64_t block_reward;
-        if(!get_block_reward(median_weight, total_weight + meta.weight, already_generated_coins, block_reward, hf_version))
+        if(!get_block_reward(lim.median_weight, total_weight + candidate.weight, lim.already_generated_coins, block_reward, hf_version))
         {
           LOG_PRINT_L2("  would exceed maximum block weight");
           continue;
@@ -2540,22 +2507,23 @@ namespace cryptonote
         // there shouldnt be any conversion tx anyways, which then means sorting happened on the meta.fee only,
         // and small differences in the tx fee shouldnt matter much. so we can just assume they are all xhv.
         if (hf_version >= HF_VERSION_USE_COLLATERAL) {
-          if (have_valid_pr) {
-            total_fee_this_tx_xhv = meta.weight * sorted_it->first.first; 
+          if (lim.have_valid_pr) {
+            total_fee_this_tx_xhv = candidate.weight * sorted_it->first.first; 
           } else {
-            total_fee_this_tx_xhv =  meta.fee + meta.offshore_fee;
+            total_fee_this_tx_xhv =  candidate.fee + candidate.offshore_fee;
           }
           coinbase = block_reward + total_fee_xhv + total_fee_this_tx_xhv;
         } else {
-          if (strcmp(meta.fee_asset_type, "XHV") == 0) {
-            coinbase = block_reward + fee_map["XHV"] + meta.fee;
+          if (candidate.fee_asset_type == "XHV") {
+            coinbase = block_reward + fee_map["XHV"] + candidate.fee;
           } else {
             coinbase = block_reward + fee_map["XHV"];
           }
         }
         if (coinbase < best_coinbase)
         {
-          LOG_PRINT_L2("  would decrease coinbase to " << print_money(coinbase));
+          if (log_txes)
+            LOG_PRINT_L2("  would decrease coinbase to " << print_money(coinbase));
           continue;
         }
       }
@@ -2563,17 +2531,153 @@ namespace cryptonote
       {
         // If we've exceeded the penalty free weight,
         // stop including more tx
-        if (total_weight > median_weight)
+        if (total_weight > lim.median_weight)
         {
           LOG_PRINT_L2("  would exceed median block weight");
           break;
         }
       }
 
-      // "local" and "stem" txes are filtered above
-      cryptonote::blobdata txblob = m_blockchain.get_txpool_tx_blob(sorted_it->second, relay_category::all);
+      // the chain checks only need doing once per tip
+      if (candidate.status == block_template_candidate::state::unchecked)
+        candidate.status = check(sorted_it->second, candidate) ? block_template_candidate::state::ready : block_template_candidate::state::rejected;
+      if (candidate.status != block_template_candidate::state::ready)
+      {
+        LOG_PRINT_L2("  not ready to go");
+        continue;
+      }
+
+      bool key_image_seen = false;
+      for (const crypto::key_image &ki: candidate.key_images)
+      {
+        if (k_images.count(ki))
+        {
+          key_image_seen = true;
+          break;
+        }
+      }
+      if (key_image_seen)
+      {
+        LOG_PRINT_L2("  key images already seen");
+        continue;
+      }
+
+      if (candidate.block_capped)
+      {
+        // dont include offshore/onshore txs if we cant calculate a valid block cap.
+        if (!lim.have_valid_pr)
+          continue;
+        if (total_conversion_xhv + candidate.conversion_xhv > lim.block_cap_xhv)
+          continue;
+      }
+
+      bl.tx_hashes.push_back(sorted_it->second);
+      total_weight += candidate.weight;
+      total_fee_xhv += total_fee_this_tx_xhv;
+      if (candidate.block_capped)
+        total_conversion_xhv += candidate.conversion_xhv;
+      fee_map[candidate.fee_asset_type] += candidate.fee;
+      if (candidate.conversion) {
+        if (candidate.xasset_conversion) {
+          // xAsset converison
+          xasset_fee_map[candidate.fee_asset_type] += candidate.offshore_fee;
+        } else {
+          // offshore/onshore
+          offshore_fee_map[candidate.fee_asset_type] += candidate.offshore_fee;
+        }
+      }
+      best_coinbase = coinbase;
+      k_images.insert(candidate.key_images.begin(), candidate.key_images.end());
+      LOG_PRINT_L2("  added, new block weight " << total_weight << "/" << max_total_weight << ", coinbase " << print_money(best_coinbase));
+    }
+
+    expected_reward = best_coinbase;
+    // HERE BE DRAGONS!!!
+    // NEAC: add in a function to iteratively output all currencies in a map as money - should live in cryptonote_tx_utils.cpp as a helper fn
+    LOG_PRINT_L2("Block template filled with " << bl.tx_hashes.size() << " txes, weight "
+        << total_weight << "/" << max_total_weight << ", coinbase " << print_money(best_coinbase)
+        << " (including " << print_money(fee_map["XHV"]) << " in fees)");
+    // LAND AHOY!!!
+    return true;
+  }
+  //---------------------------------------------------------------------------------
+  //TODO: investigate whether boolean return is appropriate
+  bool tx_memory_pool::fill_block_template(
+    block &bl,
+    size_t median_weight,
+    uint64_t already_generated_coins,
+    size_t &total_weight,
+    std::map<std::string, uint64_t> &fee_map,
+    std::map<std::string, uint64_t> &offshore_fee_map,
+    std::map<std::string, uint64_t> &xasset_fee_map,
+    uint64_t &expected_reward,
+    uint8_t hf_version
+  ){
+
+    CRITICAL_REGION_LOCAL(m_transactions_lock);
+    CRITICAL_REGION_LOCAL1(m_blockchain);
+    using tt = cryptonote::transaction_type;
+
+    LockedTXN lock(m_blockchain.get_db());
+
+    // grap the latest pricing record for conversion of fee values and block cap calculation.
+    // ignore the fee converison and block conversions if we fail.
+    bool have_valid_pr = true;
+    offshore::pricing_record latest_pr;
+    if (!m_blockchain.get_latest_acceptable_pr(latest_pr)) {
+      if (hf_version >= HF_VERSION_USE_COLLATERAL) {
+        MWARNING("Failed to find a pricing record in last 10 block.");
+        MWARNING("Tx/conversion fees wont be converted. Cant calculuate block cap. Conversion txs wont be included in the block.");
+      }
+      have_valid_pr = false;
+    }
+
+    // set the block cap
+    const std::shared_ptr<const offshore::supply_snapshot> supply = m_blockchain.get_db().get_supply_snapshot();
+    uint64_t block_cap_xhv = get_block_cap(*supply, latest_pr, hf_version);
+    MINFO("Block cap limit for offshore/onshore " << block_cap_xhv << " XHV");
 
-      cryptonote::transaction tx;
+    // everything checked against the chain below is only good for this tip
+    m_template_builder.set_tip(m_blockchain.get_tail_id(), hf_version);
+
+    const auto load_meta = [this](const crypto::hash &txid, block_template_candidate &candidate)
+    {
+      txpool_tx_meta_t meta;
+      if (!m_blockchain.get_txpool_tx_meta(txid, meta))
+        return false;
+      candidate.pruned = meta.pruned;
+      candidate.weight = meta.weight;
+      candidate.fee = meta.fee;
+      candidate.offshore_fee = meta.offshore_fee;
+      candidate.fee_asset_type = meta.fee_asset_type;
+      return true;
+    };
+
+    const uint64_t current_height = m_blockchain.get_current_blockchain_height();
+    const auto check = [&](const crypto::hash &txid, block_template_candidate &candidate)
+    {
+      // the meta and blob are read in place from the db txn opened above, the
+      // blob is only needed until the tx is parsed (or found already parsed)
+      const txpool_tx_meta_t *meta_view;
+      cryptonote::blobdata_ref txblob;
+      if (!m_blockchain.get_txpool_tx_view(txid, meta_view, txblob))
+      {
+        MERROR("  failed to find tx meta");
+        return false;
+      }
+      txpool_tx_meta_t meta = *meta_view;
+
+      // "local" and "stem" txes are filtered above
+      // txes kept from blocks may be cached without their hash, or pruned
+      auto ci = m_parsed_tx_cache.find(txid);
+      const bool cached = ci != m_parsed_tx_cache.end() && ci->second.is_hash_valid() && !ci->second.pruned;
+      if (ci == m_parsed_tx_cache.end())
+      {
+        if (m_parsed_tx_cache.size() >= PARSED_TX_CACHE_MAX_SIZE)
+          m_parsed_tx_cache.clear();
+        ci = m_parsed_tx_cache.emplace(txid, cryptonote::transaction()).first;
+      }
+      cryptonote::transaction &tx = ci->second;
 
       // Skip transactions that are not ready to be
       // included into the blockchain or that are
@@ -2582,7 +2686,7 @@ namespace cryptonote
       bool ready = false;
       try
       {
-        ready = is_transaction_ready_to_go(meta, sorted_it->second, txblob, tx);
+        ready = is_transaction_ready_to_go(meta, txid, txblob, tx, cached);
       }
       catch (const std::exception &e)
       {
@@ -2593,7 +2697,7 @@ namespace cryptonote
       {
         try
         {
-          m_blockchain.update_txpool_tx(sorted_it->second, meta);
+          m_blockchain.update_txpool_tx(txid, meta);
         }
         catch (const std::exception &e)
         {
@@ -2603,120 +2707,109 @@ namespace cryptonote
       }
       if (!ready)
       {
-        LOG_PRINT_L2("  not ready to go");
-        continue;
-      }
-      if (have_key_images(k_images, tx))
-      {
-        LOG_PRINT_L2("  key images already seen");
-        continue;
+        // keep the parse for next time, unless it failed or never happened
+        if (!tx.is_hash_valid())
+          m_parsed_tx_cache.erase(txid);
+        return false;
       }
 
       // get the asset types
       std::string source;
       std::string dest;
       tt tx_type;
-      if (!get_tx_asset_types(tx, sorted_it->second, source, dest, false)) {
+      if (!get_tx_asset_types(tx, txid, source, dest, false)) {
         LOG_PRINT_L2("At least 1 input or 1 output of the tx was invalid.");
-        continue;
+        return false;
       }
       if (!get_tx_type(source, dest, tx_type)) {
-        LOG_PRINT_L2(" transaction has invalid tx type " << sorted_it->second);
-        continue;
+        LOG_PRINT_L2(" transaction has invalid tx type " << txid);
+        return false;
       }
 
       tx_verification_context tvc;
 
       
-      if(!check_tx_inputs([&tx]()->cryptonote::transaction&{ return tx; }, sorted_it->second, meta.max_used_block_height, meta.max_used_block_id, tvc, meta.kept_by_block))
+      if(!check_tx_inputs([&tx]()->cryptonote::transaction&{ return tx; }, txid, meta.max_used_block_height, meta.max_used_block_id, tvc, meta.kept_by_block))
       {
-        LOG_PRINT_L2(" transaction has invalid inputs or anonymity pool " << sorted_it->second);
-        continue;
+        LOG_PRINT_L2(" transaction has invalid inputs or anonymity pool " << txid);
+        return false;
       }
-      
-      uint64_t conversion_this_tx_xhv = 0;
+
+      candidate.conversion = source != dest;
+      candidate.xasset_conversion = candidate.conversion && hf_version >= HF_VERSION_XASSET_FEES_V2 && source != "XHV" && dest != "XHV";
       if (source != dest)
       {
         // check for block cap limit
         if (hf_version >= HF_VERSION_USE_COLLATERAL && (tx_type == tt::OFFSHORE || tx_type == tt::ONSHORE)) {
-
-          // dont include offshore/onshore txs if we cant calculate a valid block cap.
-          if (!have_valid_pr) {
-            continue;
-          }
-
+          candidate.block_capped = true;
           if (tx_type == tt::OFFSHORE) {
-            conversion_this_tx_xhv += tx.amount_burnt;
+            candidate.conversion_xhv = tx.amount_burnt;
           }
           if (tx_type == tt::ONSHORE) {
-            conversion_this_tx_xhv += tx.amount_minted;
-          }
-
-          if (total_conversion_xhv + conversion_this_tx_xhv > block_cap_xhv) {
-            continue;
+            candidate.conversion_xhv = tx.amount_minted;
           }
         }
 
         // Validate that pricing record has not grown too old since it was first included in the pool
-        if (!tx_pr_height_valid(m_blockchain.get_current_blockchain_height(), tx.pricing_record_height, sorted_it->second)) {
+        if (!tx_pr_height_valid(current_height, tx.pricing_record_height, txid)) {
           LOG_PRINT_L2("error : offshore/xAsset transaction references a pricing record that is too old (height " << tx.pricing_record_height << ")");
-          continue;
+          return false;
         }
 
         // check for verRctSemantics2
         if (hf_version >= HF_VERSION_HAVEN2) {
 
           // get pricing record
-          block bl;
-          if (!m_blockchain.get_block_by_hash(m_blockchain.get_block_id_by_height(tx.pricing_record_height), bl)) {
+          offshore::pricing_record tx_pr;
+          if (!m_blockchain.get_pricing_record_at_height(tx.pricing_record_height, tx_pr)) {
             LOG_PRINT_L2("error: failed to get block containing pricing record");
-            continue;
+            return false;
           }
 
           // Get the slippage
           uint64_t slippage = 0;
           if (hf_version >= HF_VERSION_SLIPPAGE && source != dest) {
-            if (!get_slippage(tx_type, source, dest, tx.amount_burnt, slippage, bl.pricing_record, supply_amounts, hf_version)) {
+            if (!get_slippage(tx_type, source, dest, tx.amount_burnt, slippage, tx_pr, *supply, hf_version)) {
               LOG_PRINT_L2("error: failed to obtain slippage requirements for tx " << tx.hash);
-              continue;
+              return false;
             }
           }
           
           // Get the collateral requirement for the tx
           uint64_t collateral = 0;
           if (hf_version >= HF_VERSION_USE_COLLATERAL && (tx_type == tt::OFFSHORE || tx_type == tt::ONSHORE)) {
-            if (!get_collateral_requirements(tx_type, tx.amount_burnt, collateral, bl.pricing_record, supply_amounts, hf_version)) {
+            if (!get_collateral_requirements(tx_type, tx.amount_burnt, collateral, tx_pr, *supply, hf_version)) {
               LOG_PRINT_L2("error: failed to get collateral requirements");
-              continue;
+              return false;
             }
           }
 
           // NEAC: Get conversion rate so we can avoid doing an invert() on a number with excessive precision
           uint64_t conversion_rate = COIN;
-          if (!cryptonote::get_conversion_rate(bl.pricing_record, source, dest, conversion_rate, hf_version)) {
+          if (!cryptonote::get_conversion_rate(tx_pr, source, dest, conversion_rate, hf_version)) {
             LOG_PRINT_L2("error: failed to get conversion rate - aborting");
-            continue;
+            return false;
           }
           
           // Get the fee conversion rate used
           uint64_t fee_conversion_rate = COIN;
-          if (!cryptonote::get_conversion_rate(bl.pricing_record, source, "XHV", fee_conversion_rate, hf_version)) {
+          if (!cryptonote::get_conversion_rate(tx_pr, source, "XHV", fee_conversion_rate, hf_version)) {
             LOG_PRINT_L2("error: unable to obtain fee conversion rate.");
-            continue;
+            return false;
           }
           
           // Get the TX fee conversion rate used
           uint64_t tx_fee_conversion_rate = COIN;
-          if (!cryptonote::get_conversion_rate(bl.pricing_record, "XHV", source, tx_fee_conversion_rate, hf_version)) {
+          if (!cryptonote::get_conversion_rate(tx_pr, "XHV", source, tx_fee_conversion_rate, hf_version)) {
             LOG_PRINT_L2("error: unable to obtain TX fee conversion rate.");
-            continue;
+            return false;
           }
           
           // make sure proof-of-value still holds
-          if (!rct::verRctSemanticsSimple2(tx.rct_signatures, bl.pricing_record, conversion_rate, fee_conversion_rate, tx_fee_conversion_rate, tx_type, source, dest, tx.amount_burnt, tx.amount_minted, tx.vout, tx.vin, hf_version, collateral, slippage, tvc.m_tx_anon_pool))
+          if (!rct::verRctSemanticsSimple2(tx.rct_signatures, tx_pr, conversion_rate, fee_conversion_rate, tx_fee_conversion_rate, tx_type, source, dest, tx.amount_burnt, tx.amount_minted, tx.vout, tx.vin, hf_version, collateral, slippage, tvc.m_tx_anon_pool))
           {
-            LOG_PRINT_L2(" transaction proof-of-value is now invalid for tx " << sorted_it->second);
-            continue;
+            LOG_PRINT_L2(" transaction proof-of-value is now invalid for tx " << txid);
+            return false;
           }
         }
       } else {
@@ -2730,40 +2823,27 @@ namespace cryptonote
           offshore::pricing_record pr_empty;
           if (!rct::verRctSemanticsSimple2(tx.rct_signatures, pr_empty, conversion_rate, fee_conversion_rate, tx_fee_conversion_rate, tx_type, source, dest, tx.amount_burnt, tx.amount_minted, tx.vout, tx.vin, hf_version, collateral, slippage, tvc.m_tx_anon_pool))
           {
-            LOG_PRINT_L2(" transaction proof-of-value is now invalid for tx " << sorted_it->second);
-            continue;
+            LOG_PRINT_L2(" transaction proof-of-value is now invalid for tx " << txid);
+            return false;
           }
         }
       }
 
-      bl.tx_hashes.push_back(sorted_it->second);
-      total_weight += meta.weight;
-      total_fee_xhv += total_fee_this_tx_xhv;
-      total_conversion_xhv += conversion_this_tx_xhv;
-      fee_map[meta.fee_asset_type] += meta.fee;
-      if (source != dest) {
-        if (hf_version >= HF_VERSION_XASSET_FEES_V2 && source != "XHV" && dest != "XHV") {
-          // xAsset converison
-          xasset_fee_map[meta.fee_asset_type] += meta.offshore_fee;
-        } else {
-          // offshore/onshore
-          offshore_fee_map[meta.fee_asset_type] += meta.offshore_fee;
-        }
+      candidate.key_images.reserve(tx.vin.size());
+      for (const txin_v &in: tx.vin)
+      {
+        // same as have_key_images/append_key_images, which stop at the first non-key input
+        if (in.type() != typeid(txin_haven_key))
+          break;
+        candidate.key_images.push_back(boost::get<txin_haven_key>(in).k_image);
       }
-      best_coinbase = coinbase;
-      append_key_images(k_images, tx);
-      LOG_PRINT_L2("  added, new block weight " << total_weight << "/" << max_total_weight << ", coinbase " << print_money(best_coinbase));
-    }
-    lock.commit();
+      return true;
+    };
 
-    expected_reward = best_coinbase;
-    // HERE BE DRAGONS!!!
-    // NEAC: add in a function to iteratively output all currencies in a map as money - should live in cryptonote_tx_utils.cpp as a helper fn
-    LOG_PRINT_L2("Block template filled with " << bl.tx_hashes.size() << " txes, weight "
-        << total_weight << "/" << max_total_weight << ", coinbase " << print_money(best_coinbase)
-        << " (including " << print_money(fee_map["XHV"]) << " in fees)");
-    // LAND AHOY!!!
-    return true;
+    const block_template_builder::limits lim{median_weight, already_generated_coins, hf_version, have_valid_pr, block_cap_xhv};
+    const bool r = m_template_builder.fill(m_txs_by_fee_and_receive_time, lim, load_meta, check, bl, total_weight, fee_map, offshore_fee_map, xasset_fee_map, expected_reward);
+    lock.commit();
+    return r;
   }
   //---------------------------------------------------------------------------------
   size_t tx_memory_pool::validate(uint8_t version)
@@ -2841,7 +2921,12 @@ namespace cryptonote
 
     m_txpool_max_weight = max_txpool_weight ? max_txpool_weight : DEFAULT_TXPOOL_MAX_WEIGHT;
     m_txs_by_fee_and_receive_time.clear();
-    m_spent_key_images.clear();
+    m_template_builder.clear();
+    m_parsed_tx_cache.clear();
+    {
+      boost::unique_lock<boost::shared_mutex> key_images_lock(m_spent_key_images_lock);
+      m_spent_key_images.clear();
+    }
     m_txpool_weight = 0;
     std::vector<crypto::hash> remove;
 
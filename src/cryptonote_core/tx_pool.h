@@ -33,12 +33,19 @@
 #include "include_base_utils.h"
 
 #include <atomic>
+#include <functional>
 #include <set>
 #include <tuple>
 #include <unordered_map>
 #include <unordered_set>
 #include <queue>
+#include <boost/multi_index_container.hpp>
+#include <boost/multi_index/hashed_index.hpp>
+#include <boost/multi_index/identity.hpp>
+#include <boost/multi_index/member.hpp>
+#include <boost/multi_index/ordered_index.hpp>
 #include <boost/serialization/version.hpp>
+#include <boost/thread/shared_mutex.hpp>
 #include <boost/utility.hpp>
 
 #include "span.h"
@@ -78,8 +85,113 @@ namespace cryptonote
     }
   };
 
-  //! container for sorting transactions by fee per unit size
-  typedef std::set<tx_by_fee_and_receive_time_entry, txCompare> sorted_tx_container;
+  struct by_fee_and_receive_time {};
+  struct by_txid {};
+
+  //! container for sorting transactions by fee per unit size, also indexed by tx hash
+  typedef boost::multi_index_container<
+    tx_by_fee_and_receive_time_entry,
+    boost::multi_index::indexed_by<
+      // iteration order, highest fee per unit size first
+      boost::multi_index::ordered_unique<boost::multi_index::tag<by_fee_and_receive_time>, boost::multi_index::identity<tx_by_fee_and_receive_time_entry>, txCompare>,
+      // access by tx hash
+      boost::multi_index::hashed_unique<boost::multi_index::tag<by_txid>, boost::multi_index::member<tx_by_fee_and_receive_time_entry, crypto::hash, &tx_by_fee_and_receive_time_entry::second>, std::hash<crypto::hash>>
+    >
+  > sorted_tx_container;
+
+  /**
+   * @brief what fill_block_template needs to know about a pool transaction
+   *
+   * All of this depends only on the transaction itself and on the chain tip
+   * it was checked against, so it stays valid between block templates until
+   * the tip moves.
+   */
+  struct block_template_candidate
+  {
+    enum class state: uint8_t { unchecked, ready, rejected };
+
+    state status = state::unchecked;
+    bool pruned = false;
+    size_t weight = 0;
+    uint64_t fee = 0;
+    uint64_t offshore_fee = 0;
+    std::string fee_asset_type;
+    bool conversion = false;            //!< source and destination assets differ
+    bool xasset_conversion = false;     //!< a conversion which neither starts nor ends in XHV
+    bool block_capped = false;          //!< counts against the offshore/onshore block cap
+    uint64_t conversion_xhv = 0;        //!< XHV amount counted against the block cap
+    std::vector<crypto::key_image> key_images;
+  };
+
+  /**
+   * @brief keeps block template candidates across txpool changes
+   *
+   * The pool is already kept sorted by fee, so building a template is a
+   * single walk of that order. The expensive part is loading and checking
+   * each transaction against the chain; the builder remembers the outcome
+   * per transaction until the chain tip or hard fork version changes, so a
+   * template refresh after a new transaction arrives only has to load and
+   * check that one transaction. The walk itself still visits every pool
+   * transaction, with a cache lookup for each, so a refresh stays linear in
+   * the pool size.
+   */
+  class block_template_builder
+  {
+  public:
+    //! fills a candidate in, returns false if the transaction should be skipped
+    typedef std::function<bool(const crypto::hash&, block_template_candidate&)> loader_t;
+
+    //! per-template limits, all derived from the current chain tip
+    struct limits
+    {
+      size_t median_weight;
+      uint64_t already_generated_coins;
+      uint8_t hf_version;
+      bool have_valid_pr;
+      uint64_t block_cap_xhv;
+    };
+
+    block_template_builder();
+
+    /**
+     * @brief drops every cached candidate if the chain tip or hf version changed
+     *
+     * @return true if the cache was dropped
+     */
+    bool set_tip(const crypto::hash &top_id, uint8_t hf_version);
+
+    //! forgets a transaction which has left the pool
+    void remove(const crypto::hash &txid) { m_candidates.erase(txid); }
+
+    //! forgets every candidate
+    void clear();
+
+    //! the number of cached candidates
+    size_t size() const { return m_candidates.size(); }
+
+    /**
+     * @brief picks transactions for a block template
+     *
+     * @param txs the pool, sorted by fee per byte
+     * @param lim block weight, reward and block cap limits
+     * @param load_meta fills in the weight/fee fields of a candidate seen for the first time
+     * @param check fills in the rest of a candidate and checks it against the chain
+     * @param bl the block to add transaction hashes to
+     * @param total_weight return-by-reference the weight of the chosen transactions
+     * @param fee_map return-by-reference the fees of the chosen transactions
+     * @param offshore_fee_map return-by-reference the offshore/onshore conversion fees
+     * @param xasset_fee_map return-by-reference the xAsset conversion fees
+     * @param expected_reward return-by-reference the coinbase reward
+     *
+     * @return false if the block reward could not be computed, true otherwise
+     */
+    bool fill(const sorted_tx_container &txs, const limits &lim, const loader_t &load_meta, const loader_t &check, block &bl, size_t &total_weight, std::map<std::string, uint64_t> &fee_map, std::map<std::string, uint64_t> &offshore_fee_map, std::map<std::string, uint64_t> &xasset_fee_map, uint64_t &expected_reward);
+
+  private:
+    std::unordered_map<crypto::hash, block_template_candidate> m_candidates;
+    crypto::hash m_top_id;
+    uint8_t m_hf_version;
+  };
 
   /**
    * @brief Transaction pool, handles transactions which are not part of a block
@@ -569,10 +681,11 @@ namespace cryptonote
      * @param txid the txid of the transaction to check
      * @param txblob the transaction blob to check
      * @param tx the parsed transaction, if successful
+     * @param tx_parsed true if tx was already parsed from txblob
      *
      * @return true if the transaction is good to go, otherwise false
      */
-    bool is_transaction_ready_to_go(txpool_tx_meta_t& txd, const crypto::hash &txid, const cryptonote::blobdata_ref &txblob, transaction&tx) const;
+    bool is_transaction_ready_to_go(txpool_tx_meta_t& txd, const crypto::hash &txid, const cryptonote::blobdata_ref &txblob, transaction&tx, bool tx_parsed = false) const;
     bool is_transaction_ready_to_go(txpool_tx_meta_t& txd, const crypto::hash &txid, const cryptonote::blobdata &txblob, transaction&tx) const;
 
     /**
@@ -609,6 +722,13 @@ private:
     //! container for spent key images from the transactions in the pool
     key_images_container m_spent_key_images;  
 
+    //! guards m_spent_key_images for the RPC readers, which do not take m_transactions_lock
+    /*! Writers change m_spent_key_images with m_transactions_lock held and
+     *  take this exclusively on top; readers only need it shared, and read
+     *  the txpool tables from their own database read transaction.
+     */
+    mutable boost::shared_mutex m_spent_key_images_lock;
+
     //TODO: this time should be a named constant somewhere, not hard-coded
     //! interval on which to check for stale/"stuck" transactions
     epee::math_helper::once_a_time_seconds<30> m_remove_stuck_tx_interval;
@@ -645,8 +765,12 @@ private:
 
     mutable std::unordered_map<crypto::hash, std::tuple<bool, tx_verification_context, uint64_t, crypto::hash>> m_input_cache;
 
+    //! pool txes already parsed, kept across chain tip changes until they leave the pool
     std::unordered_map<crypto::hash, transaction> m_parsed_tx_cache;
 
+    //! candidates kept between block templates
+    block_template_builder m_template_builder;
+
     //! Next timestamp that a DB check for relayable txes is allowed
     std::atomic<time_t> m_next_check;
   };
@@ -746,6 +746,13 @@ bool t_rpc_command_executor::print_net_stats()
     % percent
     % tools::get_human_readable_bytes(limit);
 
+  const uint64_t getblocks_lookups = net_stats_res.getblocks_cache_hits + net_stats_res.getblocks_cache_misses;
+  tools::success_msg_writer() << boost::format("Block cache: %u hits, %u misses (%.2f%% hit ratio), %s cached")
+    % net_stats_res.getblocks_cache_hits
+    % net_stats_res.getblocks_cache_misses
+    % (getblocks_lookups ? net_stats_res.getblocks_cache_hits * 100.0 / getblocks_lookups : 0.0)
+    % tools::get_human_readable_bytes(net_stats_res.getblocks_cache_size);
+
   return true;
 }
 
@@ -26,6 +26,8 @@
 // THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #pragma once
+#include <cstdint>
+#include <cstring>
 #include <string>
 #include <vector>
 
@@ -33,6 +35,94 @@ namespace offshore {
 
   const std::vector<std::string> ASSET_TYPES = {"XHV", "XAG", "XAU", "XAUD", "XBTC", "XCAD", "XCHF", "XCNY", "XEUR", "XGBP", "XJPY", "XNOK", "XNZD", "XUSD"};
 
+  // Compact numeric asset ids. The value of each id is the index of the asset in ASSET_TYPES,
+  // which is also the currency index stored in the circulating supply tables, so the order
+  // MUST NOT be changed. The string form is only used at the serialization boundary.
+  enum asset_id_t : uint8_t
+  {
+    ASSET_XHV = 0,
+    ASSET_XAG,
+    ASSET_XAU,
+    ASSET_XAUD,
+    ASSET_XBTC,
+    ASSET_XCAD,
+    ASSET_XCHF,
+    ASSET_XCNY,
+    ASSET_XEUR,
+    ASSET_XGBP,
+    ASSET_XJPY,
+    ASSET_XNOK,
+    ASSET_XNZD,
+    ASSET_XUSD,
+    ASSET_COUNT,
+    ASSET_INVALID = 0xff
+  };
+
+  namespace detail
+  {
+    // Asset tickers are at most 4 characters long, so pack them into an integer and do
+    // integer compares rather than string compares.
+    constexpr uint32_t pack_asset_name(const char *name, size_t len, size_t i = 0, uint32_t acc = 0)
+    {
+      return i == len ? acc : pack_asset_name(name, len, i + 1, acc | (uint32_t(uint8_t(name[i])) << (8 * i)));
+    }
+  }
+
+  inline asset_id_t get_asset_id(const char *name, size_t len) noexcept
+  {
+    // a NUL packs to nothing, so "XHV\0" would otherwise pack to the same value as "XHV"
+    if (len < 3 || len > 4 || name[0] != 'X' || memchr(name, 0, len) != nullptr)
+      return ASSET_INVALID;
+    static constexpr uint32_t packed_names[ASSET_COUNT] = {
+      detail::pack_asset_name("XHV", 3),
+      detail::pack_asset_name("XAG", 3),
+      detail::pack_asset_name("XAU", 3),
+      detail::pack_asset_name("XAUD", 4),
+      detail::pack_asset_name("XBTC", 4),
+      detail::pack_asset_name("XCAD", 4),
+      detail::pack_asset_name("XCHF", 4),
+      detail::pack_asset_name("XCNY", 4),
+      detail::pack_asset_name("XEUR", 4),
+      detail::pack_asset_name("XGBP", 4),
+      detail::pack_asset_name("XJPY", 4),
+      detail::pack_asset_name("XNOK", 4),
+      detail::pack_asset_name("XNZD", 4),
+      detail::pack_asset_name("XUSD", 4)
+    };
+    const uint32_t packed = detail::pack_asset_name(name, len);
+    for (uint8_t id = 0; id < ASSET_COUNT; ++id)
+      if (packed_names[id] == packed)
+        return static_cast<asset_id_t>(id);
+    return ASSET_INVALID;
+  }
+
+  inline asset_id_t get_asset_id(const std::string &name) noexcept
+  {
+    return get_asset_id(name.data(), name.size());
+  }
+
+  // for the fixed size, NUL padded asset type fields stored in the DB
+  template<size_t N>
+  inline asset_id_t get_asset_id(const char (&name)[N]) noexcept
+  {
+    return get_asset_id(name, strnlen(name, N));
+  }
+
+  inline bool is_valid_asset_id(const asset_id_t id) noexcept
+  {
+    return id < ASSET_COUNT;
+  }
+
+  inline bool is_valid_asset_type(const std::string &name) noexcept
+  {
+    return is_valid_asset_id(get_asset_id(name));
+  }
+
+  inline const std::string& get_asset_name(const asset_id_t id)
+  {
+    return ASSET_TYPES.at(id);
+  }
+
   class asset_type_counts
   {
 
@@ -72,72 +162,51 @@ namespace offshore {
       {
       }
 
-      uint64_t operator[](const std::string asset_type) const noexcept
+      uint64_t operator[](const asset_id_t asset_id) const noexcept
       {
-        if (asset_type == "XHV") {
-          return XHV;
-        } else if (asset_type == "XUSD") {
-          return XUSD;
-        } else if (asset_type == "XAG") {
-          return XAG;
-        } else if (asset_type == "XAU") {
-          return XAU;
-        } else if (asset_type == "XAUD") {
-          return XAUD;
-        } else if (asset_type == "XBTC") {
-          return XBTC;
-        } else if (asset_type == "XCAD") {
-          return XCAD;
-        } else if (asset_type == "XCHF") {
-          return XCHF;
-        } else if (asset_type == "XCNY") {
-          return XCNY;
-        } else if (asset_type == "XEUR") {
-          return XEUR;
-        } else if (asset_type == "XGBP") {
-          return XGBP;
-        } else if (asset_type == "XJPY") {
-          return XJPY;
-        } else if (asset_type == "XNOK") {
-          return XNOK;
-        } else if (asset_type == "XNZD") {
-          return XNZD;
-        }
-
-        return 0;
+        if (!is_valid_asset_id(asset_id))
+          return 0;
+        return this->*field(asset_id);
       }
 
-      void add(const std::string asset_type, const uint64_t val)
+      uint64_t operator[](const std::string& asset_type) const noexcept
+      {
+        return (*this)[get_asset_id(asset_type)];
+      }
+
+      void add(const asset_id_t asset_id, const uint64_t val) noexcept
+      {
+        if (is_valid_asset_id(asset_id))
+          this->*field(asset_id) += val;
+      }
+
+      void add(const std::string& asset_type, const uint64_t val) noexcept
+      {
+        add(get_asset_id(asset_type), val);
+      }
+
+    private:
+
+      // the fields above are declared in asset id order
+      static uint64_t asset_type_counts::* field(const asset_id_t asset_id) noexcept
       {
-        if (asset_type == "XHV") {
-          XHV += val;
-        } else if (asset_type == "XUSD") {
-          XUSD += val;
-        } else if (asset_type == "XAG") {
-          XAG += val;
-        } else if (asset_type == "XAU") {
-          XAU += val;
-        } else if (asset_type == "XAUD") {
-          XAUD += val;
-        } else if (asset_type == "XBTC") {
-          XBTC += val;
-        } else if (asset_type == "XCAD") {
-          XCAD += val;
-        } else if (asset_type == "XCHF") {
-          XCHF += val;
-        } else if (asset_type == "XCNY") {
-          XCNY += val;
-        } else if (asset_type == "XEUR") {
-          XEUR += val;
-        } else if (asset_type == "XGBP") {
-          XGBP += val;
-        } else if (asset_type == "XJPY") {
-          XJPY += val;
-        } else if (asset_type == "XNOK") {
-          XNOK += val;
-        } else if (asset_type == "XNZD") {
-          XNZD += val;
-        }
+        static uint64_t asset_type_counts::* const fields[ASSET_COUNT] = {
+          &asset_type_counts::XHV,
+          &asset_type_counts::XAG,
+          &asset_type_counts::XAU,
+          &asset_type_counts::XAUD,
+          &asset_type_counts::XBTC,
+          &asset_type_counts::XCAD,
+          &asset_type_counts::XCHF,
+          &asset_type_counts::XCNY,
+          &asset_type_counts::XEUR,
+          &asset_type_counts::XGBP,
+          &asset_type_counts::XJPY,
+          &asset_type_counts::XNOK,
+          &asset_type_counts::XNZD,
+          &asset_type_counts::XUSD
+        };
+        return fields[asset_id];
       }
   };
 }
@@ -33,6 +33,13 @@
 #include "storages/portable_storage.h"
 
 #include "string_tools.h"
+#include "common/threadpool.h"
+
+#include <map>
+#include <memory>
+#include <boost/thread/locks.hpp>
+#include <boost/thread/mutex.hpp>
+
 namespace offshore
 {
 
@@ -108,6 +115,93 @@ namespace offshore
         KV_SERIALIZE(signature)
       END_KV_SERIALIZE_MAP()
     };
+
+    constexpr size_t ECDSA_SIG_MAX_DER_SIZE = 72;
+
+    struct pkey_deleter
+    {
+      void operator()(EVP_PKEY* pkey) const { EVP_PKEY_free(pkey); }
+    };
+
+    boost::mutex public_keys_lock;
+    std::map<std::string, std::shared_ptr<EVP_PKEY>> public_keys;
+
+    // Builds the DER form of a 64-byte r+s signature, returns its size or 0 on error
+    int encode_signature(const unsigned char (&signature)[64], unsigned char (&der)[ECDSA_SIG_MAX_DER_SIZE])
+    {
+      ECDSA_SIG* sig = ECDSA_SIG_new();
+      BIGNUM* r = BN_bin2bn(signature, 32, NULL);
+      BIGNUM* s = BN_bin2bn(signature + 32, 32, NULL);
+      if (!sig || !r || !s) {
+        BN_free(r);
+        BN_free(s);
+        ECDSA_SIG_free(sig);
+        return 0;
+      }
+#if OPENSSL_VERSION_NUMBER < 0x10100000L || defined(LIBRESSL_VERSION_TEXT)
+      BN_free(sig->r);
+      BN_free(sig->s);
+      sig->r = r;
+      sig->s = s;
+#else
+      ECDSA_SIG_set0(sig, r, s);
+#endif
+      int der_len = i2d_ECDSA_SIG(sig, NULL);
+      if (der_len > 0 && (size_t)der_len <= sizeof(der)) {
+        unsigned char* p = der;
+        der_len = i2d_ECDSA_SIG(sig, &p);
+      } else {
+        der_len = 0;
+      }
+      ECDSA_SIG_free(sig);
+      return der_len;
+    }
+
+    // The message the oracle signed for this record
+    std::string get_signed_message(const pricing_record& pr)
+    {
+      std::ostringstream oss;
+      switch (pr.xNZD) {
+      case 3:
+        // Build the v3 format of the JSON string
+        oss << "[";
+        oss << "{\"name\":\"xAG\",\"spot\":" << pr.xAG << ",\"ma\":" << pr.xAG << "},";
+        oss << "{\"name\":\"xAU\",\"spot\":" << pr.xAU << ",\"ma\":" << pr.xAU << "},";
+        oss << "{\"name\":\"xAUD\",\"spot\":" << pr.xAUD << ",\"ma\":" << pr.xAUD << "},";
+        oss << "{\"name\":\"xBTC\",\"spot\":" << pr.xBTC << ",\"ma\":" << pr.xBTC << "},";
+        oss << "{\"name\":\"xCHF\",\"spot\":" << pr.xCHF << ",\"ma\":" << pr.xCHF << "},";
+        oss << "{\"name\":\"xCNY\",\"spot\":" << pr.xCNY << ",\"ma\":" << pr.xCNY << "},";
+        oss << "{\"name\":\"xEUR\",\"spot\":" << pr.xEUR << ",\"ma\":" << pr.xEUR << "},";
+        oss << "{\"name\":\"xGBP\",\"spot\":" << pr.xGBP << ",\"ma\":" << pr.xGBP << "},";
+        oss << "{\"name\":\"xJPY\",\"spot\":" << pr.xJPY << ",\"ma\":" << pr.xJPY << "},";
+        oss << "{\"name\":\"xUSD\",\"spot\":" << pr.unused2 << ",\"ma\":" << pr.unused3 << "},";
+        oss << "{\"name\":\"XHV\",\"spot\":" << pr.xUSD << ",\"ma\":" << pr.unused1 << "}]";
+        break;
+      default:
+        // Build the v1/v2 format of the JSON string
+        oss << "{\"xAG\":" << pr.xAG;
+        oss << ",\"xAU\":" << pr.xAU;
+        oss << ",\"xAUD\":" << pr.xAUD;
+        oss << ",\"xBTC\":" << pr.xBTC;
+        oss << ",\"xCAD\":" << pr.xCAD;
+        oss << ",\"xCHF\":" << pr.xCHF;
+        oss << ",\"xCNY\":" << pr.xCNY;
+        oss << ",\"xEUR\":" << pr.xEUR;
+        oss << ",\"xGBP\":" << pr.xGBP;
+        oss << ",\"xJPY\":" << pr.xJPY;
+        oss << ",\"xNOK\":" << pr.xNOK;
+        oss << ",\"xNZD\":" << pr.xNZD;
+        oss << ",\"xUSD\":" << pr.xUSD;
+        oss << ",\"unused1\":" << pr.unused1;
+        oss << ",\"unused2\":" << pr.unused2;
+        oss << ",\"unused3\":" << pr.unused3;
+        if (pr.timestamp > 0)
+          oss << ",\"timestamp\":" << pr.timestamp;
+        oss << "}";
+        break;
+      }
+      return oss.str();
+    }
   }
   
   bool asset_data::_load(epee::serialization::portable_storage& src, epee::serialization::section* hparent)
@@ -289,110 +383,124 @@ namespace offshore
 
   uint64_t pricing_record::operator[](const std::string& asset_type) const
   {
-    if (asset_type == "XHV") {
+    return operator[](get_asset_id(asset_type));
+  }
+
+  uint64_t pricing_record::operator[](const asset_id_t asset_id) const
+  {
+    switch (asset_id) {
+    case ASSET_XHV:
       return xUSD; // XHV spot price
-    } else if (asset_type == "XUSD") {
+    case ASSET_XUSD:
       return COIN; // 1
-    } else if (asset_type == "XAG") {
+    case ASSET_XAG:
       return xAG;
-    } else if (asset_type == "XAU") {
+    case ASSET_XAU:
       return xAU;
-    } else if (asset_type == "XAUD") {
+    case ASSET_XAUD:
       return xAUD;
-    } else if (asset_type == "XBTC") {
+    case ASSET_XBTC:
       return xBTC;
-    } else if (asset_type == "XCAD") {
+    case ASSET_XCAD:
       return xCAD;
-    } else if (asset_type == "XCHF") {
+    case ASSET_XCHF:
       return xCHF;
-    } else if (asset_type == "XCNY") {
+    case ASSET_XCNY:
       return xCNY;
-    } else if (asset_type == "XEUR") {
+    case ASSET_XEUR:
       return xEUR;
-    } else if (asset_type == "XGBP") {
+    case ASSET_XGBP:
       return xGBP;
-    } else if (asset_type == "XJPY") {
+    case ASSET_XJPY:
       return xJPY;
-    } else if (asset_type == "XNOK") {
+    case ASSET_XNOK:
       return xNOK;
-    } else if (asset_type == "XNZD") {
+    case ASSET_XNZD:
       // NEAC: Special case - since the deprecation of xNZD as a supported asset, it has been repurposed as "pr_version"
       if (xNZD > 255)
         return xNZD;
       return 0;
-    } else {
-     CHECK_AND_ASSERT_THROW_MES(false, "Asset type doesn't exist in pricing record!");
+    default:
+      CHECK_AND_ASSERT_THROW_MES(false, "Asset type doesn't exist in pricing record!");
     }
   }
 
   uint64_t pricing_record::ma(const std::string& asset_type) const
   {
-    if (asset_type != "XHV" and asset_type != "XUSD") {
-      return operator[](asset_type);
-    }
-    if (asset_type == "XHV") {
+    return ma(get_asset_id(asset_type));
+  }
+
+  uint64_t pricing_record::max(const std::string& asset_type) const
+  {
+    return max(get_asset_id(asset_type));
+  }
+
+  uint64_t pricing_record::min(const std::string& asset_type) const
+  {
+    return min(get_asset_id(asset_type));
+  }
+
+  uint64_t pricing_record::spot(const std::string& asset_type) const
+  {
+    return spot(get_asset_id(asset_type));
+  }
+
+  uint64_t pricing_record::ma(const asset_id_t asset_id) const
+  {
+    if (asset_id == ASSET_XHV) {
       if (!unused1 || !xUSD) {
         return std::max(unused1, xUSD);
       }
       return unused1;
     }
-    if (asset_type == "XUSD") {
+    if (asset_id == ASSET_XUSD) {
       if (!unused2 || !unused3) {
         return std::max(unused2, unused3);
       }
       return unused3;
     }
-    CHECK_AND_ASSERT_THROW_MES(false, "Asset type doesn't exist in pricing record!");
+    return operator[](asset_id);
   }
   
-  uint64_t pricing_record::max(const std::string& asset_type) const
+  uint64_t pricing_record::max(const asset_id_t asset_id) const
   {
-    if (asset_type != "XHV" and asset_type != "XUSD") {
-      return operator[](asset_type);
-    }
-    if (asset_type == "XHV") return std::max(unused1, xUSD);
-    if (asset_type == "XUSD") return std::max(unused2, unused3);
-    CHECK_AND_ASSERT_THROW_MES(false, "Asset type doesn't exist in pricing record!");
+    if (asset_id == ASSET_XHV) return std::max(unused1, xUSD);
+    if (asset_id == ASSET_XUSD) return std::max(unused2, unused3);
+    return operator[](asset_id);
   }
   
-  uint64_t pricing_record::min(const std::string& asset_type) const
+  uint64_t pricing_record::min(const asset_id_t asset_id) const
   {
-    if (asset_type != "XHV" and asset_type != "XUSD") {
-      return operator[](asset_type);
-    }
-    if (asset_type == "XHV") {
+    if (asset_id == ASSET_XHV) {
       if (!unused1 || !xUSD) {
         return std::max(unused1, xUSD);
       }
       return std::min(unused1, xUSD);
     }
-    if (asset_type == "XUSD") {
+    if (asset_id == ASSET_XUSD) {
       if (!unused2 || !unused3) {
         return std::max(unused2, unused3);
       }
       return std::min(unused2, unused3);
     }
-    CHECK_AND_ASSERT_THROW_MES(false, "Asset type doesn't exist in pricing record!");
+    return operator[](asset_id);
   }
   
-  uint64_t pricing_record::spot(const std::string& asset_type) const
+  uint64_t pricing_record::spot(const asset_id_t asset_id) const
   {
-    if (asset_type != "XHV" and asset_type != "XUSD") {
-      return operator[](asset_type);
-    }
-    if (asset_type == "XHV") {
+    if (asset_id == ASSET_XHV) {
       if (!unused1 || !xUSD) {
         return std::max(unused1, xUSD);
       }
       return xUSD;
     }
-    if (asset_type == "XUSD") {
+    if (asset_id == ASSET_XUSD) {
       if (!unused2 || !unused3) {
         return std::max(unused2, unused3);
       }
       return unused2;
     }
-    CHECK_AND_ASSERT_THROW_MES(false, "Asset type doesn't exist in pricing record!");
+    return operator[](asset_id);
   }
 
   void pricing_record::set_version(const uint8_t& version)
@@ -433,102 +541,31 @@ namespace offshore
     CHECK_AND_ASSERT_THROW_MES(!public_key.empty(), "Pricing record verification failed. NULL public key. PK Size: " << public_key.size()); // TODO: is this necessary or the one below already covers this case, meannin it will produce empty pubkey?
     
     // extract the key
-    EVP_PKEY* pubkey;
-    BIO* bio = BIO_new_mem_buf(public_key.c_str(), public_key.size());
-    if (!bio) {
-      return false;
-    }
-    pubkey = PEM_read_bio_PUBKEY(bio, NULL, NULL, NULL);
-    BIO_free(bio);
-    CHECK_AND_ASSERT_THROW_MES(pubkey != NULL, "Pricing record verification failed. NULL public key.");
+    const std::shared_ptr<EVP_PKEY> pubkey = get_public_key(public_key);
+    CHECK_AND_ASSERT_THROW_MES(pubkey, "Pricing record verification failed. NULL public key.");
 
+    return verifySignature(pubkey.get());
+  }
 
-    // Convert our internal 64-byte binary representation into 128-byte hex string
-    std::string sig_hex;
-    for (unsigned int i=0; i<64; i++) {
-      std::stringstream ss;
-      ss << std::hex << std::setw(2) << std::setfill('0') << (0xff & signature[i]);
-      sig_hex += ss.str();
-    }
-    
-    // Rebuild the OpenSSL format of the signature from the r+s values
-    std::string sig_rebuilt = "30";
-    std::string r_rebuilt = (signature[0] == 0) ? sig_hex.substr(2, 62) : sig_hex.substr(0,64);
-    if (signature[(signature[0] == 0) ? 1 : 0] & 0x80)
-      r_rebuilt = "00" + r_rebuilt;
-    std::string s_rebuilt = (signature[(signature[32] == 0) ? 33 : 32] == 0) ? sig_hex.substr(66, 62) : sig_hex.substr(64,64);
-    if (signature[(signature[32] == 0) ? 33 : 32] & 0x80)
-      s_rebuilt = "00" + s_rebuilt;
-    size_t sig_length = (r_rebuilt.length() + s_rebuilt.length() + 8) >> 1;
-    std::stringstream ss;
-    ss << std::hex << sig_length;
-    sig_rebuilt += std::string(2-ss.str().length(), '0') + ss.str();
-    ss.clear();
-    sig_rebuilt += "02";
-    size_t r_length = r_rebuilt.length() >> 1;
-    std::stringstream ss2;
-    ss2 << std::hex << r_length;
-    sig_rebuilt += std::string(2-ss2.str().length(), '0') + ss2.str();
-    ss2.clear();
-    sig_rebuilt += r_rebuilt;
-    sig_rebuilt += "02";
-    size_t s_length = s_rebuilt.length() >> 1;
-    std::stringstream ss3;
-    ss3 << std::hex << s_length;
-    sig_rebuilt += std::string(2-ss3.str().length(), '0') + ss3.str();
-    ss3.clear();
-    sig_rebuilt += s_rebuilt;
+  bool pricing_record::verifySignature(EVP_PKEY* pubkey) const
+  {
+    // The 64-byte r+s signature used to be rebuilt into DER by hand, and that encoder
+    // produced non-minimal integers (which OpenSSL rejects) for some leading zero bytes.
+    // Keep rejecting exactly those so consensus does not change: r when it starts with
+    // two zero bytes not followed by a high bit, and s when it starts with a zero byte,
+    // unless that is two zero bytes followed by a high bit.
+    if (signature[0] == 0 && signature[1] == 0 && signature[2] < 0x80)
+      return false;
+    if (signature[32] == 0 && !(signature[33] == 0 && signature[34] >= 0x80))
+      return false;
+
+    unsigned char der[ECDSA_SIG_MAX_DER_SIZE];
+    const int der_len = encode_signature(signature, der);
+    if (der_len <= 0)
+      return false;
 
     // Build the JSON string, so that we can verify the signature
-    std::ostringstream oss;
-    switch (xNZD) {
-    case 3:
-      // Build the v3 format of the JSON string
-      oss << "[";
-      oss << "{\"name\":\"xAG\",\"spot\":" << xAG << ",\"ma\":" << xAG << "},";
-      oss << "{\"name\":\"xAU\",\"spot\":" << xAU << ",\"ma\":" << xAU << "},";
-      oss << "{\"name\":\"xAUD\",\"spot\":" << xAUD << ",\"ma\":" << xAUD << "},";
-      oss << "{\"name\":\"xBTC\",\"spot\":" << xBTC << ",\"ma\":" << xBTC << "},";
-      oss << "{\"name\":\"xCHF\",\"spot\":" << xCHF << ",\"ma\":" << xCHF << "},";
-      oss << "{\"name\":\"xCNY\",\"spot\":" << xCNY << ",\"ma\":" << xCNY << "},";
-      oss << "{\"name\":\"xEUR\",\"spot\":" << xEUR << ",\"ma\":" << xEUR << "},";
-      oss << "{\"name\":\"xGBP\",\"spot\":" << xGBP << ",\"ma\":" << xGBP << "},";
-      oss << "{\"name\":\"xJPY\",\"spot\":" << xJPY << ",\"ma\":" << xJPY << "},";
-      oss << "{\"name\":\"xUSD\",\"spot\":" << unused2 << ",\"ma\":" << unused3 << "},";
-      oss << "{\"name\":\"XHV\",\"spot\":" << xUSD << ",\"ma\":" << unused1 << "}]";
-      break;
-    default:
-      // Build the v1/v2 format of the JSON string
-      oss << "{\"xAG\":" << xAG;
-      oss << ",\"xAU\":" << xAU;
-      oss << ",\"xAUD\":" << xAUD;
-      oss << ",\"xBTC\":" << xBTC;
-      oss << ",\"xCAD\":" << xCAD;
-      oss << ",\"xCHF\":" << xCHF;
-      oss << ",\"xCNY\":" << xCNY;
-      oss << ",\"xEUR\":" << xEUR;
-      oss << ",\"xGBP\":" << xGBP;
-      oss << ",\"xJPY\":" << xJPY;
-      oss << ",\"xNOK\":" << xNOK;
-      oss << ",\"xNZD\":" << xNZD;
-      oss << ",\"xUSD\":" << xUSD;
-      oss << ",\"unused1\":" << unused1;
-      oss << ",\"unused2\":" << unused2;
-      oss << ",\"unused3\":" << unused3;
-      if (timestamp > 0)
-        oss << ",\"timestamp\":" << timestamp;
-      oss << "}";
-      break;
-    }
-    std::string message = oss.str();    
-
-    // Convert signature from hex-encoded to binary
-    std::string compact;
-    for (unsigned int i = 0; i < sig_rebuilt.length(); i += 2) {
-      std::string byteString = sig_rebuilt.substr(i, 2);
-      char byte = (char) strtol(byteString.c_str(), NULL, 16);
-      compact += (byte);
-    }
+    const std::string message = get_signed_message(*this);
 
     // Create a verify digest from the message
     EVP_MD_CTX *ctx = EVP_MD_CTX_create();
@@ -538,21 +575,20 @@ namespace offshore
       if (ret == 1) {
         ret = EVP_DigestVerifyUpdate(ctx, message.data(), message.length());
         if (ret == 1) {
-          ret = EVP_DigestVerifyFinal(ctx, (const unsigned char *)compact.data(), compact.length());
+          ret = EVP_DigestVerifyFinal(ctx, der, der_len);
         }
       }
     }
 
     // Cleanup the context we created
     EVP_MD_CTX_destroy(ctx);
-    // Cleanup the openssl stuff
-    EVP_PKEY_free(pubkey);
-    
+
     if (ret == 1)
       return true;
 
     // Get the errors from OpenSSL
     //ERR_print_errors_fp (stderr);
+    ERR_clear_error();
   
     return false;
   }
@@ -585,7 +621,7 @@ namespace offshore
   }
 
   // overload for pr validation for block
-  bool pricing_record::valid(cryptonote::network_type nettype, uint32_t hf_version, uint64_t bl_timestamp, uint64_t last_bl_timestamp) const 
+  bool pricing_record::valid(cryptonote::network_type nettype, uint32_t hf_version, uint64_t bl_timestamp, uint64_t last_bl_timestamp, bool signature_verified) const 
   {
     // check for empty pr 
     if (hf_version >= HF_VERSION_XASSET_FEES_V2) {
@@ -600,7 +636,7 @@ namespace offshore
     }
 
     // verify the signature
-    if (hf_version >= HF_VERSION_OFFSHORE_FULL) {
+    if (hf_version >= HF_VERSION_OFFSHORE_FULL && !signature_verified) {
       if (!verifySignature(get_config(nettype).ORACLE_PUBLIC_KEY)) {
         LOG_ERROR("Invalid pricing record signature.");
         return false;
@@ -622,4 +658,45 @@ namespace offshore
     return true;
   }
 
+  std::shared_ptr<EVP_PKEY> get_public_key(const std::string& public_key)
+  {
+    boost::lock_guard<boost::mutex> lock(public_keys_lock);
+    auto it = public_keys.find(public_key);
+    if (it != public_keys.end())
+      return it->second;
+
+    BIO* bio = BIO_new_mem_buf(public_key.c_str(), public_key.size());
+    if (!bio)
+      return nullptr;
+    std::shared_ptr<EVP_PKEY> pubkey(PEM_read_bio_PUBKEY(bio, NULL, NULL, NULL), pkey_deleter());
+    BIO_free(bio);
+    if (!pubkey)
+      return nullptr;
+    public_keys.emplace(public_key, pubkey);
+    return pubkey;
+  }
+
+  void verify_signatures(const std::vector<const pricing_record*>& records, const std::string& public_key, std::vector<uint8_t>& results)
+  {
+    results.assign(records.size(), 0);
+    if (records.empty())
+      return;
+
+    const std::shared_ptr<EVP_PKEY> pubkey = get_public_key(public_key);
+    CHECK_AND_ASSERT_THROW_MES(pubkey, "Pricing record verification failed. NULL public key.");
+
+    tools::threadpool& tpool = tools::threadpool::getInstanceForCompute();
+    const size_t threads = std::max<size_t>(1, std::min<size_t>(tpool.get_max_concurrency(), records.size()));
+    const size_t chunk = (records.size() + threads - 1) / threads;
+    tools::threadpool::waiter waiter(tpool);
+    for (size_t begin = 0; begin < records.size(); begin += chunk)
+    {
+      const size_t end = std::min(begin + chunk, records.size());
+      tpool.submit(&waiter, [&records, &results, &pubkey, begin, end]() {
+        for (size_t i = begin; i < end; ++i)
+          results[i] = records[i]->verifySignature(pubkey.get());
+      }, true);
+    }
+    waiter.wait();
+  }
 }
@@ -40,12 +40,15 @@
 #include <openssl/ssl.h>
 
 #include <cstdint>
+#include <memory>
 #include <string>
 #include <cstring>
+#include <vector>
 #include <serialization/containers.h>
 
 #include "cryptonote_config.h"
 #include "crypto/hash.h"
+#include "offshore/asset_types.h"
 
 namespace epee
 {
@@ -143,15 +146,24 @@ namespace offshore
       bool equal(const pricing_record& other) const noexcept;
       bool empty() const noexcept;
       bool verifySignature(const std::string& public_key) const;
-      bool valid(cryptonote::network_type nettype, uint32_t hf_version, uint64_t bl_timestamp, uint64_t last_bl_timestamp) const;
+      bool verifySignature(EVP_PKEY* public_key) const;
+      //! signature_verified skips the signature check for records already checked by verify_signatures()
+      bool valid(cryptonote::network_type nettype, uint32_t hf_version, uint64_t bl_timestamp, uint64_t last_bl_timestamp, bool signature_verified = false) const;
 
       pricing_record& operator=(const pricing_record& orig) noexcept;
       uint64_t operator[](const std::string& asset_type) const;
+      uint64_t operator[](const asset_id_t asset_id) const;
 
       uint64_t ma(const std::string& asset_type) const;
       uint64_t max(const std::string& asset_type) const;
       uint64_t min(const std::string& asset_type) const;
       uint64_t spot(const std::string& asset_type) const;
+
+      // constant-time accessors for the validation hot paths
+      uint64_t ma(const asset_id_t asset_id) const;
+      uint64_t max(const asset_id_t asset_id) const;
+      uint64_t min(const asset_id_t asset_id) const;
+      uint64_t spot(const asset_id_t asset_id) const;
   };
 
   inline bool operator==(const pricing_record& a, const pricing_record& b) noexcept
@@ -164,6 +176,12 @@ namespace offshore
    return !a.equal(b);
   }
 
+  //! returns the parsed PEM key, parsing it only the first time it is seen
+  std::shared_ptr<EVP_PKEY> get_public_key(const std::string& public_key);
+
+  //! verifies the signatures of many records on the compute threadpool, results[i] is non-zero iff records[i] verifies
+  void verify_signatures(const std::vector<const pricing_record*>& records, const std::string& public_key, std::vector<uint8_t>& results);
+
   // did not have a timestamp
   class pricing_record_v1
   {
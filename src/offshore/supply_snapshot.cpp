@@ -0,0 +1,100 @@
+// Copyright (c) 2023, Haven Protocol
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "supply_snapshot.h"
+
+namespace offshore
+{
+
+  supply_snapshot::supply_snapshot() noexcept
+    : version(0)
+    , height(0)
+    , mined_xhv(0)
+    , present(0)
+  {
+    for (auto &tally: tallies)
+      tally = 0;
+  }
+
+  void supply_snapshot::set_tally(const asset_id_t asset_id, const tally_t& tally)
+  {
+    if (!is_valid_asset_id(asset_id))
+      return;
+    tallies[asset_id] = tally;
+    present |= (1u << asset_id);
+  }
+
+  supply_snapshot::amount_t supply_snapshot::circulating(const asset_id_t asset_id) const
+  {
+    if (!has(asset_id))
+      return 0;
+    tally_t amount = tallies[asset_id];
+    if (asset_id == ASSET_XHV)
+      amount += mined_xhv;
+    // a negative tally wraps exactly like parsing its decimal string into an unsigned 128-bit integer
+    if (amount < 0)
+      return amount_t(0) - amount_t(-amount);
+    return amount_t(amount);
+  }
+
+  std::vector<std::pair<std::string, std::string>> supply_snapshot::to_amounts() const
+  {
+    std::vector<std::pair<std::string, std::string>> amounts;
+    for (uint8_t id = 0; id < ASSET_COUNT; ++id)
+    {
+      const asset_id_t asset_id = static_cast<asset_id_t>(id);
+      if (!has(asset_id))
+        continue;
+      tally_t amount = tallies[asset_id];
+      if (asset_id == ASSET_XHV)
+        amount += mined_xhv;
+      amounts.emplace_back(get_asset_name(asset_id), amount.str());
+    }
+    return amounts;
+  }
+
+  bool supply_snapshot::from_amounts(const std::vector<std::pair<std::string, std::string>>& amounts)
+  {
+    *this = supply_snapshot();
+    for (const auto &amount: amounts)
+    {
+      const asset_id_t asset_id = get_asset_id(amount.first);
+      if (!is_valid_asset_id(asset_id))
+        return false;
+      try
+      {
+        set_tally(asset_id, tally_t(amount.second.c_str()));
+      }
+      catch (const std::exception &e)
+      {
+        return false;
+      }
+    }
+    return true;
+  }
+
+} // offshore
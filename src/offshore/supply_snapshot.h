@@ -0,0 +1,76 @@
+// Copyright (c) 2023, Haven Protocol
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <boost/multiprecision/cpp_int.hpp>
+
+#include "offshore/asset_types.h"
+
+namespace offshore
+{
+
+  // In-memory, typed copy of the circulating supply tallies. The DB keeps a snapshot of the
+  // supply at the chain tip so that conversion checks need neither a read txn nor any
+  // decimal string parsing. Snapshots are immutable once published and are handed out as
+  // shared_ptr<const supply_snapshot>; every change produces a new snapshot with a higher version.
+  struct supply_snapshot
+  {
+    typedef boost::multiprecision::int128_t tally_t;
+    typedef boost::multiprecision::uint128_t amount_t;
+
+    uint64_t version;                  // monotonically increasing, bumped on every change; 0 if not kept by the db
+    uint64_t height;                   // blockchain height the snapshot reflects
+    uint64_t mined_xhv;                // already generated coins at height - 1
+    uint32_t present;                  // bitmask of the assets which have a tally row
+    tally_t tallies[ASSET_COUNT];      // raw circulating supply tallies, indexed by asset_id_t
+
+    supply_snapshot() noexcept;
+
+    // before the first conversion on chain there is no tally at all, and the supply is only the mined XHV
+    bool has(const asset_id_t asset_id) const noexcept
+    {
+      return is_valid_asset_id(asset_id) && ((present & (1u << asset_id)) || (asset_id == ASSET_XHV && !present));
+    }
+
+    void set_tally(const asset_id_t asset_id, const tally_t& tally);
+
+    //! circulating supply of an asset (XHV includes the mined coins), 0 for assets without a tally
+    amount_t circulating(const asset_id_t asset_id) const;
+
+    //! legacy (asset, decimal amount) representation, as returned by BlockchainDB::get_circulating_supply()
+    std::vector<std::pair<std::string, std::string>> to_amounts() const;
+
+    //! builds a snapshot from the legacy representation, fails on unknown assets or malformed amounts
+    bool from_amounts(const std::vector<std::pair<std::string, std::string>>& amounts);
+  };
+
+} // offshore
@@ -241,6 +241,15 @@ namespace rct {
       catch (...) { return false; }
     }
 
+    bool verRangeProofBatch(const range_proof_batch &batch)
+    {
+      if (!batch.bulletproofs.empty() && !verBulletproof(batch.bulletproofs))
+        return false;
+      if (!batch.bulletproofs_plus.empty() && !verBulletproofPlus(batch.bulletproofs_plus))
+        return false;
+      return true;
+    }
+
     //Borromean (c.f. gmax/andytoshi's paper)
     boroSig genBorromean(const key64 x, const key64 P1, const key64 P2, const bits indices) {
         key64 L[2], alpha;
@@ -1768,7 +1777,8 @@ namespace rct {
     const uint8_t version,
     const uint64_t amount_collateral,
     const uint64_t amount_slippage,
-    const cryptonote::anonymity_pool tx_anon_pool
+    const cryptonote::anonymity_pool tx_anon_pool,
+    range_proof_batch *deferred_range_proofs
   ){
 
     try
@@ -1801,8 +1811,8 @@ namespace rct {
       CHECK_AND_ASSERT_MES(rv.outPk.size() == rv.ecdhInfo.size(), false, "Mismatched sizes of outPk and rv.ecdhInfo");
       if (rv.type == RCTTypeHaven2) 
         CHECK_AND_ASSERT_MES(rv.maskSums.size() == 2, false, "maskSums size is not 2");
-      CHECK_AND_ASSERT_MES(std::find(offshore::ASSET_TYPES.begin(), offshore::ASSET_TYPES.end(), strSource) != offshore::ASSET_TYPES.end(), false, "Invalid Source Asset!");
-      CHECK_AND_ASSERT_MES(std::find(offshore::ASSET_TYPES.begin(), offshore::ASSET_TYPES.end(), strDest) != offshore::ASSET_TYPES.end(), false, "Invalid Dest Asset!");
+      CHECK_AND_ASSERT_MES(offshore::is_valid_asset_type(strSource), false, "Invalid Source Asset!");
+      CHECK_AND_ASSERT_MES(offshore::is_valid_asset_type(strDest), false, "Invalid Dest Asset!");
       CHECK_AND_ASSERT_MES(tx_type != tt::UNSET, false, "Transaction type is not set.");
       //### Anonymity pool sanity checks #####
       // These checks should ensure that the tx_anon_pool fits to the HF_VERSION
@@ -2366,7 +2376,14 @@ namespace rct {
       for (size_t i = 0; i < rv.p.bulletproofs_plus.size(); i++)
         proofs_plus.push_back(&rv.p.bulletproofs_plus[i]);
 
-      if (!proofs.empty())
+      // the caller verifies these along with other txes' proofs
+      if (deferred_range_proofs)
+      {
+        deferred_range_proofs->bulletproofs.insert(deferred_range_proofs->bulletproofs.end(), proofs.begin(), proofs.end());
+        deferred_range_proofs->bulletproofs_plus.insert(deferred_range_proofs->bulletproofs_plus.end(), proofs_plus.begin(), proofs_plus.end());
+        range_proof_checked = !proofs.empty() || !proofs_plus.empty();
+      }
+      else if (!proofs.empty())
       {
         if (!verBulletproof(proofs)) {
         LOG_PRINT_L1("Aggregate range proof verified failed for type BP");
@@ -2376,7 +2393,7 @@ namespace rct {
         }
       }
 
-      if (!proofs_plus.empty())
+      if (!deferred_range_proofs && !proofs_plus.empty())
       {
         if (!verBulletproofPlus(proofs_plus)) {
         LOG_PRINT_L1("Aggregate range proof verified failed for type BPP");
@@ -2471,8 +2488,8 @@ namespace rct {
             CHECK_AND_ASSERT_MES(rv.p.pseudoOuts.empty(), false, "rv.p.pseudoOuts is not empty");
           }
         CHECK_AND_ASSERT_MES(rv.outPk.size() == rv.ecdhInfo.size(), false, "Mismatched sizes of outPk and rv.ecdhInfo");
-        CHECK_AND_ASSERT_MES(std::find(offshore::ASSET_TYPES.begin(), offshore::ASSET_TYPES.end(), strSource) != offshore::ASSET_TYPES.end(), false, "Invalid Source Asset!");
-        CHECK_AND_ASSERT_MES(std::find(offshore::ASSET_TYPES.begin(), offshore::ASSET_TYPES.end(), strDest) != offshore::ASSET_TYPES.end(), false, "Invalid Dest Asset!");
+        CHECK_AND_ASSERT_MES(offshore::is_valid_asset_type(strSource), false, "Invalid Source Asset!");
+        CHECK_AND_ASSERT_MES(offshore::is_valid_asset_type(strDest), false, "Invalid Dest Asset!");
         CHECK_AND_ASSERT_MES(type != cryptonote::transaction_type::UNSET, false, "Invalid transaction type.");
         if (strSource != strDest) {
           CHECK_AND_ASSERT_MES(!pr.empty(), false, "Empty pr found for a conversion tx");
@@ -101,6 +101,19 @@ namespace rct {
     rangeSig proveRange(key & C, key & mask, const xmr_amount & amount);
     bool verRange(const key & C, const rangeSig & as);
 
+    //Batch verification of (aggregate) bulletproofs, possibly from several txes
+    //range_proof_batch collects the proofs of the txes in a block so they can
+    //all be verified in one multiexp; the proofs are not copied, so the txes
+    //must outlive it
+    struct range_proof_batch
+    {
+      std::vector<const Bulletproof*> bulletproofs;
+      std::vector<const BulletproofPlus*> bulletproofs_plus;
+    };
+    bool verBulletproof(const std::vector<const Bulletproof*> &proofs);
+    bool verBulletproofPlus(const std::vector<const BulletproofPlus*> &proofs);
+    bool verRangeProofBatch(const range_proof_batch &batch);
+
     //Ring-ct MG sigs
     //Prove:
     //   c.f. https://eprint.iacr.org/2015/1098 section 4. definition 10.
@@ -138,7 +151,7 @@ namespace rct {
   rctSig genRctSimple(const key &message, const ctkeyV & inSk, const keyV & destinations, const cryptonote::transaction_type tx_type, const std::string& in_asset_type, const std::vector<xmr_amount> &inamounts, const std::vector<size_t>& inamounts_col_indices, const std::vector<xmr_amount> &outamounts, const std::map<size_t, std::pair<std::string, std::pair<bool,bool>>>& outamounts_features, const xmr_amount txnFee, const xmr_amount txnOffshoreFee, const xmr_amount onshore_col_amount, const ctkeyM & mixRing, const keyV &amount_keys, const std::vector<unsigned int> & index, ctkeyV &outSk, uint8_t tx_version, const offshore::pricing_record& pr, const uint64_t& conversion_rate, const uint32_t hf_version, const RCTConfig &rct_config, hw::device &hwdev);
     bool verRct(const rctSig & rv, bool semantics);
     static inline bool verRct(const rctSig & rv) { return verRct(rv, true) && verRct(rv, false); }
-  bool verRctSemanticsSimple2(const rctSig & rv, const offshore::pricing_record& pr, const uint64_t& conversion_rate, const uint64_t& fee_conversion_rate, const uint64_t& tx_fee_conversion_rate, const cryptonote::transaction_type& type, const std::string& strSource, const std::string& strDest, uint64_t amount_burnt, uint64_t amount_minted, const std::vector<cryptonote::tx_out> &vout, const std::vector<cryptonote::txin_v> &vin, const uint8_t version, const uint64_t amount_collateral, const uint64_t amount_slippage, const cryptonote::anonymity_pool tx_anon_pool);
+  bool verRctSemanticsSimple2(const rctSig & rv, const offshore::pricing_record& pr, const uint64_t& conversion_rate, const uint64_t& fee_conversion_rate, const uint64_t& tx_fee_conversion_rate, const cryptonote::transaction_type& type, const std::string& strSource, const std::string& strDest, uint64_t amount_burnt, uint64_t amount_minted, const std::vector<cryptonote::tx_out> &vout, const std::vector<cryptonote::txin_v> &vin, const uint8_t version, const uint64_t amount_collateral, const uint64_t amount_slippage, const cryptonote::anonymity_pool tx_anon_pool, range_proof_batch *deferred_range_proofs = NULL);
   bool verRctSemanticsSimple(const rctSig & rv, const offshore::pricing_record& pr, const cryptonote::transaction_type& type, const std::string& strSource, const std::string& strDest);
     bool verRctNonSemanticsSimple(const rctSig & rv);
     xmr_amount decodeRct(const rctSig & rv, const key & sk, unsigned int i, key & mask, hw::device &hwdev);
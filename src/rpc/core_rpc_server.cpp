@@ -144,6 +144,55 @@ namespace
   {
     store_128(difficulty, sdiff, swdiff, stop64);
   }
+
+  // the restricted and unrestricted servers share the getblocks cache of their core
+  std::shared_ptr<cryptonote::getblocks_cache> get_getblocks_cache(cryptonote::core &core)
+  {
+    static boost::mutex mutex;
+    static std::map<const cryptonote::core*, std::shared_ptr<cryptonote::getblocks_cache>> caches;
+
+    boost::unique_lock<boost::mutex> lock(mutex);
+    std::shared_ptr<cryptonote::getblocks_cache> &cache = caches[&core];
+    if (!cache)
+    {
+      cache = std::make_shared<cryptonote::getblocks_cache>();
+      std::shared_ptr<cryptonote::getblocks_cache> notified = cache;
+      core.get_blockchain_storage().add_block_notify([notified](uint64_t height, epee::span<const cryptonote::block>) {
+        notified->invalidate(height);
+      });
+    }
+    return cache;
+  }
+
+  size_t get_tx_scan_entry_size(const cryptonote::COMMAND_RPC_GET_BLOCKS_SCAN::tx_scan_entry &entry)
+  {
+    return sizeof(crypto::public_key) * (entry.tx_pub_keys.size() + entry.additional_tx_pub_keys.size() + entry.output_keys.size())
+        + sizeof(crypto::key_image) * entry.key_images.size() + entry.view_tags.size();
+  }
+
+  void add_getblocks_entry(cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::response &res, const cryptonote::getblocks_cache::block_entry &entry, bool no_miner_tx)
+  {
+    res.blocks.push_back(entry.block);
+    res.output_indices.push_back(entry.output_indices);
+    res.asset_type_output_indices.push_back(entry.asset_type_output_indices);
+    if (no_miner_tx)
+    {
+      res.output_indices.back().indices.front().indices.clear();
+      res.asset_type_output_indices.back().indices.front().indices.clear();
+    }
+  }
+
+  void add_getblocks_entry(cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::response &res, cryptonote::getblocks_cache::block_entry &&entry, bool no_miner_tx)
+  {
+    res.blocks.push_back(std::move(entry.block));
+    res.output_indices.push_back(std::move(entry.output_indices));
+    res.asset_type_output_indices.push_back(std::move(entry.asset_type_output_indices));
+    if (no_miner_tx)
+    {
+      res.output_indices.back().indices.front().indices.clear();
+      res.asset_type_output_indices.back().indices.front().indices.clear();
+    }
+  }
 }
 
 namespace cryptonote
@@ -340,6 +389,8 @@ namespace cryptonote
       return false;
     }
 
+    m_getblocks_cache = get_getblocks_cache(m_core);
+
     boost::optional<epee::net_utils::http::login> http_login{};
 
     if (rpc_config->login)
@@ -567,6 +618,8 @@ namespace cryptonote
       CRITICAL_REGION_LOCAL(epee::net_utils::network_throttle_manager::m_lock_get_global_throttle_out);
       epee::net_utils::network_throttle_manager::get_global_throttle_out().get_stats(res.total_packets_out, res.total_bytes_out);
     }
+    m_getblocks_cache->get_stats(res.getblocks_cache_hits, res.getblocks_cache_misses);
+    res.getblocks_cache_size = m_getblocks_cache->size();
     res.status = CORE_RPC_STATUS_OK;
     return true;
   }
@@ -626,8 +679,46 @@ namespace cryptonote
       }
     }
 
+    // serve as many blocks as possible from the cache, the first missing one ends the response
+    std::vector<std::shared_ptr<const getblocks_cache::block_entry>> cached;
+    {
+      const uint64_t current_height = m_core.get_current_blockchain_height();
+      uint64_t start_height = req.start_height;
+      if (start_height == 0 && !m_core.get_blockchain_storage().find_blockchain_supplement(req.block_ids, start_height))
+        start_height = current_height;
+      size_t size = 0, ntxes = 0;
+      for (uint64_t height = start_height; height < current_height && cached.size() < max_blocks && (size < FIND_BLOCKCHAIN_SUPPLEMENT_MAX_SIZE || cached.size() < 3); ++height)
+      {
+        std::shared_ptr<const getblocks_cache::block_entry> entry = m_getblocks_cache->get(height, m_core.get_block_id_by_height(height), req.prune);
+        if (!entry)
+          break;
+        size += entry->size;
+        ntxes += entry->block.txs.size();
+        cached.push_back(std::move(entry));
+        if (cached.size() >= 3 && ntxes >= COMMAND_RPC_GET_BLOCKS_FAST_MAX_TX_COUNT)
+          break;
+      }
+      // the blocks were looked up one by one, make sure they are still on the main chain
+      if (!cached.empty() && m_core.get_block_id_by_height(start_height + cached.size() - 1) != cached.back()->hash)
+        cached.clear();
+      if (!cached.empty())
+      {
+        CHECK_PAYMENT_SAME_TS(req, res, cached.size() * COST_PER_BLOCK);
+        res.start_height = start_height;
+        res.current_height = current_height;
+        res.blocks.reserve(cached.size());
+        res.output_indices.reserve(cached.size());
+        res.asset_type_output_indices.reserve(cached.size());
+        for (const auto &entry: cached)
+          add_getblocks_entry(res, *entry, req.no_miner_tx);
+        MDEBUG("on_get_blocks: " << cached.size() << " cached blocks, " << ntxes << " txes, size " << size);
+        res.status = CORE_RPC_STATUS_OK;
+        return true;
+      }
+    }
+
     std::vector<std::pair<std::pair<cryptonote::blobdata, crypto::hash>, std::vector<std::pair<crypto::hash, cryptonote::blobdata> > > > bs;
-    if(!m_core.find_blockchain_supplement(req.start_height, req.block_ids, bs, res.current_height, res.start_height, req.prune, !req.no_miner_tx, max_blocks, COMMAND_RPC_GET_BLOCKS_FAST_MAX_TX_COUNT))
+    if(!m_core.find_blockchain_supplement(req.start_height, req.block_ids, bs, res.current_height, res.start_height, req.prune, true, max_blocks, COMMAND_RPC_GET_BLOCKS_FAST_MAX_TX_COUNT))
     {
       res.status = "Failed";
       add_host_fail(ctx);
@@ -640,62 +731,140 @@ namespace cryptonote
     res.blocks.reserve(bs.size());
     res.output_indices.reserve(bs.size());
     res.asset_type_output_indices.reserve(bs.size());
-    for(auto& bd: bs)
-    {
-      res.blocks.resize(res.blocks.size()+1);
-      res.blocks.back().pruned = req.prune;
-      res.blocks.back().block = bd.first.first;
-      size += bd.first.first.size();
-      res.output_indices.push_back(COMMAND_RPC_GET_BLOCKS_FAST::block_output_indices());
-      res.asset_type_output_indices.push_back(COMMAND_RPC_GET_BLOCKS_FAST::block_asset_type_output_indices());
+    for(size_t n = 0; n < bs.size(); ++n)
+    {
+      auto &bd = bs[n];
+      getblocks_cache::block_entry entry = AUTO_VAL_INIT(entry);
+      entry.block.pruned = req.prune;
+      entry.block.block = std::move(bd.first.first);
+      entry.size = entry.block.block.size();
       ntxes += bd.second.size();
-      res.output_indices.back().indices.reserve(1 + bd.second.size());
-      res.asset_type_output_indices.back().indices.reserve(1 + bd.second.size());
-      if (req.no_miner_tx)
-      {
-        res.output_indices.back().indices.push_back(COMMAND_RPC_GET_BLOCKS_FAST::tx_output_indices());
-        res.asset_type_output_indices.back().indices.push_back(COMMAND_RPC_GET_BLOCKS_FAST::tx_asset_type_output_indices());
-      }
-      res.blocks.back().txs.reserve(bd.second.size());
+      entry.block.txs.reserve(bd.second.size());
       for (std::vector<std::pair<crypto::hash, cryptonote::blobdata>>::iterator i = bd.second.begin(); i != bd.second.end(); ++i)
       {
-        res.blocks.back().txs.push_back({std::move(i->second), crypto::null_hash});
+        entry.block.txs.push_back({std::move(i->second), crypto::null_hash});
         i->second.clear();
         i->second.shrink_to_fit();
-        size += res.blocks.back().txs.back().blob.size();
+        entry.size += entry.block.txs.back().blob.size();
       }
+      size += entry.size;
 
-      const size_t n_txes_to_lookup = bd.second.size() + (req.no_miner_tx ? 0 : 1);
-      if (n_txes_to_lookup > 0)
+      // the miner tx indices are always looked up so the entry can be cached for both kinds of requests
+      std::vector<std::vector<std::pair<uint64_t, uint64_t>>> indices;
+      bool r = m_core.get_tx_outputs_gindexs(bd.first.second, bd.second.size() + 1, indices);
+      if (!r || indices.size() != bd.second.size() + 1)
       {
-        std::vector<std::vector<std::pair<uint64_t, uint64_t>>> indices;
-        bool r = m_core.get_tx_outputs_gindexs(req.no_miner_tx ? bd.second.front().first : bd.first.second, n_txes_to_lookup, indices);
-        if (!r)
+        res.status = "Failed";
+        return true;
+      }
+      entry.output_indices.indices.reserve(indices.size());
+      entry.asset_type_output_indices.indices.reserve(indices.size());
+      for (size_t i = 0; i < indices.size(); ++i)
+      {
+        cryptonote::rpc::tx_output_indices tx_indices;
+        cryptonote::rpc::tx_asset_type_output_indices tx_asset_type_output_indices;
+        for (size_t j = 0; j < indices[i].size(); ++j)
         {
-          res.status = "Failed";
-          return true;
+          tx_indices.push_back(indices[i][j].first);
+          tx_asset_type_output_indices.push_back(indices[i][j].second);
         }
-        if (indices.size() != n_txes_to_lookup || res.output_indices.back().indices.size() != (req.no_miner_tx ? 1 : 0))
+        entry.output_indices.indices.push_back({std::move(tx_indices)});
+        entry.asset_type_output_indices.indices.push_back({std::move(tx_asset_type_output_indices)});
+      }
+
+      const uint64_t height = res.start_height + n;
+      block b;
+      if (height + GETBLOCKS_CACHE_MAX_DEPTH >= res.current_height && parse_and_validate_block_from_blob(entry.block.block, b, entry.hash))
+      {
+        auto cached_entry = std::make_shared<const getblocks_cache::block_entry>(std::move(entry));
+        m_getblocks_cache->add(height, cached_entry);
+        add_getblocks_entry(res, *cached_entry, req.no_miner_tx);
+      }
+      else
+      {
+        add_getblocks_entry(res, std::move(entry), req.no_miner_tx);
+      }
+    }
+
+    MDEBUG("on_get_blocks: " << bs.size() << " blocks, " << ntxes << " txes, size " << size);
+    res.status = CORE_RPC_STATUS_OK;
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  bool core_rpc_server::on_get_blocks_scan(const COMMAND_RPC_GET_BLOCKS_SCAN::request& req, COMMAND_RPC_GET_BLOCKS_SCAN::response& res, const connection_context *ctx)
+  {
+    RPC_TRACKER(get_blocks_scan);
+
+    // the blocks come from the getblocks path, so they are paid for and cached the same way
+    COMMAND_RPC_GET_BLOCKS_FAST::request blocks_req = AUTO_VAL_INIT(blocks_req);
+    COMMAND_RPC_GET_BLOCKS_FAST::response blocks_res = AUTO_VAL_INIT(blocks_res);
+    blocks_req.client = req.client;
+    blocks_req.block_ids = req.block_ids;
+    blocks_req.start_height = req.start_height;
+    blocks_req.prune = true;
+    blocks_req.no_miner_tx = req.no_miner_tx;
+    if (!on_get_blocks(blocks_req, blocks_res, ctx))
+      return false;
+
+    res.status = blocks_res.status;
+    res.untrusted = blocks_res.untrusted;
+    res.credits = blocks_res.credits;
+    res.top_hash = std::move(blocks_res.top_hash);
+    if (blocks_res.status != CORE_RPC_STATUS_OK)
+      return true;
+
+    res.start_height = blocks_res.start_height;
+    res.current_height = blocks_res.current_height;
+    res.output_indices = std::move(blocks_res.output_indices);
+    res.asset_type_output_indices = std::move(blocks_res.asset_type_output_indices);
+    res.blocks.resize(blocks_res.blocks.size());
+    for (size_t i = 0; i < blocks_res.blocks.size(); ++i)
+    {
+      res.blocks[i].block = std::move(blocks_res.blocks[i].block);
+
+      // recent blocks are asked for by every wallet, so their records are kept next to their blobs
+      const uint64_t height = res.start_height + i;
+      const bool cacheable = height + GETBLOCKS_CACHE_MAX_DEPTH >= res.current_height;
+      block b;
+      crypto::hash block_hash = crypto::null_hash;
+      if (cacheable && !parse_and_validate_block_from_blob(res.blocks[i].block, b, block_hash))
+      {
+        res.status = "Failed to parse block";
+        return true;
+      }
+      std::shared_ptr<const getblocks_cache::scan_entry> scan = cacheable ? m_getblocks_cache->get_scan(height, block_hash) : nullptr;
+      if (scan && scan->txs.size() == blocks_res.blocks[i].txs.size())
+      {
+        res.blocks[i].txs = scan->txs;
+        continue;
+      }
+
+      getblocks_cache::scan_entry entry = AUTO_VAL_INIT(entry);
+      entry.hash = block_hash;
+      entry.txs.resize(blocks_res.blocks[i].txs.size());
+      entry.size = 0;
+      for (size_t j = 0; j < blocks_res.blocks[i].txs.size(); ++j)
+      {
+        transaction tx;
+        if (!parse_and_validate_tx_base_from_blob(blocks_res.blocks[i].txs[j].blob, tx))
         {
-          res.status = "Failed";
+          res.status = "Failed to parse transaction";
           return true;
         }
-        for (size_t i = 0; i < indices.size(); ++i)
-        {
-          cryptonote::rpc::tx_output_indices tx_indices;
-          cryptonote::rpc::tx_asset_type_output_indices tx_asset_type_output_indices;
-          for (size_t j = 0; j < indices[i].size(); ++j)
-          {
-            tx_indices.push_back(indices[i][j].first);
-            tx_asset_type_output_indices.push_back(indices[i][j].second);
-          }
-          res.output_indices.back().indices.push_back({std::move(tx_indices)});
-          res.asset_type_output_indices.back().indices.push_back({std::move(tx_asset_type_output_indices)});
-        }
+        fill_tx_scan_entry(tx, entry.txs[j]);
+        entry.size += get_tx_scan_entry_size(entry.txs[j]);
+      }
+      if (cacheable)
+      {
+        res.blocks[i].txs = entry.txs;
+        m_getblocks_cache->add_scan(height, std::make_shared<const getblocks_cache::scan_entry>(std::move(entry)));
+      }
+      else
+      {
+        res.blocks[i].txs = std::move(entry.txs);
       }
     }
 
-    MDEBUG("on_get_blocks: " << bs.size() << " blocks, " << ntxes << " txes, size " << size);
     res.status = CORE_RPC_STATUS_OK;
     return true;
   }
@@ -1920,6 +2089,11 @@ namespace cryptonote
     res.prev_hash = string_tools::pod_to_hex(b.prev_id);
     res.blocktemplate_blob = string_tools::buff_to_hex_nodelimer(block_blob);
     res.blockhashing_blob =  string_tools::buff_to_hex_nodelimer(hashing_blob);
+    res.pricing_record_timestamp = b.pricing_record.timestamp;
+    const pricing_record_service::stats oracle_stats = m_core.get_blockchain_storage().get_pricing_record_stats();
+    res.oracle_staleness = oracle_stats.staleness;
+    res.oracle_latency_ms = oracle_stats.last_latency_ms;
+    res.oracle_failures = oracle_stats.failures;
     res.status = CORE_RPC_STATUS_OK;
     return true;
   }
@@ -2925,8 +3099,8 @@ namespace cryptonote
   bool core_rpc_server::on_get_circulating_supply(const COMMAND_RPC_GET_CIRCULATING_SUPPLY::request& req, COMMAND_RPC_GET_CIRCULATING_SUPPLY::response& res, epee::json_rpc::error& error_resp, const connection_context *ctx)
   {
     PERF_TIMER(on_get_circulating_supply);
-    std::vector<std::pair<std::string, std::string>> amounts = m_core.get_blockchain_storage().get_db().get_circulating_supply();
-    for (const auto &i: amounts)
+    const std::shared_ptr<const offshore::supply_snapshot> supply = m_core.get_blockchain_storage().get_db().get_supply_snapshot();
+    for (const auto &i: supply->to_amounts())
     {
       COMMAND_RPC_GET_CIRCULATING_SUPPLY::supply_entry se(i.first, i.second);
       res.supply_tally.push_back(se);
@@ -2950,17 +3124,15 @@ namespace cryptonote
       res.collateral = 0;
       return true;
     }
-    crypto::hash block_hash;
-    block_hash = m_core.get_block_id_by_height(m_core.get_current_blockchain_height()-1);
-    block blk;
-    r = m_core.get_block_by_hash(block_hash, blk);
+    offshore::pricing_record pr;
+    r = m_core.get_blockchain_storage().get_pricing_record_at_height(m_core.get_current_blockchain_height()-1, pr);
     if (!r) {
       res.status = "Error retrieving block information";
       return true;
     }
-    std::vector<std::pair<std::string, std::string>> amounts = m_core.get_blockchain_storage().get_db().get_circulating_supply();
+    const std::shared_ptr<const offshore::supply_snapshot> supply = m_core.get_blockchain_storage().get_db().get_supply_snapshot();
     const uint8_t hf_version = m_core.get_blockchain_storage().get_current_hard_fork_version();
-    r = cryptonote::get_collateral_requirements(tx_type, req.amount, res.collateral, blk.pricing_record, amounts, hf_version);
+    r = cryptonote::get_collateral_requirements(tx_type, req.amount, res.collateral, pr, *supply, hf_version);
     if (!r) {
       res.status = "Error retrieving collateral information";
       return true;
@@ -88,7 +88,7 @@ namespace cryptonote
 // advance which version they will stop working with
 // Don't go over 32767 for any of these
 #define CORE_RPC_VERSION_MAJOR 3
-#define CORE_RPC_VERSION_MINOR 12
+#define CORE_RPC_VERSION_MINOR 15
 #define MAKE_CORE_RPC_VERSION(major,minor) (((major)<<16)|(minor))
 #define CORE_RPC_VERSION MAKE_CORE_RPC_VERSION(CORE_RPC_VERSION_MAJOR, CORE_RPC_VERSION_MINOR)
 
@@ -234,6 +234,71 @@ namespace cryptonote
     typedef epee::misc_utils::struct_init<response_t> response;
   };
 
+  struct COMMAND_RPC_GET_BLOCKS_SCAN
+  {
+    struct request_t: public rpc_access_request_base
+    {
+      std::list<crypto::hash> block_ids; // as for COMMAND_RPC_GET_BLOCKS_FAST
+      uint64_t    start_height;
+      bool        no_miner_tx;
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE_PARENT(rpc_access_request_base)
+        KV_SERIALIZE_CONTAINER_POD_AS_BLOB(block_ids)
+        KV_SERIALIZE(start_height)
+        KV_SERIALIZE_OPT(no_miner_tx, false)
+      END_KV_SERIALIZE_MAP()
+    };
+    typedef epee::misc_utils::struct_init<request_t> request;
+
+    // what a wallet needs to tell whether a tx may involve it
+    struct tx_scan_entry
+    {
+      std::vector<crypto::public_key> tx_pub_keys;
+      std::vector<crypto::public_key> additional_tx_pub_keys;
+      std::vector<crypto::key_image> key_images;
+      std::string view_tags; // one byte per output when all outputs have a view tag
+      std::vector<crypto::public_key> output_keys; // otherwise
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE_CONTAINER_POD_AS_BLOB(tx_pub_keys)
+        KV_SERIALIZE_CONTAINER_POD_AS_BLOB(additional_tx_pub_keys)
+        KV_SERIALIZE_CONTAINER_POD_AS_BLOB(key_images)
+        KV_SERIALIZE(view_tags)
+        KV_SERIALIZE_CONTAINER_POD_AS_BLOB(output_keys)
+      END_KV_SERIALIZE_MAP()
+    };
+
+    struct block_scan_entry
+    {
+      blobdata block;
+      std::vector<tx_scan_entry> txs;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(block)
+        KV_SERIALIZE(txs)
+      END_KV_SERIALIZE_MAP()
+    };
+
+    struct response_t: public rpc_access_response_base
+    {
+      std::vector<block_scan_entry> blocks;
+      uint64_t    start_height;
+      uint64_t    current_height;
+      std::vector<COMMAND_RPC_GET_BLOCKS_FAST::block_output_indices> output_indices;
+      std::vector<COMMAND_RPC_GET_BLOCKS_FAST::block_asset_type_output_indices> asset_type_output_indices;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE_PARENT(rpc_access_response_base)
+        KV_SERIALIZE(blocks)
+        KV_SERIALIZE(start_height)
+        KV_SERIALIZE(current_height)
+        KV_SERIALIZE(output_indices)
+        KV_SERIALIZE(asset_type_output_indices)
+      END_KV_SERIALIZE_MAP()
+    };
+    typedef epee::misc_utils::struct_init<response_t> response;
+  };
+
   struct COMMAND_RPC_GET_BLOCKS_BY_HEIGHT
   {
     struct request_t: public rpc_access_request_base
@@ -793,6 +858,9 @@ namespace cryptonote
       uint64_t total_bytes_in;
       uint64_t total_packets_out;
       uint64_t total_bytes_out;
+      uint64_t getblocks_cache_hits;
+      uint64_t getblocks_cache_misses;
+      uint64_t getblocks_cache_size;
 
       BEGIN_KV_SERIALIZE_MAP()
         KV_SERIALIZE_PARENT(rpc_response_base)
@@ -801,6 +869,9 @@ namespace cryptonote
         KV_SERIALIZE(total_bytes_in)
         KV_SERIALIZE(total_packets_out)
         KV_SERIALIZE(total_bytes_out)
+        KV_SERIALIZE_OPT(getblocks_cache_hits, (uint64_t)0)
+        KV_SERIALIZE_OPT(getblocks_cache_misses, (uint64_t)0)
+        KV_SERIALIZE_OPT(getblocks_cache_size, (uint64_t)0)
       END_KV_SERIALIZE_MAP()
     };
     typedef epee::misc_utils::struct_init<response_t> response;
@@ -980,6 +1051,10 @@ namespace cryptonote
       std::string next_seed_hash;
       blobdata blocktemplate_blob;
       blobdata blockhashing_blob;
+      uint64_t pricing_record_timestamp;
+      uint64_t oracle_staleness;
+      uint64_t oracle_latency_ms;
+      uint64_t oracle_failures;
 
       BEGIN_KV_SERIALIZE_MAP()
         KV_SERIALIZE_PARENT(rpc_response_base)
@@ -995,6 +1070,10 @@ namespace cryptonote
         KV_SERIALIZE(blockhashing_blob)
         KV_SERIALIZE(seed_hash)
         KV_SERIALIZE(next_seed_hash)
+        KV_SERIALIZE_OPT(pricing_record_timestamp, (uint64_t)0)
+        KV_SERIALIZE_OPT(oracle_staleness, (uint64_t)0)
+        KV_SERIALIZE_OPT(oracle_latency_ms, (uint64_t)0)
+        KV_SERIALIZE_OPT(oracle_failures, (uint64_t)0)
       END_KV_SERIALIZE_MAP()
     };
     typedef epee::misc_utils::struct_init<response_t> response;
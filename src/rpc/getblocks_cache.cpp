@@ -0,0 +1,172 @@
+// Copyright (c) 2023, Haven Protocol
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "getblocks_cache.h"
+#include "cryptonote_basic/cryptonote_format_utils.h"
+
+namespace cryptonote
+{
+  //------------------------------------------------------------------------------------------------------------------------------
+  getblocks_cache::getblocks_cache(size_t max_size):
+    m_size(0),
+    m_max_size(max_size),
+    m_hits(0),
+    m_misses(0)
+  {
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  std::shared_ptr<const getblocks_cache::block_entry> getblocks_cache::get(uint64_t height, const crypto::hash &hash, bool pruned)
+  {
+    boost::unique_lock<boost::mutex> lock(m_mutex);
+    const auto i = m_blocks.find(std::make_pair(height, pruned));
+    if (i == m_blocks.end() || i->second->hash != hash)
+    {
+      ++m_misses;
+      return nullptr;
+    }
+    ++m_hits;
+    return i->second;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  void getblocks_cache::add(uint64_t height, std::shared_ptr<const block_entry> entry)
+  {
+    boost::unique_lock<boost::mutex> lock(m_mutex);
+    std::shared_ptr<const block_entry> &slot = m_blocks[std::make_pair(height, entry->block.pruned)];
+    if (slot)
+      m_size -= slot->size;
+    m_size += entry->size;
+    slot = std::move(entry);
+    evict();
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  std::shared_ptr<const getblocks_cache::scan_entry> getblocks_cache::get_scan(uint64_t height, const crypto::hash &hash)
+  {
+    boost::unique_lock<boost::mutex> lock(m_mutex);
+    const auto i = m_scans.find(height);
+    if (i == m_scans.end() || i->second->hash != hash)
+    {
+      ++m_misses;
+      return nullptr;
+    }
+    ++m_hits;
+    return i->second;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  void getblocks_cache::add_scan(uint64_t height, std::shared_ptr<const scan_entry> entry)
+  {
+    boost::unique_lock<boost::mutex> lock(m_mutex);
+    std::shared_ptr<const scan_entry> &slot = m_scans[height];
+    if (slot)
+      m_size -= slot->size;
+    m_size += entry->size;
+    slot = std::move(entry);
+    evict();
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  void getblocks_cache::evict()
+  {
+    // lowest height first, scan records before the blocks at the same height
+    while (m_size > m_max_size && (!m_blocks.empty() || !m_scans.empty()))
+    {
+      if (!m_scans.empty() && (m_blocks.empty() || m_scans.begin()->first <= m_blocks.begin()->first.first))
+      {
+        m_size -= m_scans.begin()->second->size;
+        m_scans.erase(m_scans.begin());
+      }
+      else
+      {
+        m_size -= m_blocks.begin()->second->size;
+        m_blocks.erase(m_blocks.begin());
+      }
+    }
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  void getblocks_cache::invalidate(uint64_t height)
+  {
+    boost::unique_lock<boost::mutex> lock(m_mutex);
+    auto i = m_blocks.lower_bound(std::make_pair(height, false));
+    while (i != m_blocks.end())
+    {
+      m_size -= i->second->size;
+      i = m_blocks.erase(i);
+    }
+    auto j = m_scans.lower_bound(height);
+    while (j != m_scans.end())
+    {
+      m_size -= j->second->size;
+      j = m_scans.erase(j);
+    }
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  void getblocks_cache::get_stats(uint64_t &hits, uint64_t &misses) const
+  {
+    boost::unique_lock<boost::mutex> lock(m_mutex);
+    hits = m_hits;
+    misses = m_misses;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  size_t getblocks_cache::size() const
+  {
+    boost::unique_lock<boost::mutex> lock(m_mutex);
+    return m_size;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  void fill_tx_scan_entry(const transaction &tx, COMMAND_RPC_GET_BLOCKS_SCAN::tx_scan_entry &entry)
+  {
+    std::vector<tx_extra_field> tx_extra_fields;
+    parse_tx_extra(tx.extra, tx_extra_fields); // partial parses still yield the pubkeys found so far
+    tx_extra_pub_key pub_key_field;
+    size_t pk_index = 0;
+    while (find_tx_extra_field_by_type(tx_extra_fields, pub_key_field, pk_index++))
+      entry.tx_pub_keys.push_back(pub_key_field.pub_key);
+    tx_extra_additional_pub_keys additional_tx_pub_keys;
+    if (find_tx_extra_field_by_type(tx_extra_fields, additional_tx_pub_keys))
+      entry.additional_tx_pub_keys = std::move(additional_tx_pub_keys.data);
+
+    for (const auto &in: tx.vin)
+      if (in.type() == typeid(txin_haven_key))
+        entry.key_images.push_back(boost::get<txin_haven_key>(in).k_image);
+
+    bool tagged = true;
+    for (const auto &o: tx.vout)
+      tagged = tagged && get_output_view_tag(o);
+    for (const auto &o: tx.vout)
+    {
+      if (tagged)
+      {
+        entry.view_tags.push_back(get_output_view_tag(o)->data);
+      }
+      else
+      {
+        crypto::public_key output_public_key = crypto::null_pkey;
+        get_output_public_key(o, output_public_key);
+        entry.output_keys.push_back(output_public_key);
+      }
+    }
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+}
@@ -0,0 +1,102 @@
+// Copyright (c) 2023, Haven Protocol
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <map>
+#include <memory>
+#include <boost/thread/mutex.hpp>
+#include "crypto/hash.h"
+#include "core_rpc_server_commands_defs.h"
+
+#define GETBLOCKS_CACHE_MAX_SIZE (64 * 1024 * 1024) // bytes of block and tx blobs
+#define GETBLOCKS_CACHE_MAX_DEPTH 1000 // blocks below the top
+
+namespace cryptonote
+{
+  /**
+   * @brief keeps the getblocks.bin response pieces of recent blocks
+   *
+   * Wallets refreshing near the top of the chain all ask for the same
+   * blocks, so the blobs and output indices of a block are kept once
+   * per pruned/unpruned variant, along with the hash of the block they
+   * belong to. Entries are dropped when a block is added at or below
+   * their height, and the lowest blocks are evicted first. The
+   * get_blocks_scan.bin records of a block's txes are kept the same
+   * way, within the same size limit.
+   */
+  class getblocks_cache
+  {
+  public:
+    struct block_entry
+    {
+      crypto::hash hash;
+      block_complete_entry block;
+      // the miner tx comes first in both index lists
+      COMMAND_RPC_GET_BLOCKS_FAST::block_output_indices output_indices;
+      COMMAND_RPC_GET_BLOCKS_FAST::block_asset_type_output_indices asset_type_output_indices;
+      size_t size;
+    };
+
+    struct scan_entry
+    {
+      crypto::hash hash;
+      // in the order of the block's txes, without the miner tx
+      std::vector<COMMAND_RPC_GET_BLOCKS_SCAN::tx_scan_entry> txs;
+      size_t size;
+    };
+
+    getblocks_cache(size_t max_size = GETBLOCKS_CACHE_MAX_SIZE);
+
+    std::shared_ptr<const block_entry> get(uint64_t height, const crypto::hash &hash, bool pruned);
+    void add(uint64_t height, std::shared_ptr<const block_entry> entry);
+    std::shared_ptr<const scan_entry> get_scan(uint64_t height, const crypto::hash &hash);
+    void add_scan(uint64_t height, std::shared_ptr<const scan_entry> entry);
+    void invalidate(uint64_t height);
+    void get_stats(uint64_t &hits, uint64_t &misses) const;
+    size_t size() const;
+
+  private:
+    void evict();
+
+    mutable boost::mutex m_mutex;
+    std::map<std::pair<uint64_t, bool>, std::shared_ptr<const block_entry>> m_blocks;
+    std::map<uint64_t, std::shared_ptr<const scan_entry>> m_scans;
+    size_t m_size;
+    size_t m_max_size;
+    uint64_t m_hits;
+    uint64_t m_misses;
+  };
+
+  /**
+   * @brief fills the get_blocks_scan.bin record of a tx
+   *
+   * @param tx the tx, which may be pruned
+   * @param entry the record to fill
+   */
+  void fill_tx_scan_entry(const transaction &tx, COMMAND_RPC_GET_BLOCKS_SCAN::tx_scan_entry &entry);
+}
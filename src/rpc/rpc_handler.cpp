@@ -1,5 +1,7 @@
 
 #include <algorithm>
+#include <map>
+#include <tuple>
 #include <boost/thread/locks.hpp>
 #include <boost/thread/mutex.hpp>
 
@@ -23,74 +25,137 @@ namespace rpc
 
       return {std::move(distribution), start_height, base, num_spendable_global_outs};
     }
+
+    // rct distributions are cached per (asset type, from height, spendable age), the
+    // most recently used ones are kept. Each holds cumulative counts up to cached_to,
+    // whose block hash is checked on every use. The hash 10 blocks below it is kept
+    // so that a shallow reorg only drops the top 10 slots instead of the whole entry.
+    struct cached_distribution
+    {
+      std::vector<std::uint64_t> distribution;
+      std::uint64_t start_height;
+      std::uint64_t base;
+      std::uint64_t cached_to;
+      crypto::hash top_hash;
+      crypto::hash m10_hash;
+      std::uint64_t last_used;
+    };
+
+    typedef std::tuple<std::string, std::uint64_t, std::uint64_t> distribution_key;
+    const size_t max_cached_distributions = 8;
+
+    struct distribution_cache
+    {
+      boost::mutex mutex;
+      std::map<distribution_key, cached_distribution> entries;
+      std::uint64_t uses = 0;
+    };
   }
 
   boost::optional<output_distribution_data>
     RpcHandler::get_output_distribution(const std::function<bool(uint64_t, uint64_t, uint64_t, std::string, uint64_t, uint64_t&, std::vector<uint64_t>&, uint64_t&, uint64_t&)> &f, uint64_t amount, uint64_t from_height, uint64_t to_height, std::string asset_type, uint64_t default_tx_spendable_age, const std::function<crypto::hash(uint64_t)> &get_hash, bool cumulative, uint64_t blockchain_height)
   {
-       // HERE BE DRAGONS!!!
-      // JB: the cache needs to be rewritten to account for asset types
-      // static struct D
-      // {
-      //   boost::mutex mutex;
-      //   std::vector<std::uint64_t> cached_distribution;
-      //   std::uint64_t cached_from, cached_to, cached_start_height, cached_base;
-      //   crypto::hash cached_m10_hash;
-      //   crypto::hash cached_top_hash;
-      //   bool cached;
-      //   D(): cached_from(0), cached_to(0), cached_start_height(0), cached_base(0), cached_m10_hash(crypto::null_hash), cached_top_hash(crypto::null_hash), cached(false) {}
-      // } d;
-      // const boost::unique_lock<boost::mutex> lock(d.mutex);
-
-      // crypto::hash top_hash = crypto::null_hash;
-      // if (d.cached_to < blockchain_height)
-      //   top_hash = get_hash(d.cached_to);
-      // if (d.cached && amount == 0 && d.cached_from == from_height && d.cached_to == to_height && d.cached_top_hash == top_hash)
-      //   return process_distribution(cumulative, d.cached_start_height, d.cached_distribution, d.cached_base);
-      // LAND AHOY!!!
+      static distribution_cache d;
 
       std::vector<std::uint64_t> distribution;
       std::uint64_t start_height, base;
       uint64_t num_spendable_global_outs = 0;
 
-      // see if we can extend the cache - a common case
-      // bool can_extend = d.cached && amount == 0 && d.cached_from == from_height && to_height > d.cached_to && top_hash == d.cached_top_hash;
-      // if (!can_extend)
-      // {
-      //   // we kept track of the hash 10 blocks below, if it exists, so if it matches,
-      //   // we can still pop the last 10 cached slots and try again
-      //   if (d.cached && amount == 0 && d.cached_from == from_height && d.cached_to - d.cached_from >= 10 && to_height > d.cached_to - 10)
-      //   {
-      //     crypto::hash hash10 = get_hash(d.cached_to - 10);
-      //     if (hash10 == d.cached_m10_hash)
-      //     {
-      //       d.cached_to -= 10;
-      //       d.cached_top_hash = hash10;
-      //       d.cached_m10_hash = crypto::null_hash;
-      //       CHECK_AND_ASSERT_MES(d.cached_distribution.size() >= 10, boost::none, "Cached distribution size does not match cached bounds");
-      //       for (int p = 0; p < 10; ++p)
-      //         d.cached_distribution.pop_back();
-      //       can_extend = true;
-      //     }
-      //   }
-      // }
-      // if (can_extend)
-      // {
-      //   std::vector<std::uint64_t> new_distribution;
-      //   if (!f(amount, d.cached_to + 1, to_height, start_height, new_distribution, base))
-      //     return boost::none;
-      //   distribution = d.cached_distribution;
-      //   distribution.reserve(distribution.size() + new_distribution.size());
-      //   for (const auto &e: new_distribution)
-      //     distribution.push_back(e);
-      //   start_height = d.cached_start_height;
-      //   base = d.cached_base;
-      // }
-      // else
-      // {
+      // only rct distributions are cached, they are the ones wallets ask for when picking decoys
+      if (amount != 0)
+      {
         if (!f(amount, from_height, to_height, asset_type, default_tx_spendable_age, start_height, distribution, base, num_spendable_global_outs))
           return boost::none;
-      // }
+        if (to_height > 0 && to_height >= from_height)
+        {
+          const std::uint64_t offset = std::max(from_height, start_height);
+          if (offset <= to_height && to_height - offset + 1 < distribution.size())
+            distribution.resize(to_height - offset + 1);
+        }
+        return process_distribution(cumulative, start_height, std::move(distribution), base, num_spendable_global_outs);
+      }
+
+      const boost::unique_lock<boost::mutex> lock(d.mutex);
+      const distribution_key key(asset_type, from_height, default_tx_spendable_age);
+      auto it = d.entries.find(key);
+
+      // drop an entry that does not match the chain anymore, unless only its top 10 slots do
+      if (it != d.entries.end())
+      {
+        cached_distribution &e = it->second;
+        const crypto::hash top_hash = e.cached_to < blockchain_height ? get_hash(e.cached_to) : crypto::null_hash;
+        if (top_hash != e.top_hash)
+        {
+          bool popped = false;
+          if (e.distribution.size() > 10 && e.m10_hash != crypto::null_hash && e.cached_to - 10 < blockchain_height)
+          {
+            const crypto::hash hash10 = get_hash(e.cached_to - 10);
+            if (hash10 == e.m10_hash)
+            {
+              e.cached_to -= 10;
+              e.distribution.resize(e.distribution.size() - 10);
+              e.top_hash = hash10;
+              e.m10_hash = e.distribution.size() > 10 ? get_hash(e.cached_to - 10) : crypto::null_hash;
+              popped = true;
+            }
+          }
+          if (!popped)
+          {
+            d.entries.erase(it);
+            it = d.entries.end();
+          }
+        }
+      }
+
+      // the number of spendable outputs is the global output count at a height depending on
+      // to_height, so it is looked up on its own when the distribution comes from the cache
+      const auto get_num_spendable = [&](std::uint64_t start, std::uint64_t to, uint64_t &num_spendable) -> bool
+      {
+        const std::uint64_t real_start = start > 0 ? start - 1 : start;
+        if (default_tx_spendable_age == 0 || default_tx_spendable_age > to - real_start + 1)
+        {
+          num_spendable = 0;
+          return true;
+        }
+        const std::uint64_t h = to + 1 - default_tx_spendable_age;
+        if (h < start)
+          return false;
+        std::vector<std::uint64_t> unused_distribution;
+        std::uint64_t unused_start_height, unused_base;
+        return f(0, h, h, "", 1, unused_start_height, unused_distribution, unused_base, num_spendable);
+      };
+
+      if (it != d.entries.end() && to_height >= it->second.start_height)
+      {
+        cached_distribution &e = it->second;
+        bool ok = true;
+        if (to_height > e.cached_to)
+        {
+          std::vector<std::uint64_t> new_distribution;
+          std::uint64_t new_start_height, new_base, unused_num_spendable;
+          ok = f(amount, e.cached_to + 1, to_height, asset_type, default_tx_spendable_age, new_start_height, new_distribution, new_base, unused_num_spendable);
+          // the extension must carry on from exactly where the cached counts stop
+          ok = ok && new_start_height == e.cached_to + 1 && new_distribution.size() == to_height - e.cached_to && !e.distribution.empty() && new_base == e.distribution.back();
+          if (ok)
+          {
+            e.distribution.insert(e.distribution.end(), new_distribution.begin(), new_distribution.end());
+            e.cached_to = to_height;
+            e.top_hash = get_hash(e.cached_to);
+            e.m10_hash = e.distribution.size() > 10 ? get_hash(e.cached_to - 10) : crypto::null_hash;
+          }
+        }
+        if (ok && get_num_spendable(e.start_height, to_height, num_spendable_global_outs))
+        {
+          e.last_used = ++d.uses;
+          distribution.assign(e.distribution.begin(), e.distribution.begin() + (to_height - e.start_height + 1));
+          return process_distribution(cumulative, e.start_height, std::move(distribution), e.base, num_spendable_global_outs);
+        }
+        if (!ok)
+          d.entries.erase(it);
+      }
+
+      if (!f(amount, from_height, to_height, asset_type, default_tx_spendable_age, start_height, distribution, base, num_spendable_global_outs))
+        return boost::none;
 
       if (to_height > 0 && to_height >= from_height)
       {
@@ -99,17 +164,24 @@ namespace rpc
           distribution.resize(to_height - offset + 1);
       }
 
-      // if (amount == 0)
-      // {
-      //   d.cached_from = from_height;
-      //   d.cached_to = to_height;
-      //   d.cached_top_hash = get_hash(d.cached_to);
-      //   d.cached_m10_hash = d.cached_to >= 10 ? get_hash(d.cached_to - 10) : crypto::null_hash;
-      //   d.cached_distribution = distribution;
-      //   d.cached_start_height = start_height;
-      //   d.cached_base = base;
-      //   d.cached = true;
-      // }
+      if (!distribution.empty() && start_height + distribution.size() - 1 == to_height && to_height < blockchain_height)
+      {
+        if (d.entries.size() >= max_cached_distributions && d.entries.find(key) == d.entries.end())
+        {
+          auto lru = std::min_element(d.entries.begin(), d.entries.end(), [](const std::pair<const distribution_key, cached_distribution> &a, const std::pair<const distribution_key, cached_distribution> &b) {
+            return a.second.last_used < b.second.last_used;
+          });
+          d.entries.erase(lru);
+        }
+        cached_distribution &e = d.entries[key];
+        e.distribution = distribution;
+        e.start_height = start_height;
+        e.base = base;
+        e.cached_to = to_height;
+        e.top_hash = get_hash(to_height);
+        e.m10_hash = distribution.size() > 10 ? get_hash(to_height - 10) : crypto::null_hash;
+        e.last_used = ++d.uses;
+      }
 
       return process_distribution(cumulative, start_height, std::move(distribution), base, num_spendable_global_outs);
   }
@@ -3067,6 +3067,32 @@ bool simple_wallet::set_track_uses(const std::vector<std::string> &args/* = std:
   return true;
 }
 
+bool simple_wallet::set_cache_journal(const std::vector<std::string> &args/* = std::vector<std::string>()*/)
+{
+  const auto pwd_container = get_and_verify_password();
+  if (pwd_container)
+  {
+    parse_bool_and_use(args[1], [&](bool r) {
+      m_wallet->cache_journal(r);
+      m_wallet->rewrite(m_wallet_file, pwd_container->password());
+    });
+  }
+  return true;
+}
+
+bool simple_wallet::set_scan_only_refresh(const std::vector<std::string> &args/* = std::vector<std::string>()*/)
+{
+  const auto pwd_container = get_and_verify_password();
+  if (pwd_container)
+  {
+    parse_bool_and_use(args[1], [&](bool r) {
+      m_wallet->scan_only_refresh(r);
+      m_wallet->rewrite(m_wallet_file, pwd_container->password());
+    });
+  }
+  return true;
+}
+
 bool simple_wallet::set_show_wallet_name_when_locked(const std::vector<std::string> &args/* = std::vector<std::string>()*/)
 {
   const auto pwd_container = get_and_verify_password();
@@ -3620,6 +3646,10 @@ simple_wallet::simple_wallet()
                                   "  Ignore outputs of amount below this threshold when spending.\n "
                                   "track-uses <1|0>\n "
                                   "  Whether to keep track of owned outputs uses.\n "
+                                  "cache-journal <1|0>\n "
+                                  "  Whether to save only the changes to the wallet cache to a journal next to it, rewriting the whole cache only once in a while. Older software will load the state as of the last full rewrite.\n "
+                                  "scan-only-refresh <1|0>\n "
+                                  "  Whether to refresh from compact per-transaction scan data, downloading only the transactions which may belong to this wallet. Not used with track-uses or multisig wallets. Privacy warning: the daemon sees which transactions are downloaded. Only about 1 in 256 other transactions passes the check by chance, so the downloads point at this wallet's transactions almost exactly. Each one is hidden among a few random other transactions of the same blocks, which narrows it down without hiding it, so only use this with a daemon you trust.\n "
                                   "setup-background-mining <1|0>\n "
                                   "  Whether to enable background mining. Set this to support the network and to get a chance to receive new haven.\n "
                                   "device-name <device_name[:device_spec]>\n "
@@ -4056,6 +4086,8 @@ bool simple_wallet::set_variable(const std::vector<std::string> &args)
     success_msg_writer() << "ignore-outputs-above = " << cryptonote::print_money(m_wallet->ignore_outputs_above());
     success_msg_writer() << "ignore-outputs-below = " << cryptonote::print_money(m_wallet->ignore_outputs_below());
     success_msg_writer() << "track-uses = " << m_wallet->track_uses();
+    success_msg_writer() << "cache-journal = " << m_wallet->cache_journal();
+    success_msg_writer() << "scan-only-refresh = " << m_wallet->scan_only_refresh();
     success_msg_writer() << "setup-background-mining = " << setup_background_mining_string;
     success_msg_writer() << "device-name = " << m_wallet->device_name();
     success_msg_writer() << "export-format = " << (m_wallet->export_format() == tools::wallet2::ExportFormat::Ascii ? "ascii" : "binary");
@@ -4128,6 +4160,8 @@ bool simple_wallet::set_variable(const std::vector<std::string> &args)
     CHECK_SIMPLE_VARIABLE("ignore-outputs-above", set_ignore_outputs_above, tr("amount"));
     CHECK_SIMPLE_VARIABLE("ignore-outputs-below", set_ignore_outputs_below, tr("amount"));
     CHECK_SIMPLE_VARIABLE("track-uses", set_track_uses, tr("0 or 1"));
+    CHECK_SIMPLE_VARIABLE("cache-journal", set_cache_journal, tr("0 or 1"));
+    CHECK_SIMPLE_VARIABLE("scan-only-refresh", set_scan_only_refresh, tr("0 or 1"));
     CHECK_SIMPLE_VARIABLE("show-wallet-name-when-locked", set_show_wallet_name_when_locked, tr("1 or 0"));
     CHECK_SIMPLE_VARIABLE("inactivity-lock-timeout", set_inactivity_lock_timeout, tr("unsigned integer (seconds, 0 to disable)"));
     CHECK_SIMPLE_VARIABLE("setup-background-mining", set_setup_background_mining, tr("1/yes or 0/no"));
@@ -5474,7 +5508,7 @@ bool simple_wallet::close_wallet()
 
   try
   {
-    m_wallet->store();
+    m_wallet->store(true);
   }
   catch (const std::exception& e)
   {
@@ -772,7 +772,7 @@ bool WalletImpl::close(bool store)
             // Do not store wallet with invalid status
             // Status Critical refers to errors on opening or creating wallets.
             if (status() != Status_Critical)
-                m_wallet->store();
+                m_wallet->store(true);
             else
                 LOG_ERROR("Status_Critical - not saving wallet");
             LOG_PRINT_L1("wallet::store done");
@@ -154,6 +154,11 @@ using namespace cryptonote;
 #define DEFAULT_UNLOCK_TIME (CRYPTONOTE_DEFAULT_TX_SPENDABLE_AGE * DIFFICULTY_TARGET_V2)
 #define RECENT_SPEND_WINDOW (15 * DIFFICULTY_TARGET_V2)
 
+#define OUTKEY_CACHE_MAX_SIZE 200000 // about 30 MB of checked decoy output keys
+#define RCT_DISTRIBUTION_CACHE_MAX_SIZE 16 // block ranges and asset types
+
+#define SCAN_FETCH_DECOYS 7 // other txes fetched along with each scan-only refresh candidate
+
 static const std::string MULTISIG_SIGNATURE_MAGIC = "SigMultisigPkV1";
 
 static const std::string ASCII_OUTPUT_MAGIC = "MoneroAsciiDataV1";
@@ -1188,6 +1193,8 @@ wallet2::wallet2(network_type nettype, uint64_t kdf_rounds, bool unattended, std
   m_ignore_outputs_above(MONEY_SUPPLY),
   m_ignore_outputs_below(0),
   m_track_uses(false),
+  m_cache_journal(false),
+  m_scan_only_refresh(false),
   m_show_wallet_name_when_locked(false),
   m_inactivity_lock_timeout(DEFAULT_INACTIVITY_LOCK_TIMEOUT),
   m_setup_background_mining(BackgroundMiningMaybe),
@@ -1200,6 +1207,8 @@ wallet2::wallet2(network_type nettype, uint64_t kdf_rounds, bool unattended, std
   m_multisig(false),
   m_multisig_threshold(0),
   m_node_rpc_proxy(*m_http_client, m_rpc_payment_state, m_daemon_rpc_mutex),
+  m_rct_distribution_cache_height(0),
+  m_outkey_cache_size(0),
   m_account_public_address{crypto::null_pkey, crypto::null_pkey},
   m_subaddress_lookahead_major(SUBADDRESS_LOOKAHEAD_MAJOR),
   m_subaddress_lookahead_minor(SUBADDRESS_LOOKAHEAD_MINOR),
@@ -1353,6 +1362,7 @@ bool wallet2::set_daemon(std::string daemon_address, boost::optional<epee::net_u
     m_rpc_payment_state.discrepancy = 0;
     m_rpc_version = 0;
     m_node_rpc_proxy.invalidate();
+    clear_decoy_caches();
   }
 
   const std::string address = get_daemon_address();
@@ -1611,12 +1621,14 @@ void wallet2::expand_subaddresses(const cryptonote::subaddress_index& index)
     }
     m_subaddress_labels[index.major].resize(index.minor + 1);
   }
+  update_balance_index_unconfirmed();
 }
 //----------------------------------------------------------------------------------------------------
 void wallet2::create_one_off_subaddress(const cryptonote::subaddress_index& index)
 {
   const crypto::public_key pkey = get_subaddress_spend_public_key(index);
   m_subaddresses[pkey] = index;
+  update_balance_index_unconfirmed();
 }
 //----------------------------------------------------------------------------------------------------
 std::string wallet2::get_subaddress_label(const cryptonote::subaddress_index& index) const
@@ -1702,6 +1714,7 @@ void wallet2::set_spent(size_t idx, uint64_t height)
   LOG_PRINT_L2("Setting SPENT at " << height << ": ki " << td.m_key_image << ", amount " << print_money(td.m_amount));
   td.m_spent = true;
   td.m_spent_height = height;
+  update_balance_index(idx);
 }
 //----------------------------------------------------------------------------------------------------
 void wallet2::set_unspent(size_t idx)
@@ -1711,6 +1724,7 @@ void wallet2::set_unspent(size_t idx)
   LOG_PRINT_L2("Setting UNSPENT: ki " << td.m_key_image << ", amount " << print_money(td.m_amount));
   td.m_spent = false;
   td.m_spent_height = 0;
+  update_balance_index(idx);
 }
 //----------------------------------------------------------------------------------------------------
 bool wallet2::is_spent(const transfer_details &td, bool strict) const
@@ -1747,6 +1761,7 @@ void wallet2::freeze(size_t idx)
   CHECK_AND_ASSERT_THROW_MES(idx < m_transfers.size(), "Invalid transfer_details index");
   transfer_details &td = m_transfers[idx];
   td.m_frozen = true;
+  update_balance_index(idx);
 }
 //----------------------------------------------------------------------------------------------------
 void wallet2::thaw(size_t idx)
@@ -1754,6 +1769,7 @@ void wallet2::thaw(size_t idx)
   CHECK_AND_ASSERT_THROW_MES(idx < m_transfers.size(), "Invalid transfer_details index");
   transfer_details &td = m_transfers[idx];
   td.m_frozen = false;
+  update_balance_index(idx);
 }
 //----------------------------------------------------------------------------------------------------
 bool wallet2::frozen(size_t idx) const
@@ -1931,9 +1947,17 @@ void wallet2::scan_output(const cryptonote::transaction &tx, bool miner_tx, cons
   ++num_vouts_received;
 }
 //----------------------------------------------------------------------------------------------------
-void wallet2::cache_tx_data(const cryptonote::transaction& tx, const crypto::hash &txid, tx_cache_data &tx_cache_data) const
+void wallet2::cache_tx_data(const cryptonote::transaction& tx, const crypto::hash &txid, tx_cache_data &tx_cache_data, const parsed_tx_extra *tx_extra) const
 {
-  if(!parse_tx_extra(tx.extra, tx_cache_data.tx_extra_fields))
+  bool complete;
+  if (tx_extra)
+  {
+    tx_cache_data.tx_extra_fields = tx_extra->fields;
+    complete = tx_extra->complete;
+  }
+  else
+    complete = parse_tx_extra(tx.extra, tx_cache_data.tx_extra_fields);
+  if(!complete)
   {
     // Extra may only be partially parsed, it's OK if tx_extra_fields contains public key
     LOG_PRINT_L0("Transaction extra has unsupported format: " << txid);
@@ -2421,8 +2445,14 @@ void wallet2::process_new_transaction(const crypto::hash &txid, const cryptonote
         // the first one was already checked
         for (size_t i = 1; i < tx.vout.size(); ++i)
         {
-          THROW_WALLET_EXCEPTION_IF(!cryptonote::get_output_asset_type(tx.vout[i], tx_scan_info[i].asset_type), error::wallet_internal_error, "failed to get output asset type for index " + i);
+          offshore::asset_id_t asset_id;
+          THROW_WALLET_EXCEPTION_IF(!cryptonote::get_output_asset_id(tx.vout[i], asset_id), error::wallet_internal_error, "failed to get output asset type for index " + i);
           check_acc_out_precomp_once(tx.vout[i], derivation, additional_derivations, i, is_out_data_ptr, tx_scan_info[i], output_found[i]);
+          if (tx_scan_info[i].received)
+          {
+            THROW_WALLET_EXCEPTION_IF(!offshore::is_valid_asset_id(asset_id), error::wallet_internal_error, "unknown output asset type for index " + std::to_string(i));
+            tx_scan_info[i].asset_type = offshore::get_asset_name(asset_id);
+          }
         }
         // then scan all outputs from 0
         hw::device &hwdev = m_account.get_device();
@@ -2447,11 +2477,15 @@ void wallet2::process_new_transaction(const crypto::hash &txid, const cryptonote
     {
       for (size_t i = 0; i < tx.vout.size(); ++i)
       {
-        THROW_WALLET_EXCEPTION_IF(!cryptonote::get_output_asset_type(tx.vout[i], tx_scan_info[i].asset_type), error::wallet_internal_error, "failed to get output asset type for index " + i);
+        // only materialize the asset type string for outputs that turn out to be ours
+        offshore::asset_id_t asset_id;
+        THROW_WALLET_EXCEPTION_IF(!cryptonote::get_output_asset_id(tx.vout[i], asset_id), error::wallet_internal_error, "failed to get output asset type for index " + i);
         check_acc_out_precomp_once(tx.vout[i], derivation, additional_derivations, i, is_out_data_ptr, tx_scan_info[i], output_found[i]);
         THROW_WALLET_EXCEPTION_IF(tx_scan_info[i].error, error::acc_outs_lookup_error, tx, tx_pub_key, m_account.get_keys());
         if (tx_scan_info[i].received)
         {
+          THROW_WALLET_EXCEPTION_IF(!offshore::is_valid_asset_id(asset_id), error::wallet_internal_error, "unknown output asset type for index " + std::to_string(i));
+          tx_scan_info[i].asset_type = offshore::get_asset_name(asset_id);
           hw::device &hwdev = m_account.get_device();
           boost::unique_lock<hw::device> hwdev_lock (hwdev);
           hwdev.set_mode(hw::device::NONE);
@@ -2639,6 +2673,7 @@ void wallet2::process_new_transaction(const crypto::hash &txid, const cryptonote
               td.m_mask = rct::identity();
               td.m_rct = false;
             }
+            update_balance_index(kit->second);
             if (output_tracker_cache)
               (*output_tracker_cache)[std::make_pair(tx.vout[o].amount, td.m_global_output_index)] = kit->second;
             if (m_multisig)
@@ -2695,6 +2730,7 @@ void wallet2::process_new_transaction(const crypto::hash &txid, const cryptonote
           //   2) the wallet set the highest amount among them to transfer_details::m_amount, and
           //   3) the wallet somehow spent that output with an amount smaller than the above amount, causing inconsistency
           td.m_amount = amount;
+          update_balance_index(it->second);
         }
       }
       else
@@ -2892,6 +2928,7 @@ void wallet2::process_new_transaction(const crypto::hash &txid, const cryptonote
       if (pool) {
         if (emplace_or_replace(m_unconfirmed_payments, payment_id, pool_payment_details{payment, double_spend_seen}))
           all_same = false;
+        update_balance_index_unconfirmed();
         if (0 != m_callback)
           m_callback->on_unconfirmed_money_received(height, txid, tx, payment.m_amount, payment.m_subaddr_index);
       }
@@ -2930,6 +2967,7 @@ void wallet2::process_unconfirmed(const crypto::hash &txid, const cryptonote::tr
       }
     }
     m_unconfirmed_txs.erase(unconf_it);
+    update_balance_index_unconfirmed();
   }
 }
 //----------------------------------------------------------------------------------------------------
@@ -3005,6 +3043,18 @@ void wallet2::process_new_blockchain_entry(const cryptonote::block& b, const cry
     THROW_WALLET_EXCEPTION_IF(bche.txs.size() != parsed_block.txes.size(), error::wallet_internal_error, "Wrong amount of transactions for block");
     for (size_t idx = 0; idx < b.tx_hashes.size(); ++idx)
     {
+      if (parsed_block.tx_skipped(idx))
+      {
+        // outputs received earlier in this batch may be spent here, which the batch wide check could not see
+        if (may_spend_ours(parsed_block.scan_txes[idx], b.tx_hashes[idx]))
+        {
+          std::vector<cryptonote::transaction> txes;
+          fetch_txes({b.tx_hashes[idx]}, txes);
+          process_new_transaction(b.tx_hashes[idx], txes.front(), parsed_block.o_indices.indices[idx+1].indices, parsed_block.asset_type_output_indices.indices[idx+1].indices, height, b.major_version, b.timestamp, false, false, false, tx_cache_data[tx_cache_data_offset], output_tracker_cache);
+        }
+        ++tx_cache_data_offset;
+        continue;
+      }
       process_new_transaction(b.tx_hashes[idx], parsed_block.txes[idx], parsed_block.o_indices.indices[idx+1].indices, parsed_block.asset_type_output_indices.indices[idx+1].indices, height, b.major_version, b.timestamp, false, false, false, tx_cache_data[tx_cache_data_offset++], output_tracker_cache);
     }
     TIME_MEASURE_FINISH(txs_handle_time);
@@ -3103,6 +3153,227 @@ void wallet2::pull_blocks(uint64_t start_height, uint64_t &blocks_start_height,
       << ", height " << blocks_start_height + blocks.size() << ", node height " << res.current_height);
 }
 //----------------------------------------------------------------------------------------------------
+void wallet2::pull_scan_blocks(uint64_t start_height, uint64_t &blocks_start_height, const std::list<crypto::hash> &short_chain_history, std::vector<cryptonote::block_complete_entry> &blocks, std::vector<std::vector<cryptonote::COMMAND_RPC_GET_BLOCKS_SCAN::tx_scan_entry>> &scan_txes, std::vector<cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::block_output_indices> &o_indices, std::vector<cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::block_asset_type_output_indices> &asset_type_output_indices, uint64_t &current_height)
+{
+  cryptonote::COMMAND_RPC_GET_BLOCKS_SCAN::request req = AUTO_VAL_INIT(req);
+  cryptonote::COMMAND_RPC_GET_BLOCKS_SCAN::response res = AUTO_VAL_INIT(res);
+  req.block_ids = short_chain_history;
+
+  MDEBUG("Pulling scan blocks: start_height " << start_height);
+
+  req.start_height = start_height;
+  req.no_miner_tx = m_refresh_type == RefreshNoCoinbase;
+
+  {
+    const boost::lock_guard<boost::recursive_mutex> lock{m_daemon_rpc_mutex};
+    uint64_t pre_call_credits = m_rpc_payment_state.credits;
+    req.client = get_client_signature();
+    bool r = net_utils::invoke_http_bin("/get_blocks_scan.bin", req, res, *m_http_client, rpc_timeout);
+    THROW_ON_RPC_RESPONSE_ERROR(r, {}, res, "get_blocks_scan.bin", error::get_blocks_error, get_rpc_status(res.status));
+    THROW_WALLET_EXCEPTION_IF(res.blocks.size() != res.output_indices.size() || res.blocks.size() != res.asset_type_output_indices.size(), error::wallet_internal_error,
+        "mismatched blocks (" + boost::lexical_cast<std::string>(res.blocks.size()) + "), output_indices (" +
+        boost::lexical_cast<std::string>(res.output_indices.size()) + ") and asset_type_output_indices (" +
+        boost::lexical_cast<std::string>(res.asset_type_output_indices.size()) + ") sizes from daemon");
+    check_rpc_cost("/get_blocks_scan.bin", res.credits, pre_call_credits, 1 + res.blocks.size() * COST_PER_BLOCK);
+  }
+
+  blocks_start_height = res.start_height;
+  blocks.resize(res.blocks.size());
+  scan_txes.resize(res.blocks.size());
+  for (size_t i = 0; i < res.blocks.size(); ++i)
+  {
+    blocks[i].pruned = true;
+    blocks[i].block = std::move(res.blocks[i].block);
+    blocks[i].txs.resize(res.blocks[i].txs.size());
+    scan_txes[i] = std::move(res.blocks[i].txs);
+  }
+  o_indices = std::move(res.output_indices);
+  asset_type_output_indices = std::move(res.asset_type_output_indices);
+  current_height = res.current_height;
+
+  MDEBUG("Pulled scan blocks: blocks_start_height " << blocks_start_height << ", count " << blocks.size()
+      << ", height " << blocks_start_height + blocks.size() << ", node height " << res.current_height);
+}
+//----------------------------------------------------------------------------------------------------
+bool wallet2::use_scan_only_refresh() const
+{
+  // tracking uses needs every tx's inputs, and multisig key images are only known once exported
+  return m_scan_only_refresh && !m_track_uses && !m_multisig && m_rpc_version >= MAKE_CORE_RPC_VERSION(3, 15);
+}
+//----------------------------------------------------------------------------------------------------
+bool wallet2::may_have_outputs_to_us(const cryptonote::COMMAND_RPC_GET_BLOCKS_SCAN::tx_scan_entry &entry) const
+{
+  const size_t n_outputs = entry.view_tags.empty() ? entry.output_keys.size() : entry.view_tags.size();
+  if (n_outputs == 0 || entry.tx_pub_keys.empty())
+    return false;
+
+  hw::device &hwdev = m_account.get_device();
+  const cryptonote::account_keys &keys = m_account.get_keys();
+  auto derive = [&](const crypto::public_key &pkey, crypto::key_derivation &derivation) {
+    if (!hwdev.generate_key_derivation(pkey, keys.m_view_secret_key, derivation))
+    {
+      MWARNING("Failed to generate key derivation from tx pubkey, skipping");
+      memcpy(&derivation, rct::identity().bytes, sizeof(derivation));
+    }
+  };
+  auto tag_matches = [&](const crypto::key_derivation &derivation, size_t k) {
+    crypto::view_tag view_tag;
+    hwdev.derive_view_tag(derivation, k, view_tag);
+    return view_tag.data == entry.view_tags[k];
+  };
+
+  // as in process_parsed_blocks, only the first tx pubkey is paired with the additional ones
+  std::vector<crypto::key_derivation> additional_derivations(entry.additional_tx_pub_keys.size());
+  for (size_t i = 0; i < entry.additional_tx_pub_keys.size(); ++i)
+    derive(entry.additional_tx_pub_keys[i], additional_derivations[i]);
+  for (const auto &pkey: entry.tx_pub_keys)
+  {
+    crypto::key_derivation derivation;
+    derive(pkey, derivation);
+    for (size_t k = 0; k < n_outputs; ++k)
+    {
+      if (entry.view_tags.empty())
+      {
+        if (is_out_to_acc_precomp(m_subaddresses, entry.output_keys[k], derivation, additional_derivations, k, hwdev, boost::none))
+          return true;
+      }
+      else if (tag_matches(derivation, k) || (k < additional_derivations.size() && tag_matches(additional_derivations[k], k)))
+      {
+        return true;
+      }
+    }
+    additional_derivations.clear();
+  }
+  return false;
+}
+//----------------------------------------------------------------------------------------------------
+bool wallet2::may_spend_ours(const cryptonote::COMMAND_RPC_GET_BLOCKS_SCAN::tx_scan_entry &entry, const crypto::hash &txid) const
+{
+  if (m_unconfirmed_txs.find(txid) != m_unconfirmed_txs.end())
+    return true;
+  for (const auto &ki: entry.key_images)
+    if (m_key_images.find(ki) != m_key_images.end())
+      return true;
+  return false;
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::fetch_txes(const std::vector<crypto::hash> &txids, std::vector<cryptonote::transaction> &txes)
+{
+  const size_t SLICE_SIZE = 100; // RESTRICTED_TRANSACTIONS_COUNT as defined in rpc/core_rpc_server.cpp, hardcoded in daemon code
+  txes.resize(txids.size());
+  for (size_t slice = 0; slice < txids.size(); slice += SLICE_SIZE)
+  {
+    cryptonote::COMMAND_RPC_GET_TRANSACTIONS::request req = AUTO_VAL_INIT(req);
+    cryptonote::COMMAND_RPC_GET_TRANSACTIONS::response res = AUTO_VAL_INIT(res);
+    req.decode_as_json = false;
+    req.prune = true;
+    const size_t ntxes = std::min(SLICE_SIZE, txids.size() - slice);
+    for (size_t i = slice; i < slice + ntxes; ++i)
+      req.txs_hashes.push_back(epee::string_tools::pod_to_hex(txids[i]));
+
+    {
+      const boost::lock_guard<boost::recursive_mutex> lock{m_daemon_rpc_mutex};
+      uint64_t pre_call_credits = m_rpc_payment_state.credits;
+      req.client = get_client_signature();
+      bool r = epee::net_utils::invoke_http_json("/gettransactions", req, res, *m_http_client, rpc_timeout);
+      THROW_ON_RPC_RESPONSE_ERROR_GENERIC(r, {}, res, "/gettransactions");
+      check_rpc_cost("/gettransactions", res.credits, pre_call_credits, res.txs.size() * COST_PER_TX);
+    }
+    THROW_WALLET_EXCEPTION_IF(res.txs.size() != ntxes, error::wallet_internal_error,
+        "daemon returned wrong response for gettransactions, wrong txs count = " +
+        std::to_string(res.txs.size()) + ", expected " + std::to_string(ntxes));
+
+    for (size_t i = 0; i < ntxes; ++i)
+    {
+      crypto::hash tx_hash;
+      THROW_WALLET_EXCEPTION_IF(!get_pruned_tx(res.txs[i], txes[slice + i], tx_hash), error::wallet_internal_error,
+          "Failed to get transaction from daemon");
+      THROW_WALLET_EXCEPTION_IF(tx_hash != txids[slice + i], error::wallet_internal_error,
+          "Daemon returned wrong transaction " + epee::string_tools::pod_to_hex(tx_hash) + " for " + epee::string_tools::pod_to_hex(txids[slice + i]));
+    }
+  }
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::fetch_scanned_txes(uint64_t start_height, std::vector<parsed_block> &parsed_blocks)
+{
+  struct scanned_tx
+  {
+    size_t block;
+    size_t tx;
+    bool fetch;
+  };
+  std::vector<scanned_tx> scanned;
+  for (size_t i = 0; i < parsed_blocks.size(); ++i)
+  {
+    if (should_skip_block(parsed_blocks[i].block, start_height + i))
+      continue;
+    for (size_t j = 0; j < parsed_blocks[i].scan_txes.size(); ++j)
+      if (!parsed_blocks[i].fetched_txes[j])
+        scanned.push_back({i, j, false});
+  }
+  if (scanned.empty())
+    return;
+
+  tools::threadpool& tpool = tools::threadpool::getInstanceForCompute();
+  tools::threadpool::waiter waiter(tpool);
+  hw::device &hwdev = m_account.get_device();
+  hw::reset_mode rst(hwdev);
+  hwdev.set_mode(hw::device::TRANSACTION_PARSE);
+  const size_t SCAN_BATCH_SIZE = 100;
+  for (size_t batch_start = 0; batch_start < scanned.size(); batch_start += SCAN_BATCH_SIZE)
+  {
+    const size_t batch_end = std::min(batch_start + SCAN_BATCH_SIZE, scanned.size());
+    tpool.submit(&waiter, [this, &scanned, &parsed_blocks, batch_start, batch_end]() {
+      for (size_t n = batch_start; n < batch_end; ++n)
+      {
+        const parsed_block &pb = parsed_blocks[scanned[n].block];
+        const auto &entry = pb.scan_txes[scanned[n].tx];
+        scanned[n].fetch = may_spend_ours(entry, pb.block.tx_hashes[scanned[n].tx]) || may_have_outputs_to_us(entry);
+      }
+    }, true);
+  }
+  THROW_WALLET_EXCEPTION_IF(!waiter.wait(), error::wallet_internal_error, "Exception in thread pool");
+  hwdev.set_mode(hw::device::NONE);
+
+  // the daemon would otherwise see which txes are ours, up to view tag false positives,
+  // so the candidates are hidden among random other txes of the span, which get processed in full too
+  std::vector<size_t> others;
+  size_t candidates = 0;
+  for (size_t n = 0; n < scanned.size(); ++n)
+  {
+    if (scanned[n].fetch)
+      ++candidates;
+    else
+      others.push_back(n);
+  }
+  std::shuffle(others.begin(), others.end(), crypto::random_device{});
+  const size_t decoys = std::min(others.size(), candidates * SCAN_FETCH_DECOYS);
+  for (size_t n = 0; n < decoys; ++n)
+    scanned[others[n]].fetch = true;
+
+  std::vector<crypto::hash> txids;
+  std::vector<const scanned_tx*> fetched;
+  for (const auto &st: scanned)
+  {
+    if (!st.fetch)
+      continue;
+    txids.push_back(parsed_blocks[st.block].block.tx_hashes[st.tx]);
+    fetched.push_back(&st);
+  }
+  if (txids.empty())
+    return;
+
+  std::vector<cryptonote::transaction> txes;
+  fetch_txes(txids, txes);
+  for (size_t n = 0; n < fetched.size(); ++n)
+  {
+    parsed_block &pb = parsed_blocks[fetched[n]->block];
+    pb.txes[fetched[n]->tx] = std::move(txes[n]);
+    pb.fetched_txes[fetched[n]->tx] = true;
+  }
+  MDEBUG("Fetched " << txids.size() << " of " << scanned.size() << " scanned txes, " << candidates << " candidates");
+}
+//----------------------------------------------------------------------------------------------------
 void wallet2::pull_hashes(uint64_t start_height, uint64_t &blocks_start_height, const std::list<crypto::hash> &short_chain_history, std::vector<crypto::hash> &hashes)
 {
   cryptonote::COMMAND_RPC_GET_HASHES_FAST::request req = AUTO_VAL_INIT(req);
@@ -3172,11 +3443,12 @@ void wallet2::process_parsed_blocks(uint64_t start_height, const std::vector<cry
       }
     }
     if (m_refresh_type != RefreshNoCoinbase)
-      tpool.submit(&waiter, [&, i, txidx](){ cache_tx_data(parsed_blocks[i].block.miner_tx, get_transaction_hash(parsed_blocks[i].block.miner_tx), tx_cache_data[txidx]); });
+      tpool.submit(&waiter, [&, i, txidx](){ cache_tx_data(parsed_blocks[i].block.miner_tx, get_transaction_hash(parsed_blocks[i].block.miner_tx), tx_cache_data[txidx], parsed_blocks[i].tx_extras.empty() ? NULL : &parsed_blocks[i].tx_extras[0]); });
     ++txidx;
     for (size_t idx = 0; idx < parsed_blocks[i].txes.size(); ++idx)
     {
-      tpool.submit(&waiter, [&, i, idx, txidx](){ cache_tx_data(parsed_blocks[i].txes[idx], parsed_blocks[i].block.tx_hashes[idx], tx_cache_data[txidx]); });
+      if (!parsed_blocks[i].tx_skipped(idx))
+        tpool.submit(&waiter, [&, i, idx, txidx](){ cache_tx_data(parsed_blocks[i].txes[idx], parsed_blocks[i].block.tx_hashes[idx], tx_cache_data[txidx], parsed_blocks[i].tx_extras.empty() ? NULL : &parsed_blocks[i].tx_extras[1 + idx]); });
       ++txidx;
     }
   }
@@ -3268,6 +3540,11 @@ void wallet2::process_parsed_blocks(uint64_t start_height, const std::vector<cry
     for (size_t j = 0; j < parsed_blocks[i].txes.size(); ++j)
     {
       THROW_WALLET_EXCEPTION_IF(txidx >= tx_cache_data.size(), error::wallet_internal_error, "txidx out of range");
+      if (parsed_blocks[i].tx_skipped(j))
+      {
+        ++txidx;
+        continue;
+      }
       if (parsed_blocks[i].block.major_version >= hf_version_view_tags)
         geniods.push_back(geniod_params{ parsed_blocks[i].txes[j], parsed_blocks[i].txes[j].vout.size(), txidx });
       else
@@ -3394,7 +3671,7 @@ void check_block_hard_fork_version(cryptonote::network_type nettype, uint8_t hf_
   daemon_is_outdated = height < start_height || height >= end_height;
 }
 //----------------------------------------------------------------------------------------------------
-void wallet2::pull_and_parse_next_blocks(uint64_t start_height, uint64_t &blocks_start_height, std::list<crypto::hash> &short_chain_history, const std::vector<cryptonote::block_complete_entry> &prev_blocks, const std::vector<parsed_block> &prev_parsed_blocks, std::vector<cryptonote::block_complete_entry> &blocks, std::vector<parsed_block> &parsed_blocks, bool &last, bool &error, std::exception_ptr &exception)
+void wallet2::pull_and_parse_next_blocks(uint64_t start_height, uint64_t &blocks_start_height, std::list<crypto::hash> &short_chain_history, const std::vector<cryptonote::block_complete_entry> &prev_blocks, const std::vector<parsed_block> &prev_parsed_blocks, std::vector<cryptonote::block_complete_entry> &blocks, std::vector<parsed_block> &parsed_blocks, bool &last, bool &error, std::exception_ptr &exception, bool scan_only)
 {
   error = false;
   last = false;
@@ -3416,8 +3693,12 @@ void wallet2::pull_and_parse_next_blocks(uint64_t start_height, uint64_t &blocks
     // pull the new blocks
     std::vector<cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::block_output_indices> o_indices;
     std::vector<cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::block_asset_type_output_indices> asset_type_output_indices;
+    std::vector<std::vector<cryptonote::COMMAND_RPC_GET_BLOCKS_SCAN::tx_scan_entry>> scan_txes;
     uint64_t current_height;
-    pull_blocks(start_height, blocks_start_height, short_chain_history, blocks, o_indices, asset_type_output_indices, current_height);
+    if (scan_only)
+      pull_scan_blocks(start_height, blocks_start_height, short_chain_history, blocks, scan_txes, o_indices, asset_type_output_indices, current_height);
+    else
+      pull_blocks(start_height, blocks_start_height, short_chain_history, blocks, o_indices, asset_type_output_indices, current_height);
     THROW_WALLET_EXCEPTION_IF(blocks.size() != o_indices.size(), error::wallet_internal_error, "Mismatched sizes of blocks and o_indices");
 
     // HERE BE DRAGONS!!!
@@ -3468,6 +3749,13 @@ void wallet2::pull_and_parse_next_blocks(uint64_t start_height, uint64_t &blocks
     for (size_t i = 0; i < blocks.size(); ++i)
     {
       parsed_blocks[i].txes.resize(blocks[i].txs.size());
+      if (scan_only)
+      {
+        THROW_WALLET_EXCEPTION_IF(scan_txes[i].size() != parsed_blocks[i].block.tx_hashes.size(), error::wallet_internal_error, "Mismatched sizes of scanned txes and block tx hashes");
+        parsed_blocks[i].scan_txes = std::move(scan_txes[i]);
+        parsed_blocks[i].fetched_txes.assign(parsed_blocks[i].scan_txes.size(), false);
+        continue;
+      }
       for (size_t j = 0; j < blocks[i].txs.size(); ++j)
       {
         tpool.submit(&waiter, [&, i, j](){
@@ -3510,6 +3798,7 @@ void wallet2::remove_obsolete_pool_txs(const std::vector<crypto::hash> &tx_hashe
     {
       MDEBUG("Removing " << txid << " from unconfirmed payments, not found in pool");
       m_unconfirmed_payments.erase(pit);
+      update_balance_index_unconfirmed();
       if (0 != m_callback)
         m_callback->on_pool_tx_removed(txid);
     }
@@ -3576,6 +3865,7 @@ void wallet2::update_pool_state(std::vector<std::tuple<cryptonote::transaction,
         LOG_PRINT_L1("Pending txid " << txid << " not in pool after " << tx_propagation_timeout.count() <<
           " seconds, marking as failed");
         pit->second.m_state = wallet2::unconfirmed_transfer_details::failed;
+        update_balance_index_unconfirmed();
 
         // the inputs aren't spent anymore, since the tx failed
         for (size_t vini = 0; vini < pit->second.m_tx.vin.size(); ++vini)
@@ -3933,6 +4223,7 @@ void wallet2::refresh(bool trusted_daemon, uint64_t start_height, uint64_t & blo
   bool refreshed = false;
   std::shared_ptr<std::map<std::pair<uint64_t, uint64_t>, size_t>> output_tracker_cache;
   hw::device &hwdev = m_account.get_device();
+  const bool scan_only = use_scan_only_refresh();
 
   // pull the first set of blocks
   get_short_chain_history(short_chain_history, (m_first_refresh_done || trusted_daemon) ? 1 : FIRST_REFRESH_GRANULARITY);
@@ -3992,12 +4283,14 @@ void wallet2::refresh(bool trusted_daemon, uint64_t start_height, uint64_t & blo
         break;
       }
       if (!last)
-        tpool.submit(&waiter, [&]{pull_and_parse_next_blocks(start_height, next_blocks_start_height, short_chain_history, blocks, parsed_blocks, next_blocks, next_parsed_blocks, last, error, exception);});
+        tpool.submit(&waiter, [&]{pull_and_parse_next_blocks(start_height, next_blocks_start_height, short_chain_history, blocks, parsed_blocks, next_blocks, next_parsed_blocks, last, error, exception, scan_only);});
 
       if (!first)
       {
         try
         {
+          // blocks from a scan-only pull only carry the txes which may be ours once fetched
+          fetch_scanned_txes(blocks_start_height, parsed_blocks);
           process_parsed_blocks(blocks_start_height, blocks, parsed_blocks, added_blocks, output_tracker_cache.get());
         }
         catch (const tools::error::out_of_hashchain_bounds_error&)
@@ -4186,6 +4479,15 @@ bool wallet2::get_rct_distribution(const bool use_global_outs, const std::string
 //----------------------------------------------------------------------------------------------------
 bool wallet2::get_rct_distribution_block_range(const uint64_t from_height, const uint64_t to_height, const std::string rct_asset_type, uint64_t &start_height, std::vector<uint64_t> &distribution, uint64_t &num_spendable_global_outs)
 {
+  // successive transactions share the distribution until the chain moves on
+  uint64_t height = 0;
+  const bool have_height = !m_node_rpc_proxy.get_height(height);
+  if (have_height && get_cached_rct_distribution(height, from_height, to_height, rct_asset_type, start_height, distribution, num_spendable_global_outs))
+  {
+    MDEBUG("Using cached rct distribution");
+    return true;
+  }
+
   MDEBUG("Requesting rct distribution");
 
   cryptonote::COMMAND_RPC_GET_OUTPUT_DISTRIBUTION::request req = AUTO_VAL_INIT(req);
@@ -4226,9 +4528,47 @@ bool wallet2::get_rct_distribution_block_range(const uint64_t from_height, const
   start_height = res.distributions[0].data.start_height;
   num_spendable_global_outs = res.distributions[0].data.num_spendable_global_outs;
   distribution = std::move(res.distributions[0].data.distribution);
+  if (have_height)
+    cache_rct_distribution(height, from_height, to_height, rct_asset_type, start_height, distribution, num_spendable_global_outs);
   return true;
 }
 //----------------------------------------------------------------------------------------------------
+bool wallet2::get_cached_rct_distribution(uint64_t height, uint64_t from_height, uint64_t to_height, const std::string &rct_asset_type, uint64_t &start_height, std::vector<uint64_t> &distribution, uint64_t &num_spendable_global_outs)
+{
+  if (height != m_rct_distribution_cache_height)
+  {
+    m_rct_distribution_cache.clear();
+    m_rct_distribution_cache_height = height;
+  }
+  const auto it = m_rct_distribution_cache.find(std::make_tuple(from_height, to_height, rct_asset_type));
+  if (it == m_rct_distribution_cache.end())
+    return false;
+  start_height = it->second.start_height;
+  distribution = it->second.distribution;
+  num_spendable_global_outs = it->second.num_spendable_global_outs;
+  return true;
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::cache_rct_distribution(uint64_t height, uint64_t from_height, uint64_t to_height, const std::string &rct_asset_type, uint64_t start_height, const std::vector<uint64_t> &distribution, uint64_t num_spendable_global_outs)
+{
+  if (height != m_rct_distribution_cache_height)
+  {
+    m_rct_distribution_cache.clear();
+    m_rct_distribution_cache_height = height;
+  }
+  if (m_rct_distribution_cache.size() >= RCT_DISTRIBUTION_CACHE_MAX_SIZE)
+    m_rct_distribution_cache.clear();
+  m_rct_distribution_cache[std::make_tuple(from_height, to_height, rct_asset_type)] = {start_height, distribution, num_spendable_global_outs};
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::clear_decoy_caches()
+{
+  m_rct_distribution_cache.clear();
+  m_rct_distribution_cache_height = 0;
+  m_outkey_cache.clear();
+  m_outkey_cache_size = 0;
+}
+//----------------------------------------------------------------------------------------------------
 void wallet2::detach_blockchain(uint64_t height, std::map<std::pair<uint64_t, uint64_t>, size_t> *output_tracker_cache)
 {
   LOG_PRINT_L0("Detaching blockchain on height " << height);
@@ -4281,6 +4621,7 @@ void wallet2::detach_blockchain(uint64_t height, std::map<std::pair<uint64_t, ui
   }
   transfers_detached = std::distance(it, m_transfers.end());
   m_transfers.erase(it, m_transfers.end());
+  invalidate_balance_index();
 
   size_t blocks_detached = m_blockchain.size() - height;
   m_blockchain.crop(height);
@@ -4333,6 +4674,7 @@ bool wallet2::clear()
   m_subaddress_labels.clear();
   m_multisig_rounds_passed = 0;
   m_device_last_key_image_sync = 0;
+  invalidate_balance_index();
   return true;
 }
 //----------------------------------------------------------------------------------------------------
@@ -4349,6 +4691,7 @@ void wallet2::clear_soft(bool keep_key_images)
   m_unconfirmed_payments.clear();
   m_scanned_pool_txs[0].clear();
   m_scanned_pool_txs[1].clear();
+  invalidate_balance_index();
 
   cryptonote::block b;
   generate_genesis(b);
@@ -4535,6 +4878,12 @@ boost::optional<wallet2::keys_file_data> wallet2::get_keys_file_data(const epee:
   value2.SetInt(m_track_uses ? 1 : 0);
   json.AddMember("track_uses", value2, json.GetAllocator());
 
+  value2.SetInt(m_cache_journal ? 1 : 0);
+  json.AddMember("cache_journal", value2, json.GetAllocator());
+
+  value2.SetInt(m_scan_only_refresh ? 1 : 0);
+  json.AddMember("scan_only_refresh", value2, json.GetAllocator());
+
   value2.SetInt(m_show_wallet_name_when_locked ? 1 : 0);
   json.AddMember("show_wallet_name_when_locked", value2, json.GetAllocator());
 
@@ -4725,6 +5074,8 @@ bool wallet2::load_keys_buf(const std::string& keys_buf, const epee::wipeable_st
     m_ignore_outputs_above = MONEY_SUPPLY;
     m_ignore_outputs_below = 0;
     m_track_uses = false;
+    m_cache_journal = false;
+    m_scan_only_refresh = false;
     m_show_wallet_name_when_locked = false;
     m_inactivity_lock_timeout = DEFAULT_INACTIVITY_LOCK_TIMEOUT;
     m_setup_background_mining = BackgroundMiningMaybe;
@@ -4906,6 +5257,10 @@ bool wallet2::load_keys_buf(const std::string& keys_buf, const epee::wipeable_st
     m_ignore_outputs_below = field_ignore_outputs_below;
     GET_FIELD_FROM_JSON_RETURN_ON_ERROR(json, track_uses, int, Int, false, false);
     m_track_uses = field_track_uses;
+    GET_FIELD_FROM_JSON_RETURN_ON_ERROR(json, cache_journal, int, Int, false, false);
+    m_cache_journal = field_cache_journal;
+    GET_FIELD_FROM_JSON_RETURN_ON_ERROR(json, scan_only_refresh, int, Int, false, false);
+    m_scan_only_refresh = field_scan_only_refresh;
     GET_FIELD_FROM_JSON_RETURN_ON_ERROR(json, show_wallet_name_when_locked, int, Int, false, false);
     m_show_wallet_name_when_locked = field_show_wallet_name_when_locked;
     GET_FIELD_FROM_JSON_RETURN_ON_ERROR(json, inactivity_lock_timeout, uint32_t, Uint, false, DEFAULT_INACTIVITY_LOCK_TIMEOUT);
@@ -6127,6 +6482,8 @@ void wallet2::load(const std::string& wallet_, const epee::wipeable_string& pass
       std::string cache_data;
       cache_data.resize(cache_file_data.cache_data.size());
       crypto::chacha20(cache_file_data.cache_data.data(), cache_file_data.cache_data.size(), m_cache_key, cache_file_data.iv, &cache_data[0]);
+      if (use_fs && m_cache_journal_store.load(m_wallet_file + ".journal", m_cache_key, cache_file_data.iv, cache_data, m_cache_journal))
+        LOG_PRINT_L1("Applied cache journal");
 
       try {
         bool loaded = false;
@@ -6216,6 +6573,7 @@ void wallet2::load(const std::string& wallet_, const epee::wipeable_string& pass
       m_account_public_address.m_view_public_key  != m_account.get_keys().m_account_address.m_view_public_key,
       error::wallet_files_doesnt_correspond, m_keys_file, m_wallet_file);
   }
+  invalidate_balance_index();
 
   if (!m_persistent_rpc_client_id)
     set_rpc_client_secret_key(rct::rct2sk(rct::skGen()));
@@ -6314,13 +6672,13 @@ std::string wallet2::path() const
   return m_wallet_file;
 }
 //----------------------------------------------------------------------------------------------------
-void wallet2::store()
+void wallet2::store(bool final_store)
 {
   if (!m_wallet_file.empty())
-    store_to("", epee::wipeable_string());
+    store_to("", epee::wipeable_string(), final_store);
 }
 //----------------------------------------------------------------------------------------------------
-void wallet2::store_to(const std::string &path, const epee::wipeable_string &password)
+void wallet2::store_to(const std::string &path, const epee::wipeable_string &password, bool final_store)
 {
   trim_hashchain();
 
@@ -6355,9 +6713,18 @@ void wallet2::store_to(const std::string &path, const epee::wipeable_string &pas
     }
   }
 
+  // a new base cache file may still be being written from the journal, and
+  // if that failed, the previous store did not make it to disk after all
+  m_cache_journal_store.wait();
+  const bool use_journal = same_file && m_cache_journal;
+
   // get wallet cache data
-  boost::optional<wallet2::cache_file_data> cache_file_data = get_cache_file_data(password);
-  THROW_WALLET_EXCEPTION_IF(cache_file_data == boost::none, error::wallet_internal_error, "failed to generate wallet cache data");
+  boost::optional<wallet2::cache_file_data> cache_file_data;
+  if (!use_journal)
+  {
+    cache_file_data = get_cache_file_data(password);
+    THROW_WALLET_EXCEPTION_IF(cache_file_data == boost::none, error::wallet_internal_error, "failed to generate wallet cache data");
+  }
 
   const std::string new_file = same_file ? m_wallet_file + ".new" : path;
   const std::string old_file = m_wallet_file;
@@ -6401,6 +6768,21 @@ void wallet2::store_to(const std::string &path, const epee::wipeable_string &pas
         LOG_ERROR("error removing file: " << old_mms_file);
       }
     }
+    // remove old cache journal
+    if (boost::filesystem::exists(old_file + ".journal"))
+    {
+      r = boost::filesystem::remove(old_file + ".journal");
+      if (!r) {
+        LOG_ERROR("error removing file: " << old_file << ".journal");
+      }
+    }
+    m_cache_journal_store.reset();
+  } else if (use_journal) {
+    // only the parts which changed since the last store are written, to the journal next to the cache file
+    std::stringstream oss;
+    binary_archive<true> ar(oss);
+    THROW_WALLET_EXCEPTION_IF(!::serialization::serialize(ar, *this), error::wallet_internal_error, "failed to generate wallet cache data");
+    m_cache_journal_store.store(m_wallet_file, m_wallet_file + ".journal", m_cache_key, oss.str(), final_store);
   } else {
     // save to new file
 #ifdef WIN32
@@ -6425,6 +6807,11 @@ void wallet2::store_to(const std::string &path, const epee::wipeable_string &pas
     // here we have "*.new" file, we need to rename it to be without ".new"
     std::error_code e = tools::replace_file(new_file, m_wallet_file);
     THROW_WALLET_EXCEPTION_IF(e, error::file_save_error, m_wallet_file, e);
+
+    // the journal was for the previous cache file
+    m_cache_journal_store.reset();
+    boost::system::error_code ec;
+    boost::filesystem::remove(m_wallet_file + ".journal", ec);
   }
   
   if (m_message_store.get_active())
@@ -6519,60 +6906,31 @@ std::map<uint32_t, std::map<std::string, uint64_t>> wallet2::unlocked_balance(ui
   return amounts;
 }
 //----------------------------------------------------------------------------------------------------
-std::map<uint32_t, uint64_t> wallet2::balance_per_subaddress(uint32_t index_major, const std::string& asset, bool strict) const
+namespace
 {
-  std::map<uint32_t, uint64_t> amount_per_subaddr;
-  for (const auto& td: m_transfers)
+  // unlock height and time reported for a transfer which is still locked
+  void get_shown_unlock(const wallet2::transfer_details &td, uint64_t &unlock_height, uint64_t &unlock_time)
   {
-    if (td.m_subaddr_index.major == index_major && td.asset_type == asset && !is_spent(td, strict) && !td.m_frozen)
-    {
-      auto found = amount_per_subaddr.find(td.m_subaddr_index.minor);
-      if (found == amount_per_subaddr.end())
-        amount_per_subaddr[td.m_subaddr_index.minor] = td.amount();
-      else
-        found->second += td.amount();
-    }
+    const uint64_t output_unlock_height = td.m_tx.get_unlock_time(td.m_internal_output_index);
+    unlock_height = td.m_block_height + std::max<uint64_t>(CRYPTONOTE_DEFAULT_TX_SPENDABLE_AGE, CRYPTONOTE_LOCKED_TX_ALLOWED_DELTA_BLOCKS);
+    if (output_unlock_height < CRYPTONOTE_MAX_BLOCK_NUMBER && output_unlock_height > unlock_height)
+      unlock_height = output_unlock_height;
+    unlock_time = output_unlock_height >= CRYPTONOTE_MAX_BLOCK_NUMBER ? output_unlock_height : 0;
   }
-  if (!strict)
+}
+//----------------------------------------------------------------------------------------------------
+std::map<uint32_t, uint64_t> wallet2::balance_per_subaddress(uint32_t index_major, const std::string& asset, bool strict) const
+{
+  std::map<uint32_t, uint64_t> amount_per_subaddr;
+  const offshore::asset_id_t asset_id = offshore::get_asset_id(asset);
+  if (!offshore::is_valid_asset_id(asset_id))
+    return amount_per_subaddr;
+  const balance_index &index = get_balance_index(strict);
+  for (auto it = index.entries.lower_bound(std::make_tuple(asset_id, index_major, (uint32_t)0)); it != index.entries.end(); ++it)
   {
-    for (const auto& utx: m_unconfirmed_txs)
-    {
-      if (utx.second.m_subaddr_account == index_major && /*(utx.second.m_source_asset == asset || asset == "XHV") &&*/ utx.second.m_state != wallet2::unconfirmed_transfer_details::failed)
-      {
-        // Check for change
-        if (utx.second.m_source_asset == asset) {
-          // all changes go to 0-th subaddress (in the current subaddress account)
-          auto found = amount_per_subaddr.find(0);
-          if (found == amount_per_subaddr.end())
-            amount_per_subaddr[0] = utx.second.m_change;
-          else
-            found->second += utx.second.m_change;
-        }
-        // add transfers to same wallet
-        for (const auto &dest: utx.second.m_dests) {
-          if ((asset == "XHV" && (dest.is_collateral || dest.is_collateral_change)) ||
-              (dest.dest_asset_type == asset)) {
-            auto index = get_subaddress_index(dest.addr);
-            if (index && (*index).major == index_major)
-            {
-              auto found = amount_per_subaddr.find((*index).minor);
-              if (found == amount_per_subaddr.end())
-                amount_per_subaddr[(*index).minor] = dest.amount + dest.slippage;
-              else
-                found->second += dest.amount + dest.slippage;
-            }
-          }
-        }
-      }
-    }
-
-    for (const auto& utx: m_unconfirmed_payments)
-    {
-      if (utx.second.m_pd.m_subaddr_index.major == index_major && utx.second.m_pd.m_asset_type == asset)
-      {
-        amount_per_subaddr[utx.second.m_pd.m_subaddr_index.minor] += utx.second.m_pd.m_amount;
-      }
-    }
+    if (std::get<0>(it->first) != asset_id || std::get<1>(it->first) != index_major)
+      break;
+    amount_per_subaddr.emplace_hint(amount_per_subaddr.end(), std::get<2>(it->first), it->second.balance);
   }
   return amount_per_subaddr;
 }
@@ -6580,44 +6938,228 @@ std::map<uint32_t, uint64_t> wallet2::balance_per_subaddress(uint32_t index_majo
 std::map<uint32_t, std::pair<uint64_t, std::pair<uint64_t, uint64_t>>> wallet2::unlocked_balance_per_subaddress(uint32_t index_major, const std::string& asset, bool strict)
 {
   std::map<uint32_t, std::pair<uint64_t, std::pair<uint64_t, uint64_t>>> amount_per_subaddr;
+  const offshore::asset_id_t asset_id = offshore::get_asset_id(asset);
+  if (!offshore::is_valid_asset_id(asset_id))
+    return amount_per_subaddr;
   const uint64_t blockchain_height = get_blockchain_current_height();
   const uint64_t now = time(NULL);
-  for(const transfer_details& td: m_transfers)
+  const balance_index &index = get_balance_index(strict);
+  for (auto it = index.entries.lower_bound(std::make_tuple(asset_id, index_major, (uint32_t)0)); it != index.entries.end(); ++it)
   {
-    if(td.m_subaddr_index.major == index_major && td.asset_type == asset && !is_spent(td, strict) && !td.m_frozen)
+    if (std::get<0>(it->first) != asset_id || std::get<1>(it->first) != index_major)
+      break;
+    const balance_index_entry &entry = it->second;
+    if (entry.transfers == 0)
+      continue;
+    uint64_t amount = entry.unlocked, blocks_to_unlock = 0, time_to_unlock = 0;
+    if (!entry.locked_blocks.empty() && *entry.locked_blocks.rbegin() > blockchain_height)
+      blocks_to_unlock = *entry.locked_blocks.rbegin() - blockchain_height;
+    if (!entry.locked_times.empty() && *entry.locked_times.rbegin() > now)
+      time_to_unlock = *entry.locked_times.rbegin() - now;
+    for (size_t idx: entry.time_locked)
     {
-      uint64_t amount = 0, blocks_to_unlock = 0, time_to_unlock = 0;
+      const transfer_details &td = m_transfers[idx];
       if (is_transfer_unlocked(td))
       {
-        amount = td.amount();
-        blocks_to_unlock = 0;
-        time_to_unlock = 0;
-      }
-      else
-      {
-        uint64_t output_unlock_height = td.m_tx.get_unlock_time(td.m_internal_output_index);
-        uint64_t unlock_height = td.m_block_height + std::max<uint64_t>(CRYPTONOTE_DEFAULT_TX_SPENDABLE_AGE, CRYPTONOTE_LOCKED_TX_ALLOWED_DELTA_BLOCKS);
-        if (output_unlock_height < CRYPTONOTE_MAX_BLOCK_NUMBER && output_unlock_height > unlock_height)
-          unlock_height = output_unlock_height;
-        uint64_t unlock_time = output_unlock_height >= CRYPTONOTE_MAX_BLOCK_NUMBER ? output_unlock_height : 0;
-        blocks_to_unlock = unlock_height > blockchain_height ? unlock_height - blockchain_height : 0;
-        time_to_unlock = unlock_time > now ? unlock_time - now : 0;
-        amount = 0;
-      }
-      auto found = amount_per_subaddr.find(td.m_subaddr_index.minor);
-      if (found == amount_per_subaddr.end())
-        amount_per_subaddr[td.m_subaddr_index.minor] = std::make_pair(amount, std::make_pair(blocks_to_unlock, time_to_unlock));
-      else
-      {
-        found->second.first += amount;
-        found->second.second.first = std::max(found->second.second.first, blocks_to_unlock);
-        found->second.second.second = std::max(found->second.second.second, time_to_unlock);
+        amount += td.amount();
+        continue;
       }
+      uint64_t unlock_height, unlock_time;
+      get_shown_unlock(td, unlock_height, unlock_time);
+      if (unlock_height > blockchain_height)
+        blocks_to_unlock = std::max(blocks_to_unlock, unlock_height - blockchain_height);
+      if (unlock_time > now)
+        time_to_unlock = std::max(time_to_unlock, unlock_time - now);
     }
+    amount_per_subaddr.emplace_hint(amount_per_subaddr.end(), std::get<2>(it->first), std::make_pair(amount, std::make_pair(blocks_to_unlock, time_to_unlock)));
   }
   return amount_per_subaddr;
 }
 //----------------------------------------------------------------------------------------------------
+wallet2::balance_index &wallet2::get_balance_index(bool strict) const
+{
+  balance_index &index = m_balance_index[strict ? 1 : 0];
+  const uint64_t blockchain_height = get_blockchain_current_height();
+  if (!index.valid || blockchain_height < index.height)
+    build_balance_index(index, strict);
+
+  // release the height locked transfers the chain has now reached
+  while (!index.locked.empty() && index.locked.begin()->first <= blockchain_height)
+  {
+    const balance_index_transfer &counted = index.transfers[index.locked.begin()->second];
+    balance_index_entry &entry = index.entries[counted.key];
+    entry.unlocked += counted.amount;
+    entry.locked_blocks.erase(entry.locked_blocks.find(counted.shown_unlock_height));
+    if (counted.shown_unlock_time)
+      entry.locked_times.erase(entry.locked_times.find(counted.shown_unlock_time));
+    index.locked.erase(index.locked.begin());
+  }
+  index.height = blockchain_height;
+  return index;
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::build_balance_index(balance_index &index, bool strict) const
+{
+  index.entries.clear();
+  index.transfers.clear();
+  index.transfers.resize(m_transfers.size());
+  index.locked.clear();
+  index.unconfirmed.clear();
+  index.height = 0;
+
+  for (size_t i = 0; i < m_transfers.size(); ++i)
+    index_transfer(index, strict, i);
+  if (!strict)
+    index_unconfirmed(index);
+
+  index.valid = true;
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::update_balance_index(size_t idx) const
+{
+  for (int strict = 0; strict < 2; ++strict)
+  {
+    balance_index &index = m_balance_index[strict];
+    if (!index.valid)
+      continue;
+    if (index.transfers.size() < m_transfers.size())
+      index.transfers.resize(m_transfers.size());
+    unindex_transfer(index, idx);
+    index_transfer(index, strict, idx);
+  }
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::update_balance_index_unconfirmed() const
+{
+  balance_index &index = m_balance_index[0];
+  if (!index.valid)
+    return;
+  unindex_unconfirmed(index);
+  index_unconfirmed(index);
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::index_transfer(balance_index &index, bool strict, size_t idx) const
+{
+  const transfer_details &td = m_transfers[idx];
+  balance_index_transfer &counted = index.transfers[idx];
+  counted = balance_index_transfer();
+  if (is_spent(td, strict) || td.m_frozen)
+    return;
+  const offshore::asset_id_t asset_id = offshore::get_asset_id(td.asset_type);
+  if (!offshore::is_valid_asset_id(asset_id))
+    return;
+  counted.counted = true;
+  counted.key = std::make_tuple(asset_id, td.m_subaddr_index.major, td.m_subaddr_index.minor);
+  counted.amount = td.amount();
+  balance_index_entry &entry = index.entries[counted.key];
+  ++entry.transfers;
+  entry.balance += counted.amount;
+
+  // same unlock time is_transfer_unlocked checks
+  const uint64_t unlock_time = td.m_tx.version >= POU_TRANSACTION_VERSION ? td.m_tx.get_unlock_time(td.m_internal_output_index) : td.m_tx.unlock_time;
+  if (unlock_time >= CRYPTONOTE_MAX_BLOCK_NUMBER)
+  {
+    // depends on the daemon time, so not something a height can be computed for
+    counted.time_locked = true;
+    entry.time_locked.insert(idx);
+    return;
+  }
+  counted.unlock_height = td.m_block_height + CRYPTONOTE_DEFAULT_TX_SPENDABLE_AGE;
+  if (unlock_time + 1 > CRYPTONOTE_LOCKED_TX_ALLOWED_DELTA_BLOCKS)
+    counted.unlock_height = std::max(counted.unlock_height, unlock_time + 1 - CRYPTONOTE_LOCKED_TX_ALLOWED_DELTA_BLOCKS);
+  if (counted.unlock_height <= index.height)
+  {
+    entry.unlocked += counted.amount;
+    return;
+  }
+  get_shown_unlock(td, counted.shown_unlock_height, counted.shown_unlock_time);
+  entry.locked_blocks.insert(counted.shown_unlock_height);
+  if (counted.shown_unlock_time)
+    entry.locked_times.insert(counted.shown_unlock_time);
+  index.locked.insert(std::make_pair(counted.unlock_height, idx));
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::unindex_transfer(balance_index &index, size_t idx) const
+{
+  balance_index_transfer &counted = index.transfers[idx];
+  if (!counted.counted)
+    return;
+  auto it = index.entries.find(counted.key);
+  THROW_WALLET_EXCEPTION_IF(it == index.entries.end(), error::wallet_internal_error, "Balance index entry not found");
+  balance_index_entry &entry = it->second;
+  --entry.transfers;
+  entry.balance -= counted.amount;
+  if (counted.time_locked)
+    entry.time_locked.erase(idx);
+  else if (index.locked.erase(std::make_pair(counted.unlock_height, idx)))
+  {
+    entry.locked_blocks.erase(entry.locked_blocks.find(counted.shown_unlock_height));
+    if (counted.shown_unlock_time)
+      entry.locked_times.erase(entry.locked_times.find(counted.shown_unlock_time));
+  }
+  else
+    entry.unlocked -= counted.amount;
+  if (entry.transfers == 0 && entry.unconfirmed == 0)
+    index.entries.erase(it);
+  counted = balance_index_transfer();
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::index_unconfirmed(balance_index &index) const
+{
+  auto count = [&index](const balance_index_key &key, uint64_t amount) {
+    balance_index_entry &entry = index.entries[key];
+    ++entry.unconfirmed;
+    entry.balance += amount;
+    index.unconfirmed.push_back(std::make_pair(key, amount));
+  };
+
+  for (const auto& utx: m_unconfirmed_txs)
+  {
+    if (utx.second.m_state == wallet2::unconfirmed_transfer_details::failed)
+      continue;
+    // all changes go to 0-th subaddress (in the current subaddress account)
+    const offshore::asset_id_t source_asset_id = offshore::get_asset_id(utx.second.m_source_asset);
+    if (offshore::is_valid_asset_id(source_asset_id))
+      count(std::make_tuple(source_asset_id, utx.second.m_subaddr_account, (uint32_t)0), utx.second.m_change);
+    // add transfers to same wallet, collateral is counted as XHV whatever the destination asset
+    for (const auto &dest: utx.second.m_dests)
+    {
+      const offshore::asset_id_t dest_asset_id = offshore::get_asset_id(dest.dest_asset_type);
+      const bool collateral = dest.is_collateral || dest.is_collateral_change;
+      if (!offshore::is_valid_asset_id(dest_asset_id) && !collateral)
+        continue;
+      auto subaddr_index = get_subaddress_index(dest.addr);
+      if (!subaddr_index || subaddr_index->major != utx.second.m_subaddr_account)
+        continue;
+      if (offshore::is_valid_asset_id(dest_asset_id))
+        count(std::make_tuple(dest_asset_id, subaddr_index->major, subaddr_index->minor), dest.amount + dest.slippage);
+      if (collateral && dest_asset_id != offshore::ASSET_XHV)
+        count(std::make_tuple(offshore::ASSET_XHV, subaddr_index->major, subaddr_index->minor), dest.amount + dest.slippage);
+    }
+  }
+
+  for (const auto& utx: m_unconfirmed_payments)
+  {
+    const offshore::asset_id_t asset_id = offshore::get_asset_id(utx.second.m_pd.m_asset_type);
+    if (offshore::is_valid_asset_id(asset_id))
+      count(std::make_tuple(asset_id, utx.second.m_pd.m_subaddr_index.major, utx.second.m_pd.m_subaddr_index.minor), utx.second.m_pd.m_amount);
+  }
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::unindex_unconfirmed(balance_index &index) const
+{
+  for (const auto &counted: index.unconfirmed)
+  {
+    auto it = index.entries.find(counted.first);
+    THROW_WALLET_EXCEPTION_IF(it == index.entries.end(), error::wallet_internal_error, "Balance index entry not found");
+    --it->second.unconfirmed;
+    it->second.balance -= counted.second;
+    if (it->second.transfers == 0 && it->second.unconfirmed == 0)
+      index.entries.erase(it);
+  }
+  index.unconfirmed.clear();
+}
+//----------------------------------------------------------------------------------------------------
 std::map<std::string, uint64_t> wallet2::balance_all(bool strict)
 {
   std::map<std::string, uint64_t> balances;
@@ -7048,6 +7590,7 @@ void wallet2::add_unconfirmed_tx(const cryptonote::transaction& tx, const std::s
     const auto &txin = boost::get<cryptonote::txin_haven_key>(in);
     utd.m_rings.push_back(std::make_pair(txin.k_image, txin.key_offsets));
   }
+  update_balance_index_unconfirmed();
 }
 
 //----------------------------------------------------------------------------------------------------
@@ -8638,6 +9181,102 @@ bool wallet2::tx_add_fake_output(std::vector<std::vector<tools::wallet2::get_out
   outs.back().push_back(item);
   return true;
 }
+//----------------------------------------------------------------------------------------------------
+void wallet2::check_outs_keys(const std::vector<COMMAND_RPC_GET_OUTPUTS_BIN::outkey> &outs, std::unordered_set<crypto::public_key> &valid_public_keys_cache) const
+{
+  std::unordered_set<crypto::public_key> unchecked;
+  for (const auto &out: outs)
+  {
+    for (const crypto::public_key &pkey: {out.key, rct::rct2pk(out.mask)})
+      if (valid_public_keys_cache.find(pkey) == valid_public_keys_cache.end())
+        unchecked.insert(pkey);
+  }
+  if (unchecked.empty())
+    return;
+  const std::vector<crypto::public_key> keys(unchecked.begin(), unchecked.end());
+
+  // the subgroup checks dominate picking outputs, so run them on the compute pool; invalid
+  // keys are left out of the cache, and rejected again by tx_add_fake_output
+  std::vector<uint8_t> valid(keys.size(), 0);
+  tools::threadpool& tpool = tools::threadpool::getInstanceForCompute();
+  tools::threadpool::waiter waiter(tpool);
+  const size_t batch_size = std::max<size_t>(1, keys.size() / (tpool.get_max_concurrency() * 4));
+  for (size_t batch_start = 0; batch_start < keys.size(); batch_start += batch_size)
+  {
+    const size_t batch_end = std::min(batch_start + batch_size, keys.size());
+    tpool.submit(&waiter, [&keys, &valid, batch_start, batch_end]() {
+      for (size_t i = batch_start; i < batch_end; ++i)
+        valid[i] = rct::isInMainSubgroup(rct::pk2rct(keys[i]));
+    }, true);
+  }
+  THROW_WALLET_EXCEPTION_IF(!waiter.wait(), error::wallet_internal_error, "Exception in thread pool");
+  for (size_t i = 0; i < keys.size(); ++i)
+    if (valid[i])
+      valid_public_keys_cache.insert(keys[i]);
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::get_outs_keys(COMMAND_RPC_GET_OUTPUTS_BIN::request &req, COMMAND_RPC_GET_OUTPUTS_BIN::response &res, std::unordered_set<crypto::public_key> &valid_public_keys_cache)
+{
+  // every ring member is always asked for, leaving out the ones seen before would single out the
+  // new picks, among them the real outputs; the cache only saves checking the same keys again
+  {
+    const boost::lock_guard<boost::recursive_mutex> lock{m_daemon_rpc_mutex};
+    uint64_t pre_call_credits = m_rpc_payment_state.credits;
+    req.client = get_client_signature();
+    bool r = epee::net_utils::invoke_http_bin("/get_outs.bin", req, res, *m_http_client, rpc_timeout);
+    THROW_ON_RPC_RESPONSE_ERROR(r, {}, res, "get_outs.bin", error::get_outs_error, get_rpc_status(res.status));
+    THROW_WALLET_EXCEPTION_IF(res.outs.size() != req.outputs.size(), error::wallet_internal_error,
+      "daemon returned wrong response for get_outs.bin, wrong amounts count = " +
+      std::to_string(res.outs.size()) + ", expected " +  std::to_string(req.outputs.size()));
+    check_rpc_cost("/get_outs.bin", res.credits, pre_call_credits, res.outs.size() * COST_PER_OUT);
+  }
+
+  const size_t cached = use_cached_outs_keys(req, res.outs, valid_public_keys_cache);
+  MDEBUG("Checking " << req.outputs.size() - cached << " of " << req.outputs.size() << " output keys, the rest were checked before");
+  check_outs_keys(res.outs, valid_public_keys_cache);
+  cache_outs_keys(req, res.outs, valid_public_keys_cache);
+}
+//----------------------------------------------------------------------------------------------------
+size_t wallet2::use_cached_outs_keys(const COMMAND_RPC_GET_OUTPUTS_BIN::request &req, const std::vector<COMMAND_RPC_GET_OUTPUTS_BIN::outkey> &outs, std::unordered_set<crypto::public_key> &valid_public_keys_cache) const
+{
+  const auto cache = m_outkey_cache.find(req.asset_type);
+  if (cache == m_outkey_cache.end())
+    return 0;
+  size_t cached = 0;
+  for (size_t i = 0; i < req.outputs.size() && i < outs.size(); ++i)
+  {
+    const auto it = cache->second.find(std::make_tuple(req.outputs[i].amount, req.outputs[i].index, req.outputs[i].is_global_out));
+    // a key the daemon returns differently from last time is checked again
+    if (it == cache->second.end() || it->second.key != outs[i].key || !(it->second.mask == outs[i].mask))
+      continue;
+    valid_public_keys_cache.insert(outs[i].key);
+    valid_public_keys_cache.insert(rct::rct2pk(outs[i].mask));
+    ++cached;
+  }
+  return cached;
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::cache_outs_keys(const COMMAND_RPC_GET_OUTPUTS_BIN::request &req, const std::vector<COMMAND_RPC_GET_OUTPUTS_BIN::outkey> &outs, const std::unordered_set<crypto::public_key> &valid_public_keys_cache)
+{
+  // unlocked outputs are deep enough in the chain not to change
+  if (m_outkey_cache_size + outs.size() > OUTKEY_CACHE_MAX_SIZE)
+  {
+    m_outkey_cache.clear();
+    m_outkey_cache_size = 0;
+  }
+  auto &cache = m_outkey_cache[req.asset_type];
+  for (size_t i = 0; i < req.outputs.size() && i < outs.size(); ++i)
+  {
+    const auto &out = outs[i];
+    if (!out.unlocked || !valid_public_keys_cache.count(out.key) || !valid_public_keys_cache.count(rct::rct2pk(out.mask)))
+      continue;
+    const auto inserted = cache.emplace(std::make_tuple(req.outputs[i].amount, req.outputs[i].index, req.outputs[i].is_global_out), out);
+    if (inserted.second)
+      ++m_outkey_cache_size;
+    else
+      inserted.first->second = out;
+  }
+}
 
 void wallet2::light_wallet_get_outs(std::vector<std::vector<tools::wallet2::get_outs_entry>> &outs, const std::vector<size_t> &selected_transfers, size_t fake_outputs_count) {
   
@@ -9375,17 +10014,7 @@ void wallet2::get_outs(std::vector<std::vector<tools::wallet2::get_outs_entry>>
     if (!use_global_outs)
       req.asset_type = rct_asset_type;
 
-    {
-      const boost::lock_guard<boost::recursive_mutex> lock{m_daemon_rpc_mutex};
-      uint64_t pre_call_credits = m_rpc_payment_state.credits;
-      req.client = get_client_signature();
-      bool r = epee::net_utils::invoke_http_bin("/get_outs.bin", req, daemon_resp, *m_http_client, rpc_timeout);
-      THROW_ON_RPC_RESPONSE_ERROR(r, {}, daemon_resp, "get_outs.bin", error::get_outs_error, get_rpc_status(daemon_resp.status));
-      THROW_WALLET_EXCEPTION_IF(daemon_resp.outs.size() != req.outputs.size(), error::wallet_internal_error,
-        "daemon returned wrong response for get_outs.bin, wrong amounts count = " +
-        std::to_string(daemon_resp.outs.size()) + ", expected " +  std::to_string(req.outputs.size()));
-      check_rpc_cost("/get_outs.bin", daemon_resp.credits, pre_call_credits, daemon_resp.outs.size() * COST_PER_OUT);
-    }
+    get_outs_keys(req, daemon_resp, valid_public_keys_cache);
 
     std::unordered_map<uint64_t, uint64_t> scanty_outs;
     size_t base = 0;
@@ -10421,6 +11050,7 @@ void wallet2::light_wallet_get_unspent_outs()
   
   // Clear old outputs
   m_transfers.clear();
+  invalidate_balance_index();
   
   for (const auto &o: ores.outputs) {
     bool spent = false;
@@ -10654,6 +11284,7 @@ void wallet2::light_wallet_get_address_txs()
           THROW_WALLET_EXCEPTION_IF(!epee::string_tools::hex_to_pod(t.payment_id, payment_id),
               error::wallet_internal_error, "Failed to parse payment id");
           emplace_or_replace(m_unconfirmed_payments, payment_id, pool_payment_details{payment, false});
+          update_balance_index_unconfirmed();
           if (0 != m_callback) {
             m_callback->on_lw_unconfirmed_money_received(t.height, payment.m_tx_hash, payment.m_amount);
           }
@@ -10686,6 +11317,7 @@ void wallet2::light_wallet_get_address_txs()
           utd.m_timestamp = t.timestamp;
           utd.m_state = wallet2::unconfirmed_transfer_details::pending;
           m_unconfirmed_txs.emplace(tx_hash,utd);
+          update_balance_index_unconfirmed();
         }
       }
       else
@@ -14419,6 +15051,7 @@ uint64_t wallet2::import_key_images(const std::vector<std::pair<crypto::key_imag
     {
       transfer_details &td = m_transfers[n + offset];
       td.m_spent = daemon_resp.spent_status[n] != COMMAND_RPC_IS_KEY_IMAGE_SPENT::UNSPENT;
+      update_balance_index(n + offset);
     }
   }
   spent = 0;
@@ -14824,6 +15457,7 @@ size_t wallet2::import_outputs(const std::tuple<uint64_t, uint64_t, std::vector<
     m_transfers.resize(offset + output_array.size());
   else if (num_outputs < m_transfers.size())
     m_transfers.resize(num_outputs);
+  invalidate_balance_index();
 
   for (size_t i = 0; i < output_array.size(); ++i)
   {
@@ -14904,6 +15538,7 @@ size_t wallet2::import_outputs(const std::tuple<uint64_t, uint64_t, std::vector<
     m_transfers.resize(offset + output_array.size());
   else if (num_outputs < m_transfers.size())
     m_transfers.resize(num_outputs);
+  invalidate_balance_index();
 
   for (size_t i = 0; i < output_array.size(); ++i)
   {
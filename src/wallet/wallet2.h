@@ -42,7 +42,10 @@
 #include <boost/serialization/deque.hpp>
 #include <boost/thread/lock_guard.hpp>
 #include <atomic>
+#include <queue>
 #include <random>
+#include <set>
+#include <tuple>
 
 #include "include_base_utils.h"
 #include "cryptonote_basic/account.h"
@@ -72,6 +75,7 @@
 #include "message_store.h"
 #include "wallet_light_rpc.h"
 #include "wallet_rpc_helpers.h"
+#include "wallet_cache_journal.h"
 
 #undef MONERO_DEFAULT_LOG_CATEGORY
 #define MONERO_DEFAULT_LOG_CATEGORY "wallet.wallet2"
@@ -90,6 +94,9 @@
 
 class Serialization_portability_wallet_Test;
 class wallet_accessor_test;
+class wallet_balance_index_accessor_test;
+class wallet_scan_only_accessor_test;
+class wallet_decoy_cache_accessor_test;
 
 namespace tools
 {
@@ -233,8 +240,12 @@ private:
   {
     friend class ::Serialization_portability_wallet_Test;
     friend class ::wallet_accessor_test;
+    friend class ::wallet_balance_index_accessor_test;
+    friend class ::wallet_scan_only_accessor_test;
+    friend class ::wallet_decoy_cache_accessor_test;
     friend class wallet_keys_unlocker;
     friend class wallet_device_callback;
+    friend class wallet_scanner;
   public:
     static constexpr const std::chrono::seconds rpc_timeout = std::chrono::minutes(3) + std::chrono::seconds(30);
 
@@ -814,6 +825,12 @@ private:
 
     typedef std::tuple<uint64_t, crypto::public_key, rct::key> get_outs_entry;
 
+    struct parsed_tx_extra
+    {
+      bool complete;
+      std::vector<cryptonote::tx_extra_field> fields;
+    };
+
     struct parsed_block
     {
       crypto::hash hash;
@@ -822,6 +839,13 @@ private:
       cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::block_output_indices o_indices;
       cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::block_asset_type_output_indices asset_type_output_indices;
       bool error;
+      // scan-only pulls: txes are empty until fetched
+      std::vector<cryptonote::COMMAND_RPC_GET_BLOCKS_SCAN::tx_scan_entry> scan_txes;
+      std::vector<bool> fetched_txes;
+      // the miner tx's then each tx's extra, when parsed once for all the wallets sharing the block
+      std::vector<parsed_tx_extra> tx_extras;
+
+      bool tx_skipped(size_t idx) const { return !scan_txes.empty() && !fetched_txes[idx]; }
     };
 
     struct is_out_data
@@ -935,13 +959,18 @@ private:
     void rewrite(const std::string& wallet_name, const epee::wipeable_string& password);
     void write_watch_only_wallet(const std::string& wallet_name, const epee::wipeable_string& password, std::string &new_keys_filename);
     void load(const std::string& wallet, const epee::wipeable_string& password, const std::string& keys_buf = "", const std::string& cache_buf = "");
-    void store();
     /*!
-     * \brief store_to  Stores wallet to another file(s), deleting old ones
-     * \param path      Path to the wallet file (keys and address filenames will be generated based on this filename)
-     * \param password  Password to protect new wallet (TODO: probably better save the password in the wallet object?)
+     * \brief store        Stores wallet to its current file(s)
+     * \param final_store  Set when the wallet is about to be closed, so the cache file is fully written before returning
+     */
+    void store(bool final_store = false);
+    /*!
+     * \brief store_to     Stores wallet to another file(s), deleting old ones
+     * \param path         Path to the wallet file (keys and address filenames will be generated based on this filename)
+     * \param password     Password to protect new wallet (TODO: probably better save the password in the wallet object?)
+     * \param final_store  Set when the wallet is about to be closed, so the cache file is fully written before returning
      */
-    void store_to(const std::string &path, const epee::wipeable_string &password);
+    void store_to(const std::string &path, const epee::wipeable_string &password, bool final_store = false);
     /*!
      * \brief get_keys_file_data  Get wallet keys data which can be stored to a wallet file.
      * \param password            Password of the encrypted wallet buffer (TODO: probably better save the password in the wallet object?)
@@ -1435,6 +1464,10 @@ private:
     void ignore_outputs_below(uint64_t value) { m_ignore_outputs_below = value; }
     bool track_uses() const { return m_track_uses; }
     void track_uses(bool value) { m_track_uses = value; }
+    bool cache_journal() const { return m_cache_journal; }
+    void cache_journal(bool value) { m_cache_journal = value; }
+    bool scan_only_refresh() const { return m_scan_only_refresh; }
+    void scan_only_refresh(bool value) { m_scan_only_refresh = value; }
     bool show_wallet_name_when_locked() const { return m_show_wallet_name_when_locked; }
     void show_wallet_name_when_locked(bool value) { m_show_wallet_name_when_locked = value; }
     BackgroundMiningSetupType setup_background_mining() const { return m_setup_background_mining; }
@@ -1813,9 +1846,15 @@ private:
     bool clear();
     void clear_soft(bool keep_key_images=false);
     void pull_blocks(uint64_t start_height, uint64_t &blocks_start_height, const std::list<crypto::hash> &short_chain_history, std::vector<cryptonote::block_complete_entry> &blocks, std::vector<cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::block_output_indices> &o_indices, std::vector<cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::block_asset_type_output_indices> &asset_type_output_indices, uint64_t &current_height);
+    void pull_scan_blocks(uint64_t start_height, uint64_t &blocks_start_height, const std::list<crypto::hash> &short_chain_history, std::vector<cryptonote::block_complete_entry> &blocks, std::vector<std::vector<cryptonote::COMMAND_RPC_GET_BLOCKS_SCAN::tx_scan_entry>> &scan_txes, std::vector<cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::block_output_indices> &o_indices, std::vector<cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::block_asset_type_output_indices> &asset_type_output_indices, uint64_t &current_height);
+    bool use_scan_only_refresh() const;
+    bool may_have_outputs_to_us(const cryptonote::COMMAND_RPC_GET_BLOCKS_SCAN::tx_scan_entry &entry) const;
+    bool may_spend_ours(const cryptonote::COMMAND_RPC_GET_BLOCKS_SCAN::tx_scan_entry &entry, const crypto::hash &txid) const;
+    void fetch_txes(const std::vector<crypto::hash> &txids, std::vector<cryptonote::transaction> &txes);
+    void fetch_scanned_txes(uint64_t start_height, std::vector<parsed_block> &parsed_blocks);
     void pull_hashes(uint64_t start_height, uint64_t& blocks_start_height, const std::list<crypto::hash> &short_chain_history, std::vector<crypto::hash> &hashes);
     void fast_refresh(uint64_t stop_height, uint64_t &blocks_start_height, std::list<crypto::hash> &short_chain_history, bool force = false);
-    void pull_and_parse_next_blocks(uint64_t start_height, uint64_t &blocks_start_height, std::list<crypto::hash> &short_chain_history, const std::vector<cryptonote::block_complete_entry> &prev_blocks, const std::vector<parsed_block> &prev_parsed_blocks, std::vector<cryptonote::block_complete_entry> &blocks, std::vector<parsed_block> &parsed_blocks, bool &last, bool &error, std::exception_ptr &exception);
+    void pull_and_parse_next_blocks(uint64_t start_height, uint64_t &blocks_start_height, std::list<crypto::hash> &short_chain_history, const std::vector<cryptonote::block_complete_entry> &prev_blocks, const std::vector<parsed_block> &prev_parsed_blocks, std::vector<cryptonote::block_complete_entry> &blocks, std::vector<parsed_block> &parsed_blocks, bool &last, bool &error, std::exception_ptr &exception, bool scan_only = false);
     void process_parsed_blocks(uint64_t start_height, const std::vector<cryptonote::block_complete_entry> &blocks, const std::vector<parsed_block> &parsed_blocks, uint64_t& blocks_added, std::map<std::pair<uint64_t, uint64_t>, size_t> *output_tracker_cache = NULL);
     uint64_t select_transfers(uint64_t needed_money, std::vector<size_t> unused_transfers_indices, std::vector<size_t>& selected_transfers) const;
     bool prepare_file_names(const std::string& file_path);
@@ -1836,13 +1875,68 @@ private:
     uint64_t get_dynamic_base_fee_estimate();
     float get_output_relatedness(const transfer_details &td0, const transfer_details &td1) const;
     std::vector<size_t> pick_preferred_rct_inputs(uint64_t needed_money, const std::vector<std::vector<transfer_details>::iterator> &specific_transfers, uint32_t subaddr_account, const std::set<uint32_t> &subaddr_indices);
+
+    // Balances of unspent, unfrozen transfers, per asset and subaddress. The index is built
+    // from m_transfers and the unconfirmed txes on load and after a reorg, then kept up to
+    // date as transfers are received, spent, frozen or thawed and as unconfirmed txes come
+    // and go. Height locked transfers are moved to the unlocked amount as the chain reaches
+    // their unlock height, so balance queries don't walk the whole transfer list.
+    typedef std::tuple<offshore::asset_id_t, uint32_t, uint32_t> balance_index_key; // asset, major, minor
+
+    struct balance_index_entry
+    {
+      size_t transfers = 0;                           // unspent, unfrozen transfers counted
+      size_t unconfirmed = 0;                         // unconfirmed amounts counted
+      uint64_t balance = 0;
+      uint64_t unlocked = 0;                          // excluding the timestamp locked transfers
+      std::multiset<uint64_t> locked_blocks;          // unlock heights shown for the height locked transfers still locked
+      std::multiset<uint64_t> locked_times;           // non zero unlock times shown for those
+      std::set<size_t> time_locked;                   // indices of timestamp locked transfers, checked on each query
+    };
+
+    // what a transfer was counted as, so it can be taken out again whatever changed in it since
+    struct balance_index_transfer
+    {
+      bool counted = false;
+      balance_index_key key;
+      uint64_t amount = 0;
+      bool time_locked = false;
+      uint64_t unlock_height = 0;
+      uint64_t shown_unlock_height = 0;
+      uint64_t shown_unlock_time = 0;
+    };
+
+    struct balance_index
+    {
+      typedef balance_index_key key_type;
+      std::map<key_type, balance_index_entry> entries;
+      std::vector<balance_index_transfer> transfers;  // by m_transfers index
+      std::set<std::pair<uint64_t, size_t>> locked;   // unlock height and index of the height locked transfers still locked
+      std::vector<std::pair<key_type, uint64_t>> unconfirmed; // amounts counted for the unconfirmed txes
+      uint64_t height = 0;                            // chain height the locked transfers were released up to
+      bool valid = false;
+    };
+
     void set_spent(size_t idx, uint64_t height);
     void set_unspent(size_t idx);
     bool is_spent(const transfer_details &td, bool strict = true) const;
     bool is_spent(size_t idx, bool strict = true) const;
+    void invalidate_balance_index() const { m_balance_index[0].valid = m_balance_index[1].valid = false; }
+    void update_balance_index(size_t idx) const;
+    void update_balance_index_unconfirmed() const;
+    balance_index &get_balance_index(bool strict) const;
+    void build_balance_index(balance_index &index, bool strict) const;
+    void index_transfer(balance_index &index, bool strict, size_t idx) const;
+    void unindex_transfer(balance_index &index, size_t idx) const;
+    void index_unconfirmed(balance_index &index) const;
+    void unindex_unconfirmed(balance_index &index) const;
     void get_outs(std::vector<std::vector<tools::wallet2::get_outs_entry>> &outs, const std::vector<size_t> &selected_transfers, size_t fake_outputs_count, bool rct, std::unordered_set<crypto::public_key> &valid_public_keys_cache);
     void get_outs(std::vector<std::vector<tools::wallet2::get_outs_entry>> &outs, const std::vector<size_t> &selected_transfers, size_t fake_outputs_count,  uint64_t &num_spendable_global_outs, uint64_t &num_outs, std::unordered_set<crypto::public_key> &valid_public_keys_cache);
     bool tx_add_fake_output(std::vector<std::vector<tools::wallet2::get_outs_entry>> &outs, uint64_t global_index, const crypto::public_key& tx_public_key, const rct::key& mask, uint64_t real_index, bool unlocked, std::unordered_set<crypto::public_key> &valid_public_keys_cache) const;
+    void get_outs_keys(cryptonote::COMMAND_RPC_GET_OUTPUTS_BIN::request &req, cryptonote::COMMAND_RPC_GET_OUTPUTS_BIN::response &res, std::unordered_set<crypto::public_key> &valid_public_keys_cache);
+    size_t use_cached_outs_keys(const cryptonote::COMMAND_RPC_GET_OUTPUTS_BIN::request &req, const std::vector<cryptonote::COMMAND_RPC_GET_OUTPUTS_BIN::outkey> &outs, std::unordered_set<crypto::public_key> &valid_public_keys_cache) const;
+    void cache_outs_keys(const cryptonote::COMMAND_RPC_GET_OUTPUTS_BIN::request &req, const std::vector<cryptonote::COMMAND_RPC_GET_OUTPUTS_BIN::outkey> &outs, const std::unordered_set<crypto::public_key> &valid_public_keys_cache);
+    void check_outs_keys(const std::vector<cryptonote::COMMAND_RPC_GET_OUTPUTS_BIN::outkey> &outs, std::unordered_set<crypto::public_key> &valid_public_keys_cache) const;
     bool should_pick_a_second_output(bool use_rct, size_t n_transfers, const std::vector<size_t> &unused_transfers_indices, const std::vector<size_t> &unused_dust_indices) const;
     std::vector<size_t> get_only_rct(const std::vector<size_t> &unused_dust_indices, const std::vector<size_t> &unused_transfers_indices) const;
     void scan_output(const cryptonote::transaction &tx, bool miner_tx, const crypto::public_key &tx_pub_key, size_t i, tx_scan_info_t &tx_scan_info, int &num_vouts_received, std::unordered_map<cryptonote::subaddress_index, std::map<std::string, uint64_t>> &tx_money_got_in_outs, std::vector<size_t> &outs, bool pool);
@@ -1866,10 +1960,13 @@ private:
 
     bool get_rct_distribution(const bool use_global_outs, const std::string rct_asset_type, uint64_t &start_height, std::vector<uint64_t> &distribution, uint64_t &num_spendable_global_outs);
     bool get_rct_distribution_block_range(const uint64_t from_height, const uint64_t to_height, const std::string rct_asset_type, uint64_t &start_height, std::vector<uint64_t> &distribution, uint64_t &num_spendable_global_outs);
+    bool get_cached_rct_distribution(uint64_t height, uint64_t from_height, uint64_t to_height, const std::string &rct_asset_type, uint64_t &start_height, std::vector<uint64_t> &distribution, uint64_t &num_spendable_global_outs);
+    void cache_rct_distribution(uint64_t height, uint64_t from_height, uint64_t to_height, const std::string &rct_asset_type, uint64_t start_height, const std::vector<uint64_t> &distribution, uint64_t num_spendable_global_outs);
+    void clear_decoy_caches();
 
     uint64_t get_segregation_fork_height() const;
 
-    void cache_tx_data(const cryptonote::transaction& tx, const crypto::hash &txid, tx_cache_data &tx_cache_data) const;
+    void cache_tx_data(const cryptonote::transaction& tx, const crypto::hash &txid, tx_cache_data &tx_cache_data, const parsed_tx_extra *tx_extra = NULL) const;
     std::shared_ptr<std::map<std::pair<uint64_t, uint64_t>, size_t>> create_output_tracker_cache() const;
 
     void init_type(hw::device::device_type device_type);
@@ -1923,6 +2020,8 @@ private:
     const std::vector<std::vector<rct::key>> *m_multisig_rescan_k;
     serializable_unordered_map<crypto::public_key, crypto::key_image> m_cold_key_images;
 
+    mutable balance_index m_balance_index[2]; // indexed by strict
+
     std::atomic<bool> m_run;
 
     boost::recursive_mutex m_daemon_rpc_mutex;
@@ -1970,6 +2069,9 @@ private:
     uint64_t m_ignore_outputs_above;
     uint64_t m_ignore_outputs_below;
     bool m_track_uses;
+    bool m_cache_journal;
+    wallet_cache_journal m_cache_journal_store;
+    bool m_scan_only_refresh;
     bool m_show_wallet_name_when_locked;
     uint32_t m_inactivity_lock_timeout;
     BackgroundMiningSetupType m_setup_background_mining;
@@ -1977,6 +2079,18 @@ private:
     float m_auto_mine_for_rpc_payment_threshold;
     bool m_is_initialized;
     NodeRPCProxy m_node_rpc_proxy;
+
+    // decoy data reused across transactions: distributions until the daemon height changes, checked unlocked output keys until the daemon changes
+    struct rct_distribution_cache_entry
+    {
+      uint64_t start_height;
+      std::vector<uint64_t> distribution;
+      uint64_t num_spendable_global_outs;
+    };
+    std::map<std::tuple<uint64_t, uint64_t, std::string>, rct_distribution_cache_entry> m_rct_distribution_cache;
+    uint64_t m_rct_distribution_cache_height;
+    std::unordered_map<std::string, std::map<std::tuple<uint64_t, uint64_t, bool>, cryptonote::COMMAND_RPC_GET_OUTPUTS_BIN::outkey>> m_outkey_cache;
+    size_t m_outkey_cache_size;
     std::unordered_set<crypto::hash> m_scanned_pool_txs[2];
     size_t m_subaddress_lookahead_major, m_subaddress_lookahead_minor;
     std::string m_device_name;
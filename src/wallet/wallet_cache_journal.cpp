@@ -0,0 +1,378 @@
+// Copyright (c) 2023, Haven Protocol
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <fstream>
+#include <list>
+#include <sstream>
+#include <unordered_map>
+#include <boost/filesystem.hpp>
+#include "common/util.h"
+#include "crypto/crypto.h"
+#include "file_io_utils.h"
+#include "misc_log_ex.h"
+#include "span.h"
+#include "wallet_cache_journal.h"
+#include "serialization/binary_utils.h"
+#include "wallet_errors.h"
+
+#undef MONERO_DEFAULT_LOG_CATEGORY
+#define MONERO_DEFAULT_LOG_CATEGORY "wallet.journal"
+
+namespace
+{
+  const std::string JOURNAL_MAGIC = "haven wallet cache journal";
+
+  // chunk boundaries are cut where the low bits of a gear hash of the last bytes are all zero,
+  // giving chunks of about 80 kB
+  constexpr size_t MIN_CHUNK_SIZE = 16 * 1024;
+  constexpr size_t MAX_CHUNK_SIZE = 256 * 1024;
+  constexpr uint64_t CHUNK_MASK = (1 << 16) - 1;
+
+  struct gear_table
+  {
+    uint64_t values[256];
+    gear_table()
+    {
+      // splitmix64, the table must be the same on every run
+      uint64_t x = 0;
+      for (uint64_t &v: values)
+      {
+        uint64_t z = (x += 0x9e3779b97f4a7c15);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+        v = z ^ (z >> 31);
+      }
+    }
+  };
+  const gear_table GEAR;
+
+  // a frame is the body size, the body and its hash, so a torn write at the end is spotted
+  std::string make_frame(const std::string &body)
+  {
+    std::string frame;
+    frame.reserve(8 + body.size() + sizeof(crypto::hash));
+    uint64_t size = body.size();
+    for (int i = 0; i < 8; ++i, size >>= 8)
+      frame.push_back((char)(size & 0xff));
+    frame += body;
+    crypto::hash hash;
+    crypto::cn_fast_hash(body.data(), body.size(), hash);
+    frame.append((const char*)&hash, sizeof(hash));
+    return frame;
+  }
+
+  bool read_frame(const std::string &journal, size_t &offset, std::string &body)
+  {
+    if (journal.size() - offset < 8)
+      return false;
+    uint64_t size = 0;
+    for (int i = 7; i >= 0; --i)
+      size = (size << 8) | (uint8_t)journal[offset + i];
+    if (journal.size() - offset - 8 < size || journal.size() - offset - 8 - size < sizeof(crypto::hash))
+      return false;
+    crypto::hash hash;
+    crypto::cn_fast_hash(journal.data() + offset + 8, size, hash);
+    if (memcmp(&hash, journal.data() + offset + 8 + size, sizeof(hash)))
+      return false;
+    body.assign(journal, offset + 8, size);
+    offset += 8 + size + sizeof(crypto::hash);
+    return true;
+  }
+
+  std::string make_header(const crypto::chacha_iv &base_iv)
+  {
+    return JOURNAL_MAGIC + std::string((const char*)&base_iv, sizeof(base_iv));
+  }
+}
+
+namespace tools
+{
+//----------------------------------------------------------------------------------------------------
+wallet_cache_journal::~wallet_cache_journal()
+{
+  try { wait(); }
+  catch (...) { }
+}
+//----------------------------------------------------------------------------------------------------
+std::vector<wallet_cache_journal::chunk> wallet_cache_journal::split(const std::string &data)
+{
+  std::vector<chunk> chunks;
+  chunks.reserve(data.size() / (MIN_CHUNK_SIZE + CHUNK_MASK) + 1);
+  const uint8_t *bytes = (const uint8_t*)data.data();
+  size_t start = 0;
+  while (start < data.size())
+  {
+    const size_t end = std::min(data.size(), start + MAX_CHUNK_SIZE);
+    size_t pos = std::min(end, start + MIN_CHUNK_SIZE);
+    uint64_t h = 0;
+    while (pos < end)
+    {
+      h = (h << 1) + GEAR.values[bytes[pos++]];
+      if ((h & CHUNK_MASK) == 0)
+        break;
+    }
+    chunk c;
+    c.offset = start;
+    c.size = pos - start;
+    crypto::cn_fast_hash(bytes + start, c.size, c.hash);
+    chunks.push_back(c);
+    start = pos;
+  }
+  return chunks;
+}
+//----------------------------------------------------------------------------------------------------
+void wallet_cache_journal::reset()
+{
+  m_has_base = false;
+  m_base_size = 0;
+  m_journal_size = 0;
+  m_chunks.clear();
+}
+//----------------------------------------------------------------------------------------------------
+void wallet_cache_journal::wait()
+{
+  if (m_compaction.joinable())
+    m_compaction.join();
+  if (m_compaction_error)
+  {
+    // the files were left as they were, so whatever we thought is stored may not be
+    reset();
+    std::exception_ptr error = m_compaction_error;
+    m_compaction_error = nullptr;
+    std::rethrow_exception(error);
+  }
+}
+//----------------------------------------------------------------------------------------------------
+bool wallet_cache_journal::load(const std::string &journal_file, const crypto::chacha_key &key, const crypto::chacha_iv &base_iv, std::string &cache_data, bool keep_chunks)
+{
+  try { wait(); }
+  catch (const std::exception &e) { MWARNING("Ignoring earlier failure to write the wallet cache: " << e.what()); }
+  reset();
+
+  boost::system::error_code ec;
+  const bool journal_exists = boost::filesystem::exists(journal_file, ec) && !ec;
+  if (!journal_exists && !keep_chunks)
+    return false;
+
+  std::unordered_map<crypto::hash, epee::span<const char>> stored;
+  for (const chunk &c: split(cache_data))
+  {
+    m_chunks.insert(c.hash);
+    stored.emplace(c.hash, epee::span<const char>(cache_data.data() + c.offset, c.size));
+  }
+  m_has_base = true;
+  m_base_iv = base_iv;
+  m_base_size = cache_data.size();
+  if (!journal_exists)
+    return false;
+
+  std::string journal, body;
+  if (!epee::file_io_utils::load_file_to_string(journal_file, journal, std::numeric_limits<size_t>::max()))
+  {
+    MERROR("Failed to read wallet cache journal " << journal_file);
+    return false;
+  }
+  size_t offset = 0;
+  if (!read_frame(journal, offset, body) || body != make_header(base_iv))
+  {
+    // left over from before the base was last written
+    MINFO("Ignoring wallet cache journal " << journal_file << ", it is not for this cache");
+    return false;
+  }
+
+  std::list<record> records;
+  const std::vector<crypto::hash> *latest = NULL;
+  size_t good_size = offset;
+  while (read_frame(journal, offset, body))
+  {
+    entry e;
+    if (!::serialization::parse_binary(body, e))
+      break;
+    std::string plain;
+    plain.resize(e.data.size());
+    crypto::chacha20(e.data.data(), e.data.size(), key, e.iv, &plain[0]);
+    records.emplace_back();
+    if (!::serialization::parse_binary(plain, records.back()))
+    {
+      records.pop_back();
+      break;
+    }
+    for (const std::string &data: records.back().new_chunks)
+    {
+      crypto::hash hash;
+      crypto::cn_fast_hash(data.data(), data.size(), hash);
+      m_chunks.insert(hash);
+      stored.emplace(hash, epee::span<const char>(data.data(), data.size()));
+    }
+    latest = &records.back().chunks;
+    good_size = offset;
+  }
+  if (good_size != journal.size())
+    MWARNING("Wallet cache journal " << journal_file << " has " << journal.size() - good_size << " unreadable bytes at the end, ignoring them");
+  m_journal_size = good_size;
+  if (!latest)
+    return false;
+
+  std::string data;
+  for (const crypto::hash &hash: *latest)
+  {
+    const auto i = stored.find(hash);
+    if (i == stored.end())
+    {
+      MERROR("Wallet cache journal " << journal_file << " refers to unknown data, ignoring it");
+      reset();
+      return false;
+    }
+    data.append(i->second.data(), i->second.size());
+  }
+  MDEBUG("Loaded " << records.size() << " records from wallet cache journal " << journal_file);
+  cache_data = std::move(data);
+  return true;
+}
+//----------------------------------------------------------------------------------------------------
+void wallet_cache_journal::store(const std::string &cache_file, const std::string &journal_file, const crypto::chacha_key &key, std::string cache_data, bool final_store)
+{
+  wait();
+
+  const std::vector<chunk> chunks = split(cache_data);
+  if (!m_has_base || final_store)
+  {
+    compact(cache_file, journal_file, key, std::move(cache_data), chunks, !final_store);
+    return;
+  }
+
+  record r;
+  r.chunks.reserve(chunks.size());
+  std::unordered_set<crypto::hash> added;
+  for (const chunk &c: chunks)
+  {
+    r.chunks.push_back(c.hash);
+    if (m_chunks.find(c.hash) == m_chunks.end() && added.insert(c.hash).second)
+      r.new_chunks.emplace_back(cache_data, c.offset, c.size);
+  }
+
+  std::stringstream oss;
+  binary_archive<true> ar(oss);
+  THROW_WALLET_EXCEPTION_IF(!::serialization::serialize(ar, r), error::wallet_internal_error, "Failed to serialize wallet cache journal record");
+  const std::string plain = oss.str();
+  entry e;
+  e.iv = crypto::rand<crypto::chacha_iv>();
+  e.data.resize(plain.size());
+  crypto::chacha20(plain.data(), plain.size(), key, e.iv, &e.data[0]);
+  std::string body;
+  THROW_WALLET_EXCEPTION_IF(!::serialization::dump_binary(e, body), error::wallet_internal_error, "Failed to serialize wallet cache journal record");
+
+  std::string frames = make_frame(body);
+  if (m_journal_size == 0)
+    frames = make_frame(make_header(m_base_iv)) + frames;
+  if (m_journal_size + frames.size() > m_base_size / 2)
+  {
+    compact(cache_file, journal_file, key, std::move(cache_data), chunks, true);
+    return;
+  }
+
+  // drop anything after the last good record, from a failed or torn write
+  boost::system::error_code ec;
+  if (m_journal_size > 0 && boost::filesystem::file_size(journal_file, ec) != m_journal_size)
+  {
+    boost::filesystem::resize_file(journal_file, m_journal_size, ec);
+    THROW_WALLET_EXCEPTION_IF(ec, error::file_save_error, journal_file);
+  }
+  std::ofstream ostr;
+  ostr.open(journal_file, std::ios_base::binary | std::ios_base::out | (m_journal_size > 0 ? std::ios_base::app : std::ios_base::trunc));
+  ostr.write(frames.data(), frames.size());
+  ostr.close();
+  THROW_WALLET_EXCEPTION_IF(!ostr.good(), error::file_save_error, journal_file);
+
+  m_journal_size += frames.size();
+  m_chunks.insert(added.begin(), added.end());
+  MDEBUG("Stored " << r.new_chunks.size() << "/" << chunks.size() << " chunks to wallet cache journal " << journal_file << ", now " << m_journal_size << " bytes");
+}
+//----------------------------------------------------------------------------------------------------
+void wallet_cache_journal::write_base(const std::string &cache_file, const std::string &journal_file, const crypto::chacha_key &key, const crypto::chacha_iv &iv, const std::string &cache_data)
+{
+  entry e;
+  e.iv = iv;
+  e.data.resize(cache_data.size());
+  crypto::chacha20(cache_data.data(), cache_data.size(), key, iv, &e.data[0]);
+
+  const std::string new_file = cache_file + ".new";
+  std::ofstream ostr;
+  ostr.open(new_file, std::ios_base::binary | std::ios_base::out | std::ios_base::trunc);
+  binary_archive<true> oar(ostr);
+  bool success = ::serialization::serialize(oar, e);
+  ostr.close();
+  THROW_WALLET_EXCEPTION_IF(!success || !ostr.good(), error::file_save_error, new_file);
+
+  std::error_code err = tools::replace_file(new_file, cache_file);
+  THROW_WALLET_EXCEPTION_IF(err, error::file_save_error, cache_file, err);
+
+  // the journal is for the previous base, it would be ignored anyway
+  boost::system::error_code ec;
+  boost::filesystem::remove(journal_file, ec);
+}
+//----------------------------------------------------------------------------------------------------
+void wallet_cache_journal::compact(const std::string &cache_file, const std::string &journal_file, const crypto::chacha_key &key, std::string cache_data, const std::vector<chunk> &chunks, bool background)
+{
+  m_has_base = true;
+  m_base_iv = crypto::rand<crypto::chacha_iv>();
+  m_base_size = cache_data.size();
+  m_journal_size = 0;
+  m_chunks.clear();
+  for (const chunk &c: chunks)
+    m_chunks.insert(c.hash);
+
+  const crypto::chacha_iv iv = m_base_iv;
+  if (!background)
+  {
+    MDEBUG("Writing wallet cache " << cache_file << ", " << cache_data.size() << " bytes");
+    try
+    {
+      write_base(cache_file, journal_file, key, iv, cache_data);
+    }
+    catch (...)
+    {
+      reset();
+      throw;
+    }
+    return;
+  }
+
+  MDEBUG("Writing wallet cache " << cache_file << " in the background, " << cache_data.size() << " bytes");
+  m_compaction = boost::thread([this, cache_file, journal_file, key, iv, cache_data = std::move(cache_data)]() {
+    try
+    {
+      write_base(cache_file, journal_file, key, iv, cache_data);
+    }
+    catch (const std::exception &e)
+    {
+      MERROR("Failed to write wallet cache " << cache_file << ": " << e.what());
+      m_compaction_error = std::current_exception();
+    }
+  });
+}
+}
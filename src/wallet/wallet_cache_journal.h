@@ -0,0 +1,134 @@
+// Copyright (c) 2023, Haven Protocol
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <exception>
+#include <string>
+#include <unordered_set>
+#include <vector>
+#include <boost/thread/thread.hpp>
+#include "crypto/chacha.h"
+#include "crypto/hash.h"
+#include "serialization/crypto.h"
+#include "serialization/string.h"
+#include "serialization/containers.h"
+
+namespace tools
+{
+  /*!
+   * \brief Stores a wallet cache as a base cache file plus a journal of changes
+   *
+   * The cache data is cut into chunks at content defined boundaries, so that
+   * data inserted or removed only changes the chunks around it. Each store
+   * appends to the journal the chunks which are not already in the base file
+   * or the journal, with the list of chunks making up the cache data. Once the
+   * journal grows past half the size of the base, a new base is written in the
+   * background and the journal is started over. If writing it fails, the error
+   * is thrown by the next store.
+   *
+   * The base file is an ordinary cache file, so software which does not know
+   * about the journal loads the state as of the last compaction.
+   */
+  class wallet_cache_journal
+  {
+  public:
+    // the encrypted cache data, laid out like wallet2::cache_file_data
+    struct entry
+    {
+      crypto::chacha_iv iv;
+      std::string data;
+
+      BEGIN_SERIALIZE_OBJECT()
+        FIELD(iv)
+        FIELD(data)
+      END_SERIALIZE()
+    };
+
+    struct record
+    {
+      std::vector<crypto::hash> chunks;       // the cache data, as its chunks in order
+      std::vector<std::string> new_chunks;    // the chunks not stored in the base or earlier records
+
+      BEGIN_SERIALIZE_OBJECT()
+        VERSION_FIELD(0)
+        FIELD(chunks)
+        FIELD(new_chunks)
+      END_SERIALIZE()
+    };
+
+    wallet_cache_journal(): m_has_base(false), m_base_size(0), m_journal_size(0) {}
+    ~wallet_cache_journal();
+
+    /*!
+     * \brief applies the journal next to a base cache file
+     * \param journal_file the journal file
+     * \param key the cache encryption key
+     * \param base_iv the iv of the base cache file, which the journal must have been written for
+     * \param cache_data the decrypted base cache data, replaced by the journaled cache data
+     * \param keep_chunks whether to remember the stored chunks for later stores even without a journal
+     * \return whether the cache data was replaced
+     */
+    bool load(const std::string &journal_file, const crypto::chacha_key &key, const crypto::chacha_iv &base_iv, std::string &cache_data, bool keep_chunks);
+
+    /*!
+     * \brief stores cache data, either in the journal or as a new base cache file
+     * \param cache_file the base cache file
+     * \param journal_file the journal file
+     * \param key the cache encryption key
+     * \param cache_data the decrypted cache data
+     * \param final_store whether to write a new base before returning, for when the wallet is closed
+     */
+    void store(const std::string &cache_file, const std::string &journal_file, const crypto::chacha_key &key, std::string cache_data, bool final_store = false);
+
+    //! waits for a new base being written in the background, and throws if writing it failed
+    void wait();
+
+    //! forgets what was stored, for when the cache file was written by other means
+    void reset();
+
+    struct chunk
+    {
+      size_t offset;
+      size_t size;
+      crypto::hash hash;
+    };
+    static std::vector<chunk> split(const std::string &data);
+
+  private:
+    void compact(const std::string &cache_file, const std::string &journal_file, const crypto::chacha_key &key, std::string cache_data, const std::vector<chunk> &chunks, bool background);
+    static void write_base(const std::string &cache_file, const std::string &journal_file, const crypto::chacha_key &key, const crypto::chacha_iv &iv, const std::string &cache_data);
+
+    bool m_has_base;
+    crypto::chacha_iv m_base_iv;
+    size_t m_base_size;
+    size_t m_journal_size;
+    std::unordered_set<crypto::hash> m_chunks;
+    boost::thread m_compaction;
+    std::exception_ptr m_compaction_error;
+  };
+}
@@ -151,7 +151,18 @@ namespace tools
       if (boost::posix_time::microsec_clock::universal_time() < m_last_auto_refresh_time + boost::posix_time::seconds(m_auto_refresh_period))
         return true;
       try {
-        if (m_wallet) m_wallet->refresh(m_wallet->is_trusted_daemon());
+        if (!m_hosted_wallets.empty())
+        {
+          // hosted wallets share each span of blocks with the open wallet
+          std::vector<wallet2*> wallets;
+          if (m_wallet)
+            wallets.push_back(m_wallet);
+          for (const auto &hosted: m_hosted_wallets)
+            wallets.push_back(hosted.second.get());
+          uint64_t blocks_fetched;
+          m_wallet_scanner.refresh(wallets, blocks_fetched);
+        }
+        else if (m_wallet) m_wallet->refresh(m_wallet->is_trusted_daemon());
       } catch (const std::exception& ex) {
         LOG_ERROR("Exception at while refreshing, what=" << ex.what());
       }
@@ -175,11 +186,24 @@ namespace tools
   {
     if (m_wallet)
     {
-      m_wallet->store();
+      m_wallet->store(true);
       m_wallet->deinit();
       delete m_wallet;
       m_wallet = NULL;
     }
+    for (auto &hosted: m_hosted_wallets)
+    {
+      try
+      {
+        hosted.second->store(true);
+      }
+      catch (const std::exception &e)
+      {
+        MERROR("Failed to store hosted wallet " << hosted.first << ": " << e.what());
+      }
+      hosted.second->deinit();
+    }
+    m_hosted_wallets.clear();
   }
   //------------------------------------------------------------------------------------------------------------------------------
   bool wallet_rpc_server::init(const boost::program_options::variables_map *vm)
@@ -342,6 +366,70 @@ namespace tools
       return false;
   }
   //------------------------------------------------------------------------------------------------------------------------------
+  bool wallet_rpc_server::check_wallet_filename(const std::string &filename, epee::json_rpc::error& er)
+  {
+    if (m_wallet_dir.empty())
+    {
+      er.code = WALLET_RPC_ERROR_CODE_NO_WALLET_DIR;
+      er.message = "No wallet dir configured";
+      return false;
+    }
+
+    const char *ptr = strchr(filename.c_str(), '/');
+#ifdef _WIN32
+    if (!ptr)
+      ptr = strchr(filename.c_str(), '\\');
+    if (!ptr)
+      ptr = strchr(filename.c_str(), ':');
+#endif
+    if (ptr)
+    {
+      er.code = WALLET_RPC_ERROR_CODE_UNKNOWN_ERROR;
+      er.message = "Invalid filename";
+      return false;
+    }
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  std::unique_ptr<wallet2> wallet_rpc_server::load_wallet(const std::string &filename, const std::string &password, epee::json_rpc::error& er)
+  {
+    namespace po = boost::program_options;
+    po::variables_map vm2;
+    std::string wallet_file = m_wallet_dir + "/" + filename;
+    {
+      po::options_description desc("dummy");
+      const command_line::arg_descriptor<std::string, true> arg_password = {"password", "password"};
+      const char *argv[4];
+      int argc = 3;
+      argv[0] = "wallet-rpc";
+      argv[1] = "--password";
+      argv[2] = password.c_str();
+      argv[3] = NULL;
+      vm2 = *m_vm;
+      command_line::add_arg(desc, arg_password);
+      po::store(po::parse_command_line(argc, argv, desc), vm2);
+    }
+    std::unique_ptr<tools::wallet2> wal = nullptr;
+    try {
+      wal = tools::wallet2::make_from_file(vm2, true, wallet_file, nullptr).first;
+    }
+    catch (const std::exception& e)
+    {
+      handle_rpc_exception(std::current_exception(), er, WALLET_RPC_ERROR_CODE_UNKNOWN_ERROR);
+    }
+    if (!wal)
+    {
+      er.code = WALLET_RPC_ERROR_CODE_UNKNOWN_ERROR;
+      er.message = "Failed to open wallet";
+    }
+    return wal;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  bool wallet_rpc_server::is_open_wallet_hosted() const
+  {
+    return m_wallet && !m_open_hosted_wallet.empty() && m_wallet->get_wallet_file() == m_wallet_dir + "/" + m_open_hosted_wallet;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
   void wallet_rpc_server::fill_transfer_entry(tools::wallet_rpc::transfer_entry &entry, const crypto::hash &txid, const crypto::hash &payment_id, const tools::wallet2::payment_details &pd)
   {
     entry.txid = string_tools::pod_to_hex(pd.m_tx_hash);
@@ -2280,7 +2368,7 @@ namespace tools
 
     try
     {
-      m_wallet->store();
+      m_wallet->store(true);
       m_stop.store(true, std::memory_order_relaxed);
     }
     catch (const std::exception& e)
@@ -3410,7 +3498,7 @@ namespace tools
     {
       try
       {
-        m_wallet->store();
+        m_wallet->store(true);
       }
       catch (const std::exception& e)
       {
@@ -3425,33 +3513,23 @@ namespace tools
   //------------------------------------------------------------------------------------------------------------------------------
   bool wallet_rpc_server::on_open_wallet(const wallet_rpc::COMMAND_RPC_OPEN_WALLET::request& req, wallet_rpc::COMMAND_RPC_OPEN_WALLET::response& res, epee::json_rpc::error& er, const connection_context *ctx)
   {
-    if (m_wallet_dir.empty())
-    {
-      er.code = WALLET_RPC_ERROR_CODE_NO_WALLET_DIR;
-      er.message = "No wallet dir configured";
+    if (!check_wallet_filename(req.filename, er))
       return false;
-    }
-
-    namespace po = boost::program_options;
-    po::variables_map vm2;
-    const char *ptr = strchr(req.filename.c_str(), '/');
-#ifdef _WIN32
-    if (!ptr)
-      ptr = strchr(req.filename.c_str(), '\\');
-    if (!ptr)
-      ptr = strchr(req.filename.c_str(), ':');
-#endif
-    if (ptr)
+    if (is_open_wallet_hosted() && m_open_hosted_wallet == req.filename)
     {
-      er.code = WALLET_RPC_ERROR_CODE_UNKNOWN_ERROR;
-      er.message = "Invalid filename";
-      return false;
+      if (!m_wallet->verify_password(req.password))
+      {
+        er.code = WALLET_RPC_ERROR_CODE_INVALID_PASSWORD;
+        er.message = "Invalid password.";
+        return false;
+      }
+      return true;
     }
     if (m_wallet && req.autosave_current)
     {
       try
       {
-        m_wallet->store();
+        m_wallet->store(!is_open_wallet_hosted());
       }
       catch (const std::exception& e)
       {
@@ -3459,38 +3537,37 @@ namespace tools
         return false;
       }
     }
-    std::string wallet_file = m_wallet_dir + "/" + req.filename;
-    {
-      po::options_description desc("dummy");
-      const command_line::arg_descriptor<std::string, true> arg_password = {"password", "password"};
-      const char *argv[4];
-      int argc = 3;
-      argv[0] = "wallet-rpc";
-      argv[1] = "--password";
-      argv[2] = req.password.c_str();
-      argv[3] = NULL;
-      vm2 = *m_vm;
-      command_line::add_arg(desc, arg_password);
-      po::store(po::parse_command_line(argc, argv, desc), vm2);
-    }
     std::unique_ptr<tools::wallet2> wal = nullptr;
-    try {
-      wal = tools::wallet2::make_from_file(vm2, true, wallet_file, nullptr).first;
-    }
-    catch (const std::exception& e)
+    auto hosted = m_hosted_wallets.find(req.filename);
+    const bool was_hosted = hosted != m_hosted_wallets.end();
+    if (was_hosted)
     {
-      handle_rpc_exception(std::current_exception(), er, WALLET_RPC_ERROR_CODE_UNKNOWN_ERROR);
+      // already loaded and refreshed, it just becomes the open one
+      if (!hosted->second->verify_password(req.password))
+      {
+        er.code = WALLET_RPC_ERROR_CODE_INVALID_PASSWORD;
+        er.message = "Invalid password.";
+        return false;
+      }
+      wal = std::move(hosted->second);
+      m_hosted_wallets.erase(hosted);
     }
-    if (!wal)
+    else
     {
-      er.code = WALLET_RPC_ERROR_CODE_UNKNOWN_ERROR;
-      er.message = "Failed to open wallet";
-      return false;
+      wal = load_wallet(req.filename, req.password, er);
+      if (!wal)
+        return false;
     }
 
     if (m_wallet)
-      delete m_wallet;
+    {
+      if (is_open_wallet_hosted())
+        m_hosted_wallets[m_open_hosted_wallet].reset(m_wallet);
+      else
+        delete m_wallet;
+    }
     m_wallet = wal.release();
+    m_open_hosted_wallet = was_hosted ? req.filename : std::string();
     return true;
   }
   //------------------------------------------------------------------------------------------------------------------------------
@@ -3502,7 +3579,7 @@ namespace tools
     {
       try
       {
-        m_wallet->store();
+        m_wallet->store(true);
       }
       catch (const std::exception& e)
       {
@@ -3510,8 +3587,77 @@ namespace tools
         return false;
       }
     }
+    // closing a hosted wallet stops hosting it too
     delete m_wallet;
     m_wallet = NULL;
+    m_open_hosted_wallet.clear();
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  bool wallet_rpc_server::on_host_wallet(const wallet_rpc::COMMAND_RPC_HOST_WALLET::request& req, wallet_rpc::COMMAND_RPC_HOST_WALLET::response& res, epee::json_rpc::error& er, const connection_context *ctx)
+  {
+    if (!check_wallet_filename(req.filename, er))
+      return false;
+    if (m_hosted_wallets.find(req.filename) != m_hosted_wallets.end() || (is_open_wallet_hosted() && m_open_hosted_wallet == req.filename))
+    {
+      er.code = WALLET_RPC_ERROR_CODE_WALLET_ALREADY_EXISTS;
+      er.message = "Wallet is already hosted";
+      return false;
+    }
+    if (m_wallet && m_wallet->get_wallet_file() == m_wallet_dir + "/" + req.filename)
+    {
+      er.code = WALLET_RPC_ERROR_CODE_WALLET_ALREADY_EXISTS;
+      er.message = "Wallet is already open";
+      return false;
+    }
+
+    std::unique_ptr<tools::wallet2> wal = load_wallet(req.filename, req.password, er);
+    if (!wal)
+      return false;
+    m_hosted_wallets[req.filename] = std::move(wal);
+    MINFO("Now hosting " << m_hosted_wallets.size() << " wallet(s)");
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  bool wallet_rpc_server::on_unhost_wallet(const wallet_rpc::COMMAND_RPC_UNHOST_WALLET::request& req, wallet_rpc::COMMAND_RPC_UNHOST_WALLET::response& res, epee::json_rpc::error& er, const connection_context *ctx)
+  {
+    if (!check_wallet_filename(req.filename, er))
+      return false;
+    if (is_open_wallet_hosted() && m_open_hosted_wallet == req.filename)
+    {
+      // it stays open, but will not go back to the hosted wallets
+      m_open_hosted_wallet.clear();
+      return true;
+    }
+    auto hosted = m_hosted_wallets.find(req.filename);
+    if (hosted == m_hosted_wallets.end())
+    {
+      er.code = WALLET_RPC_ERROR_CODE_NOT_OPEN;
+      er.message = "Wallet is not hosted";
+      return false;
+    }
+    if (req.autosave)
+    {
+      try
+      {
+        hosted->second->store(true);
+      }
+      catch (const std::exception& e)
+      {
+        handle_rpc_exception(std::current_exception(), er, WALLET_RPC_ERROR_CODE_UNKNOWN_ERROR);
+        return false;
+      }
+    }
+    m_hosted_wallets.erase(hosted);
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  bool wallet_rpc_server::on_get_hosted_wallets(const wallet_rpc::COMMAND_RPC_GET_HOSTED_WALLETS::request& req, wallet_rpc::COMMAND_RPC_GET_HOSTED_WALLETS::response& res, epee::json_rpc::error& er, const connection_context *ctx)
+  {
+    if (is_open_wallet_hosted())
+      res.wallets.push_back({m_open_hosted_wallet, m_wallet->get_account().get_public_address_str(m_wallet->nettype()), m_wallet->get_blockchain_current_height(), true});
+    for (const auto &hosted: m_hosted_wallets)
+      res.wallets.push_back({hosted.first, hosted.second->get_account().get_public_address_str(hosted.second->nettype()), hosted.second->get_blockchain_current_height(), false});
     return true;
   }
   //------------------------------------------------------------------------------------------------------------------------------
@@ -3735,7 +3881,7 @@ namespace tools
       try
       {
         if (!wallet_file.empty())
-          m_wallet->store();
+          m_wallet->store(true);
       }
       catch (const std::exception &e)
       {
@@ -3873,7 +4019,7 @@ namespace tools
     {
       try
       {
-        m_wallet->store();
+        m_wallet->store(true);
       }
       catch (const std::exception &e)
       {
@@ -4658,7 +4804,7 @@ public:
       if (quit)
       {
         MINFO(tools::wallet_rpc_server::tr("Saving wallet..."));
-        wal->store();
+        wal->store(true);
         MINFO(tools::wallet_rpc_server::tr("Successfully saved"));
         return false;
       }
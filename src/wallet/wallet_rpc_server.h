@@ -38,6 +38,7 @@
 #include "math_helper.h"
 #include "wallet_rpc_server_commands_defs.h"
 #include "wallet2.h"
+#include "wallet_scanner.h"
 
 #undef MONERO_DEFAULT_LOG_CATEGORY
 #define MONERO_DEFAULT_LOG_CATEGORY "wallet.rpc"
@@ -142,6 +143,9 @@ namespace tools
         MAP_JON_RPC_WE("create_wallet",      on_create_wallet,      wallet_rpc::COMMAND_RPC_CREATE_WALLET)
         MAP_JON_RPC_WE("open_wallet",        on_open_wallet,        wallet_rpc::COMMAND_RPC_OPEN_WALLET)
         MAP_JON_RPC_WE("close_wallet",       on_close_wallet,       wallet_rpc::COMMAND_RPC_CLOSE_WALLET)
+        MAP_JON_RPC_WE("host_wallet",        on_host_wallet,        wallet_rpc::COMMAND_RPC_HOST_WALLET)
+        MAP_JON_RPC_WE("unhost_wallet",      on_unhost_wallet,      wallet_rpc::COMMAND_RPC_UNHOST_WALLET)
+        MAP_JON_RPC_WE("get_hosted_wallets", on_get_hosted_wallets, wallet_rpc::COMMAND_RPC_GET_HOSTED_WALLETS)
         MAP_JON_RPC_WE("change_wallet_password",        on_change_wallet_password,        wallet_rpc::COMMAND_RPC_CHANGE_WALLET_PASSWORD)
         MAP_JON_RPC_WE("generate_from_keys", on_generate_from_keys, wallet_rpc::COMMAND_RPC_GENERATE_FROM_KEYS)
         MAP_JON_RPC_WE("restore_deterministic_wallet",      on_restore_deterministic_wallet,      wallet_rpc::COMMAND_RPC_RESTORE_DETERMINISTIC_WALLET)
@@ -233,6 +237,9 @@ namespace tools
       bool on_create_wallet(const wallet_rpc::COMMAND_RPC_CREATE_WALLET::request& req, wallet_rpc::COMMAND_RPC_CREATE_WALLET::response& res, epee::json_rpc::error& er, const connection_context *ctx = NULL);
       bool on_open_wallet(const wallet_rpc::COMMAND_RPC_OPEN_WALLET::request& req, wallet_rpc::COMMAND_RPC_OPEN_WALLET::response& res, epee::json_rpc::error& er, const connection_context *ctx = NULL);
       bool on_close_wallet(const wallet_rpc::COMMAND_RPC_CLOSE_WALLET::request& req, wallet_rpc::COMMAND_RPC_CLOSE_WALLET::response& res, epee::json_rpc::error& er, const connection_context *ctx = NULL);
+      bool on_host_wallet(const wallet_rpc::COMMAND_RPC_HOST_WALLET::request& req, wallet_rpc::COMMAND_RPC_HOST_WALLET::response& res, epee::json_rpc::error& er, const connection_context *ctx = NULL);
+      bool on_unhost_wallet(const wallet_rpc::COMMAND_RPC_UNHOST_WALLET::request& req, wallet_rpc::COMMAND_RPC_UNHOST_WALLET::response& res, epee::json_rpc::error& er, const connection_context *ctx = NULL);
+      bool on_get_hosted_wallets(const wallet_rpc::COMMAND_RPC_GET_HOSTED_WALLETS::request& req, wallet_rpc::COMMAND_RPC_GET_HOSTED_WALLETS::response& res, epee::json_rpc::error& er, const connection_context *ctx = NULL);
       bool on_change_wallet_password(const wallet_rpc::COMMAND_RPC_CHANGE_WALLET_PASSWORD::request& req, wallet_rpc::COMMAND_RPC_CHANGE_WALLET_PASSWORD::response& res, epee::json_rpc::error& er, const connection_context *ctx = NULL);
       bool on_generate_from_keys(const wallet_rpc::COMMAND_RPC_GENERATE_FROM_KEYS::request& req, wallet_rpc::COMMAND_RPC_GENERATE_FROM_KEYS::response& res, epee::json_rpc::error& er, const connection_context *ctx = NULL);
       bool on_restore_deterministic_wallet(const wallet_rpc::COMMAND_RPC_RESTORE_DETERMINISTIC_WALLET::request& req, wallet_rpc::COMMAND_RPC_RESTORE_DETERMINISTIC_WALLET::response& res, epee::json_rpc::error& er, const connection_context *ctx = NULL);
@@ -261,6 +268,9 @@ namespace tools
       void fill_transfer_entry(tools::wallet_rpc::transfer_entry &entry, const crypto::hash &txid, const tools::wallet2::unconfirmed_transfer_details &pd);
       void fill_transfer_entry(tools::wallet_rpc::transfer_entry &entry, const crypto::hash &payment_id, const tools::wallet2::pool_payment_details &pd);
       bool not_open(epee::json_rpc::error& er);
+      bool check_wallet_filename(const std::string &filename, epee::json_rpc::error& er);
+      std::unique_ptr<wallet2> load_wallet(const std::string &filename, const std::string &password, epee::json_rpc::error& er);
+      bool is_open_wallet_hosted() const;
       void handle_rpc_exception(const std::exception_ptr& e, epee::json_rpc::error& er, int default_error_code);
 
       template<typename Ts, typename Tu, typename Tk>
@@ -273,6 +283,10 @@ namespace tools
       void check_background_mining();
 
       wallet2 *m_wallet;
+      // wallets kept loaded in the wallet dir and refreshed along with the open one, by filename
+      std::map<std::string, std::unique_ptr<wallet2>> m_hosted_wallets;
+      std::string m_open_hosted_wallet;
+      wallet_scanner m_wallet_scanner;
       std::string m_wallet_dir;
       tools::private_file rpc_login_file;
       std::atomic<bool> m_stop;
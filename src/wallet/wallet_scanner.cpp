@@ -0,0 +1,251 @@
+// Copyright (c) 2023, Haven Protocol
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <algorithm>
+#include "common/threadpool.h"
+#include "misc_log_ex.h"
+#include "wallet_errors.h"
+#include "wallet2.h"
+#include "wallet_scanner.h"
+
+#undef MONERO_DEFAULT_LOG_CATEGORY
+#define MONERO_DEFAULT_LOG_CATEGORY "wallet.scanner"
+
+namespace
+{
+  // tx extras are the same for every wallet, so they are parsed once per block rather than by each wallet
+  void parse_tx_extras(std::vector<tools::wallet2::parsed_block> &parsed_blocks)
+  {
+    tools::threadpool& tpool = tools::threadpool::getInstanceForCompute();
+    tools::threadpool::waiter waiter(tpool);
+    for (tools::wallet2::parsed_block &parsed_block: parsed_blocks)
+    {
+      parsed_block.tx_extras.resize(1 + parsed_block.txes.size());
+      tpool.submit(&waiter, [&parsed_block]() {
+        parsed_block.tx_extras[0].complete = cryptonote::parse_tx_extra(parsed_block.block.miner_tx.extra, parsed_block.tx_extras[0].fields);
+        for (size_t i = 0; i < parsed_block.txes.size(); ++i)
+          parsed_block.tx_extras[1 + i].complete = cryptonote::parse_tx_extra(parsed_block.txes[i].extra, parsed_block.tx_extras[1 + i].fields);
+      }, true);
+    }
+    THROW_WALLET_EXCEPTION_IF(!waiter.wait(), tools::error::wallet_internal_error, "Exception in thread pool");
+  }
+}
+
+namespace tools
+{
+//----------------------------------------------------------------------------------------------------
+bool wallet_scanner::can_share_blocks(const wallet2 &wallet)
+{
+  if (wallet.m_offline || wallet.m_light_wallet)
+    return false;
+  // the device is shared by every wallet using it, and only the software one can be used from several threads
+  if (wallet.m_account.get_device().get_type() != hw::device::SOFTWARE)
+    return false;
+  // those pull hashes rather than blocks up to their restore height first
+  if (wallet.m_refresh_from_block_height > wallet.m_blockchain.size())
+    return false;
+  return true;
+}
+//----------------------------------------------------------------------------------------------------
+size_t wallet_scanner::refresh(const std::vector<wallet2*> &wallets, uint64_t &blocks_fetched)
+{
+  blocks_fetched = 0;
+  m_run.store(true, std::memory_order_relaxed);
+
+  std::vector<wallet2*> shared, alone;
+  for (wallet2 *wallet: wallets)
+    (can_share_blocks(*wallet) ? shared : alone).push_back(wallet);
+  if (shared.size() == 1)
+  {
+    alone.push_back(shared.back());
+    shared.clear();
+  }
+
+  struct shared_wallet
+  {
+    wallet2 *wallet;
+    bool failed;
+    uint64_t blocks_added;
+    std::shared_ptr<std::map<std::pair<uint64_t, uint64_t>, size_t>> output_tracker_cache;
+    std::vector<std::tuple<cryptonote::transaction, crypto::hash, bool>> process_pool_txs;
+  };
+  std::vector<shared_wallet> states;
+  for (wallet2 *wallet: shared)
+    states.push_back({wallet, false, 0, {}, {}});
+
+  tools::threadpool& tpool = tools::threadpool::getInstanceForCompute();
+
+  // get updated pool states first, they get processed once the blocks are, as in wallet2::refresh
+  {
+    tools::threadpool::waiter waiter(tpool);
+    for (shared_wallet &state: states)
+    {
+      tpool.submit(&waiter, [&state]() {
+        try { state.wallet->update_pool_state(state.process_pool_txs, true); }
+        catch (const std::exception &e) { MERROR("Failed to get pool state for a wallet: " << e.what()); }
+      });
+    }
+    THROW_WALLET_EXCEPTION_IF(!waiter.wait(), error::wallet_internal_error, "Exception in thread pool");
+  }
+
+  // the wallet furthest behind pulls the blocks, the others will find they already have the first ones
+  wallet2 *lead = states.empty() ? NULL : std::min_element(states.begin(), states.end(), [](const shared_wallet &a, const shared_wallet &b) {
+    return a.wallet->m_blockchain.size() < b.wallet->m_blockchain.size();
+  })->wallet;
+  std::list<crypto::hash> short_chain_history;
+  if (lead)
+    lead->get_short_chain_history(short_chain_history);
+
+  uint64_t blocks_start_height = 0;
+  std::vector<cryptonote::block_complete_entry> blocks;
+  std::vector<wallet2::parsed_block> parsed_blocks;
+  bool first = true, last = false, done = false;
+  while (lead && m_run.load(std::memory_order_relaxed))
+  {
+    if (!first && blocks.empty())
+    {
+      done = true;
+      break;
+    }
+
+    // pull the next span while the current one is processed, as wallet2::refresh does
+    uint64_t next_blocks_start_height = blocks_start_height;
+    std::vector<cryptonote::block_complete_entry> next_blocks;
+    std::vector<wallet2::parsed_block> next_parsed_blocks;
+    bool error = false;
+    std::exception_ptr exception;
+    tools::threadpool::waiter pull_waiter(tpool);
+    if (!last)
+      tpool.submit(&pull_waiter, [&]{
+        lead->pull_and_parse_next_blocks(0, next_blocks_start_height, short_chain_history, blocks, parsed_blocks, next_blocks, next_parsed_blocks, last, error, exception);
+        if (!error)
+          parse_tx_extras(next_parsed_blocks);
+      });
+
+    if (!first)
+    {
+      const uint64_t end_height = blocks_start_height + blocks.size();
+      tools::threadpool::waiter waiter(tpool);
+      for (shared_wallet &state: states)
+      {
+        if (state.failed || state.wallet->m_blockchain.size() > end_height)
+          continue;
+        tpool.submit(&waiter, [&]() {
+          wallet2 &wallet = *state.wallet;
+          try
+          {
+            uint64_t added = 0;
+            wallet.process_parsed_blocks(blocks_start_height, blocks, parsed_blocks, added, state.output_tracker_cache.get());
+            state.blocks_added += added;
+          }
+          catch (const std::exception &e)
+          {
+            MERROR("Failed to process shared blocks for a wallet, it will refresh on its own: " << e.what());
+            state.failed = true;
+          }
+          wallet.m_encrypt_keys_after_refresh.reset();
+        });
+      }
+      THROW_WALLET_EXCEPTION_IF(!waiter.wait(), error::wallet_internal_error, "Exception in thread pool");
+    }
+    THROW_WALLET_EXCEPTION_IF(!pull_waiter.wait(), error::wallet_internal_error, "Exception in thread pool");
+
+    if (error)
+    {
+      try { if (exception) std::rethrow_exception(exception); }
+      catch (const std::exception &e) { MERROR("Failed to pull blocks: " << e.what()); }
+      // let each wallet try on its own
+      break;
+    }
+
+    if (!first && blocks_start_height == next_blocks_start_height)
+    {
+      done = true;
+      break;
+    }
+    first = false;
+    blocks_fetched += next_blocks.size();
+
+    // if we've got at least 10 blocks to refresh, assume we're starting
+    // a long refresh, and setup a tracking output cache if we need to
+    for (shared_wallet &state: states)
+      if (state.wallet->m_track_uses && (!state.output_tracker_cache || state.output_tracker_cache->empty()) && next_blocks.size() >= 10)
+        state.output_tracker_cache = state.wallet->create_output_tracker_cache();
+
+    // switch to the new blocks from the daemon
+    blocks_start_height = next_blocks_start_height;
+    blocks = std::move(next_blocks);
+    parsed_blocks = std::move(next_parsed_blocks);
+  }
+
+  size_t refreshed = 0;
+  for (shared_wallet &state: states)
+  {
+    if (!done || state.failed)
+    {
+      alone.push_back(state.wallet);
+      continue;
+    }
+    wallet2 *wallet = state.wallet;
+    wallet->m_node_rpc_proxy.set_height(wallet->m_blockchain.size());
+    wallet->m_has_ever_refreshed_from_node = true;
+    try
+    {
+      if (!state.process_pool_txs.empty())
+        wallet->process_pool_state(state.process_pool_txs);
+    }
+    catch (...)
+    {
+      LOG_PRINT_L1("Failed to check pending transactions");
+    }
+    wallet->m_first_refresh_done = true;
+    ++refreshed;
+  }
+
+  // one at a time, hardware wallets may share a device
+  for (wallet2 *wallet: alone)
+  {
+    if (!m_run.load(std::memory_order_relaxed))
+      break;
+    try
+    {
+      uint64_t wallet_blocks_fetched = 0;
+      bool received_money = false;
+      wallet->refresh(wallet->is_trusted_daemon(), 0, wallet_blocks_fetched, received_money);
+      blocks_fetched += wallet_blocks_fetched;
+      ++refreshed;
+    }
+    catch (const std::exception &e)
+    {
+      MERROR("Failed to refresh wallet: " << e.what());
+    }
+  }
+
+  return refreshed;
+}
+//----------------------------------------------------------------------------------------------------
+}
@@ -0,0 +1,74 @@
+// Copyright (c) 2023, Haven Protocol
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <atomic>
+#include <vector>
+
+namespace tools
+{
+  class wallet2;
+
+  /*!
+   * \brief Refreshes many wallets connected to the same daemon together
+   *
+   * Each span of blocks is fetched and parsed once, by the wallet furthest
+   * behind, along with the tx extras holding the tx public keys. It is then
+   * processed for all the wallets in parallel on the compute threadpool, while
+   * the next span is being fetched. Key derivations and view tag checks need
+   * each wallet's own view key, so each wallet still does those, and checks
+   * every tx's inputs for its own spends. Wallets' callbacks may therefore run
+   * concurrently. Each wallet then processes its own pool txes.
+   *
+   * Wallets which can not share blocks (offline, light or hardware device
+   * wallets, and wallets which still have to skip ahead to their restore
+   * height), and wallets which fail to process a shared span, are refreshed
+   * on their own afterwards.
+   */
+  class wallet_scanner
+  {
+  public:
+    wallet_scanner(): m_run(true) {}
+
+    /*!
+     * \brief brings the wallets up to the daemon's height
+     * \param wallets the wallets to refresh
+     * \param blocks_fetched return-by-reference the number of blocks fetched from the daemon
+     * \return the number of wallets which were refreshed successfully
+     */
+    size_t refresh(const std::vector<wallet2*> &wallets, uint64_t &blocks_fetched);
+
+    //! stops a refresh in progress after the current span
+    void stop() { m_run.store(false, std::memory_order_relaxed); }
+
+  private:
+    static bool can_share_blocks(const wallet2 &wallet);
+
+    std::atomic<bool> m_run;
+  };
+}
@@ -371,3 +371,64 @@ bool gen_bpp_tx_invalid_clsag_type::generate(std::vector<test_event_entry>& even
     return true;
   });
 }
+
+bool gen_bpp_txs_invalid_clsag_in_later_tx::generate(std::vector<test_event_entry>& events) const
+{
+  DEFINE_TESTS_ERROR_CONTEXT("gen_bpp_txs_invalid_clsag_in_later_tx");
+  const size_t mixin = 10;
+  const uint64_t amounts_paid[] = {1000, 1000, (uint64_t)-1, 1000, 1000, (uint64_t)-1};
+  const rct::RCTConfig rct_config[] = { { rct::RangeProofPaddedBulletproof, 4 }, { rct::RangeProofPaddedBulletproof, 4 } };
+  SET_EVENT_VISITOR_SETT(events, event_visitor_settings::set_txs_keeped_by_block);
+  if (!generate_with(events, mixin, 2, amounts_paid, false, rct_config, HF_VERSION_BULLETPROOF_PLUS, NULL, [&](cryptonote::transaction &tx, size_t tx_idx){
+    if (tx_idx != 1)
+      return true;
+    CHECK_TEST_CONDITION(!tx.rct_signatures.p.CLSAGs.empty());
+    tx.rct_signatures.p.CLSAGs[0].s[0].bytes[0] ^= 1;
+    tx.invalidate_hashes();
+    return true;
+  }))
+    return false;
+  DO_CALLBACK(events, "check_rolled_back");
+  return true;
+}
+
+bool gen_bpp_txs_invalid_clsag_in_later_tx::check_rolled_back(cryptonote::core& c, size_t ev_index, const std::vector<test_event_entry>& events)
+{
+  DEFINE_TESTS_ERROR_CONTEXT("gen_bpp_txs_invalid_clsag_in_later_tx::check_rolled_back");
+
+  // the rejected block is the last event before this callback, and its txes the last tx event
+  const cryptonote::block *blk = NULL;
+  const std::vector<cryptonote::transaction> *txes = NULL;
+  for (size_t i = ev_index; i-- > 0 && !txes; )
+  {
+    if (!blk && events[i].type() == typeid(cryptonote::block))
+      blk = &boost::get<cryptonote::block>(events[i]);
+    else if (events[i].type() == typeid(std::vector<cryptonote::transaction>))
+      txes = &boost::get<std::vector<cryptonote::transaction>>(events[i]);
+  }
+  CHECK_TEST_CONDITION(blk && txes && txes->size() == 2);
+
+  // nothing of the block stayed on the chain, although the first tx verified
+  CHECK_TEST_CONDITION(c.get_tail_id() == blk->prev_id);
+  CHECK_TEST_CONDITION(c.get_current_blockchain_height() == cryptonote::get_block_height(*blk));
+  for (const cryptonote::transaction &tx: *txes)
+  {
+    CHECK_TEST_CONDITION(!c.get_blockchain_storage().have_tx(cryptonote::get_transaction_hash(tx)));
+    for (const cryptonote::txin_v &in: tx.vin)
+    {
+      crypto::key_image k_image;
+      if (in.type() == typeid(cryptonote::txin_haven_key))
+        k_image = boost::get<cryptonote::txin_haven_key>(in).k_image;
+      else
+      {
+        CHECK_TEST_CONDITION(in.type() == typeid(cryptonote::txin_to_key));
+        k_image = boost::get<cryptonote::txin_to_key>(in).k_image;
+      }
+      CHECK_TEST_CONDITION(!c.get_blockchain_storage().have_tx_keyimg_as_spent(k_image));
+    }
+  }
+
+  // and the txes went back to the pool
+  CHECK_TEST_CONDITION(c.get_pool_transactions_count() == 2);
+  return true;
+}
@@ -204,3 +204,23 @@ struct gen_bpp_tx_invalid_clsag_type : public gen_bpp_tx_validation_base
   bool generate(std::vector<test_event_entry>& events) const;
 };
 template<> struct get_test_options<gen_bpp_tx_invalid_clsag_type>: public get_bpp_versioned_test_options<HF_VERSION_BULLETPROOF_PLUS + 1> {};
+
+// the second tx of the block has a bad CLSAG, which is only found by the RCT
+// verification deferred until after the block's other checks
+struct gen_bpp_txs_invalid_clsag_in_later_tx : public gen_bpp_tx_validation_base
+{
+  gen_bpp_txs_invalid_clsag_in_later_tx()
+  {
+    REGISTER_CALLBACK_METHOD(gen_bpp_txs_invalid_clsag_in_later_tx, check_rolled_back);
+  }
+
+  // the txes come with the block, so the pool keeps them even though one does not verify
+  bool check_tx_verification_context_array(const std::vector<cryptonote::tx_verification_context>& tvcs, size_t tx_added, size_t event_idx, const std::vector<cryptonote::transaction>& /*txs*/)
+  {
+    return tx_added == tvcs.size();
+  }
+
+  bool generate(std::vector<test_event_entry>& events) const;
+  bool check_rolled_back(cryptonote::core& c, size_t ev_index, const std::vector<test_event_entry>& events);
+};
+template<> struct get_test_options<gen_bpp_txs_invalid_clsag_in_later_tx>: public get_bpp_versioned_test_options<HF_VERSION_BULLETPROOF_PLUS> {};
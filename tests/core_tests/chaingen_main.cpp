@@ -169,6 +169,7 @@ int main(int argc, char* argv[])
     GENERATE_AND_PLAY(txpool_double_spend_local);
     GENERATE_AND_PLAY(txpool_double_spend_keyimage);
     GENERATE_AND_PLAY(txpool_stem_loop);
+    GENERATE_AND_PLAY(txpool_template_parse_cache);
 
     // Double spend
     GENERATE_AND_PLAY(gen_double_spend_in_tx<false>);
@@ -298,6 +299,7 @@ int main(int argc, char* argv[])
     GENERATE_AND_PLAY(gen_bpp_tx_invalid_too_many_proofs);
     GENERATE_AND_PLAY(gen_bpp_tx_invalid_wrong_amount);
     GENERATE_AND_PLAY(gen_bpp_tx_invalid_clsag_type);
+    GENERATE_AND_PLAY(gen_bpp_txs_invalid_clsag_in_later_tx);
 
     GENERATE_AND_PLAY(gen_rct2_tx_clsag_malleability);
 
@@ -30,6 +30,7 @@
 
 #include <boost/chrono/chrono.hpp>
 #include <boost/thread/thread_only.hpp>
+#include <algorithm>
 #include <limits>
 #include "string_tools.h"
 
@@ -635,3 +636,118 @@ bool txpool_stem_loop::generate(std::vector<test_event_entry>& events) const
 
   return true;
 }
+
+txpool_template_parse_cache::txpool_template_parse_cache()
+  : txpool_base()
+  , m_txid(crypto::null_hash)
+  , m_blob()
+{
+  REGISTER_CALLBACK_METHOD(txpool_template_parse_cache, check_in_template);
+  REGISTER_CALLBACK_METHOD(txpool_template_parse_cache, garble_pool_blob);
+  REGISTER_CALLBACK_METHOD(txpool_template_parse_cache, restore_pool_blob);
+  REGISTER_CALLBACK_METHOD(txpool_template_parse_cache, check_mined);
+}
+
+bool txpool_template_parse_cache::generate(std::vector<test_event_entry>& events) const
+{
+  INIT_MEMPOOL_TEST();
+
+  MAKE_TX(events, tx_0, miner_account, bob_account, send_amount, blk_0);
+  DO_CALLBACK(events, "check_in_template");
+
+  // with the pool blob unparsable, the tx can only get into the next template
+  // if the parse from the first one is reused
+  DO_CALLBACK(events, "garble_pool_blob");
+  MAKE_NEXT_BLOCK(events, blk_1, blk_0r, miner_account);
+  DO_CALLBACK(events, "check_in_template");
+  DO_CALLBACK(events, "restore_pool_blob");
+
+  MAKE_NEXT_BLOCK_TX1(events, blk_2, blk_1, miner_account, tx_0);
+  DO_CALLBACK(events, "check_mined");
+
+  return true;
+}
+
+bool txpool_template_parse_cache::get_template(cryptonote::core& c, cryptonote::block& b)
+{
+  cryptonote::account_base miner;
+  miner.generate();
+  cryptonote::difficulty_type diffic;
+  uint64_t height, expected_reward, seed_height;
+  crypto::hash seed_hash;
+  if (!c.get_block_template(b, miner.get_keys().m_account_address, diffic, height, expected_reward, cryptonote::blobdata(), seed_height, seed_hash))
+  {
+    MERROR("Failed to get a block template");
+    return false;
+  }
+  return true;
+}
+
+bool txpool_template_parse_cache::check_in_template(cryptonote::core& c, size_t /*ev_index*/, const std::vector<test_event_entry>& /*events*/)
+{
+  std::vector<crypto::hash> hashes{};
+  if (!c.get_pool_transaction_hashes(hashes) || hashes.size() != 1)
+  {
+    MERROR("Expected one tx in the pool");
+    return false;
+  }
+  m_txid = hashes[0];
+
+  cryptonote::block b;
+  if (!get_template(c, b))
+    return false;
+  if (std::find(b.tx_hashes.begin(), b.tx_hashes.end(), m_txid) == b.tx_hashes.end())
+  {
+    MERROR("Pool tx " << m_txid << " is not in the block template");
+    return false;
+  }
+  return true;
+}
+
+bool txpool_template_parse_cache::replace_pool_blob(cryptonote::core& c, const cryptonote::blobdata& blob)
+{
+  cryptonote::BlockchainDB &db = c.get_blockchain_storage().get_db();
+  cryptonote::db_wtxn_guard txn_guard(&db);
+  cryptonote::txpool_tx_meta_t meta;
+  if (!db.get_txpool_tx_meta(m_txid, meta))
+  {
+    MERROR("Failed to get the meta of pool tx " << m_txid);
+    return false;
+  }
+  db.remove_txpool_tx(m_txid);
+  db.add_txpool_tx(m_txid, blob, meta);
+  return true;
+}
+
+bool txpool_template_parse_cache::garble_pool_blob(cryptonote::core& c, size_t /*ev_index*/, const std::vector<test_event_entry>& /*events*/)
+{
+  if (!c.get_pool_transaction(m_txid, m_blob, cryptonote::relay_category::all))
+  {
+    MERROR("Failed to get the blob of pool tx " << m_txid);
+    return false;
+  }
+  return replace_pool_blob(c, cryptonote::blobdata(m_blob.size(), '\xff'));
+}
+
+bool txpool_template_parse_cache::restore_pool_blob(cryptonote::core& c, size_t /*ev_index*/, const std::vector<test_event_entry>& /*events*/)
+{
+  return replace_pool_blob(c, m_blob);
+}
+
+bool txpool_template_parse_cache::check_mined(cryptonote::core& c, size_t /*ev_index*/, const std::vector<test_event_entry>& /*events*/)
+{
+  if (c.get_pool_transactions_count(true) != 0)
+  {
+    MERROR("Expected the pool tx to be mined");
+    return false;
+  }
+  cryptonote::block b;
+  if (!get_template(c, b))
+    return false;
+  if (!b.tx_hashes.empty())
+  {
+    MERROR("Mined tx " << m_txid << " is still in the block template");
+    return false;
+  }
+  return true;
+}
@@ -136,3 +136,23 @@ struct txpool_stem_loop : txpool_double_spend_base
 
   bool generate(std::vector<test_event_entry>& events) const;
 };
+
+// a pool tx parsed for a block template keeps its parse across tip changes, until it leaves the pool
+class txpool_template_parse_cache : public txpool_base
+{
+  crypto::hash m_txid;
+  cryptonote::blobdata m_blob;
+
+  bool replace_pool_blob(cryptonote::core& c, const cryptonote::blobdata& blob);
+  bool get_template(cryptonote::core& c, cryptonote::block& b);
+
+public:
+  txpool_template_parse_cache();
+
+  bool generate(std::vector<test_event_entry>& events) const;
+
+  bool check_in_template(cryptonote::core& c, size_t ev_index, const std::vector<test_event_entry>& events);
+  bool garble_pool_blob(cryptonote::core& c, size_t ev_index, const std::vector<test_event_entry>& events);
+  bool restore_pool_blob(cryptonote::core& c, size_t ev_index, const std::vector<test_event_entry>& events);
+  bool check_mined(cryptonote::core& c, size_t ev_index, const std::vector<test_event_entry>& events);
+};
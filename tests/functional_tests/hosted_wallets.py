@@ -0,0 +1,171 @@
+#!/usr/bin/env python3
+
+# Copyright (c) 2022, The Monero Project
+# 
+# All rights reserved.
+# 
+# Redistribution and use in source and binary forms, with or without modification, are
+# permitted provided that the following conditions are met:
+# 
+# 1. Redistributions of source code must retain the above copyright notice, this list of
+#    conditions and the following disclaimer.
+# 
+# 2. Redistributions in binary form must reproduce the above copyright notice, this list
+#    of conditions and the following disclaimer in the documentation and/or other
+#    materials provided with the distribution.
+# 
+# 3. Neither the name of the copyright holder nor the names of its contributors may be
+#    used to endorse or promote products derived from this software without specific
+#    prior written permission.
+# 
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+# EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+# MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+# THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+# SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+# PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+# INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+# STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+# THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+from __future__ import print_function
+import os
+import errno
+import time
+
+"""Test wallets hosted by the wallet RPC server:
+- several wallets are refreshed together through the shared scanner
+- they end up with the same transfers as wallets refreshed on their own
+"""
+
+from framework.daemon import Daemon
+from framework.wallet import Wallet
+
+SEEDS = [
+  'velvet lymph giddy number token physics poetry unquoted nibs useful sabotage limits benches lifestyle eden nitrogen anvil fewest avoid batch vials washing fences goat unquoted',
+  'peeled mixture ionic radar utopia puddle buying illness nuns gadget river spout cavernous bounced paradise drunk looking cottage jump tequila melting went winter adjust spout',
+  'dilute gutter certain antics pamphlet macro enjoy left slid guarded bogeys upload nineteen bomb jubilee enhanced irritate turnip eggs swung jukebox loudly reduce sedan slid',
+]
+
+class HostedWalletsTest():
+    def run_test(self):
+      self.reset()
+      self.create()
+      self.mine_and_transfer()
+      self.check_hosted()
+
+    def remove_wallet_files(self, name):
+        WALLET_DIRECTORY = os.environ['WALLET_DIRECTORY']
+        assert WALLET_DIRECTORY != ''
+        for suffix in ['', '.keys']:
+            try:
+                os.unlink(WALLET_DIRECTORY + '/' + name + suffix)
+            except OSError as e:
+                if e.errno != errno.ENOENT:
+                    raise
+
+    def reset(self):
+        print('Resetting blockchain')
+        daemon = Daemon()
+        res = daemon.get_height()
+        daemon.pop_blocks(res.height - 1)
+        daemon.flush_txpool()
+
+    def create(self):
+        print('Creating hosted wallet files')
+        wallet = Wallet(idx = 0)
+        try: wallet.close_wallet()
+        except: pass
+        self.addresses = []
+        for i in range(len(SEEDS)):
+            self.remove_wallet_files('hosted_' + str(i))
+            res = wallet.restore_deterministic_wallet(seed = SEEDS[i], filename = 'hosted_' + str(i))
+            self.addresses.append(res.address)
+            wallet.close_wallet()
+        # in memory, to fund the others
+        wallet.restore_deterministic_wallet(seed = SEEDS[0])
+
+    def mine_and_transfer(self):
+        print('Mining and transferring between the hosted wallets')
+        daemon = Daemon()
+        wallet = Wallet(idx = 0)
+        daemon.generateblocks(self.addresses[0], 80)
+        wallet.refresh()
+        wallet.transfer([{'address': self.addresses[1], 'amount': 1000000000000}, {'address': self.addresses[2], 'amount': 2000000000000}], ring_size = 16)
+        daemon.generateblocks(self.addresses[2], 5)
+        wallet.refresh()
+        # left in the pool
+        wallet.transfer([{'address': self.addresses[1], 'amount': 3000000000000}], ring_size = 16)
+        wallet.close_wallet()
+
+    def transfers(self, wallet):
+        res = wallet.get_transfers()
+        transfers = {}
+        for kind in ['in', 'out', 'pending', 'failed', 'pool']:
+            # the pool timestamp is when the wallet first saw the tx
+            transfers[kind] = sorted([(e.txid, e.amount, e.height, e.unlock_time, e.subaddr_index.major, e.subaddr_index.minor) for e in (res[kind] if kind in res else [])])
+        return transfers
+
+    def check_hosted(self):
+        print('Refreshing hosted wallets together')
+        daemon = Daemon()
+        height = daemon.get_height().height
+        wallet = Wallet(idx = 1)
+        try: wallet.close_wallet()
+        except: pass
+        for i in range(len(SEEDS)):
+            wallet.host_wallet('hosted_' + str(i))
+        ok = False
+        try: wallet.host_wallet('hosted_0')
+        except: ok = True
+        assert ok
+
+        wallet.auto_refresh(True, 1)
+        deadline = time.time() + 60
+        while True:
+            res = wallet.get_hosted_wallets()
+            assert len(res.wallets) == len(SEEDS)
+            if all(e.height == height for e in res.wallets):
+                break
+            assert time.time() < deadline
+            time.sleep(1)
+        wallet.auto_refresh(False)
+        assert sorted([e.address for e in res.wallets]) == sorted(self.addresses)
+
+        print('Comparing with wallets refreshed on their own')
+        reference = Wallet(idx = 2)
+        for i in range(len(SEEDS)):
+            wallet.open_wallet('hosted_' + str(i))
+            res = wallet.get_hosted_wallets()
+            assert len([e for e in res.wallets if e.open]) == 1
+            assert [e.filename for e in res.wallets if e.open] == ['hosted_' + str(i)]
+            hosted_transfers = self.transfers(wallet)
+
+            try: reference.close_wallet()
+            except: pass
+            reference.restore_deterministic_wallet(seed = SEEDS[i])
+            reference.refresh()
+            own_transfers = self.transfers(reference)
+            assert hosted_transfers == own_transfers, (hosted_transfers, own_transfers)
+            reference.close_wallet()
+        assert len(self.transfers(wallet)['in']) > 0
+
+        # the open one goes back to the hosted wallets when another is opened
+        wallet.open_wallet('hosted_0')
+        res = wallet.get_hosted_wallets()
+        assert len(res.wallets) == len(SEEDS)
+
+        ok = False
+        try: wallet.unhost_wallet('../hosted_1')
+        except: ok = True
+        assert ok
+        for i in range(1, len(SEEDS)):
+            wallet.unhost_wallet('hosted_' + str(i))
+        wallet.close_wallet()
+        res = wallet.get_hosted_wallets()
+        assert 'wallets' not in res or len(res.wallets) == 0
+        wallet.auto_refresh(True)
+
+
+if __name__ == '__main__':
+    HostedWalletsTest().run_test()
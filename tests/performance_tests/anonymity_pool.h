@@ -0,0 +1,115 @@
+// Copyright (c) 2023, Haven Protocol
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "cryptonote_config.h"
+#include "cryptonote_core/cryptonote_tx_utils.h"
+
+// anonymity pool of a tx with 16 member rings, from the ring members as read from
+// the DB: either copied to a vector per input and classified with a per member
+// asset type string compare, as the pool checks did, or through the flat ring
+// member arrays of asset ids and heights
+template<size_t inputs, bool flat>
+class test_anonymity_pool
+{
+public:
+  static const size_t loop_count = 100000;
+  static const size_t ring_size = 16;
+
+  bool init()
+  {
+    for (size_t i = 0; i < inputs; ++i)
+    {
+      cryptonote::txin_haven_key in;
+      in.amount = 0;
+      in.asset_type = "XUSD";
+      m_tx.vin.push_back(in);
+
+      std::vector<cryptonote::output_data_t> ring(ring_size);
+      for (size_t j = 0; j < ring_size; ++j)
+      {
+        memset(&ring[j], 0, sizeof(ring[j]));
+        ring[j].height = SUPPLY_AUDIT_BLOCK_HEIGHT + crypto::rand_idx<uint64_t>(100000);
+        strncpy(ring[j].asset_type, "XUSD", sizeof(ring[j].asset_type));
+      }
+      m_rings.push_back(std::move(ring));
+    }
+    return true;
+  }
+
+  bool test()
+  {
+    cryptonote::anonymity_pool pool;
+    if (flat)
+    {
+      cryptonote::tx_ring_members ring_members;
+      ring_members.reserve(inputs, inputs * ring_size);
+      for (const auto &ring: m_rings)
+        ring_members.add_input(ring.data(), ring.size());
+      if (!cryptonote::get_anonymity_pool(m_tx, ring_members, pool, cryptonote::MAINNET))
+        return false;
+    }
+    else
+    {
+      std::vector<std::vector<cryptonote::output_data_t>> tx_ring_outputs;
+      tx_ring_outputs.reserve(inputs);
+      for (const auto &ring: m_rings)
+        tx_ring_outputs.push_back(ring);
+      pool = cryptonote::anonymity_pool::UNSET;
+      for (size_t i = 0; i < inputs; ++i)
+      {
+        const std::string source_asset_type = boost::get<cryptonote::txin_haven_key>(m_tx.vin[i]).asset_type;
+        for (const auto &out: tx_ring_outputs[i])
+        {
+          cryptonote::anonymity_pool member_pool = cryptonote::anonymity_pool::UNSET;
+          if (out.height < SUPPLY_AUDIT_BLOCK_HEIGHT && out.asset_type == source_asset_type)
+            member_pool = cryptonote::anonymity_pool::POOL_1;
+          if (out.height >= SUPPLY_AUDIT_BLOCK_HEIGHT && out.asset_type == source_asset_type)
+            member_pool = cryptonote::anonymity_pool::POOL_2;
+          if (member_pool == cryptonote::anonymity_pool::UNSET)
+            return false;
+          if (pool == cryptonote::anonymity_pool::UNSET)
+            pool = member_pool;
+          else if (pool != member_pool)
+            pool = cryptonote::anonymity_pool::MIXED;
+        }
+        LOG_PRINT_L2("Anonymity pool of the input is " << (pool == cryptonote::anonymity_pool::POOL_1 ? "Pool 1" : "Pool 2"));
+      }
+      LOG_PRINT_L2("anonymity pool of the input is " << (pool == cryptonote::anonymity_pool::POOL_1 ? "Pool 1" : "Pool 2"));
+    }
+    return pool == cryptonote::anonymity_pool::POOL_2;
+  }
+
+private:
+  cryptonote::transaction m_tx;
+  std::vector<std::vector<cryptonote::output_data_t>> m_rings;
+};
@@ -0,0 +1,120 @@
+// Copyright (c) 2023, Haven Protocol
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+
+#pragma once
+
+#include <vector>
+
+#include "crypto/crypto.h"
+#include "crypto/hash.h"
+#include "cryptonote_config.h"
+#include "cryptonote_core/tx_pool.h"
+
+// builds a block template after each new tx arrives in a pool of pool_size
+// txes, either keeping candidates between templates (incremental) or
+// checking every tx again (as a full rescan does). Loading a tx's meta and
+// checking a tx hash a meta-sized and a tx-sized blob respectively, which
+// stand in for the DB reads and parsing they cost in the daemon. Both walk
+// the whole pool, so the incremental times still grow with pool_size; the
+// difference is the per-tx loading and checking that is saved.
+template<size_t pool_size, bool incremental>
+class test_block_template_builder
+{
+public:
+  static const size_t loop_count = pool_size >= 10000 ? 10 : 100;
+  static const size_t meta_blob_size = 200;
+  static const size_t tx_blob_size = 2000;
+
+  bool init()
+  {
+    m_blob.resize(tx_blob_size);
+    crypto::rand(m_blob.size(), (uint8_t*)&m_blob[0]);
+    for (size_t i = 0; i < pool_size; ++i)
+      add_tx();
+    m_newest = m_txs.end();
+
+    // the first template after a block has to check everything either way
+    cryptonote::block bl;
+    return fill(bl);
+  }
+
+  bool test()
+  {
+    // replace the tx added by the previous iteration by a new one
+    if (m_newest != m_txs.end())
+    {
+      m_builder.remove(m_newest->second);
+      m_txs.erase(m_newest);
+    }
+    m_newest = add_tx();
+    if (!incremental)
+      m_builder.clear();
+
+    cryptonote::block bl;
+    return fill(bl) && !bl.tx_hashes.empty();
+  }
+
+private:
+  cryptonote::sorted_tx_container::iterator add_tx()
+  {
+    const crypto::hash id = crypto::rand<crypto::hash>();
+    const double fee_per_byte = 1 + crypto::rand_idx<uint64_t>(1000000) / 1000.0;
+    const std::time_t receive_time = 1600000000 + crypto::rand_idx<uint64_t>(86400);
+    return m_txs.emplace(std::pair<double, std::time_t>(fee_per_byte, receive_time), id).first;
+  }
+
+  bool fill(cryptonote::block &bl)
+  {
+    const auto load_meta = [this](const crypto::hash &txid, cryptonote::block_template_candidate &candidate)
+    {
+      crypto::hash h;
+      crypto::cn_fast_hash(m_blob.data(), meta_blob_size, h);
+      candidate.weight = 1500 + txid.data[0] * 8;
+      candidate.fee = candidate.weight * 20000;
+      candidate.fee_asset_type = "XHV";
+      return h != crypto::null_hash;
+    };
+    const auto check = [this](const crypto::hash &txid, cryptonote::block_template_candidate &candidate)
+    {
+      crypto::hash h;
+      crypto::cn_fast_hash(m_blob.data(), m_blob.size(), h);
+      candidate.key_images.push_back(reinterpret_cast<const crypto::key_image&>(txid));
+      return h != crypto::null_hash;
+    };
+
+    const cryptonote::block_template_builder::limits lim{300000, 0, HF_VERSION_USE_COLLATERAL, true, 0};
+    size_t total_weight;
+    uint64_t expected_reward;
+    std::map<std::string, uint64_t> fee_map, offshore_fee_map, xasset_fee_map;
+    m_builder.set_tip(crypto::null_hash, HF_VERSION_USE_COLLATERAL);
+    return m_builder.fill(m_txs, lim, load_meta, check, bl, total_weight, fee_map, offshore_fee_map, xasset_fee_map, expected_reward);
+  }
+
+  cryptonote::sorted_tx_container m_txs;
+  cryptonote::sorted_tx_container::iterator m_newest;
+  cryptonote::block_template_builder m_builder;
+  std::string m_blob;
+};
@@ -30,6 +30,7 @@
 
 #pragma once
 
+#include <algorithm>
 #include <vector>
 
 #include "cryptonote_basic/account.h"
@@ -37,6 +38,7 @@
 #include "cryptonote_core/cryptonote_tx_utils.h"
 #include "crypto/crypto.h"
 #include "ringct/rctSigs.h"
+#include "common/threadpool.h"
 
 #include "multi_tx_test_base.h"
 
@@ -172,3 +174,74 @@ private:
   cryptonote::account_base m_alice;
   std::vector<cryptonote::transaction> m_txes;
 };
+
+// verifies the RCT signatures of a block's worth of txes, one after the other
+// or all at once on the compute threadpool as Blockchain::handle_block_to_main_chain does
+template<size_t a_ring_size, size_t a_num_txes, bool a_parallel>
+class test_check_block_rct_signatures : private multi_tx_test_base<a_ring_size>
+{
+  static_assert(0 < a_ring_size, "ring_size must be greater than 0");
+  static_assert(0 < a_num_txes, "num_txes must be greater than 0");
+
+public:
+  static const size_t loop_count = a_ring_size <= 2 ? 20 : 5;
+  static const size_t ring_size = a_ring_size;
+
+  typedef multi_tx_test_base<a_ring_size> base_class;
+
+  bool init()
+  {
+    using namespace cryptonote;
+
+    if (!base_class::init())
+      return false;
+
+    m_alice.generate();
+
+    std::vector<tx_destination_entry> destinations;
+    destinations.push_back(tx_destination_entry(this->m_source_amount - 1, m_alice.get_keys().m_account_address, false));
+    destinations.push_back(tx_destination_entry(1, m_alice.get_keys().m_account_address, false));
+
+    crypto::secret_key tx_key;
+    std::vector<crypto::secret_key> additional_tx_keys;
+    std::unordered_map<crypto::public_key, cryptonote::subaddress_index> subaddresses;
+    subaddresses[this->m_miners[this->real_source_idx].get_keys().m_account_address.m_spend_public_key] = {0,0};
+
+    m_txes.resize(a_num_txes);
+    for (size_t n = 0; n < a_num_txes; ++n)
+    {
+      if (!construct_tx_and_get_tx_key(this->m_miners[this->real_source_idx].get_keys(), subaddresses, this->m_sources, destinations, cryptonote::account_public_address{}, std::vector<uint8_t>(), m_txes[n], 0, tx_key, additional_tx_keys, true, {rct::RangeProofPaddedBulletproof, 4}))
+        return false;
+    }
+
+    return true;
+  }
+
+  bool test()
+  {
+    if (!a_parallel)
+    {
+      for (size_t n = 0; n < m_txes.size(); ++n)
+        if (!rct::verRctNonSemanticsSimple(m_txes[n].rct_signatures))
+          return false;
+      return true;
+    }
+
+    std::vector<uint8_t> results(m_txes.size(), 1);
+    tools::threadpool& tpool = tools::threadpool::getInstanceForCompute();
+    tools::threadpool::waiter waiter(tpool);
+    for (size_t n = 0; n < m_txes.size(); ++n)
+    {
+      tpool.submit(&waiter, [this, n, &results]() {
+        results[n] = rct::verRctNonSemanticsSimple(m_txes[n].rct_signatures);
+      }, false);
+    }
+    if (!waiter.wait())
+      return false;
+    return std::find(results.begin(), results.end(), 0) == results.end();
+  }
+
+private:
+  cryptonote::account_base m_alice;
+  std::vector<cryptonote::transaction> m_txes;
+};
@@ -0,0 +1,98 @@
+// Copyright (c) 2023, Haven Protocol
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+#pragma once
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include "crypto/crypto.h"
+#include "blockchain_db/hard_fork_table.h"
+#include "hardforks/hardforks.h"
+
+// looks up the hard fork version of the heights of a 16 member ring, either
+// from the in-memory table of fork start heights or from a per-height sorted
+// index, which stands in for the hf_versions lookups (without their txn cost)
+template<bool table>
+class test_hard_fork_table
+{
+public:
+  static const size_t loop_count = 100000;
+  static const size_t ring_size = 16;
+  static const uint64_t chain_height = 1800000;
+
+  bool init()
+  {
+    size_t fork = 0;
+    for (uint64_t h = 0; h < chain_height; ++h)
+    {
+      while (fork + 1 < num_mainnet_hard_forks && mainnet_hard_forks[fork + 1].height <= h)
+        ++fork;
+      const uint8_t version = mainnet_hard_forks[fork].version;
+      if (table)
+      {
+        if (!m_table.set(h, version))
+          return false;
+      }
+      else
+        m_versions.push_back(std::make_pair(h, version));
+    }
+    for (size_t i = 0; i < 1024; ++i)
+      m_heights.push_back(crypto::rand_idx(chain_height));
+    return true;
+  }
+
+  bool test()
+  {
+    unsigned sum = 0;
+    for (size_t i = 0; i < ring_size; ++i)
+    {
+      const uint64_t height = m_heights[m_next++ % m_heights.size()];
+      uint8_t version = 0;
+      if (table)
+      {
+        if (!m_table.get(height, version))
+          return false;
+      }
+      else
+      {
+        const auto it = std::lower_bound(m_versions.begin(), m_versions.end(), std::make_pair(height, (uint8_t)0));
+        if (it == m_versions.end() || it->first != height)
+          return false;
+        version = it->second;
+      }
+      sum += version;
+    }
+    return sum > 0;
+  }
+
+private:
+  cryptonote::hard_fork_table m_table;
+  std::vector<std::pair<uint64_t, uint8_t>> m_versions;
+  std::vector<uint64_t> m_heights;
+  size_t m_next = 0;
+};
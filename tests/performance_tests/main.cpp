@@ -65,6 +65,14 @@
 #include "multiexp.h"
 #include "sig_mlsag.h"
 #include "sig_clsag.h"
+#include "pricing_record_signature.h"
+#include "txpool_sorted_container.h"
+#include "block_template_builder.h"
+#include "hard_fork_table.h"
+#include "rct_asset_counts.h"
+#include "anonymity_pool.h"
+#include "txpool_contention.h"
+#include "slippage.h"
 
 namespace po = boost::program_options;
 
@@ -186,6 +194,11 @@ int main(int argc, char** argv)
   TEST_PERFORMANCE4(filter, p, test_check_tx_signature_aggregated_bulletproofs, 2, 2, 56, 16);
   TEST_PERFORMANCE4(filter, p, test_check_tx_signature_aggregated_bulletproofs, 10, 2, 56, 16);
 
+  TEST_PERFORMANCE3(filter, p, test_check_block_rct_signatures, 16, 16, false);
+  TEST_PERFORMANCE3(filter, p, test_check_block_rct_signatures, 16, 16, true);
+  TEST_PERFORMANCE3(filter, p, test_check_block_rct_signatures, 16, 64, false);
+  TEST_PERFORMANCE3(filter, p, test_check_block_rct_signatures, 16, 64, true);
+
   TEST_PERFORMANCE4(filter, p, test_check_hash, 0, 1, 0, 1);
   TEST_PERFORMANCE4(filter, p, test_check_hash, 0, 0xffffffffffffffff, 0, 0xffffffffffffffff);
   TEST_PERFORMANCE4(filter, p, test_check_hash, 0, 0xffffffffffffffff, 0, 1);
@@ -237,6 +250,36 @@ int main(int argc, char** argv)
   TEST_PERFORMANCE3(filter, p, test_sig_clsag, 128, 2, 2);
   TEST_PERFORMANCE3(filter, p, test_sig_clsag, 256, 2, 2);
 
+  TEST_PERFORMANCE1(filter, p, test_pricing_record_signature, 1); // oracle signature verification
+  TEST_PERFORMANCE1(filter, p, test_pricing_record_signature, 16);
+  TEST_PERFORMANCE1(filter, p, test_pricing_record_signature, 128);
+
+  TEST_PERFORMANCE0(filter, p, test_txpool_sorted_container); // txpool lookup by hash with 100k txes
+
+  TEST_PERFORMANCE2(filter, p, test_block_template_builder, 1000, false); // block template after one new tx, full rescan
+  TEST_PERFORMANCE2(filter, p, test_block_template_builder, 1000, true); // same, candidates kept between templates, still walking the whole pool
+  TEST_PERFORMANCE2(filter, p, test_block_template_builder, 10000, false);
+  TEST_PERFORMANCE2(filter, p, test_block_template_builder, 10000, true);
+  TEST_PERFORMANCE2(filter, p, test_block_template_builder, 50000, false);
+  TEST_PERFORMANCE2(filter, p, test_block_template_builder, 50000, true);
+
+  TEST_PERFORMANCE1(filter, p, test_hard_fork_table, false); // hard fork versions of a 16 member ring, per-height index
+  TEST_PERFORMANCE1(filter, p, test_hard_fork_table, true); // same, from the table of fork start heights
+
+  TEST_PERFORMANCE1(filter, p, test_rct_asset_counts, false); // one asset's rct output counts over 5000 blocks, from block info records
+  TEST_PERFORMANCE1(filter, p, test_rct_asset_counts, true); // same, from the per asset table
+
+  TEST_PERFORMANCE2(filter, p, test_anonymity_pool, 2, false); // anonymity pool of a tx with two 16 member rings, asset type strings
+  TEST_PERFORMANCE2(filter, p, test_anonymity_pool, 2, true); // same, flat ring member asset ids and heights
+  TEST_PERFORMANCE2(filter, p, test_anonymity_pool, 8, false);
+  TEST_PERFORMANCE2(filter, p, test_anonymity_pool, 8, true);
+
+  TEST_PERFORMANCE1(filter, p, test_txpool_contention, false); // pool stats while txes are being admitted, under the pool lock
+  TEST_PERFORMANCE1(filter, p, test_txpool_contention, true); // same, from a DB read txn with the key images lock shared
+
+  TEST_PERFORMANCE1(filter, p, test_slippage, false); // onshore slippage, in doubles with a quad fallback for close calls
+  TEST_PERFORMANCE1(filter, p, test_slippage, true); // same slippage fraction, always in quads
+
   TEST_PERFORMANCE2(filter, p, test_ringct_mlsag, 11, false);
   TEST_PERFORMANCE2(filter, p, test_ringct_mlsag, 11, true);
 
@@ -0,0 +1,67 @@
+// Copyright (c) 2023, Haven Protocol
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+
+#pragma once
+
+#include <vector>
+
+#include "cryptonote_config.h"
+#include "offshore/pricing_record.h"
+
+template<size_t a_batch_size>
+class test_pricing_record_signature
+{
+public:
+  static const size_t loop_count = a_batch_size > 1 ? 100 : 1000;
+  static const size_t batch_size = a_batch_size;
+
+  bool init()
+  {
+    // the record mined at height 821428, signed with the mainnet oracle key
+    m_pr.set_for_height_821428();
+    m_public_key = cryptonote::get_config(cryptonote::MAINNET).ORACLE_PUBLIC_KEY;
+    m_records.assign(batch_size, &m_pr);
+    return m_pr.verifySignature(m_public_key);
+  }
+
+  bool test()
+  {
+    if (batch_size == 1)
+      return m_pr.verifySignature(m_public_key);
+
+    std::vector<uint8_t> results;
+    offshore::verify_signatures(m_records, m_public_key, results);
+    for (const uint8_t result: results)
+      if (!result)
+        return false;
+    return true;
+  }
+
+private:
+  offshore::pricing_record m_pr;
+  std::string m_public_key;
+  std::vector<const offshore::pricing_record*> m_records;
+};
@@ -0,0 +1,164 @@
+// Copyright (c) 2023, Haven Protocol
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <string>
+#include <boost/filesystem.hpp>
+#include <lmdb.h>
+
+#include "crypto/hash.h"
+#include "offshore/asset_types.h"
+#include "offshore/pricing_record.h"
+
+// reads the cumulative rct output counts of one asset over a range of heights,
+// either from block info sized records (the version 8 layout, with the counts of
+// all assets in each block's record) or from the per asset table of version 9
+template<bool per_asset>
+class test_rct_asset_counts
+{
+public:
+  static const size_t loop_count = 1000;
+  static const uint64_t chain_height = 100000;
+  static const uint64_t range = 5000;
+
+  struct block_info_8
+  {
+    uint64_t height;
+    uint64_t timestamp;
+    uint64_t coins;
+    uint64_t weight;
+    uint64_t diff_lo;
+    uint64_t diff_hi;
+    crypto::hash hash;
+    uint64_t cum_rct;
+    uint64_t long_term_block_weight;
+    offshore::pricing_record pricing_record;
+    offshore::asset_type_counts cum_rct_by_asset_type;
+  };
+
+  struct rct_asset_count
+  {
+    uint64_t height;
+    uint64_t cum_rct;
+  };
+
+  ~test_rct_asset_counts()
+  {
+    if (m_env)
+    {
+      mdb_env_close(m_env);
+      boost::system::error_code ec;
+      boost::filesystem::remove_all(m_dir, ec);
+    }
+  }
+
+  bool init()
+  {
+    m_dir = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+    if (!boost::filesystem::create_directory(m_dir))
+      return false;
+    if (mdb_env_create(&m_env) || mdb_env_set_maxdbs(m_env, 1) || mdb_env_set_mapsize(m_env, 1ull << 30) || mdb_env_open(m_env, m_dir.string().c_str(), MDB_NOSYNC, 0644))
+      return false;
+
+    MDB_txn *txn;
+    MDB_cursor *cur;
+    if (mdb_txn_begin(m_env, NULL, 0, &txn))
+      return false;
+    if (mdb_dbi_open(txn, "rct", MDB_INTEGERKEY | MDB_DUPSORT | MDB_DUPFIXED | MDB_CREATE, &m_dbi) || mdb_set_dupsort(txn, m_dbi, compare_height) || mdb_cursor_open(txn, m_dbi, &cur))
+    {
+      mdb_txn_abort(txn);
+      return false;
+    }
+    uint64_t key = per_asset ? offshore::ASSET_XUSD : 0;
+    MDB_val k = {sizeof(key), &key};
+    for (uint64_t h = 0; h < chain_height; ++h)
+    {
+      int result;
+      if (per_asset)
+      {
+        rct_asset_count rc = {h, h * 3};
+        MDB_val v = {sizeof(rc), &rc};
+        result = mdb_cursor_put(cur, &k, &v, MDB_APPENDDUP);
+      }
+      else
+      {
+        block_info_8 bi = {};
+        bi.height = h;
+        bi.cum_rct_by_asset_type.XUSD = h * 3;
+        MDB_val v = {sizeof(bi), &bi};
+        result = mdb_cursor_put(cur, &k, &v, MDB_APPENDDUP);
+      }
+      if (result)
+      {
+        mdb_txn_abort(txn);
+        return false;
+      }
+    }
+    return !mdb_txn_commit(txn);
+  }
+
+  bool test()
+  {
+    MDB_txn *txn;
+    MDB_cursor *cur;
+    if (mdb_txn_begin(m_env, NULL, MDB_RDONLY, &txn))
+      return false;
+    if (mdb_cursor_open(txn, m_dbi, &cur))
+    {
+      mdb_txn_abort(txn);
+      return false;
+    }
+    uint64_t key = per_asset ? offshore::ASSET_XUSD : 0;
+    MDB_val k = {sizeof(key), &key};
+    MDB_val v;
+    uint64_t sum = 0, n = 0;
+    int result = mdb_cursor_get(cur, &k, &v, MDB_SET);
+    if (!result)
+      result = mdb_cursor_get(cur, &k, &v, MDB_GET_MULTIPLE);
+    while (!result && n < range)
+    {
+      const size_t records = v.mv_size / (per_asset ? sizeof(rct_asset_count) : sizeof(block_info_8));
+      for (size_t i = 0; i < records && n < range; ++i, ++n)
+        sum += per_asset ? ((const rct_asset_count*)v.mv_data)[i].cum_rct : ((const block_info_8*)v.mv_data)[i].cum_rct_by_asset_type.XUSD;
+      result = mdb_cursor_get(cur, &k, &v, MDB_NEXT_MULTIPLE);
+    }
+    mdb_txn_abort(txn);
+    return n == range && sum == 3 * range * (range - 1) / 2;
+  }
+
+private:
+  static int compare_height(const MDB_val *a, const MDB_val *b)
+  {
+    const uint64_t va = *(const uint64_t*)a->mv_data, vb = *(const uint64_t*)b->mv_data;
+    return va < vb ? -1 : va > vb;
+  }
+
+  boost::filesystem::path m_dir;
+  MDB_env *m_env = NULL;
+  MDB_dbi m_dbi;
+};
@@ -0,0 +1,74 @@
+// Copyright (c) 2023, Haven Protocol
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include "cryptonote_config.h"
+#include "cryptonote_core/cryptonote_tx_utils.h"
+#include "cryptonote_core/slippage_utils.h"
+#include "offshore/pricing_record.h"
+#include "offshore/supply_snapshot.h"
+
+// slippage of an onshore, either as get_slippage computes it, in doubles with the
+// quad computation only for close calls, or as its slippage fraction always in quads
+template<bool exact>
+class test_slippage
+{
+public:
+  static const size_t loop_count = 1000;
+
+  bool init()
+  {
+    m_supply.set_tally(offshore::ASSET_XHV, 15000000000000000000ull);
+    m_supply.set_tally(offshore::ASSET_XUSD, 5000000000000000000ll);
+    m_supply.set_tally(offshore::ASSET_XBTC, 100000000000ll);
+    m_pr.xUSD = COIN;
+    m_pr.unused1 = COIN / 2;
+    m_pr.unused2 = COIN;
+    m_pr.unused3 = COIN;
+    m_pr.xBTC = 20000;
+    return true;
+  }
+
+  bool test()
+  {
+    if (exact)
+    {
+      cryptonote::slippage_inputs in;
+      cryptonote::get_slippage_inputs(in, cryptonote::transaction_type::ONSHORE, offshore::ASSET_XUSD, offshore::ASSET_XHV, 1000 * COIN, m_pr, m_supply);
+      boost::multiprecision::cpp_bin_float_quad total_slippage;
+      return cryptonote::get_total_slippage(total_slippage, in, m_pr, m_supply, HF_VERSION_SLIPPAGE_V2) && cryptonote::round_slippage_percent(total_slippage) < 100;
+    }
+    uint64_t slippage = 0;
+    const bool r = cryptonote::get_slippage(cryptonote::transaction_type::ONSHORE, "XUSD", "XHV", 1000 * COIN, slippage, m_pr, m_supply, HF_VERSION_SLIPPAGE_V2);
+    return r && slippage > 0;
+  }
+
+private:
+  offshore::supply_snapshot m_supply;
+  offshore::pricing_record m_pr;
+};
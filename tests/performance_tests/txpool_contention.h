@@ -0,0 +1,193 @@
+// Copyright (c) 2023, Haven Protocol
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <boost/filesystem.hpp>
+#include <boost/thread/shared_mutex.hpp>
+#include <boost/thread/thread.hpp>
+#include <lmdb.h>
+
+#include "syncobj.h"
+#include "crypto/hash.h"
+#include "crypto/crypto.h"
+
+// a pool stats style reader (walk every pool tx's metadata and the spent key images)
+// while another thread keeps admitting txes, each holding the pool lock for a while
+// as the input checks do: either the reader takes the pool lock like every pool
+// entry point did, or it reads from its own DB read transaction and only takes the
+// key images lock shared, which admission takes exclusively just to insert them
+template<bool shared>
+class test_txpool_contention
+{
+public:
+  static const size_t loop_count = 200;
+  static const size_t pool_size = 2000;
+  static const size_t admission_hashes = 2000; // about as long as checking a two input tx
+  static const size_t request_interval = 200; // microseconds
+
+  struct meta
+  {
+    uint64_t weight;
+    uint64_t fee;
+    uint64_t receive_time;
+    uint8_t padding[64];
+  };
+
+  ~test_txpool_contention()
+  {
+    m_stop = true;
+    if (m_writer.joinable())
+      m_writer.join();
+    if (m_env)
+    {
+      mdb_env_close(m_env);
+      boost::system::error_code ec;
+      boost::filesystem::remove_all(m_dir, ec);
+    }
+  }
+
+  bool init()
+  {
+    m_dir = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+    if (!boost::filesystem::create_directory(m_dir))
+      return false;
+    if (mdb_env_create(&m_env) || mdb_env_set_maxdbs(m_env, 1) || mdb_env_set_mapsize(m_env, 1ull << 30) || mdb_env_open(m_env, m_dir.string().c_str(), MDB_NOSYNC, 0644))
+      return false;
+
+    MDB_txn *txn;
+    if (mdb_txn_begin(m_env, NULL, 0, &txn))
+      return false;
+    if (mdb_dbi_open(txn, "txpool_meta", MDB_CREATE, &m_dbi))
+    {
+      mdb_txn_abort(txn);
+      return false;
+    }
+    for (size_t i = 0; i < pool_size; ++i)
+    {
+      if (!add_tx(txn, i))
+      {
+        mdb_txn_abort(txn);
+        return false;
+      }
+    }
+    if (mdb_txn_commit(txn))
+      return false;
+
+    m_next = pool_size;
+    m_writer = boost::thread([this](){ admit(); });
+    return true;
+  }
+
+  bool test()
+  {
+    // requests come in between admissions rather than back to back
+    boost::this_thread::sleep_for(boost::chrono::microseconds(request_interval));
+
+    std::unique_ptr<epee::critical_region_t<epee::critical_section>> pool_lock;
+    if (!shared)
+      pool_lock.reset(new epee::critical_region_t<epee::critical_section>(m_pool_lock));
+
+    MDB_txn *txn;
+    MDB_cursor *cur;
+    if (mdb_txn_begin(m_env, NULL, MDB_RDONLY, &txn))
+      return false;
+    if (mdb_cursor_open(txn, m_dbi, &cur))
+    {
+      mdb_txn_abort(txn);
+      return false;
+    }
+    MDB_val k, v;
+    uint64_t txes = 0, weight = 0;
+    for (int result = mdb_cursor_get(cur, &k, &v, MDB_FIRST); !result; result = mdb_cursor_get(cur, &k, &v, MDB_NEXT))
+    {
+      weight += ((const meta*)v.mv_data)->weight;
+      ++txes;
+    }
+    mdb_txn_abort(txn);
+
+    size_t spent = 0;
+    {
+      boost::shared_lock<boost::shared_mutex> key_images_lock(m_key_images_lock);
+      for (const auto &e: m_key_images)
+        spent += e.second.size();
+    }
+    return txes >= pool_size && weight >= pool_size && spent >= pool_size;
+  }
+
+private:
+  bool add_tx(MDB_txn *txn, size_t i)
+  {
+    crypto::hash txid;
+    crypto::cn_fast_hash(&i, sizeof(i), txid);
+    meta m = {};
+    m.weight = 1500 + i % 1000;
+    m.fee = m.weight * 20000;
+    m.receive_time = i;
+    MDB_val k = {sizeof(txid), &txid};
+    MDB_val v = {sizeof(m), &m};
+    if (mdb_put(txn, m_dbi, &k, &v, 0))
+      return false;
+
+    crypto::key_image ki;
+    crypto::cn_fast_hash(&txid, sizeof(txid), (crypto::hash&)ki);
+    boost::unique_lock<boost::shared_mutex> key_images_lock(m_key_images_lock);
+    m_key_images[ki].insert(txid);
+    return true;
+  }
+
+  void admit()
+  {
+    while (!m_stop)
+    {
+      CRITICAL_REGION_LOCAL(m_pool_lock);
+      crypto::hash h = crypto::null_hash;
+      for (size_t i = 0; i < admission_hashes; ++i)
+        crypto::cn_fast_hash(&h, sizeof(h), h);
+      MDB_txn *txn;
+      if (mdb_txn_begin(m_env, NULL, 0, &txn))
+        return;
+      if (!add_tx(txn, m_next++) || mdb_txn_commit(txn))
+        return;
+    }
+  }
+
+  boost::filesystem::path m_dir;
+  MDB_env *m_env = NULL;
+  MDB_dbi m_dbi;
+  epee::critical_section m_pool_lock;
+  boost::shared_mutex m_key_images_lock;
+  std::unordered_map<crypto::key_image, std::unordered_set<crypto::hash>> m_key_images;
+  boost::thread m_writer;
+  std::atomic<bool> m_stop{false};
+  size_t m_next;
+};
@@ -0,0 +1,73 @@
+// Copyright (c) 2023, Haven Protocol
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+
+#pragma once
+
+#include <vector>
+
+#include "crypto/crypto.h"
+#include "cryptonote_core/tx_pool.h"
+
+// looks a tx up by hash in a pool of 100k fee-sorted entries, then removes
+// and re-adds it, as take_tx and add_tx do
+class test_txpool_sorted_container
+{
+public:
+  static const size_t loop_count = 100000;
+  static const size_t pool_size = 100000;
+
+  bool init()
+  {
+    m_ids.reserve(pool_size);
+    for (size_t i = 0; i < pool_size; ++i)
+    {
+      const crypto::hash id = crypto::rand<crypto::hash>();
+      const double fee_per_byte = crypto::rand_idx<uint64_t>(1000000) / 1000.0;
+      const std::time_t receive_time = 1600000000 + crypto::rand_idx<uint64_t>(86400);
+      if (m_txs.emplace(std::pair<double, std::time_t>(fee_per_byte, receive_time), id).second)
+        m_ids.push_back(id);
+    }
+    m_next = 0;
+    return m_txs.size() == m_ids.size();
+  }
+
+  bool test()
+  {
+    const crypto::hash &id = m_ids[m_next++ % m_ids.size()];
+    const auto &by_id = m_txs.get<cryptonote::by_txid>();
+    const auto it = by_id.find(id);
+    if (it == by_id.end())
+      return false;
+    const cryptonote::tx_by_fee_and_receive_time_entry entry = *it;
+    m_txs.erase(m_txs.project<cryptonote::by_fee_and_receive_time>(it));
+    return m_txs.emplace(entry).second;
+  }
+
+private:
+  cryptonote::sorted_tx_container m_txs;
+  std::vector<crypto::hash> m_ids;
+  size_t m_next;
+};
@@ -0,0 +1,120 @@
+// Copyright (c) 2019-2021, Haven Protocol
+// Portions copyright (c) 2016-2019, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "gtest/gtest.h"
+#include "offshore/asset_types.h"
+#include "offshore/pricing_record.h"
+
+TEST(asset_types, ids_match_asset_types_order)
+{
+  ASSERT_EQ(offshore::ASSET_TYPES.size(), offshore::ASSET_COUNT);
+  for (size_t i = 0; i < offshore::ASSET_TYPES.size(); ++i)
+  {
+    const offshore::asset_id_t id = offshore::get_asset_id(offshore::ASSET_TYPES[i]);
+    ASSERT_EQ(id, i);
+    ASSERT_EQ(offshore::get_asset_name(id), offshore::ASSET_TYPES[i]);
+  }
+  ASSERT_EQ(offshore::get_asset_id("XHV"), offshore::ASSET_XHV);
+  ASSERT_EQ(offshore::get_asset_id("XUSD"), offshore::ASSET_XUSD);
+}
+
+TEST(asset_types, invalid_names)
+{
+  ASSERT_EQ(offshore::get_asset_id(std::string()), offshore::ASSET_INVALID);
+  ASSERT_EQ(offshore::get_asset_id(std::string("xhv")), offshore::ASSET_INVALID);
+  ASSERT_EQ(offshore::get_asset_id(std::string("XH")), offshore::ASSET_INVALID);
+  ASSERT_EQ(offshore::get_asset_id(std::string("XHVX")), offshore::ASSET_INVALID);
+  ASSERT_EQ(offshore::get_asset_id(std::string("XUSDX")), offshore::ASSET_INVALID);
+  ASSERT_EQ(offshore::get_asset_id(std::string("XUS\0", 4)), offshore::ASSET_INVALID);
+  ASSERT_FALSE(offshore::is_valid_asset_type("XCAN"));
+  ASSERT_TRUE(offshore::is_valid_asset_type("XNZD"));
+}
+
+TEST(asset_types, nul_padded_names)
+{
+  ASSERT_EQ(offshore::get_asset_id(std::string("XHV\0", 4)), offshore::ASSET_INVALID);
+  ASSERT_EQ(offshore::get_asset_id(std::string("XAG\0", 4)), offshore::ASSET_INVALID);
+  ASSERT_EQ(offshore::get_asset_id(std::string("XH\0V", 4)), offshore::ASSET_INVALID);
+  ASSERT_EQ(offshore::get_asset_id(std::string("XA\0\0", 4)), offshore::ASSET_INVALID);
+  ASSERT_EQ(offshore::get_asset_id("XHV\0", 4), offshore::ASSET_INVALID);
+  ASSERT_FALSE(offshore::is_valid_asset_type(std::string("XHV\0", 4)));
+  ASSERT_EQ(offshore::get_asset_id("XHV", 3), offshore::ASSET_XHV);
+}
+
+TEST(asset_types, fixed_size_db_field)
+{
+  char field[8];
+  memset(field, 0, sizeof(field));
+  memcpy(field, "XAUD", 4);
+  ASSERT_EQ(offshore::get_asset_id(field), offshore::ASSET_XAUD);
+  memset(field, 0, sizeof(field));
+  memcpy(field, "XHV", 3);
+  ASSERT_EQ(offshore::get_asset_id(field), offshore::ASSET_XHV);
+}
+
+TEST(asset_types, asset_type_counts_by_id)
+{
+  offshore::asset_type_counts counts;
+  for (size_t i = 0; i < offshore::ASSET_COUNT; ++i)
+    counts.add(offshore::asset_id_t(i), i + 1);
+  counts.add("XUSD", 100);
+  counts.add(offshore::ASSET_INVALID, 1000);
+  for (size_t i = 0; i < offshore::ASSET_COUNT; ++i)
+    ASSERT_EQ(counts[offshore::asset_id_t(i)], counts[offshore::ASSET_TYPES[i]]);
+  ASSERT_EQ(counts.XHV, 1);
+  ASSERT_EQ(counts.XAUD, 4);
+  ASSERT_EQ(counts.XUSD, 114);
+  ASSERT_EQ(counts[offshore::ASSET_INVALID], 0);
+  ASSERT_EQ(counts["XCAN"], 0);
+}
+
+TEST(asset_types, pricing_record_accessors_by_id)
+{
+  offshore::pricing_record pr;
+  pr.xAG = 1; pr.xAU = 2; pr.xAUD = 3; pr.xBTC = 4; pr.xCAD = 5; pr.xCHF = 6; pr.xCNY = 7;
+  pr.xEUR = 8; pr.xGBP = 9; pr.xJPY = 10; pr.xNOK = 11; pr.xNZD = 3; pr.xUSD = 13;
+  pr.unused1 = 14; pr.unused2 = 15; pr.unused3 = 16;
+  for (size_t i = 0; i < offshore::ASSET_COUNT; ++i)
+  {
+    const offshore::asset_id_t id = offshore::asset_id_t(i);
+    const std::string &name = offshore::ASSET_TYPES[i];
+    ASSERT_EQ(pr[id], pr[name]);
+    ASSERT_EQ(pr.spot(id), pr.spot(name));
+    ASSERT_EQ(pr.ma(id), pr.ma(name));
+    ASSERT_EQ(pr.min(id), pr.min(name));
+    ASSERT_EQ(pr.max(id), pr.max(name));
+  }
+  ASSERT_EQ(pr.spot(offshore::ASSET_XHV), 13);
+  ASSERT_EQ(pr.ma(offshore::ASSET_XHV), 14);
+  ASSERT_EQ(pr.spot(offshore::ASSET_XUSD), 15);
+  ASSERT_EQ(pr.ma(offshore::ASSET_XUSD), 16);
+  ASSERT_EQ(pr[offshore::ASSET_XNZD], 0);
+  ASSERT_THROW(pr[offshore::ASSET_INVALID], std::runtime_error);
+  ASSERT_THROW(pr.spot("XCAN"), std::runtime_error);
+}
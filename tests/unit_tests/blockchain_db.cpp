@@ -39,6 +39,7 @@
 #include "blockchain_db/blockchain_db.h"
 #include "blockchain_db/lmdb/db_lmdb.h"
 #include "cryptonote_basic/cryptonote_format_utils.h"
+#include "ringct/rctOps.h"
 
 using namespace cryptonote;
 using epee::string_tools::pod_to_hex;
@@ -149,6 +150,103 @@ std::string h2b(const std::string& s)
   return result;
 }
 
+// a block whose miner tx pays one XHV output, and one XUSD output too if with_xusd is set
+std::pair<block, blobdata> make_rct_block(const crypto::hash &prev_id, uint64_t height, bool with_xusd)
+{
+  block b;
+  b.major_version = 1;
+  b.minor_version = 0;
+  b.timestamp = height;
+  b.prev_id = prev_id;
+  b.nonce = 0;
+
+  b.miner_tx.version = HAVEN_TYPES_TRANSACTION_VERSION;
+  txin_gen in;
+  in.height = height;
+  b.miner_tx.vin.push_back(in);
+  const crypto::public_key key = rct::rct2pk(rct::scalarmultBase(rct::d2h(height + 1)));
+  for (const char *asset_type: {"XHV", "XUSD"})
+  {
+    if (!with_xusd && !strcmp(asset_type, "XUSD"))
+      break;
+    tx_out out;
+    out.amount = 1000;
+    out.target = txout_haven_key(key, asset_type, height + CRYPTONOTE_MINED_MONEY_UNLOCK_WINDOW, false, false);
+    b.miner_tx.vout.push_back(out);
+  }
+  b.miner_tx.rct_signatures.type = rct::RCTTypeNull;
+
+  return std::make_pair(b, block_to_blob(b));
+}
+
+// block_info records up to DB version 8 carried the per asset rct output counts
+struct block_info_v8
+{
+  uint64_t bi_height;
+  uint64_t bi_timestamp;
+  uint64_t bi_coins;
+  uint64_t bi_weight;
+  uint64_t bi_diff_lo;
+  uint64_t bi_diff_hi;
+  crypto::hash bi_hash;
+  uint64_t bi_cum_rct;
+  uint64_t bi_long_term_block_weight;
+  offshore::pricing_record bi_pricing_record;
+  offshore::asset_type_counts bi_cum_rct_by_asset_type;
+};
+
+#define CHECK_MDB(x) do { int r = (x); CHECK_AND_ASSERT_THROW_MES(!r, #x ": " << mdb_strerror(r)); } while(0)
+
+// turn a current DB into a version 8 one, with the counts folded back into block_info
+void downgrade_to_v8(const std::string &dir, const std::vector<uint64_t> &cum_xhv, const std::vector<uint64_t> &cum_xusd)
+{
+  MDB_env *env;
+  MDB_txn *txn;
+  MDB_cursor *cur;
+  MDB_dbi block_info, rct_asset_counts, properties;
+  MDB_val k, v;
+
+  CHECK_MDB(mdb_env_create(&env));
+  CHECK_MDB(mdb_env_set_maxdbs(env, 32));
+  CHECK_MDB(mdb_env_open(env, dir.c_str(), 0, 0644));
+  CHECK_MDB(mdb_txn_begin(env, NULL, 0, &txn));
+  CHECK_MDB(mdb_dbi_open(txn, "block_info", MDB_INTEGERKEY | MDB_DUPSORT | MDB_DUPFIXED, &block_info));
+  CHECK_MDB(mdb_set_dupsort(txn, block_info, BlockchainLMDB::compare_uint64));
+  CHECK_MDB(mdb_dbi_open(txn, "rct_asset_counts", MDB_INTEGERKEY | MDB_DUPSORT | MDB_DUPFIXED, &rct_asset_counts));
+  CHECK_MDB(mdb_dbi_open(txn, "properties", 0, &properties));
+
+  std::vector<block_info_v8> records;
+  CHECK_MDB(mdb_cursor_open(txn, block_info, &cur));
+  for (MDB_cursor_op op = MDB_FIRST; mdb_cursor_get(cur, &k, &v, op) == 0; op = MDB_NEXT)
+  {
+    CHECK_AND_ASSERT_THROW_MES(v.mv_size == offsetof(block_info_v8, bi_cum_rct_by_asset_type), "Unexpected block_info record size");
+    block_info_v8 bi;
+    memcpy(static_cast<void *>(&bi), v.mv_data, v.mv_size);
+    bi.bi_cum_rct_by_asset_type = offshore::asset_type_counts();
+    bi.bi_cum_rct_by_asset_type.add(offshore::ASSET_XHV, cum_xhv[bi.bi_height]);
+    bi.bi_cum_rct_by_asset_type.add(offshore::ASSET_XUSD, cum_xusd[bi.bi_height]);
+    records.push_back(bi);
+  }
+  mdb_cursor_close(cur);
+
+  CHECK_MDB(mdb_drop(txn, block_info, 0));
+  CHECK_MDB(mdb_drop(txn, rct_asset_counts, 0));
+  for (auto &bi: records)
+  {
+    uint64_t zero = 0;
+    k = {sizeof(zero), (void *)&zero};
+    v = {sizeof(bi), (void *)&bi};
+    CHECK_MDB(mdb_put(txn, block_info, &k, &v, MDB_APPENDDUP));
+  }
+  uint32_t version = 8;
+  k = {strlen("version") + 1, (void *)"version"};
+  v = {sizeof(version), (void *)&version};
+  CHECK_MDB(mdb_put(txn, properties, &k, &v, 0));
+
+  CHECK_MDB(mdb_txn_commit(txn));
+  mdb_env_close(env);
+}
+
 template <typename T>
 class BlockchainDBTest : public testing::Test
 {
@@ -226,6 +324,32 @@ protected:
   {
     m_prefix = prefix;
   }
+
+  // adds blocks up to the given height, with XUSD outputs from xusd_height on
+  void add_rct_blocks(uint64_t height, uint64_t xusd_height)
+  {
+    for (uint64_t h = m_db->height(); h < height; ++h)
+    {
+      const crypto::hash prev_id = h ? m_db->top_block_hash() : crypto::null_hash;
+      m_db->add_block(make_rct_block(prev_id, h, h >= xusd_height), 100, 100, h + 1, (h + 1) * 1000, {});
+    }
+  }
+
+  void check_rct_counts(uint64_t height, uint64_t xusd_height)
+  {
+    std::vector<uint64_t> heights, cum_xhv, cum_xusd, cum_all;
+    for (uint64_t h = 0; h < height; ++h)
+    {
+      heights.push_back(h);
+      cum_xhv.push_back(h + 1);
+      cum_xusd.push_back(h >= xusd_height ? h + 1 - xusd_height : 0);
+      cum_all.push_back(cum_xhv.back() + cum_xusd.back());
+    }
+    ASSERT_EQ(cum_xhv, m_db->get_block_cumulative_rct_outputs(heights, "XHV", 0).first);
+    ASSERT_EQ(cum_xusd, m_db->get_block_cumulative_rct_outputs(heights, "XUSD", 0).first);
+    ASSERT_EQ(cum_all, m_db->get_block_cumulative_rct_outputs(heights, "", 0).first);
+    ASSERT_EQ(std::vector<uint64_t>(height, 0), m_db->get_block_cumulative_rct_outputs(heights, "XEUR", 0).first);
+  }
 };
 
 using testing::Types;
@@ -339,6 +463,119 @@ TYPED_TEST(BlockchainDBTest, RetrieveBlockData)
 
   ASSERT_HASH_EQ(get_block_hash(this->m_blocks[0].first), hashes[0]);
   ASSERT_HASH_EQ(get_block_hash(this->m_blocks[1].first), hashes[1]);
+
+  ASSERT_TRUE(this->m_blocks[1].first.pricing_record == this->m_db->get_block_pricing_record(1));
+  ASSERT_THROW(this->m_db->get_block_pricing_record(2), BLOCK_DNE);
+
+  std::vector<offshore::pricing_record> prs;
+  ASSERT_NO_THROW(prs = this->m_db->get_block_pricing_records(0, 3));
+  ASSERT_EQ(2, prs.size());
+  ASSERT_TRUE(this->m_blocks[0].first.pricing_record == prs[0]);
+  ASSERT_TRUE(this->m_blocks[1].first.pricing_record == prs[1]);
+}
+
+TYPED_TEST(BlockchainDBTest, TxpoolTxView)
+{
+  boost::filesystem::path tempPath = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+  std::string dirPath = tempPath.string();
+
+  this->set_prefix(dirPath);
+
+  ASSERT_NO_THROW(this->m_db->open(dirPath));
+  this->get_filenames();
+  this->init_hard_fork();
+
+  const crypto::hash txid = get_transaction_hash(this->m_txs[0][0].first);
+  const blobdata &blob = this->m_txs[0][0].second;
+  txpool_tx_meta_t meta{};
+  meta.weight = blob.size();
+  meta.fee = 1234;
+  meta.set_relay_method(relay_method::block);
+  {
+    db_wtxn_guard guard(this->m_db);
+    ASSERT_NO_THROW(this->m_db->add_txpool_tx(txid, blobdata_ref{blob.data(), blob.size()}, meta));
+  }
+
+  const txpool_tx_meta_t *meta_view = nullptr;
+  blobdata_ref blob_view;
+
+  // the view would outlive a txn started just for it
+  ASSERT_THROW(this->m_db->get_txpool_tx_view(txid, meta_view, blob_view), DB_ERROR);
+
+  db_rtxn_guard guard(this->m_db);
+  ASSERT_FALSE(this->m_db->get_txpool_tx_view(crypto::null_hash, meta_view, blob_view));
+  ASSERT_TRUE(this->m_db->get_txpool_tx_view(txid, meta_view, blob_view));
+  ASSERT_EQ(0, memcmp(meta_view, &meta, sizeof(meta)));
+  ASSERT_EQ(blob, std::string(blob_view.data(), blob_view.size()));
+}
+
+TYPED_TEST(BlockchainDBTest, RctAssetCounts)
+{
+  boost::filesystem::path tempPath = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+  std::string dirPath = tempPath.string();
+
+  this->set_prefix(dirPath);
+
+  ASSERT_NO_THROW(this->m_db->open(dirPath));
+  this->get_filenames();
+  this->init_hard_fork();
+
+  db_wtxn_guard guard(this->m_db);
+
+  ASSERT_NO_THROW(this->add_rct_blocks(12, 5));
+  this->check_rct_counts(12, 5);
+
+  // popping a block removes its counts, down to no XUSD record at all
+  block blk;
+  std::vector<transaction> txs;
+  for (uint64_t height = 11; height >= 4; --height)
+  {
+    ASSERT_NO_THROW(this->m_db->pop_block(blk, txs));
+    this->check_rct_counts(height, 5);
+  }
+
+  // and adding blocks back on top finds the counts where it left them
+  ASSERT_NO_THROW(this->add_rct_blocks(8, 6));
+  this->check_rct_counts(8, 6);
+}
+
+TYPED_TEST(BlockchainDBTest, MigrateRctAssetCountsFromV8)
+{
+  boost::filesystem::path tempPath = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+  std::string dirPath = tempPath.string();
+
+  this->set_prefix(dirPath);
+
+  ASSERT_NO_THROW(this->m_db->open(dirPath));
+  this->get_filenames();
+  this->init_hard_fork();
+
+  // more blocks than the migration handles in one txn
+  const uint64_t height = 2500, xusd_height = 900;
+  {
+    db_wtxn_guard guard(this->m_db);
+    ASSERT_NO_THROW(this->add_rct_blocks(height, xusd_height));
+  }
+  const crypto::hash top_hash = this->m_db->top_block_hash();
+  this->m_db->close();
+
+  std::vector<uint64_t> cum_xhv, cum_xusd;
+  for (uint64_t h = 0; h < height; ++h)
+  {
+    cum_xhv.push_back(h + 1);
+    cum_xusd.push_back(h >= xusd_height ? h + 1 - xusd_height : 0);
+  }
+  ASSERT_NO_THROW(downgrade_to_v8(dirPath, cum_xhv, cum_xusd));
+
+  ASSERT_NO_THROW(this->m_db->open(dirPath));
+  ASSERT_EQ(height, this->m_db->height());
+  ASSERT_HASH_EQ(top_hash, this->m_db->top_block_hash());
+  ASSERT_EQ(1001 * 1000, this->m_db->get_block_already_generated_coins(1000));
+  this->check_rct_counts(height, xusd_height);
+
+  db_wtxn_guard guard(this->m_db);
+  ASSERT_NO_THROW(this->add_rct_blocks(height + 1, xusd_height));
+  this->check_rct_counts(height + 1, xusd_height);
 }
 
 }  // anonymous namespace
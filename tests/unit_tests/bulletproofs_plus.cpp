@@ -96,6 +96,38 @@ TEST(bulletproofs_plus, valid_aggregated)
   ASSERT_TRUE(rct::bulletproof_plus_VERIFY(proofs));
 }
 
+TEST(bulletproofs_plus, range_proof_batch)
+{
+  // proofs from several txes, as a block would batch them
+  static const size_t N_TXES = 4;
+  std::vector<rct::BulletproofPlus> proofs(N_TXES);
+  rct::range_proof_batch batch;
+  for (size_t n = 0; n < N_TXES; ++n)
+  {
+    std::vector<uint64_t> amounts;
+    rct::keyV gamma;
+    for (size_t i = 0; i < 2; ++i)
+    {
+      amounts.push_back(crypto::rand<uint64_t>());
+      gamma.push_back(rct::skGen());
+    }
+    proofs[n] = bulletproof_plus_PROVE(amounts, gamma);
+    batch.bulletproofs_plus.push_back(&proofs[n]);
+  }
+  ASSERT_TRUE(rct::verRangeProofBatch(batch));
+  ASSERT_TRUE(rct::verRangeProofBatch(rct::range_proof_batch()));
+
+  // one bad proof fails the whole batch, but only its own tx on its own
+  proofs[2].V[0] = rct::scalarmultBase(rct::skGen());
+  ASSERT_FALSE(rct::verRangeProofBatch(batch));
+  for (size_t n = 0; n < N_TXES; ++n)
+  {
+    rct::range_proof_batch tx_batch;
+    tx_batch.bulletproofs_plus.push_back(&proofs[n]);
+    ASSERT_EQ(n != 2, rct::verRangeProofBatch(tx_batch));
+  }
+}
+
 TEST(bulletproofs_plus, invalid_8)
 {
   rct::key invalid_amount = rct::zero();
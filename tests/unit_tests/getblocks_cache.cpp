@@ -0,0 +1,249 @@
+// Copyright (c) 2023, Haven Protocol
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "gtest/gtest.h"
+#include "cryptonote_basic/cryptonote_format_utils.h"
+#include "rpc/getblocks_cache.h"
+
+namespace
+{
+  std::shared_ptr<const cryptonote::getblocks_cache::block_entry> make_entry(uint64_t height, bool pruned, size_t size, uint8_t fork = 0)
+  {
+    auto entry = std::make_shared<cryptonote::getblocks_cache::block_entry>();
+    entry->hash = crypto::null_hash;
+    *(uint64_t*)entry->hash.data = height;
+    entry->hash.data[8] = fork;
+    entry->block.pruned = pruned;
+    entry->block.block = std::string(size, 'b');
+    entry->size = size;
+    return entry;
+  }
+
+  std::shared_ptr<const cryptonote::getblocks_cache::scan_entry> make_scan_entry(uint64_t height, size_t size, uint8_t fork = 0)
+  {
+    auto entry = std::make_shared<cryptonote::getblocks_cache::scan_entry>();
+    entry->hash = make_entry(height, true, 0, fork)->hash;
+    entry->txs.resize(1);
+    entry->txs[0].view_tags = std::string(size, 't');
+    entry->size = size;
+    return entry;
+  }
+
+  crypto::public_key random_pkey()
+  {
+    crypto::public_key pkey;
+    crypto::secret_key skey;
+    crypto::generate_keys(pkey, skey);
+    return pkey;
+  }
+
+  cryptonote::transaction make_tx(const crypto::public_key &tx_pkey, const std::vector<crypto::public_key> &additional_tx_pkeys, const std::vector<crypto::key_image> &key_images, size_t n_outputs, bool tagged)
+  {
+    cryptonote::transaction tx;
+    tx.version = HAVEN_TYPES_TRANSACTION_VERSION;
+    cryptonote::add_tx_pub_key_to_extra(tx, tx_pkey);
+    if (!additional_tx_pkeys.empty())
+      cryptonote::add_additional_tx_pub_keys_to_extra(tx.extra, additional_tx_pkeys);
+    for (const auto &ki: key_images)
+    {
+      cryptonote::txin_haven_key in;
+      in.amount = 0;
+      in.asset_type = "XHV";
+      in.key_offsets = {1, 2, 3};
+      in.k_image = ki;
+      tx.vin.push_back(in);
+    }
+    for (size_t k = 0; k < n_outputs; ++k)
+    {
+      crypto::view_tag view_tag;
+      view_tag.data = 'a' + k;
+      if (tagged)
+        tx.vout.push_back(cryptonote::tx_out{0, cryptonote::txout_haven_tagged_key(random_pkey(), "XHV", 0, false, false, view_tag)});
+      else
+        tx.vout.push_back(cryptonote::tx_out{0, cryptonote::txout_haven_key(random_pkey(), "XHV", 0, false, false)});
+    }
+    return tx;
+  }
+}
+
+TEST(getblocks_cache, get)
+{
+  cryptonote::getblocks_cache cache(1000);
+  cache.add(10, make_entry(10, true, 100));
+
+  ASSERT_TRUE(cache.get(10, make_entry(10, true, 0)->hash, true) != nullptr);
+  ASSERT_EQ(cache.get(10, make_entry(10, true, 0)->hash, true)->block.block.size(), 100);
+  ASSERT_TRUE(cache.get(10, make_entry(10, true, 0)->hash, false) == nullptr);
+  ASSERT_TRUE(cache.get(10, make_entry(10, true, 0, 1)->hash, true) == nullptr);
+  ASSERT_TRUE(cache.get(11, make_entry(11, true, 0)->hash, true) == nullptr);
+
+  uint64_t hits, misses;
+  cache.get_stats(hits, misses);
+  ASSERT_EQ(hits, 2);
+  ASSERT_EQ(misses, 3);
+}
+
+TEST(getblocks_cache, replace)
+{
+  cryptonote::getblocks_cache cache(1000);
+  cache.add(10, make_entry(10, true, 100));
+  cache.add(10, make_entry(10, true, 200, 1));
+  ASSERT_EQ(cache.size(), 200);
+  ASSERT_TRUE(cache.get(10, make_entry(10, true, 0)->hash, true) == nullptr);
+  ASSERT_TRUE(cache.get(10, make_entry(10, true, 0, 1)->hash, true) != nullptr);
+}
+
+TEST(getblocks_cache, evicts_lowest_blocks)
+{
+  cryptonote::getblocks_cache cache(1000);
+  for (uint64_t height = 0; height < 10; ++height)
+  {
+    cache.add(height, make_entry(height, true, 150));
+    ASSERT_LE(cache.size(), 1000);
+  }
+  ASSERT_EQ(cache.size(), 900);
+  for (uint64_t height = 0; height < 4; ++height)
+    ASSERT_TRUE(cache.get(height, make_entry(height, true, 0)->hash, true) == nullptr);
+  for (uint64_t height = 4; height < 10; ++height)
+    ASSERT_TRUE(cache.get(height, make_entry(height, true, 0)->hash, true) != nullptr);
+}
+
+TEST(getblocks_cache, invalidate)
+{
+  cryptonote::getblocks_cache cache(1000);
+  for (uint64_t height = 0; height < 5; ++height)
+  {
+    cache.add(height, make_entry(height, true, 10));
+    cache.add(height, make_entry(height, false, 20));
+  }
+  ASSERT_EQ(cache.size(), 150);
+  cache.invalidate(3);
+  ASSERT_EQ(cache.size(), 90);
+  ASSERT_TRUE(cache.get(2, make_entry(2, true, 0)->hash, true) != nullptr);
+  ASSERT_TRUE(cache.get(2, make_entry(2, false, 0)->hash, false) != nullptr);
+  ASSERT_TRUE(cache.get(3, make_entry(3, true, 0)->hash, true) == nullptr);
+  ASSERT_TRUE(cache.get(3, make_entry(3, false, 0)->hash, false) == nullptr);
+  cache.invalidate(0);
+  ASSERT_EQ(cache.size(), 0);
+}
+
+TEST(getblocks_cache, scan_entries)
+{
+  cryptonote::getblocks_cache cache(1000);
+  cache.add(10, make_entry(10, true, 100));
+  cache.add_scan(10, make_scan_entry(10, 50));
+  ASSERT_EQ(cache.size(), 150);
+
+  ASSERT_TRUE(cache.get_scan(10, make_entry(10, true, 0)->hash) != nullptr);
+  ASSERT_EQ(cache.get_scan(10, make_entry(10, true, 0)->hash)->txs[0].view_tags.size(), 50);
+  ASSERT_TRUE(cache.get_scan(10, make_entry(10, true, 0, 1)->hash) == nullptr);
+  ASSERT_TRUE(cache.get_scan(11, make_entry(11, true, 0)->hash) == nullptr);
+
+  cache.add_scan(10, make_scan_entry(10, 70, 1));
+  ASSERT_EQ(cache.size(), 170);
+  ASSERT_TRUE(cache.get_scan(10, make_entry(10, true, 0, 1)->hash) != nullptr);
+
+  // they go with the blocks on a reorg
+  cache.invalidate(10);
+  ASSERT_EQ(cache.size(), 0);
+  ASSERT_TRUE(cache.get_scan(10, make_entry(10, true, 0, 1)->hash) == nullptr);
+}
+
+TEST(getblocks_cache, evicts_lowest_scan_entries)
+{
+  cryptonote::getblocks_cache cache(1000);
+  for (uint64_t height = 0; height < 5; ++height)
+  {
+    cache.add(height, make_entry(height, true, 100));
+    cache.add_scan(height, make_scan_entry(height, 50));
+    ASSERT_LE(cache.size(), 1000);
+  }
+  ASSERT_EQ(cache.size(), 750);
+  cache.add(5, make_entry(5, true, 550));
+  ASSERT_EQ(cache.size(), 1000);
+  for (uint64_t height = 0; height < 2; ++height)
+  {
+    ASSERT_TRUE(cache.get(height, make_entry(height, true, 0)->hash, true) == nullptr);
+    ASSERT_TRUE(cache.get_scan(height, make_entry(height, true, 0)->hash) == nullptr);
+  }
+  for (uint64_t height = 2; height < 5; ++height)
+  {
+    ASSERT_TRUE(cache.get(height, make_entry(height, true, 0)->hash, true) != nullptr);
+    ASSERT_TRUE(cache.get_scan(height, make_entry(height, true, 0)->hash) != nullptr);
+  }
+}
+
+TEST(getblocks_cache, fill_tx_scan_entry_tagged)
+{
+  const crypto::public_key tx_pkey = random_pkey();
+  const std::vector<crypto::public_key> additional_tx_pkeys{random_pkey(), random_pkey(), random_pkey()};
+  const std::vector<crypto::key_image> key_images{crypto::rand<crypto::key_image>(), crypto::rand<crypto::key_image>()};
+  const cryptonote::transaction tx = make_tx(tx_pkey, additional_tx_pkeys, key_images, 3, true);
+
+  cryptonote::COMMAND_RPC_GET_BLOCKS_SCAN::tx_scan_entry entry;
+  cryptonote::fill_tx_scan_entry(tx, entry);
+  ASSERT_EQ(entry.tx_pub_keys, std::vector<crypto::public_key>{tx_pkey});
+  ASSERT_EQ(entry.additional_tx_pub_keys, additional_tx_pkeys);
+  ASSERT_EQ(entry.key_images, key_images);
+  ASSERT_EQ(entry.view_tags, "abc");
+  ASSERT_TRUE(entry.output_keys.empty());
+}
+
+TEST(getblocks_cache, fill_tx_scan_entry_untagged)
+{
+  const crypto::public_key tx_pkey = random_pkey();
+  cryptonote::transaction tx = make_tx(tx_pkey, {}, {}, 2, true);
+  // a single untagged output means every output key is sent
+  const cryptonote::transaction untagged = make_tx(tx_pkey, {}, {}, 1, false);
+  tx.vout.push_back(untagged.vout[0]);
+
+  cryptonote::COMMAND_RPC_GET_BLOCKS_SCAN::tx_scan_entry entry;
+  cryptonote::fill_tx_scan_entry(tx, entry);
+  ASSERT_EQ(entry.tx_pub_keys, std::vector<crypto::public_key>{tx_pkey});
+  ASSERT_TRUE(entry.additional_tx_pub_keys.empty());
+  ASSERT_TRUE(entry.key_images.empty());
+  ASSERT_TRUE(entry.view_tags.empty());
+  ASSERT_EQ(entry.output_keys.size(), 3);
+  for (size_t k = 0; k < tx.vout.size(); ++k)
+  {
+    crypto::public_key output_key;
+    ASSERT_TRUE(cryptonote::get_output_public_key(tx.vout[k], output_key));
+    ASSERT_EQ(entry.output_keys[k], output_key);
+  }
+}
+
+TEST(getblocks_cache, fill_tx_scan_entry_miner_tx)
+{
+  const crypto::public_key tx_pkey = random_pkey();
+  cryptonote::transaction tx = make_tx(tx_pkey, {}, {}, 1, true);
+  tx.vin.push_back(cryptonote::txin_gen{10});
+
+  cryptonote::COMMAND_RPC_GET_BLOCKS_SCAN::tx_scan_entry entry;
+  cryptonote::fill_tx_scan_entry(tx, entry);
+  ASSERT_TRUE(entry.key_images.empty());
+  ASSERT_EQ(entry.view_tags, "a");
+}
@@ -32,6 +32,7 @@
 #include "gtest/gtest.h"
 
 #include "blockchain_db/blockchain_db.h"
+#include "blockchain_db/hard_fork_table.h"
 #include "cryptonote_basic/cryptonote_format_utils.h"
 #include "cryptonote_basic/hardfork.h"
 #include "blockchain_db/testdb.h"
@@ -604,3 +605,54 @@ TEST(get, earliest_ideal_height)
     ASSERT_EQ(hf.get_earliest_ideal_height_for_version(10), std::numeric_limits<uint64_t>::max());
 }
 
+
+TEST(hard_fork_table, lookup)
+{
+    hard_fork_table table;
+    uint8_t v;
+    ASSERT_FALSE(table.get(0, v));
+    ASSERT_FALSE(table.set(1, 1));
+
+    const uint8_t versions[] = {1, 1, 1, 2, 2, 5, 6, 6, 6, 6};
+    for (uint64_t h = 0; h < sizeof(versions); ++h)
+        ASSERT_TRUE(table.set(h, versions[h]));
+    ASSERT_EQ(table.height(), sizeof(versions));
+    ASSERT_EQ(table.runs(), 4);
+    for (uint64_t h = 0; h < sizeof(versions); ++h)
+    {
+        ASSERT_TRUE(table.get(h, v));
+        ASSERT_EQ(v, versions[h]);
+    }
+    ASSERT_FALSE(table.get(sizeof(versions), v));
+    ASSERT_FALSE(table.set(sizeof(versions) + 1, 6));
+    ASSERT_EQ(table.height(), sizeof(versions));
+}
+
+TEST(hard_fork_table, overwrite)
+{
+    hard_fork_table table;
+    uint8_t v;
+    for (uint64_t h = 0; h < 10; ++h)
+        ASSERT_TRUE(table.set(h, h < 5 ? 1 : 2));
+
+    // a reorg rewrites a height, the ones above it are no longer known
+    ASSERT_TRUE(table.set(7, 3));
+    ASSERT_EQ(table.height(), 8);
+    ASSERT_TRUE(table.get(6, v));
+    ASSERT_EQ(v, 2);
+    ASSERT_TRUE(table.get(7, v));
+    ASSERT_EQ(v, 3);
+    ASSERT_FALSE(table.get(8, v));
+
+    ASSERT_TRUE(table.set(5, 1));
+    ASSERT_EQ(table.runs(), 1);
+    ASSERT_TRUE(table.get(5, v));
+    ASSERT_EQ(v, 1);
+
+    table.truncate(3);
+    ASSERT_EQ(table.height(), 3);
+    ASSERT_FALSE(table.get(3, v));
+    table.truncate(0);
+    ASSERT_EQ(table.runs(), 0);
+    ASSERT_FALSE(table.get(0, v));
+}
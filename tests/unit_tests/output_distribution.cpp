@@ -184,3 +184,107 @@ TEST(output_distribution, part_noncumulative)
   ASSERT_EQ(res->distribution.size(), 5);
   ASSERT_EQ(res->distribution, std::vector<uint64_t>({0, 1, 5, 1, 4}));
 }
+
+namespace
+{
+
+// a chain whose blocks above fork_height differ from the original ones once forked, and
+// whose rct outputs for an asset are the test distribution (doubled on the fork)
+struct forking_chain
+{
+  uint64_t height = test_distribution_size;
+  uint64_t fork_height = test_distribution_size;
+  bool forked = false;
+  size_t calls = 0;
+
+  uint64_t count(uint64_t h) const { return test_distribution[h] * (forked && h >= fork_height ? 2 : 1); }
+  uint64_t cum(uint64_t h) const { uint64_t c = 0; for (uint64_t i = 0; i <= h; ++i) c += count(i); return c; }
+
+  bool get(uint64_t amount, uint64_t from, uint64_t to, std::string asset_type, uint64_t default_tx_spendable_age, uint64_t &start_height, std::vector<uint64_t> &distribution, uint64_t &base, uint64_t &num_spendable_global_outs)
+  {
+    ++calls;
+    if (to < from || to >= height)
+      return false;
+    start_height = from;
+    base = from > 0 ? cum(from - 1) : 0;
+    distribution.clear();
+    for (uint64_t h = from; h <= to; ++h)
+      distribution.push_back(cum(h));
+    const uint64_t real_start = from > 0 ? from - 1 : from;
+    num_spendable_global_outs = default_tx_spendable_age && default_tx_spendable_age <= to - real_start + 1 ? cum(to + 1 - default_tx_spendable_age) : 0;
+    return true;
+  }
+
+  crypto::hash hash(uint64_t h) const
+  {
+    crypto::hash hash = crypto::null_hash;
+    *((uint64_t*)&hash) = h;
+    if (forked && h >= fork_height)
+      hash.data[8] = 1 + fork_height;
+    return hash;
+  }
+};
+
+boost::optional<cryptonote::rpc::output_distribution_data> get_cached_distribution(forking_chain &chain, const std::string &asset_type, uint64_t to)
+{
+  using namespace std::placeholders;
+  return cryptonote::rpc::RpcHandler::get_output_distribution(std::bind(&forking_chain::get, &chain, _1, _2, _3, _4, _5, _6, _7, _8, _9),
+      0, 0, to, asset_type, 2, std::bind(&forking_chain::hash, &chain, _1), true, chain.height);
+}
+
+}
+
+TEST(output_distribution, cache)
+{
+  forking_chain chain;
+  chain.height = 20;
+  boost::optional<cryptonote::rpc::output_distribution_data> res;
+
+  // first call fills the cache, a shorter range is then served from it
+  res = get_cached_distribution(chain, "XCACHE1", 19);
+  ASSERT_TRUE(res != boost::none);
+  ASSERT_EQ(res->distribution.size(), 20);
+  ASSERT_EQ(res->distribution.back(), chain.cum(19));
+  ASSERT_EQ(chain.calls, 1);
+  res = get_cached_distribution(chain, "XCACHE1", 15);
+  ASSERT_TRUE(res != boost::none);
+  ASSERT_EQ(res->distribution.size(), 16);
+  ASSERT_EQ(res->distribution.back(), chain.cum(15));
+  ASSERT_EQ(res->num_spendable_global_outs, chain.cum(14));
+
+  // new blocks only fetch the new heights
+  chain.height = test_distribution_size;
+  chain.calls = 0;
+  res = get_cached_distribution(chain, "XCACHE1", 25);
+  ASSERT_TRUE(res != boost::none);
+  ASSERT_EQ(res->distribution.size(), 26);
+  for (uint64_t h = 0; h <= 25; ++h)
+    ASSERT_EQ(res->distribution[h], chain.cum(h));
+  ASSERT_EQ(res->num_spendable_global_outs, chain.cum(24));
+  ASSERT_EQ(res->start_height, 0);
+  ASSERT_EQ(chain.calls, 2); // the new heights, and the spendable output count
+
+  // a reorg of the top blocks keeps everything up to 10 blocks below the cached top
+  chain.fork_height = 22;
+  chain.forked = true;
+  chain.calls = 0;
+  res = get_cached_distribution(chain, "XCACHE1", 31);
+  ASSERT_TRUE(res != boost::none);
+  ASSERT_EQ(res->distribution.size(), 32);
+  for (uint64_t h = 0; h <= 31; ++h)
+    ASSERT_EQ(res->distribution[h], chain.cum(h));
+  ASSERT_EQ(chain.calls, 2);
+
+  // a deeper one starts over
+  chain.fork_height = 5;
+  res = get_cached_distribution(chain, "XCACHE1", 31);
+  ASSERT_TRUE(res != boost::none);
+  for (uint64_t h = 0; h <= 31; ++h)
+    ASSERT_EQ(res->distribution[h], chain.cum(h));
+
+  // other assets have their own entries
+  chain.calls = 0;
+  res = get_cached_distribution(chain, "XCACHE2", 31);
+  ASSERT_TRUE(res != boost::none);
+  ASSERT_EQ(chain.calls, 1);
+}
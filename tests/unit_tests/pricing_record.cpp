@@ -27,6 +27,13 @@
 // STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
 // THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
+#include <sstream>
+#include <openssl/ec.h>
+#include <openssl/err.h>
+#include <openssl/evp.h>
+#include <openssl/obj_mac.h>
+#include <openssl/sha.h>
+
 #include "gtest/gtest.h"
 #include "offshore/pricing_record.h"
 
@@ -116,3 +123,143 @@ TEST(pricing_record, verify_known_good_fail_if_edited)
   EXPECT_FALSE(pr.valid(cryptonote::network_type::MAINNET, 16, 1632401454, 1632400454));
 }
 
+
+TEST(pricing_record, verify_signatures_batch)
+{
+  const std::string public_key = cryptonote::get_config(cryptonote::network_type::MAINNET).ORACLE_PUBLIC_KEY;
+  offshore::pricing_record good;
+  good.set_for_height_821428();
+  offshore::pricing_record edited = good;
+  edited.xAG += 1;
+
+  std::vector<const offshore::pricing_record*> records;
+  for (size_t i = 0; i < 32; ++i)
+    records.push_back(i % 3 ? &good : &edited);
+  std::vector<uint8_t> results;
+  offshore::verify_signatures(records, public_key, results);
+  ASSERT_EQ(results.size(), records.size());
+  for (size_t i = 0; i < records.size(); ++i)
+    EXPECT_EQ(results[i] != 0, records[i] == &good);
+
+  offshore::verify_signatures({}, public_key, results);
+  EXPECT_TRUE(results.empty());
+}
+
+TEST(pricing_record, verify_signature_cached_key)
+{
+  const std::string public_key = cryptonote::get_config(cryptonote::network_type::MAINNET).ORACLE_PUBLIC_KEY;
+  offshore::pricing_record pr;
+  pr.set_for_height_821428();
+  EXPECT_TRUE(pr.verifySignature(public_key));
+  EXPECT_EQ(offshore::get_public_key(public_key), offshore::get_public_key(public_key));
+  EXPECT_TRUE(pr.verifySignature(offshore::get_public_key(public_key).get()));
+  EXPECT_FALSE(offshore::get_public_key("not a key"));
+}
+
+namespace
+{
+  // the message the oracle signs for a v1 record without a timestamp
+  std::string get_v1_message(const offshore::pricing_record &pr)
+  {
+    std::ostringstream oss;
+    oss << "{\"xAG\":" << pr.xAG << ",\"xAU\":" << pr.xAU << ",\"xAUD\":" << pr.xAUD << ",\"xBTC\":" << pr.xBTC
+        << ",\"xCAD\":" << pr.xCAD << ",\"xCHF\":" << pr.xCHF << ",\"xCNY\":" << pr.xCNY << ",\"xEUR\":" << pr.xEUR
+        << ",\"xGBP\":" << pr.xGBP << ",\"xJPY\":" << pr.xJPY << ",\"xNOK\":" << pr.xNOK << ",\"xNZD\":" << pr.xNZD
+        << ",\"xUSD\":" << pr.xUSD << ",\"unused1\":" << pr.unused1 << ",\"unused2\":" << pr.unused2
+        << ",\"unused3\":" << pr.unused3 << "}";
+    return oss.str();
+  }
+
+  // Sets the leading bytes of r (offset 0) or s (offset 32), and returns a P-256 key for which
+  // the resulting r+s is a valid signature of the record, so only the encoding can fail it.
+  // The last byte of r is bumped until r is the x coordinate of a curve point R, and the key
+  // is then Q = (s*R - e*G) / r, which gives (e/s)*G + (r/s)*Q = R.
+  std::shared_ptr<EVP_PKEY> set_signature_bytes(offshore::pricing_record &pr, size_t offset, const std::vector<uint8_t> &bytes)
+  {
+    pr.set_for_height_821428();
+    memcpy(pr.signature + offset, bytes.data(), bytes.size());
+
+    const std::string message = get_v1_message(pr);
+    unsigned char digest[SHA256_DIGEST_LENGTH];
+    SHA256((const unsigned char*)message.data(), message.size(), digest);
+
+    EC_GROUP *group = EC_GROUP_new_by_curve_name(NID_X9_62_prime256v1);
+    BN_CTX *ctx = BN_CTX_new();
+    BIGNUM *n = BN_new(), *r = BN_new(), *s = BN_new(), *e = BN_new(), *r_inv = BN_new(), *k1 = BN_new(), *k2 = BN_new();
+    EC_POINT *R = EC_POINT_new(group), *Q = EC_POINT_new(group);
+    EC_GROUP_get_order(group, n, ctx);
+    BN_bin2bn(digest, sizeof(digest), e);
+    BN_bin2bn(pr.signature + 32, 32, s);
+    while (true)
+    {
+      BN_bin2bn(pr.signature, 32, r);
+      if (EC_POINT_set_compressed_coordinates(group, R, r, 0, ctx) == 1)
+        break;
+      ++pr.signature[31];
+    }
+    ERR_clear_error();
+    BN_mod_inverse(r_inv, r, n, ctx);
+    BN_mod_mul(k1, s, r_inv, n, ctx);
+    BN_mod_mul(k2, e, r_inv, n, ctx);
+    BN_sub(k2, n, k2);
+    EC_POINT_mul(group, Q, k2, R, k1, ctx);
+
+    EC_KEY *key = EC_KEY_new_by_curve_name(NID_X9_62_prime256v1);
+    EC_KEY_set_public_key(key, Q);
+    std::shared_ptr<EVP_PKEY> pkey(EVP_PKEY_new(), EVP_PKEY_free);
+    EVP_PKEY_assign_EC_KEY(pkey.get(), key);
+
+    EC_POINT_free(Q);
+    EC_POINT_free(R);
+    BN_free(k2);
+    BN_free(k1);
+    BN_free(r_inv);
+    BN_free(e);
+    BN_free(s);
+    BN_free(r);
+    BN_free(n);
+    BN_CTX_free(ctx);
+    EC_GROUP_free(group);
+    return pkey;
+  }
+}
+
+TEST(pricing_record, accept_legacy_minimal_encoding)
+{
+  // the old hand-built DER was minimal for these, so they are valid on chain
+  offshore::pricing_record pr;
+  std::shared_ptr<EVP_PKEY> key = set_signature_bytes(pr, 0, {0x2f});
+  EXPECT_TRUE(pr.verifySignature(key.get()));
+  key = set_signature_bytes(pr, 0, {0x00, 0x7f});
+  EXPECT_TRUE(pr.verifySignature(key.get()));
+  key = set_signature_bytes(pr, 0, {0x00, 0x80});
+  EXPECT_TRUE(pr.verifySignature(key.get()));
+  key = set_signature_bytes(pr, 0, {0x00, 0x00, 0x80});
+  EXPECT_TRUE(pr.verifySignature(key.get()));
+  key = set_signature_bytes(pr, 0, {0x00, 0x00, 0xff});
+  EXPECT_TRUE(pr.verifySignature(key.get()));
+  key = set_signature_bytes(pr, 32, {0x00, 0x00, 0x80});
+  EXPECT_TRUE(pr.verifySignature(key.get()));
+  key = set_signature_bytes(pr, 32, {0x00, 0x00, 0xff});
+  EXPECT_TRUE(pr.verifySignature(key.get()));
+  key = set_signature_bytes(pr, 32, {0x80});
+  EXPECT_TRUE(pr.verifySignature(key.get()));
+}
+
+TEST(pricing_record, reject_legacy_non_minimal_encoding)
+{
+  // the old hand-built DER was not minimal for these, so OpenSSL never accepted them
+  offshore::pricing_record pr;
+  std::shared_ptr<EVP_PKEY> key = set_signature_bytes(pr, 0, {0x00, 0x00, 0x7f});
+  EXPECT_FALSE(pr.verifySignature(key.get()));
+  key = set_signature_bytes(pr, 0, {0x00, 0x00, 0x00, 0x80});
+  EXPECT_FALSE(pr.verifySignature(key.get()));
+  key = set_signature_bytes(pr, 32, {0x00, 0x7f});
+  EXPECT_FALSE(pr.verifySignature(key.get()));
+  key = set_signature_bytes(pr, 32, {0x00, 0x80});
+  EXPECT_FALSE(pr.verifySignature(key.get()));
+  key = set_signature_bytes(pr, 32, {0x00, 0x00, 0x7f});
+  EXPECT_FALSE(pr.verifySignature(key.get()));
+  key = set_signature_bytes(pr, 32, {0x00, 0x00, 0x00, 0x80});
+  EXPECT_FALSE(pr.verifySignature(key.get()));
+}
@@ -0,0 +1,238 @@
+// Copyright (c) 2023, Haven Protocol
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <boost/thread/mutex.hpp>
+
+#include "gtest/gtest.h"
+
+#include "crypto/crypto.h"
+#include "net/http_server_impl_base.h"
+#include "storages/portable_storage_template_helper.h"
+#include "cryptonote_core/pricing_record_service.h"
+#include "rpc/core_rpc_server_commands_defs.h"
+
+namespace
+{
+  // Local stand-in for the oracle, serves a fixed body for any request
+  class stand_in_oracle: public epee::http_server_impl_base<stand_in_oracle>
+  {
+  public:
+    typedef epee::net_utils::connection_context_base connection_context;
+
+    bool start()
+    {
+      auto rng = [](size_t len, uint8_t *ptr){ return crypto::rand(len, ptr); };
+      if (!init(rng, "0", "127.0.0.1", "::", false, true, {}, boost::none, epee::net_utils::ssl_support_t::e_ssl_support_disabled))
+        return false;
+      return run(1, false);
+    }
+
+    void stop()
+    {
+      send_stop_signal();
+      timed_wait_server_stop(5000);
+      deinit();
+    }
+
+    std::string url() { return "127.0.0.1:" + std::to_string(get_binded_port()); }
+
+    void serve(const offshore::pricing_record &pr)
+    {
+      cryptonote::COMMAND_RPC_GET_PRICING_RECORD::response res = AUTO_VAL_INIT(res);
+      res.pr = pr;
+      std::string body;
+      ASSERT_TRUE(epee::serialization::store_t_to_json(res, body));
+      serve(body);
+    }
+
+    void serve(const std::string &body)
+    {
+      boost::unique_lock<boost::mutex> lock(m_lock);
+      m_body = body;
+    }
+
+    std::vector<std::string> uris()
+    {
+      boost::unique_lock<boost::mutex> lock(m_lock);
+      return m_uris;
+    }
+
+    virtual bool handle_http_request(const epee::net_utils::http::http_request_info& query_info,
+      epee::net_utils::http::http_response_info& response, connection_context& context) override
+    {
+      boost::unique_lock<boost::mutex> lock(m_lock);
+      m_uris.push_back(query_info.m_URI);
+      response.m_response_code = 200;
+      response.m_response_comment = "OK";
+      response.m_mime_tipe = "application/json";
+      response.m_body = m_body;
+      return true;
+    }
+
+  private:
+    boost::mutex m_lock;
+    std::string m_body;
+    std::vector<std::string> m_uris;
+  };
+
+  class pricing_record_service_test: public ::testing::Test
+  {
+  protected:
+    void SetUp() override
+    {
+      ASSERT_TRUE(oracle.start());
+      pr.xUSD = 1000000000000;
+      pr.xBTC = 12345;
+      pr.timestamp = 1600000000;
+    }
+
+    void TearDown() override
+    {
+      oracle.stop();
+    }
+
+    stand_in_oracle oracle;
+    offshore::pricing_record pr;
+  };
+}
+
+TEST_F(pricing_record_service_test, nothing_cached_before_fetch)
+{
+  cryptonote::pricing_record_service service({oracle.url()}, "", epee::net_utils::ssl_support_t::e_ssl_support_disabled);
+  offshore::pricing_record cached;
+  ASSERT_FALSE(service.get(cached));
+  ASSERT_FALSE(service.fetch()); // no hard fork version set yet
+  const auto stats = service.get_stats();
+  ASSERT_EQ(stats.fetches, 0);
+  ASSERT_EQ(stats.staleness, std::numeric_limits<uint64_t>::max());
+}
+
+TEST_F(pricing_record_service_test, fetch_caches_record)
+{
+  oracle.serve(pr);
+  cryptonote::pricing_record_service service({oracle.url()}, "", epee::net_utils::ssl_support_t::e_ssl_support_disabled);
+  service.set_hf_version(HF_VERSION_OFFSHORE_PRICING);
+  ASSERT_TRUE(service.fetch());
+
+  offshore::pricing_record cached;
+  ASSERT_TRUE(service.get(cached));
+  ASSERT_EQ(cached.xUSD, pr.xUSD);
+  ASSERT_EQ(cached.xBTC, pr.xBTC);
+  ASSERT_EQ(cached.timestamp, 0); // not used before HF_VERSION_XASSET_FEES_V2
+
+  const auto stats = service.get_stats();
+  ASSERT_EQ(stats.fetches, 1);
+  ASSERT_EQ(stats.failures, 0);
+  ASSERT_LE(stats.last_latency_ms, stats.max_latency_ms);
+  ASSERT_NE(stats.last_success_time, 0);
+  ASSERT_LE(stats.staleness, 1);
+
+  const auto uris = oracle.uris();
+  ASSERT_EQ(uris.size(), 1);
+  ASSERT_EQ(uris[0].find("/price/?timestamp="), 0);
+  ASSERT_NE(uris[0].find("&version=" + std::to_string(HF_VERSION_OFFSHORE_PRICING)), std::string::npos);
+}
+
+TEST_F(pricing_record_service_test, garbage_counts_as_failure)
+{
+  oracle.serve(std::string("not a pricing record"));
+  cryptonote::pricing_record_service service({oracle.url()}, "", epee::net_utils::ssl_support_t::e_ssl_support_disabled);
+  service.set_hf_version(HF_VERSION_OFFSHORE_PRICING);
+  ASSERT_FALSE(service.fetch());
+
+  offshore::pricing_record cached;
+  ASSERT_FALSE(service.get(cached));
+  const auto stats = service.get_stats();
+  ASSERT_EQ(stats.fetches, 1);
+  ASSERT_EQ(stats.failures, 1);
+  ASSERT_EQ(stats.last_success_time, 0);
+}
+
+TEST_F(pricing_record_service_test, failure_keeps_previous_record)
+{
+  oracle.serve(pr);
+  cryptonote::pricing_record_service service({oracle.url()}, "", epee::net_utils::ssl_support_t::e_ssl_support_disabled);
+  service.set_hf_version(HF_VERSION_OFFSHORE_PRICING);
+  ASSERT_TRUE(service.fetch());
+  oracle.serve(std::string("<html>oracle down</html>"));
+  ASSERT_FALSE(service.fetch());
+
+  offshore::pricing_record cached;
+  ASSERT_TRUE(service.get(cached));
+  ASSERT_EQ(cached.xUSD, pr.xUSD);
+  const auto stats = service.get_stats();
+  ASSERT_EQ(stats.fetches, 2);
+  ASSERT_EQ(stats.failures, 1);
+}
+
+TEST_F(pricing_record_service_test, unverified_record_is_rejected)
+{
+  oracle.serve(pr);
+  cryptonote::pricing_record_service service({oracle.url()}, "not a key", epee::net_utils::ssl_support_t::e_ssl_support_disabled);
+  service.set_hf_version(HF_VERSION_OFFSHORE_FULL);
+  ASSERT_FALSE(service.fetch());
+
+  offshore::pricing_record cached;
+  ASSERT_FALSE(service.get(cached));
+  ASSERT_EQ(service.get_stats().failures, 1);
+}
+
+TEST_F(pricing_record_service_test, record_is_per_hard_fork)
+{
+  oracle.serve(pr);
+  cryptonote::pricing_record_service service({oracle.url()}, "", epee::net_utils::ssl_support_t::e_ssl_support_disabled);
+  service.set_hf_version(HF_VERSION_OFFSHORE_PRICING);
+  ASSERT_TRUE(service.fetch());
+
+  offshore::pricing_record cached;
+  ASSERT_TRUE(service.get(cached));
+  service.set_hf_version(HF_VERSION_OFFSHORE_PRICING + 1);
+  ASSERT_FALSE(service.get(cached));
+}
+
+TEST_F(pricing_record_service_test, background_polling)
+{
+  oracle.serve(pr);
+  cryptonote::pricing_record_service service({oracle.url()}, "", epee::net_utils::ssl_support_t::e_ssl_support_disabled);
+  service.set_hf_version(HF_VERSION_OFFSHORE_PRICING);
+  ASSERT_TRUE(service.start(3600));
+  ASSERT_FALSE(service.start(3600));
+
+  offshore::pricing_record cached;
+  for (int i = 0; i < 500 && !service.get(cached); ++i)
+    boost::this_thread::sleep_for(boost::chrono::milliseconds(10));
+  ASSERT_EQ(cached.xUSD, pr.xUSD);
+
+  // a refresh does not wait for the poll interval
+  service.refresh();
+  for (int i = 0; i < 500 && service.get_stats().fetches < 2; ++i)
+    boost::this_thread::sleep_for(boost::chrono::milliseconds(10));
+  ASSERT_GE(service.get_stats().fetches, 2);
+
+  service.stop();
+  ASSERT_FALSE(service.is_running());
+}
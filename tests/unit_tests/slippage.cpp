@@ -0,0 +1,146 @@
+// Copyright (c) 2023, Haven Protocol
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <cmath>
+#include <random>
+#include "gtest/gtest.h"
+#include "cryptonote_config.h"
+#include "cryptonote_core/cryptonote_tx_utils.h"
+#include "cryptonote_core/slippage_utils.h"
+#include "offshore/supply_snapshot.h"
+
+namespace
+{
+  using tt = cryptonote::transaction_type;
+
+  const struct { tt type; const char *source; const char *dest; } conversions[] = {
+    {tt::OFFSHORE, "XHV", "XUSD"},
+    {tt::ONSHORE, "XUSD", "XHV"},
+    {tt::XUSD_TO_XASSET, "XUSD", "XBTC"},
+    {tt::XASSET_TO_XUSD, "XBTC", "XUSD"}
+  };
+}
+
+// whenever the double evaluation of the slippage fraction decides the rounding on
+// its own, it must round to what the quad evaluation gives
+TEST(slippage, matches_quad_computation)
+{
+  std::mt19937_64 rng(0);
+  const auto log_uniform = [&rng](double lo, double hi) { return std::exp(std::uniform_real_distribution<double>(std::log(lo), std::log(hi))(rng)); };
+  size_t valid = 0, decided = 0;
+  for (int i = 0; i < 4000; ++i)
+  {
+    offshore::supply_snapshot supply;
+    supply.set_tally(offshore::ASSET_XHV, (int64_t)log_uniform(1e15, 9e18));
+    supply.set_tally(offshore::ASSET_XUSD, (int64_t)log_uniform(1e12, 9e18));
+    supply.set_tally(offshore::ASSET_XBTC, (int64_t)log_uniform(1e8, 1e15));
+    offshore::pricing_record pr;
+    pr.xUSD = log_uniform(1e9, 1e13);
+    pr.unused1 = pr.xUSD * log_uniform(0.5, 2);
+    pr.unused2 = log_uniform(5e11, 1.2e12);
+    pr.unused3 = log_uniform(5e11, 1.2e12);
+    pr.xBTC = log_uniform(1e4, 1e6);
+    const auto &c = conversions[i % 4];
+    const uint8_t hf_version = (i / 4) % 2 ? HF_VERSION_SLIPPAGE_V2 : HF_VERSION_SLIPPAGE;
+    const uint64_t amount = log_uniform(1e8, 1e18);
+
+    cryptonote::slippage_inputs in;
+    cryptonote::get_slippage_inputs(in, c.type, offshore::get_asset_id(c.source), offshore::get_asset_id(c.dest), amount, pr, supply);
+    double total_double = 0.0;
+    boost::multiprecision::cpp_bin_float_quad total_quad;
+    const bool r = cryptonote::get_total_slippage(total_double, in, pr, supply, hf_version);
+    const bool r_quad = cryptonote::get_total_slippage(total_quad, in, pr, supply, hf_version);
+    ASSERT_EQ(r, r_quad);
+    if (!r)
+      continue;
+    ++valid;
+
+    if (hf_version < HF_VERSION_SLIPPAGE_V2)
+    {
+      uint64_t slippage = 0;
+      if (cryptonote::round_slippage_v1(total_double, amount, slippage))
+      {
+        ASSERT_EQ(slippage, cryptonote::round_slippage_v1(total_quad, in.convert_amount));
+        ++decided;
+      }
+    }
+    else
+    {
+      boost::multiprecision::uint128_t percent = 0;
+      if (cryptonote::round_slippage_percent(total_double, percent))
+      {
+        ASSERT_EQ(percent, cryptonote::round_slippage_percent(total_quad));
+        ++decided;
+      }
+    }
+  }
+  // most draws are valid conversions, the rest fail on both paths
+  ASSERT_GT(valid, 3000);
+  ASSERT_GT(decided, 0);
+}
+
+// the pool takes the slippage the incoming tx checks computed only while the supply
+// snapshot they used is still the current one, and recomputes it once a block changed it
+TEST(slippage, reuses_only_same_snapshot)
+{
+  offshore::supply_snapshot supply;
+  supply.version = 7;
+  supply.set_tally(offshore::ASSET_XHV, (int64_t)30000000 * COIN);
+  supply.set_tally(offshore::ASSET_XUSD, (int64_t)5000000 * COIN);
+  supply.set_tally(offshore::ASSET_XBTC, (int64_t)100 * COIN);
+  offshore::pricing_record pr;
+  pr.xBTC = 20000;
+  pr.xUSD = COIN;
+  pr.unused1 = COIN / 2;
+  pr.unused2 = COIN;
+  pr.unused3 = COIN;
+  const uint64_t amount = 1000 * COIN;
+
+  uint64_t expected = 0;
+  ASSERT_TRUE(cryptonote::get_slippage(tt::XUSD_TO_XASSET, "XUSD", "XBTC", amount, expected, pr, supply, HF_VERSION_SLIPPAGE_V2));
+  const uint64_t stale = expected + 1;
+
+  // same snapshot: the earlier result is taken as is
+  uint64_t slippage = 0;
+  ASSERT_TRUE(cryptonote::get_slippage_reusing(7, stale, tt::XUSD_TO_XASSET, "XUSD", "XBTC", amount, slippage, pr, supply, HF_VERSION_SLIPPAGE_V2));
+  ASSERT_EQ(slippage, stale);
+
+  // the tip moved on, or the slippage was never computed: it is computed again
+  supply.version = 8;
+  slippage = 0;
+  ASSERT_TRUE(cryptonote::get_slippage_reusing(7, stale, tt::XUSD_TO_XASSET, "XUSD", "XBTC", amount, slippage, pr, supply, HF_VERSION_SLIPPAGE_V2));
+  ASSERT_EQ(slippage, expected);
+  slippage = 0;
+  ASSERT_TRUE(cryptonote::get_slippage_reusing(0, stale, tt::XUSD_TO_XASSET, "XUSD", "XBTC", amount, slippage, pr, supply, HF_VERSION_SLIPPAGE_V2));
+  ASSERT_EQ(slippage, expected);
+
+  // a snapshot not kept by the db has no version, and is never trusted to match
+  supply.version = 0;
+  slippage = 0;
+  ASSERT_TRUE(cryptonote::get_slippage_reusing(0, stale, tt::XUSD_TO_XASSET, "XUSD", "XBTC", amount, slippage, pr, supply, HF_VERSION_SLIPPAGE_V2));
+  ASSERT_EQ(slippage, expected);
+}
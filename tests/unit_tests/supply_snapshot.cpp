@@ -0,0 +1,153 @@
+// Copyright (c) 2019-2023, Haven Protocol
+// Portions copyright (c) 2016-2019, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "gtest/gtest.h"
+#include "cryptonote_config.h"
+#include "cryptonote_core/cryptonote_tx_utils.h"
+#include "offshore/supply_snapshot.h"
+
+namespace
+{
+  const std::vector<std::pair<std::string, std::string>> test_amounts = {
+    {"XHV", "30000000000000000000"},
+    {"XBTC", "100000000000"},
+    {"XUSD", "5000000000000000000"}
+  };
+
+  offshore::pricing_record make_pricing_record()
+  {
+    offshore::pricing_record pr;
+    pr.xUSD = COIN;         // XHV spot
+    pr.unused1 = COIN / 2;  // XHV MA
+    pr.unused2 = COIN;      // XUSD spot
+    pr.unused3 = COIN;      // XUSD MA
+    pr.xBTC = 20000;
+    return pr;
+  }
+}
+
+TEST(supply_snapshot, amounts_round_trip)
+{
+  offshore::supply_snapshot supply;
+  ASSERT_TRUE(supply.from_amounts(test_amounts));
+  ASSERT_TRUE(supply.has(offshore::ASSET_XHV));
+  ASSERT_TRUE(supply.has(offshore::ASSET_XBTC));
+  ASSERT_FALSE(supply.has(offshore::ASSET_XAU));
+  ASSERT_FALSE(supply.has(offshore::ASSET_INVALID));
+  ASSERT_EQ(supply.circulating(offshore::ASSET_XAU), 0);
+  ASSERT_EQ(supply.circulating(offshore::ASSET_XHV), boost::multiprecision::uint128_t("30000000000000000000"));
+  ASSERT_EQ(supply.to_amounts(), test_amounts);
+}
+
+TEST(supply_snapshot, mined_coins_count_towards_xhv)
+{
+  offshore::supply_snapshot supply;
+  supply.set_tally(offshore::ASSET_XHV, -1000);
+  supply.set_tally(offshore::ASSET_XUSD, 42);
+  supply.mined_xhv = 5000;
+  ASSERT_EQ(supply.circulating(offshore::ASSET_XHV), 4000);
+  ASSERT_EQ(supply.circulating(offshore::ASSET_XUSD), 42);
+
+  const auto amounts = supply.to_amounts();
+  ASSERT_EQ(amounts.size(), 2u);
+  ASSERT_EQ(amounts[0], std::make_pair(std::string("XHV"), std::string("4000")));
+  ASSERT_EQ(amounts[1], std::make_pair(std::string("XUSD"), std::string("42")));
+}
+
+TEST(supply_snapshot, negative_tally_matches_string_parse)
+{
+  offshore::supply_snapshot supply;
+  supply.set_tally(offshore::ASSET_XUSD, -7);
+  ASSERT_EQ(supply.circulating(offshore::ASSET_XUSD), boost::multiprecision::uint128_t("-7"));
+}
+
+TEST(supply_snapshot, invalid_amounts)
+{
+  offshore::supply_snapshot supply;
+  ASSERT_FALSE(supply.from_amounts({{"XCAN", "1"}}));
+  ASSERT_FALSE(supply.from_amounts({{"XHV", "12a"}}));
+  ASSERT_TRUE(supply.from_amounts({}));
+  ASSERT_EQ(supply.present, 0u);
+}
+
+TEST(supply_snapshot, empty_tally_is_mined_xhv_only)
+{
+  offshore::supply_snapshot supply;
+  supply.mined_xhv = 1234;
+  ASSERT_TRUE(supply.has(offshore::ASSET_XHV));
+  ASSERT_FALSE(supply.has(offshore::ASSET_XUSD));
+  ASSERT_EQ(supply.circulating(offshore::ASSET_XHV), 1234);
+  const auto amounts = supply.to_amounts();
+  ASSERT_EQ(amounts.size(), 1u);
+  ASSERT_EQ(amounts[0], std::make_pair(std::string("XHV"), std::string("1234")));
+
+  // once any tally exists, XHV is only reported if it has a tally of its own
+  supply.set_tally(offshore::ASSET_XUSD, 5);
+  ASSERT_FALSE(supply.has(offshore::ASSET_XHV));
+  ASSERT_EQ(supply.circulating(offshore::ASSET_XHV), 0);
+}
+
+TEST(supply_snapshot, tx_utils_overloads_match)
+{
+  using tt = cryptonote::transaction_type;
+  offshore::supply_snapshot supply;
+  ASSERT_TRUE(supply.from_amounts(test_amounts));
+  const offshore::pricing_record pr = make_pricing_record();
+
+  ASSERT_EQ(cryptonote::get_block_cap(test_amounts, pr, HF_VERSION_USE_COLLATERAL), cryptonote::get_block_cap(supply, pr, HF_VERSION_USE_COLLATERAL));
+
+  const struct { tt type; const char *source; const char *dest; } conversions[] = {
+    {tt::OFFSHORE, "XHV", "XUSD"},
+    {tt::ONSHORE, "XUSD", "XHV"},
+    {tt::XUSD_TO_XASSET, "XUSD", "XBTC"},
+    {tt::XASSET_TO_XUSD, "XBTC", "XUSD"}
+  };
+  for (const uint8_t hf_version: {(uint8_t)HF_VERSION_USE_COLLATERAL, (uint8_t)HF_VERSION_SLIPPAGE, (uint8_t)HF_VERSION_SLIPPAGE_V2})
+  {
+    for (const auto &c: conversions)
+    {
+      const uint64_t amount = 1000 * COIN;
+      if (hf_version >= HF_VERSION_SLIPPAGE)
+      {
+        uint64_t slippage_strings = 0, slippage_snapshot = 0;
+        const bool r_strings = cryptonote::get_slippage(c.type, c.source, c.dest, amount, slippage_strings, pr, test_amounts, hf_version);
+        const bool r_snapshot = cryptonote::get_slippage(c.type, c.source, c.dest, amount, slippage_snapshot, pr, supply, hf_version);
+        ASSERT_EQ(r_strings, r_snapshot);
+        ASSERT_EQ(slippage_strings, slippage_snapshot);
+      }
+      if (c.type != tt::OFFSHORE && c.type != tt::ONSHORE)
+        continue;
+      uint64_t collateral_strings = 0, collateral_snapshot = 0;
+      const bool r_strings = cryptonote::get_collateral_requirements(c.type, amount, collateral_strings, pr, test_amounts, hf_version);
+      const bool r_snapshot = cryptonote::get_collateral_requirements(c.type, amount, collateral_snapshot, pr, supply, hf_version);
+      ASSERT_EQ(r_strings, r_snapshot);
+      ASSERT_EQ(collateral_strings, collateral_snapshot);
+    }
+  }
+}
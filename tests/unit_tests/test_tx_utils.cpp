@@ -357,3 +357,146 @@ TEST(remove_field_from_tx_extra, invalid_varint)
   ASSERT_FALSE(cryptonote::remove_field_from_tx_extra(extra, typeid(cryptonote::tx_extra_nonce)));
   ASSERT_EQ(sizeof(extra_arr), extra.size());
 }
+
+namespace
+{
+  // a ring of the given asset with its members at heights from start_height
+  std::vector<cryptonote::output_data_t> make_ring(const char *asset_type, uint64_t start_height, size_t size = 16)
+  {
+    std::vector<cryptonote::output_data_t> ring(size);
+    for (size_t i = 0; i < size; ++i)
+    {
+      memset(&ring[i], 0, sizeof(ring[i]));
+      ring[i].height = start_height + i;
+      strncpy(ring[i].asset_type, asset_type, sizeof(ring[i].asset_type));
+    }
+    return ring;
+  }
+
+  cryptonote::txin_v make_input(const char *asset_type)
+  {
+    cryptonote::txin_haven_key in;
+    in.amount = 0;
+    in.asset_type = asset_type;
+    return in;
+  }
+}
+
+TEST(anonymity_pool, classifies_rings)
+{
+  const uint64_t audit = SUPPLY_AUDIT_BLOCK_HEIGHT;
+  cryptonote::transaction tx;
+  tx.vin.push_back(make_input("XUSD"));
+  tx.vin.push_back(make_input("XUSD"));
+  cryptonote::anonymity_pool pool;
+
+  cryptonote::tx_ring_members ring_members;
+  std::vector<cryptonote::output_data_t> ring = make_ring("XUSD", audit - 100);
+  ring_members.add_input(ring.data(), ring.size());
+  ring = make_ring("XUSD", audit - 1000);
+  ring_members.add_input(ring.data(), ring.size());
+  ASSERT_TRUE(cryptonote::get_anonymity_pool(tx, ring_members, pool, cryptonote::MAINNET));
+  ASSERT_EQ(cryptonote::anonymity_pool::POOL_1, pool);
+
+  ring_members = cryptonote::tx_ring_members();
+  ring = make_ring("XUSD", audit);
+  ring_members.add_input(ring.data(), ring.size());
+  ring_members.add_input(ring.data(), ring.size());
+  ASSERT_TRUE(cryptonote::get_anonymity_pool(tx, ring_members, pool, cryptonote::MAINNET));
+  ASSERT_EQ(cryptonote::anonymity_pool::POOL_2, pool);
+
+  // a ring across the cut-off, or inputs from either side of it
+  ring_members = cryptonote::tx_ring_members();
+  ring = make_ring("XUSD", audit - 8);
+  ring_members.add_input(ring.data(), ring.size());
+  ring_members.add_input(ring.data(), ring.size());
+  ASSERT_TRUE(cryptonote::get_anonymity_pool(tx, ring_members, pool, cryptonote::MAINNET));
+  ASSERT_EQ(cryptonote::anonymity_pool::MIXED, pool);
+  ring_members = cryptonote::tx_ring_members();
+  ring = make_ring("XUSD", audit - 100);
+  ring_members.add_input(ring.data(), ring.size());
+  ring = make_ring("XUSD", audit + 100);
+  ring_members.add_input(ring.data(), ring.size());
+  ASSERT_TRUE(cryptonote::get_anonymity_pool(tx, ring_members, pool, cryptonote::MAINNET));
+  ASSERT_EQ(cryptonote::anonymity_pool::MIXED, pool);
+}
+
+TEST(anonymity_pool, rejects_bad_rings)
+{
+  const uint64_t audit = SUPPLY_AUDIT_BLOCK_HEIGHT;
+  cryptonote::transaction tx;
+  tx.vin.push_back(make_input("XUSD"));
+  cryptonote::anonymity_pool pool;
+
+  // a member of another asset
+  cryptonote::tx_ring_members ring_members;
+  std::vector<cryptonote::output_data_t> ring = make_ring("XUSD", audit);
+  strncpy(ring[15].asset_type, "XHV", sizeof(ring[15].asset_type));
+  ring_members.add_input(ring.data(), ring.size());
+  ASSERT_FALSE(cryptonote::get_anonymity_pool(tx, ring_members, pool, cryptonote::MAINNET));
+  ASSERT_EQ(cryptonote::anonymity_pool::UNSET, pool);
+
+  // no ring members, or a group missing
+  ring_members = cryptonote::tx_ring_members();
+  ring_members.add_input(ring.data(), 0);
+  ASSERT_FALSE(cryptonote::get_anonymity_pool(tx, ring_members, pool, cryptonote::MAINNET));
+  ASSERT_FALSE(cryptonote::get_anonymity_pool(tx, cryptonote::tx_ring_members(), pool, cryptonote::MAINNET));
+
+  // no input asset type
+  tx.vin[0] = make_input("");
+  ring = make_ring("", audit);
+  ring_members = cryptonote::tx_ring_members();
+  ring_members.add_input(ring.data(), ring.size());
+  ASSERT_FALSE(cryptonote::get_anonymity_pool(tx, ring_members, pool, cryptonote::MAINNET));
+  ASSERT_EQ(cryptonote::anonymity_pool::UNSET, pool);
+}
+
+TEST(anonymity_pool, compares_asset_type_strings)
+{
+  const uint64_t audit = SUPPLY_AUDIT_BLOCK_HEIGHT;
+  cryptonote::transaction tx;
+  cryptonote::anonymity_pool pool;
+
+  // an asset type is only compared as a string, whether it is known or not
+  tx.vin.push_back(make_input("XFOO"));
+  std::vector<cryptonote::output_data_t> ring = make_ring("XFOO", audit);
+  cryptonote::tx_ring_members ring_members;
+  ring_members.add_input(ring.data(), ring.size());
+  ASSERT_TRUE(cryptonote::get_anonymity_pool(tx, ring_members, pool, cryptonote::MAINNET));
+  ASSERT_EQ(cryptonote::anonymity_pool::POOL_2, pool);
+
+  // bytes after the terminating NUL are not part of it
+  ring[3].asset_type[6] = 'Z';
+  ring_members = cryptonote::tx_ring_members();
+  ring_members.add_input(ring.data(), ring.size());
+  ASSERT_TRUE(cryptonote::get_anonymity_pool(tx, ring_members, pool, cryptonote::MAINNET));
+
+  // a prefix, or a longer string, is another asset type
+  tx.vin[0] = make_input("XFO");
+  ASSERT_FALSE(cryptonote::get_anonymity_pool(tx, ring_members, pool, cryptonote::MAINNET));
+  tx.vin[0] = make_input("XFOOBARBAZ");
+  ASSERT_FALSE(cryptonote::get_anonymity_pool(tx, ring_members, pool, cryptonote::MAINNET));
+}
+
+TEST(anonymity_pool, rejects_inputs_without_pool)
+{
+  // coinbase inputs have no ring, so no pool, which no tx may end up with
+  cryptonote::transaction tx;
+  tx.vin.push_back(cryptonote::txin_gen{10});
+  tx.vin.push_back(cryptonote::txin_gen{11});
+  cryptonote::tx_ring_members ring_members;
+  ring_members.add_input(nullptr, 0);
+  ring_members.add_input(nullptr, 0);
+  cryptonote::anonymity_pool pool;
+  ASSERT_FALSE(cryptonote::get_anonymity_pool(tx, ring_members, pool, cryptonote::MAINNET));
+  ASSERT_EQ(cryptonote::anonymity_pool::UNSET, pool);
+
+  // and one next to an input with a ring
+  tx.vin[1] = make_input("XUSD");
+  std::vector<cryptonote::output_data_t> ring = make_ring("XUSD", SUPPLY_AUDIT_BLOCK_HEIGHT);
+  ring_members = cryptonote::tx_ring_members();
+  ring_members.add_input(nullptr, 0);
+  ring_members.add_input(ring.data(), ring.size());
+  ASSERT_FALSE(cryptonote::get_anonymity_pool(tx, ring_members, pool, cryptonote::MAINNET));
+  ASSERT_EQ(cryptonote::anonymity_pool::UNSET, pool);
+}
@@ -0,0 +1,325 @@
+// Copyright (c) 2023, Haven Protocol
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "gtest/gtest.h"
+
+#include "crypto/crypto.h"
+#include "cryptonote_basic/cryptonote_format_utils.h"
+#include "wallet/wallet2.h"
+
+typedef std::map<uint32_t, uint64_t> balances_t;
+typedef std::map<uint32_t, std::pair<uint64_t, std::pair<uint64_t, uint64_t>>> unlocked_balances_t;
+
+class wallet_balance_index_accessor_test
+{
+public:
+  static size_t add_transfer(tools::wallet2 &w, const std::string &asset, uint64_t amount, uint64_t height, uint64_t unlock_time, const cryptonote::subaddress_index &subaddr)
+  {
+    crypto::public_key pkey;
+    crypto::secret_key skey;
+    crypto::generate_keys(pkey, skey);
+    w.m_transfers.push_back(tools::wallet2::transfer_details{});
+    tools::wallet2::transfer_details &td = w.m_transfers.back();
+    td.m_block_height = height;
+    td.m_tx.version = HAVEN_TYPES_TRANSACTION_VERSION;
+    td.m_tx.vout.push_back(cryptonote::tx_out{0, cryptonote::txout_haven_key(pkey, asset, unlock_time, false, false)});
+    td.m_internal_output_index = 0;
+    td.asset_type = asset;
+    td.m_amount = amount;
+    td.m_subaddr_index = subaddr;
+    td.m_frozen = false;
+    const size_t idx = w.m_transfers.size() - 1;
+    w.m_pub_keys[pkey] = idx;
+    // the index counts a transfer once it is marked unspent, as when received
+    w.set_unspent(idx);
+    return idx;
+  }
+  static void set_spent(tools::wallet2 &w, size_t idx, uint64_t height) { w.set_spent(idx, height); }
+  static void set_unspent(tools::wallet2 &w, size_t idx) { w.set_unspent(idx); }
+  static void grow_chain(tools::wallet2 &w, uint64_t height) { while (w.m_blockchain.size() < height) w.m_blockchain.push_back(crypto::null_hash); }
+  static void detach(tools::wallet2 &w, uint64_t height) { w.detach_blockchain(height); }
+  static void add_unconfirmed_tx(tools::wallet2 &w, const cryptonote::transaction &tx, const std::string &source_asset, const std::vector<cryptonote::tx_destination_entry> &dests, uint64_t change, uint32_t account)
+  {
+    w.add_unconfirmed_tx(tx, source_asset, 0, 0, dests, crypto::null_hash, change, account, {});
+  }
+  static void confirm_tx(tools::wallet2 &w, const cryptonote::transaction &tx, uint64_t height) { w.process_unconfirmed(cryptonote::get_transaction_hash(tx), tx, height); }
+  static void add_pool_payment(tools::wallet2 &w, const crypto::hash &txid, const std::string &asset, uint64_t amount, const cryptonote::subaddress_index &subaddr)
+  {
+    tools::wallet2::payment_details pd = AUTO_VAL_INIT(pd);
+    pd.m_tx_hash = txid;
+    pd.m_asset_type = asset;
+    pd.m_amount = amount;
+    pd.m_subaddr_index = subaddr;
+    w.m_unconfirmed_payments.emplace(crypto::null_hash, tools::wallet2::pool_payment_details{pd, false});
+    w.update_balance_index_unconfirmed();
+  }
+  static void remove_pool_payments(tools::wallet2 &w)
+  {
+    w.m_unconfirmed_payments.clear();
+    w.update_balance_index_unconfirmed();
+  }
+  static bool index_valid(const tools::wallet2 &w) { return w.m_balance_index[0].valid && w.m_balance_index[1].valid; }
+  static void invalidate(const tools::wallet2 &w) { w.invalidate_balance_index(); }
+
+  // the per transfer computations the index replaced
+  static balances_t balance_per_subaddress(const tools::wallet2 &w, uint32_t index_major, const std::string& asset, bool strict)
+  {
+    balances_t amount_per_subaddr;
+    for (const auto& td: w.m_transfers)
+    {
+      if (td.m_subaddr_index.major == index_major && td.asset_type == asset && !w.is_spent(td, strict) && !td.m_frozen)
+        amount_per_subaddr[td.m_subaddr_index.minor] += td.amount();
+    }
+    if (!strict)
+    {
+      for (const auto& utx: w.m_unconfirmed_txs)
+      {
+        if (utx.second.m_subaddr_account == index_major && utx.second.m_state != tools::wallet2::unconfirmed_transfer_details::failed)
+        {
+          if (utx.second.m_source_asset == asset)
+            amount_per_subaddr[0] += utx.second.m_change;
+          for (const auto &dest: utx.second.m_dests)
+          {
+            if ((asset == "XHV" && (dest.is_collateral || dest.is_collateral_change)) || (dest.dest_asset_type == asset))
+            {
+              auto index = w.get_subaddress_index(dest.addr);
+              if (index && (*index).major == index_major)
+                amount_per_subaddr[(*index).minor] += dest.amount + dest.slippage;
+            }
+          }
+        }
+      }
+      for (const auto& utx: w.m_unconfirmed_payments)
+      {
+        if (utx.second.m_pd.m_subaddr_index.major == index_major && utx.second.m_pd.m_asset_type == asset)
+          amount_per_subaddr[utx.second.m_pd.m_subaddr_index.minor] += utx.second.m_pd.m_amount;
+      }
+    }
+    return amount_per_subaddr;
+  }
+
+  static unlocked_balances_t unlocked_balance_per_subaddress(tools::wallet2 &w, uint32_t index_major, const std::string& asset, bool strict)
+  {
+    unlocked_balances_t amount_per_subaddr;
+    const uint64_t blockchain_height = w.get_blockchain_current_height();
+    const uint64_t now = time(NULL);
+    for (const auto& td: w.m_transfers)
+    {
+      if (td.m_subaddr_index.major != index_major || td.asset_type != asset || w.is_spent(td, strict) || td.m_frozen)
+        continue;
+      uint64_t amount = 0, blocks_to_unlock = 0, time_to_unlock = 0;
+      if (w.is_transfer_unlocked(td))
+        amount = td.amount();
+      else
+      {
+        uint64_t output_unlock_height = td.m_tx.get_unlock_time(td.m_internal_output_index);
+        uint64_t unlock_height = td.m_block_height + std::max<uint64_t>(CRYPTONOTE_DEFAULT_TX_SPENDABLE_AGE, CRYPTONOTE_LOCKED_TX_ALLOWED_DELTA_BLOCKS);
+        if (output_unlock_height < CRYPTONOTE_MAX_BLOCK_NUMBER && output_unlock_height > unlock_height)
+          unlock_height = output_unlock_height;
+        uint64_t unlock_time = output_unlock_height >= CRYPTONOTE_MAX_BLOCK_NUMBER ? output_unlock_height : 0;
+        blocks_to_unlock = unlock_height > blockchain_height ? unlock_height - blockchain_height : 0;
+        time_to_unlock = unlock_time > now ? unlock_time - now : 0;
+      }
+      auto found = amount_per_subaddr.find(td.m_subaddr_index.minor);
+      if (found == amount_per_subaddr.end())
+        amount_per_subaddr[td.m_subaddr_index.minor] = std::make_pair(amount, std::make_pair(blocks_to_unlock, time_to_unlock));
+      else
+      {
+        found->second.first += amount;
+        found->second.second.first = std::max(found->second.second.first, blocks_to_unlock);
+        found->second.second.second = std::max(found->second.second.second, time_to_unlock);
+      }
+    }
+    return amount_per_subaddr;
+  }
+};
+
+namespace
+{
+  typedef wallet_balance_index_accessor_test accessor;
+
+  const std::vector<std::string> assets = {"XHV", "XUSD"};
+
+  void expect_same_unlocked(const unlocked_balances_t &expected, const unlocked_balances_t &actual)
+  {
+    ASSERT_EQ(expected.size(), actual.size());
+    for (auto e = expected.begin(), a = actual.begin(); e != expected.end(); ++e, ++a)
+    {
+      EXPECT_EQ(e->first, a->first);
+      EXPECT_EQ(e->second.first, a->second.first);
+      EXPECT_EQ(e->second.second.first, a->second.second.first);
+      // computed from time(NULL) a few calls apart
+      EXPECT_LE(std::max(e->second.second.second, a->second.second.second) - std::min(e->second.second.second, a->second.second.second), 1u);
+    }
+  }
+
+  void check_balances(tools::wallet2 &w)
+  {
+    for (int pass = 0; pass < 2; ++pass)
+    {
+      // first as kept up to date, then as rebuilt from scratch
+      if (pass == 1)
+        accessor::invalidate(w);
+      for (const std::string &asset: assets)
+      {
+        for (uint32_t major = 0; major < w.get_num_subaddress_accounts(); ++major)
+        {
+          for (bool strict: {false, true})
+          {
+            EXPECT_EQ(accessor::balance_per_subaddress(w, major, asset, strict), w.balance_per_subaddress(major, asset, strict));
+            expect_same_unlocked(accessor::unlocked_balance_per_subaddress(w, major, asset, strict), w.unlocked_balance_per_subaddress(major, asset, strict));
+          }
+        }
+      }
+      EXPECT_TRUE(accessor::index_valid(w));
+    }
+  }
+
+  class wallet_balance_index: public ::testing::Test
+  {
+  protected:
+    virtual void SetUp()
+    {
+      w.generate("", "", crypto::secret_key(), true, false);
+      w.add_subaddress_account("second");
+      accessor::grow_chain(w, 60);
+    }
+
+    tools::wallet2 w;
+  };
+}
+
+TEST_F(wallet_balance_index, received)
+{
+  const uint64_t now = time(NULL);
+  accessor::add_transfer(w, "XHV", 1000, 10, 0, {0, 0});
+  accessor::add_transfer(w, "XHV", 2000, 55, 0, {0, 1});
+  accessor::add_transfer(w, "XUSD", 3000, 20, 100, {1, 0});
+  accessor::add_transfer(w, "XHV", 4000, 20, now - 100000, {0, 2});
+  accessor::add_transfer(w, "XHV", 5000, 20, now + 100000, {0, 2});
+  accessor::add_transfer(w, "XUSD", 6000, 40, 0, {1, 1});
+  check_balances(w);
+
+  // received once the index is built
+  accessor::add_transfer(w, "XHV", 7000, 58, 0, {0, 0});
+  accessor::add_transfer(w, "XUSD", 8000, 59, 80, {0, 3});
+  check_balances(w);
+}
+
+TEST_F(wallet_balance_index, height_locks)
+{
+  accessor::add_transfer(w, "XHV", 1000, 55, 0, {0, 0});
+  accessor::add_transfer(w, "XHV", 2000, 50, 75, {0, 0});
+  accessor::add_transfer(w, "XUSD", 3000, 58, 0, {1, 4});
+  for (uint64_t height = 60; height <= 80; ++height)
+  {
+    accessor::grow_chain(w, height);
+    check_balances(w);
+  }
+}
+
+TEST_F(wallet_balance_index, spend)
+{
+  const size_t a = accessor::add_transfer(w, "XHV", 1000, 10, 0, {0, 0});
+  const size_t b = accessor::add_transfer(w, "XHV", 2000, 55, 0, {0, 1});
+  const size_t c = accessor::add_transfer(w, "XUSD", 3000, 20, 0, {1, 0});
+  check_balances(w);
+
+  accessor::set_spent(w, a, 59);
+  check_balances(w);
+  // seen spent in the pool only, spent for non strict balances only
+  accessor::set_spent(w, b, 0);
+  check_balances(w);
+  accessor::set_spent(w, c, 59);
+  check_balances(w);
+  accessor::set_unspent(w, a);
+  accessor::set_unspent(w, b);
+  check_balances(w);
+}
+
+TEST_F(wallet_balance_index, freeze_thaw)
+{
+  const size_t a = accessor::add_transfer(w, "XHV", 1000, 10, 0, {0, 0});
+  const size_t b = accessor::add_transfer(w, "XHV", 2000, 55, 0, {0, 0});
+  check_balances(w);
+
+  w.freeze(a);
+  check_balances(w);
+  w.freeze(b);
+  check_balances(w);
+  w.thaw(a);
+  check_balances(w);
+  accessor::grow_chain(w, 70);
+  w.thaw(b);
+  check_balances(w);
+}
+
+TEST_F(wallet_balance_index, unconfirmed)
+{
+  accessor::add_transfer(w, "XHV", 10000, 10, 0, {0, 0});
+  check_balances(w);
+
+  cryptonote::transaction tx;
+  tx.version = HAVEN_TYPES_TRANSACTION_VERSION;
+  std::vector<cryptonote::tx_destination_entry> dests;
+  cryptonote::tx_destination_entry to_self(1500, w.get_subaddress({0, 3}), true);
+  to_self.dest_asset_type = "XUSD";
+  to_self.slippage = 20;
+  dests.push_back(to_self);
+  dests.push_back(cryptonote::tx_destination_entry(700, w.get_subaddress({0, 3}), true, true, false));
+  dests.push_back(cryptonote::tx_destination_entry(300, w.get_subaddress({1, 2}), true));
+  accessor::add_unconfirmed_tx(w, tx, "XHV", dests, 4000, 0);
+  check_balances(w);
+
+  accessor::add_pool_payment(w, crypto::null_hash, "XUSD", 900, {1, 1});
+  accessor::add_pool_payment(w, crypto::null_hash, "XHV", 800, {0, 5});
+  check_balances(w);
+
+  accessor::confirm_tx(w, tx, 59);
+  check_balances(w);
+  accessor::remove_pool_payments(w);
+  check_balances(w);
+}
+
+TEST_F(wallet_balance_index, detach)
+{
+  accessor::add_transfer(w, "XHV", 1000, 10, 0, {0, 0});
+  const size_t b = accessor::add_transfer(w, "XHV", 2000, 30, 0, {0, 1});
+  accessor::add_transfer(w, "XUSD", 3000, 50, 0, {1, 0});
+  accessor::add_transfer(w, "XHV", 4000, 55, 0, {0, 0});
+  accessor::set_spent(w, b, 52);
+  check_balances(w);
+
+  // drops the transfers received from height 45 and unspends those spent there
+  accessor::detach(w, 45);
+  EXPECT_EQ(w.get_num_transfer_details(), 2u);
+  check_balances(w);
+
+  accessor::add_transfer(w, "XUSD", 5000, 46, 0, {1, 0});
+  check_balances(w);
+}
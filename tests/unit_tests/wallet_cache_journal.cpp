@@ -0,0 +1,237 @@
+// Copyright (c) 2023, Haven Protocol
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <string.h>
+#include <boost/filesystem.hpp>
+
+#include "gtest/gtest.h"
+
+#include "crypto/crypto.h"
+#include "crypto/chacha.h"
+#include "file_io_utils.h"
+#include "wallet/wallet_cache_journal.h"
+#include "wallet/wallet_errors.h"
+#include "serialization/binary_utils.h"
+
+namespace
+{
+  std::string make_data(size_t size, uint64_t seed)
+  {
+    std::string data(size, 0);
+    for (size_t i = 0; i < size; ++i)
+    {
+      seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+      data[i] = (char)(seed >> 56);
+    }
+    return data;
+  }
+
+  crypto::chacha_key make_key()
+  {
+    crypto::chacha_key key;
+    crypto::generate_chacha_key(std::string("journal test"), key, 1);
+    return key;
+  }
+
+  class temp_dir
+  {
+  public:
+    temp_dir(): path(boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("haven-journal-test-%%%%-%%%%")) { boost::filesystem::create_directories(path); }
+    ~temp_dir() { boost::system::error_code ec; boost::filesystem::remove_all(path, ec); }
+    std::string file(const char *name) const { return (path / name).string(); }
+  private:
+    boost::filesystem::path path;
+  };
+
+  // loads the base cache file then applies the journal, as wallet2::load does
+  bool load_cache(tools::wallet_cache_journal &journal, const std::string &cache_file, const crypto::chacha_key &key, std::string &cache_data)
+  {
+    std::string buf;
+    if (!epee::file_io_utils::load_file_to_string(cache_file, buf))
+      return false;
+    tools::wallet_cache_journal::entry e;
+    if (!::serialization::parse_binary(buf, e))
+      return false;
+    cache_data.resize(e.data.size());
+    crypto::chacha20(e.data.data(), e.data.size(), key, e.iv, &cache_data[0]);
+    journal.load(cache_file + ".journal", key, e.iv, cache_data, true);
+    return true;
+  }
+}
+
+TEST(wallet_cache_journal, split)
+{
+  const std::string data = make_data(4 * 1024 * 1024, 1);
+  const auto chunks = tools::wallet_cache_journal::split(data);
+  ASSERT_GT(chunks.size(), 16);
+  size_t offset = 0;
+  for (const auto &c: chunks)
+  {
+    ASSERT_EQ(c.offset, offset);
+    ASSERT_GT(c.size, 0);
+    ASSERT_LE(c.size, 256 * 1024);
+    offset += c.size;
+  }
+  ASSERT_EQ(offset, data.size());
+
+  // inserting data only changes the chunks around it
+  std::string changed = data;
+  changed.insert(data.size() / 3, "some inserted data");
+  std::unordered_set<crypto::hash> hashes;
+  for (const auto &c: chunks)
+    hashes.insert(c.hash);
+  size_t new_chunks = 0;
+  for (const auto &c: tools::wallet_cache_journal::split(changed))
+    new_chunks += !hashes.count(c.hash);
+  ASSERT_LE(new_chunks, 2);
+}
+
+TEST(wallet_cache_journal, store_and_load)
+{
+  temp_dir dir;
+  const std::string cache_file = dir.file("wallet"), journal_file = cache_file + ".journal";
+  const crypto::chacha_key key = make_key();
+  std::string data = make_data(4 * 1024 * 1024, 2), loaded;
+
+  // the first store writes a base
+  tools::wallet_cache_journal journal;
+  journal.store(cache_file, journal_file, key, data);
+  journal.wait();
+  ASSERT_FALSE(boost::filesystem::exists(journal_file));
+  tools::wallet_cache_journal journal2;
+  ASSERT_TRUE(load_cache(journal2, cache_file, key, loaded));
+  ASSERT_EQ(loaded, data);
+
+  // small changes go to the journal
+  for (int i = 0; i < 3; ++i)
+  {
+    data.insert(data.size() / (i + 2), make_data(100, 10 + i));
+    data += make_data(1000, 20 + i);
+    journal.store(cache_file, journal_file, key, data);
+    ASSERT_TRUE(boost::filesystem::exists(journal_file));
+    ASSERT_LT(boost::filesystem::file_size(journal_file), data.size() / 4);
+    tools::wallet_cache_journal journal3;
+    ASSERT_TRUE(load_cache(journal3, cache_file, key, loaded));
+    ASSERT_EQ(loaded, data);
+  }
+
+  // a torn write at the end is ignored, and dropped by the next store
+  {
+    std::ofstream ostr(journal_file, std::ios_base::binary | std::ios_base::app);
+    ostr << "torn";
+  }
+  tools::wallet_cache_journal journal4;
+  ASSERT_TRUE(load_cache(journal4, cache_file, key, loaded));
+  ASSERT_EQ(loaded, data);
+  data += make_data(1000, 30);
+  journal4.store(cache_file, journal_file, key, data);
+  tools::wallet_cache_journal journal5;
+  ASSERT_TRUE(load_cache(journal5, cache_file, key, loaded));
+  ASSERT_EQ(loaded, data);
+
+  // a large change writes a new base, and the journal goes
+  data = make_data(2 * 1024 * 1024, 3);
+  journal5.store(cache_file, journal_file, key, data);
+  journal5.wait();
+  ASSERT_FALSE(boost::filesystem::exists(journal_file));
+  tools::wallet_cache_journal journal6;
+  ASSERT_TRUE(load_cache(journal6, cache_file, key, loaded));
+  ASSERT_EQ(loaded, data);
+}
+
+TEST(wallet_cache_journal, ignores_journal_for_other_base)
+{
+  temp_dir dir;
+  const std::string cache_file = dir.file("wallet"), journal_file = cache_file + ".journal";
+  const crypto::chacha_key key = make_key();
+  std::string data = make_data(1024 * 1024, 4), loaded;
+
+  tools::wallet_cache_journal journal;
+  journal.store(cache_file, journal_file, key, data);
+  journal.wait();
+  const std::string base_data = data;
+  data += make_data(1000, 5);
+  journal.store(cache_file, journal_file, key, data);
+  ASSERT_TRUE(boost::filesystem::exists(journal_file));
+
+  // the base gets rewritten by something which does not know about the journal
+  {
+    tools::wallet_cache_journal other;
+    other.store(cache_file, cache_file + ".other", key, base_data);
+  }
+  tools::wallet_cache_journal journal2;
+  ASSERT_TRUE(load_cache(journal2, cache_file, key, loaded));
+  ASSERT_EQ(loaded, base_data);
+}
+
+TEST(wallet_cache_journal, background_failure_thrown_by_next_store)
+{
+  temp_dir dir;
+  // the directory does not exist, so the base cache file cannot be written
+  const std::string cache_file = dir.file("missing/wallet"), journal_file = cache_file + ".journal";
+  const crypto::chacha_key key = make_key();
+  std::string data = make_data(1024 * 1024, 6);
+
+  tools::wallet_cache_journal journal;
+  journal.store(cache_file, journal_file, key, data);
+  data += make_data(1000, 7);
+  ASSERT_THROW(journal.store(cache_file, journal_file, key, data), tools::error::file_save_error);
+
+  // the failure is reported once, and the next store writes the whole base again
+  journal.store(cache_file, journal_file, key, data);
+  ASSERT_THROW(journal.wait(), tools::error::file_save_error);
+  journal.wait();
+}
+
+TEST(wallet_cache_journal, final_store)
+{
+  temp_dir dir;
+  const std::string cache_file = dir.file("wallet"), journal_file = cache_file + ".journal";
+  const crypto::chacha_key key = make_key();
+  std::string data = make_data(1024 * 1024, 8), loaded;
+
+  tools::wallet_cache_journal journal;
+  journal.store(cache_file, journal_file, key, data);
+  journal.wait();
+  data += make_data(1000, 9);
+  journal.store(cache_file, journal_file, key, data);
+  ASSERT_TRUE(boost::filesystem::exists(journal_file));
+
+  // written before returning, with no journal left behind
+  data += make_data(1000, 10);
+  journal.store(cache_file, journal_file, key, data, true);
+  ASSERT_FALSE(boost::filesystem::exists(journal_file));
+  ASSERT_FALSE(boost::filesystem::exists(cache_file + ".new"));
+  tools::wallet_cache_journal journal2;
+  ASSERT_TRUE(load_cache(journal2, cache_file, key, loaded));
+  ASSERT_EQ(loaded, data);
+
+  // and a failure to write it is thrown straight away
+  const std::string missing_file = dir.file("missing/wallet");
+  tools::wallet_cache_journal journal3;
+  ASSERT_THROW(journal3.store(missing_file, missing_file + ".journal", key, data, true), tools::error::file_save_error);
+}
@@ -0,0 +1,226 @@
+// Copyright (c) 2023, Haven Protocol
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "gtest/gtest.h"
+
+#include "crypto/crypto.h"
+#include "ringct/rctOps.h"
+#include "wallet/wallet2.h"
+
+typedef cryptonote::COMMAND_RPC_GET_OUTPUTS_BIN::outkey outkey;
+
+class wallet_decoy_cache_accessor_test
+{
+public:
+  static bool get_cached_rct_distribution(tools::wallet2 &w, uint64_t height, uint64_t from_height, const std::string &asset_type, std::vector<uint64_t> &distribution)
+  {
+    uint64_t start_height, num_spendable_global_outs;
+    return w.get_cached_rct_distribution(height, from_height, 0, asset_type, start_height, distribution, num_spendable_global_outs);
+  }
+  static void cache_rct_distribution(tools::wallet2 &w, uint64_t height, uint64_t from_height, const std::string &asset_type, const std::vector<uint64_t> &distribution)
+  {
+    w.cache_rct_distribution(height, from_height, 0, asset_type, from_height, distribution, distribution.empty() ? 0 : distribution.back());
+  }
+  static size_t use_cached_outs_keys(const tools::wallet2 &w, const cryptonote::COMMAND_RPC_GET_OUTPUTS_BIN::request &req, const std::vector<outkey> &outs, std::unordered_set<crypto::public_key> &valid)
+  {
+    return w.use_cached_outs_keys(req, outs, valid);
+  }
+  static void cache_outs_keys(tools::wallet2 &w, const cryptonote::COMMAND_RPC_GET_OUTPUTS_BIN::request &req, const std::vector<outkey> &outs, const std::unordered_set<crypto::public_key> &valid)
+  {
+    w.cache_outs_keys(req, outs, valid);
+  }
+  static size_t outkey_cache_size(const tools::wallet2 &w) { return w.m_outkey_cache_size; }
+};
+
+namespace
+{
+  typedef wallet_decoy_cache_accessor_test accessor;
+
+  crypto::public_key random_pkey()
+  {
+    crypto::public_key pkey;
+    crypto::secret_key skey;
+    crypto::generate_keys(pkey, skey);
+    return pkey;
+  }
+
+  cryptonote::COMMAND_RPC_GET_OUTPUTS_BIN::request make_request(uint64_t first_index, size_t count)
+  {
+    cryptonote::COMMAND_RPC_GET_OUTPUTS_BIN::request req = AUTO_VAL_INIT(req);
+    req.asset_type = "XHV";
+    for (size_t i = 0; i < count; ++i)
+      req.outputs.push_back({0, first_index + i});
+    return req;
+  }
+
+  // what the daemon returns for those outputs, all keys being valid
+  std::vector<outkey> make_outs(size_t count, std::unordered_set<crypto::public_key> &valid)
+  {
+    std::vector<outkey> outs(count);
+    for (auto &out: outs)
+    {
+      out.key = random_pkey();
+      out.mask = rct::pk2rct(random_pkey());
+      out.unlocked = true;
+      out.height = 10;
+      valid.insert(out.key);
+      valid.insert(rct::rct2pk(out.mask));
+    }
+    return outs;
+  }
+
+  class wallet_decoy_cache: public ::testing::Test
+  {
+  protected:
+    virtual void SetUp()
+    {
+      w.generate("", "", crypto::secret_key(), true, false);
+      ASSERT_TRUE(w.set_daemon("127.0.0.1:18081"));
+    }
+
+    tools::wallet2 w;
+  };
+}
+
+TEST_F(wallet_decoy_cache, rct_distribution_hit)
+{
+  std::vector<uint64_t> distribution;
+  ASSERT_FALSE(accessor::get_cached_rct_distribution(w, 100, 0, "XHV", distribution));
+  accessor::cache_rct_distribution(w, 100, 0, "XHV", {1, 2, 3});
+  ASSERT_TRUE(accessor::get_cached_rct_distribution(w, 100, 0, "XHV", distribution));
+  ASSERT_EQ(distribution, std::vector<uint64_t>({1, 2, 3}));
+
+  // other ranges and asset types are separate
+  ASSERT_FALSE(accessor::get_cached_rct_distribution(w, 100, 1, "XHV", distribution));
+  ASSERT_FALSE(accessor::get_cached_rct_distribution(w, 100, 0, "XUSD", distribution));
+}
+
+TEST_F(wallet_decoy_cache, rct_distribution_invalidated)
+{
+  std::vector<uint64_t> distribution;
+  accessor::cache_rct_distribution(w, 100, 0, "XHV", {1, 2, 3});
+  ASSERT_FALSE(accessor::get_cached_rct_distribution(w, 101, 0, "XHV", distribution));
+  // and it stays dropped when going back to the old height
+  ASSERT_FALSE(accessor::get_cached_rct_distribution(w, 100, 0, "XHV", distribution));
+
+  accessor::cache_rct_distribution(w, 100, 0, "XHV", {1, 2, 3});
+  ASSERT_TRUE(w.set_daemon("127.0.0.1:28081"));
+  ASSERT_FALSE(accessor::get_cached_rct_distribution(w, 100, 0, "XHV", distribution));
+
+  // setting the same daemon again keeps it
+  accessor::cache_rct_distribution(w, 100, 0, "XHV", {1, 2, 3});
+  ASSERT_TRUE(w.set_daemon("127.0.0.1:28081"));
+  ASSERT_TRUE(accessor::get_cached_rct_distribution(w, 100, 0, "XHV", distribution));
+}
+
+TEST_F(wallet_decoy_cache, rct_distribution_size_cap)
+{
+  std::vector<uint64_t> distribution;
+  for (uint64_t from_height = 0; from_height < 1000; ++from_height)
+  {
+    accessor::cache_rct_distribution(w, 100, from_height, "XHV", {from_height});
+    ASSERT_TRUE(accessor::get_cached_rct_distribution(w, 100, from_height, "XHV", distribution));
+  }
+  size_t cached = 0;
+  for (uint64_t from_height = 0; from_height < 1000; ++from_height)
+    cached += accessor::get_cached_rct_distribution(w, 100, from_height, "XHV", distribution);
+  ASSERT_GT(cached, 0);
+  ASSERT_LT(cached, 100);
+}
+
+TEST_F(wallet_decoy_cache, outs_keys_hit)
+{
+  const auto req = make_request(1000, 11);
+  std::unordered_set<crypto::public_key> valid;
+  const std::vector<outkey> outs = make_outs(11, valid);
+  ASSERT_EQ(accessor::use_cached_outs_keys(w, req, outs, valid), 0);
+  accessor::cache_outs_keys(w, req, outs, valid);
+  ASSERT_EQ(accessor::outkey_cache_size(w), 11);
+
+  // a later request for the same outputs needs no checks, and seeds the valid key set
+  std::unordered_set<crypto::public_key> valid2;
+  ASSERT_EQ(accessor::use_cached_outs_keys(w, req, outs, valid2), 11);
+  ASSERT_EQ(valid2, valid);
+
+  // keys the daemon returns differently are checked again
+  std::vector<outkey> changed = outs;
+  changed[3].key = random_pkey();
+  changed[4].mask = rct::pk2rct(random_pkey());
+  std::unordered_set<crypto::public_key> valid3;
+  ASSERT_EQ(accessor::use_cached_outs_keys(w, req, changed, valid3), 9);
+  ASSERT_EQ(valid3.count(changed[3].key), 0);
+  ASSERT_EQ(valid3.count(rct::rct2pk(changed[4].mask)), 0);
+
+  // other asset types are separate
+  auto other_req = req;
+  other_req.asset_type = "XUSD";
+  std::unordered_set<crypto::public_key> valid4;
+  ASSERT_EQ(accessor::use_cached_outs_keys(w, other_req, outs, valid4), 0);
+}
+
+TEST_F(wallet_decoy_cache, outs_keys_only_unlocked_and_valid)
+{
+  const auto req = make_request(1000, 3);
+  std::unordered_set<crypto::public_key> valid;
+  std::vector<outkey> outs = make_outs(3, valid);
+  outs[0].unlocked = false;
+  valid.erase(outs[1].key);
+  accessor::cache_outs_keys(w, req, outs, valid);
+  ASSERT_EQ(accessor::outkey_cache_size(w), 1);
+  std::unordered_set<crypto::public_key> valid2;
+  ASSERT_EQ(accessor::use_cached_outs_keys(w, req, outs, valid2), 1);
+  ASSERT_EQ(valid2.count(outs[2].key), 1);
+}
+
+TEST_F(wallet_decoy_cache, outs_keys_invalidated)
+{
+  const auto req = make_request(1000, 11);
+  std::unordered_set<crypto::public_key> valid;
+  const std::vector<outkey> outs = make_outs(11, valid);
+  accessor::cache_outs_keys(w, req, outs, valid);
+  ASSERT_TRUE(w.set_daemon("127.0.0.1:28081"));
+  ASSERT_EQ(accessor::outkey_cache_size(w), 0);
+  std::unordered_set<crypto::public_key> valid2;
+  ASSERT_EQ(accessor::use_cached_outs_keys(w, req, outs, valid2), 0);
+}
+
+TEST_F(wallet_decoy_cache, outs_keys_size_cap)
+{
+  std::unordered_set<crypto::public_key> valid;
+  const std::vector<outkey> outs = make_outs(1000, valid);
+  size_t max_size = 0;
+  for (uint64_t n = 0; n < 300; ++n)
+  {
+    accessor::cache_outs_keys(w, make_request(n * 1000, 1000), outs, valid);
+    max_size = std::max(max_size, accessor::outkey_cache_size(w));
+  }
+  ASSERT_GE(max_size, 100000);
+  ASSERT_LE(max_size, 200000);
+  // the latest request is always kept
+  std::unordered_set<crypto::public_key> valid2;
+  ASSERT_EQ(accessor::use_cached_outs_keys(w, make_request(299 * 1000, 1000), outs, valid2), 1000);
+}
@@ -0,0 +1,214 @@
+// Copyright (c) 2023, Haven Protocol
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "gtest/gtest.h"
+
+#include "crypto/crypto.h"
+#include "ringct/rctOps.h"
+#include "wallet/wallet2.h"
+
+typedef cryptonote::COMMAND_RPC_GET_BLOCKS_SCAN::tx_scan_entry tx_scan_entry;
+
+class wallet_scan_only_accessor_test
+{
+public:
+  static bool may_have_outputs_to_us(const tools::wallet2 &w, const tx_scan_entry &entry) { return w.may_have_outputs_to_us(entry); }
+  static bool may_spend_ours(const tools::wallet2 &w, const tx_scan_entry &entry, const crypto::hash &txid) { return w.may_spend_ours(entry, txid); }
+  static void add_key_image(tools::wallet2 &w, const crypto::key_image &ki) { w.m_key_images[ki] = 0; }
+  static void add_unconfirmed_tx(tools::wallet2 &w, const crypto::hash &txid) { w.m_unconfirmed_txs[txid] = tools::wallet2::unconfirmed_transfer_details(); }
+};
+
+namespace
+{
+  typedef wallet_scan_only_accessor_test accessor;
+
+  // an output to the given keys, as a sender with tx secret key r makes it
+  void make_output(const crypto::public_key &view_pkey, const crypto::public_key &spend_pkey, const crypto::secret_key &r, size_t index, crypto::public_key &output_key, crypto::view_tag &view_tag)
+  {
+    crypto::key_derivation derivation;
+    ASSERT_TRUE(crypto::generate_key_derivation(view_pkey, r, derivation));
+    ASSERT_TRUE(crypto::derive_public_key(derivation, index, spend_pkey, output_key));
+    crypto::derive_view_tag(derivation, index, view_tag);
+  }
+
+  // the view tag the wallet computes for an output of a tx with the given pubkey
+  char wallet_view_tag(const tools::wallet2 &w, const crypto::public_key &tx_pkey, size_t index)
+  {
+    crypto::key_derivation derivation;
+    crypto::generate_key_derivation(tx_pkey, w.get_account().get_keys().m_view_secret_key, derivation);
+    crypto::view_tag view_tag;
+    crypto::derive_view_tag(derivation, index, view_tag);
+    return view_tag.data;
+  }
+
+  // a view tag matching neither the main nor the additional derivation of an output
+  char other_view_tag(const tools::wallet2 &w, const tx_scan_entry &entry, size_t index)
+  {
+    char view_tag = 0;
+    while (view_tag == wallet_view_tag(w, entry.tx_pub_keys[0], index) || view_tag == wallet_view_tag(w, entry.additional_tx_pub_keys[index], index))
+      ++view_tag;
+    return view_tag;
+  }
+
+  crypto::public_key random_pkey()
+  {
+    crypto::public_key pkey;
+    crypto::secret_key skey;
+    crypto::generate_keys(pkey, skey);
+    return pkey;
+  }
+
+  class wallet_scan_only: public ::testing::Test
+  {
+  protected:
+    virtual void SetUp()
+    {
+      w.generate("", "", crypto::secret_key(), true, false);
+      crypto::generate_keys(tx_pkey, tx_skey);
+    }
+
+    // a tx with three outputs, the second of which is to the wallet's main address
+    tx_scan_entry make_entry(bool tagged)
+    {
+      const cryptonote::account_public_address &address = w.get_account().get_keys().m_account_address;
+      tx_scan_entry entry;
+      entry.tx_pub_keys.push_back(tx_pkey);
+      for (size_t k = 0; k < 3; ++k)
+      {
+        crypto::public_key output_key = random_pkey();
+        crypto::view_tag view_tag;
+        view_tag.data = wallet_view_tag(w, tx_pkey, k) ^ 1;
+        if (k == 1)
+          make_output(address.m_view_public_key, address.m_spend_public_key, tx_skey, k, output_key, view_tag);
+        if (tagged)
+          entry.view_tags.push_back(view_tag.data);
+        else
+          entry.output_keys.push_back(output_key);
+      }
+      return entry;
+    }
+
+    // a tx with two outputs, the second of which is to a subaddress, so has an additional pubkey
+    tx_scan_entry make_subaddress_entry(bool tagged, crypto::public_key &output_key, crypto::view_tag &view_tag)
+    {
+      const cryptonote::account_public_address address = w.get_subaddress({0, 1});
+      tx_scan_entry entry;
+      entry.tx_pub_keys.push_back(tx_pkey);
+      for (size_t k = 0; k < 2; ++k)
+      {
+        crypto::secret_key r;
+        crypto::public_key unused;
+        crypto::generate_keys(unused, r);
+        entry.additional_tx_pub_keys.push_back(rct::rct2pk(rct::scalarmultKey(rct::pk2rct(address.m_spend_public_key), rct::sk2rct(r))));
+        if (k == 1)
+          make_output(address.m_view_public_key, address.m_spend_public_key, r, k, output_key, view_tag);
+      }
+      if (tagged)
+      {
+        entry.view_tags.push_back(other_view_tag(w, entry, 0));
+        entry.view_tags.push_back(view_tag.data);
+      }
+      else
+      {
+        entry.output_keys.push_back(random_pkey());
+        entry.output_keys.push_back(output_key);
+      }
+      return entry;
+    }
+
+    tools::wallet2 w;
+    crypto::public_key tx_pkey;
+    crypto::secret_key tx_skey;
+  };
+}
+
+TEST_F(wallet_scan_only, tagged_outputs)
+{
+  tx_scan_entry entry = make_entry(true);
+  ASSERT_TRUE(accessor::may_have_outputs_to_us(w, entry));
+
+  // every tag off by one bit
+  entry.view_tags[1] ^= 1;
+  ASSERT_FALSE(accessor::may_have_outputs_to_us(w, entry));
+}
+
+TEST_F(wallet_scan_only, untagged_outputs)
+{
+  tx_scan_entry entry = make_entry(false);
+  ASSERT_TRUE(accessor::may_have_outputs_to_us(w, entry));
+
+  // untagged outputs are checked in full, so an output to someone else never passes
+  entry.output_keys[1] = random_pkey();
+  ASSERT_FALSE(accessor::may_have_outputs_to_us(w, entry));
+}
+
+TEST_F(wallet_scan_only, additional_pubkeys)
+{
+  crypto::public_key output_key;
+  crypto::view_tag view_tag;
+  tx_scan_entry entry = make_subaddress_entry(true, output_key, view_tag);
+  ASSERT_TRUE(accessor::may_have_outputs_to_us(w, entry));
+  entry.view_tags[1] = other_view_tag(w, entry, 1);
+  ASSERT_FALSE(accessor::may_have_outputs_to_us(w, entry));
+
+  entry = make_subaddress_entry(false, output_key, view_tag);
+  ASSERT_TRUE(accessor::may_have_outputs_to_us(w, entry));
+  entry.output_keys[1] = random_pkey();
+  ASSERT_FALSE(accessor::may_have_outputs_to_us(w, entry));
+}
+
+TEST_F(wallet_scan_only, nothing_to_check)
+{
+  tx_scan_entry entry = make_entry(true);
+  entry.view_tags.clear();
+  ASSERT_FALSE(accessor::may_have_outputs_to_us(w, entry));
+
+  entry = make_entry(false);
+  entry.tx_pub_keys.clear();
+  ASSERT_FALSE(accessor::may_have_outputs_to_us(w, entry));
+}
+
+TEST_F(wallet_scan_only, may_spend_ours)
+{
+  const crypto::key_image ours = crypto::rand<crypto::key_image>(), other = crypto::rand<crypto::key_image>();
+  const crypto::hash txid = crypto::rand<crypto::hash>();
+
+  tx_scan_entry entry;
+  entry.key_images.push_back(other);
+  entry.key_images.push_back(ours);
+  ASSERT_FALSE(accessor::may_spend_ours(w, entry, txid));
+
+  accessor::add_key_image(w, ours);
+  ASSERT_TRUE(accessor::may_spend_ours(w, entry, txid));
+  entry.key_images.pop_back();
+  ASSERT_FALSE(accessor::may_spend_ours(w, entry, txid));
+
+  // our own txes still in the pool are fetched to confirm them
+  accessor::add_unconfirmed_tx(w, txid);
+  ASSERT_TRUE(accessor::may_spend_ours(w, entry, txid));
+  ASSERT_FALSE(accessor::may_spend_ours(w, entry, crypto::rand<crypto::hash>()));
+}
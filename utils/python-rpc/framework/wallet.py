@@ -355,6 +355,40 @@ class Wallet(object):
         }
         return self.rpc.send_json_rpc_request(close_wallet)
 
+    def host_wallet(self, filename, password=''):
+        host_wallet = {
+            'method': 'host_wallet',
+            'params' : {
+                'filename': filename,
+                'password': password,
+            },
+            'jsonrpc': '2.0', 
+            'id': '0'
+        }
+        return self.rpc.send_json_rpc_request(host_wallet)
+
+    def unhost_wallet(self, filename, autosave = True):
+        unhost_wallet = {
+            'method': 'unhost_wallet',
+            'params' : {
+                'filename': filename,
+                'autosave': autosave,
+            },
+            'jsonrpc': '2.0', 
+            'id': '0'
+        }
+        return self.rpc.send_json_rpc_request(unhost_wallet)
+
+    def get_hosted_wallets(self):
+        get_hosted_wallets = {
+            'method': 'get_hosted_wallets',
+            'params' : {
+            },
+            'jsonrpc': '2.0', 
+            'id': '0'
+        }
+        return self.rpc.send_json_rpc_request(get_hosted_wallets)
+
     def change_wallet_password(self, old_password, new_password):
         change_wallet_password = {
             'method': 'change_wallet_password',